@@ -31,6 +31,7 @@
 #include <atheme/culture.h>
 #include <atheme/database_backend.h>
 #include <atheme/datastream.h>
+#include <atheme/deadline.h>
 #include <atheme/digest.h>
 #include <atheme/entity.h>
 #include <atheme/entity-validation.h>
@@ -44,8 +45,10 @@
 #include <atheme/linker.h>
 #include <atheme/match.h>
 #include <atheme/memory.h>
+#include <atheme/memtag.h>
 #include <atheme/module.h>
 #include <atheme/object.h>
+#include <atheme/pacing.h>
 #include <atheme/pbkdf2.h>
 #include <atheme/phandler.h>
 #include <atheme/pmodule.h>
@@ -65,6 +68,7 @@
 #include <atheme/table.h>
 #include <atheme/taint.h>
 #include <atheme/template.h>
+#include <atheme/timeheap.h>
 #include <atheme/tools.h>
 #include <atheme/uid.h>
 #include <atheme/uplink.h>
@@ -18,6 +18,6 @@
  * digits and set the rest to 0 (e.g. 330000). Otherwise, increment
  * the lower digits.
  */
-#define CURRENT_ABI_REVISION 730000U
+#define CURRENT_ABI_REVISION 730015U
 
 #endif /* !ATHEME_INC_ABIREV_H */
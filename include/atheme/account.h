@@ -15,42 +15,46 @@
 #include <atheme/object.h>
 #include <atheme/stdheaders.h>
 #include <atheme/structures.h>
+#include <atheme/timeheap.h>
 
 /* kline list struct */
 struct kline
 {
-	char *          user;
-	char *          host;
-	char *          reason;
-	char *          setby;
-	unsigned long   number;
-	long            duration;
-	time_t          settime;
-	time_t          expires;
+	char *                  user;
+	char *                  host;
+	char *                  reason;
+	char *                  setby;
+	unsigned long           number;
+	long                    duration;
+	time_t                  settime;
+	time_t                  expires;
+	struct deadline *       deadline;
 };
 
 /* xline list struct */
 struct xline
 {
-	char *          realname;
-	char *          reason;
-	char *          setby;
-	unsigned int    number;
-	long            duration;
-	time_t          settime;
-	time_t          expires;
+	char *                  realname;
+	char *                  reason;
+	char *                  setby;
+	unsigned int            number;
+	long                    duration;
+	time_t                  settime;
+	time_t                  expires;
+	struct deadline *       deadline;
 };
 
 /* qline list struct */
 struct qline
 {
-	char *          mask;
-	char *          reason;
-	char *          setby;
-	unsigned int    number;
-	long            duration;
-	time_t          settime;
-	time_t          expires;
+	char *                  mask;
+	char *                  reason;
+	char *                  setby;
+	unsigned int            number;
+	long                    duration;
+	time_t                  settime;
+	time_t                  expires;
+	struct deadline *       deadline;
 };
 
 /* services ignore struct */
@@ -63,6 +67,14 @@ struct svsignore
 	char *                  reason;
 };
 
+/* an account, nick or channel's place in the expiry queue (account.c) */
+struct expiry_node
+{
+	struct timeheap_node    node;
+	unsigned int            type;
+	void *                  obj;
+};
+
 /* services accounts */
 struct myuser
 {
@@ -84,6 +96,7 @@ struct myuser
 	mowgli_list_t           nicks;                  // registered nicks, must include mu->name if nonempty
 	struct language *       language;
 	mowgli_list_t           cert_fingerprints;
+	struct expiry_node      expiry;
 };
 
 /* Keep this synchronized with mu_flags in libathemecore/flags.c */
@@ -120,6 +133,7 @@ struct mynick
 	time_t                  registered;
 	time_t                  lastseen;
 	mowgli_node_t           node;   // for struct myuser -> nicks
+	struct expiry_node      expiry;
 };
 
 /* record about a name that used to exist */
@@ -149,6 +163,8 @@ struct mychan
 	unsigned int            mlock_limit;
 	char *                  mlock_key;
 	unsigned int            flags;
+	struct flood_message_queue *antiflood;  // owned by chanserv/antiflood
+	struct expiry_node      expiry;
 };
 
 /* Keep this synchronized with mc_flags in libathemecore/flags.c */
@@ -324,7 +340,7 @@ void kline_delete(struct kline *k);
 struct kline *kline_find(const char *user, const char *host);
 struct kline *kline_find_num(unsigned long number);
 struct kline *kline_find_user(struct user *u);
-void kline_expire(void *arg);
+void kline_schedule_expiry(struct kline *k);
 
 extern mowgli_list_t xlnlist;
 
@@ -333,7 +349,7 @@ void xline_delete(const char *realname);
 struct xline *xline_find(const char *realname);
 struct xline *xline_find_num(unsigned int number);
 struct xline *xline_find_user(struct user *u);
-void xline_expire(void *arg);
+void xline_schedule_expiry(struct xline *x);
 
 extern mowgli_list_t qlnlist;
 
@@ -344,7 +360,7 @@ struct qline *qline_find_match(const char *mask);
 struct qline *qline_find_num(unsigned int number);
 struct qline *qline_find_user(struct user *u);
 struct qline *qline_find_channel(struct channel *c);
-void qline_expire(void *arg);
+void qline_schedule_expiry(struct qline *q);
 
 /* account.c */
 extern mowgli_patricia_t *nicklist;
@@ -415,6 +431,11 @@ bool chanacs_change(struct mychan *mychan, struct myentity *mt, const char *host
 bool chanacs_change_simple(struct mychan *mychan, struct myentity *mt, const char *hostmask, unsigned int addflags, unsigned int removeflags, struct myentity *setter);
 
 void expire_check(void *arg);
+void myuser_expiry_update(struct myuser *mu);
+void mynick_expiry_update(struct mynick *mn);
+void mychan_expiry_update(struct mychan *mc);
+void expire_tick(void *arg);
+void expire_stats(void (*)(const char *, void *), void *);
 /* Check the database for (version) problems common to all backends */
 void db_check(void);
 
@@ -46,4 +46,17 @@ size_t base64_decode_table(const char *, void *, size_t, const char alphabet[sta
 size_t base64_encode(const void *, size_t, char *, size_t) ATHEME_FATTR_WUR;
 size_t base64_encode_table(const void *, size_t, char *, size_t, const char alphabet[static 65]) ATHEME_FATTR_WUR;
 
+/* The encoder and decoder use the best kernel the CPU supports. These let
+ * a benchmark list the kernels (in order of preference; the last one is the
+ * scalar code, which is always supported) and pin one of them. Selecting
+ * BASE64_KERNEL_AUTO goes back to picking the best one.
+ */
+#define BASE64_KERNEL_AUTO      ((size_t) -1)
+
+size_t base64_kernel_count(void);
+const char *base64_kernel_name(size_t);
+bool base64_kernel_supported(size_t);
+size_t base64_kernel_current(void);
+bool base64_kernel_select(size_t) ATHEME_FATTR_WUR;
+
 #endif /* !ATHEME_INC_BASE64_H */
@@ -67,6 +67,7 @@ struct chanban
 
 /* for struct channel -> flags */
 #define CHAN_LOG        0x00000001U /* logs sent to here */
+#define CHAN_SPLITTING  0x00000002U /* queued for bulk removal of split members */
 
 /* for struct chanuser -> modes */
 #define CSTATUS_OP      0x00000001U
@@ -130,6 +131,7 @@ void channel_delete(struct channel *c);
 
 struct chanuser *chanuser_add(struct channel *chan, const char *user);
 void chanuser_delete(struct channel *chan, struct user *user);
+void chanuser_delete_split(struct channel *chan);
 struct chanuser *chanuser_find(struct channel *chan, struct user *user);
 
 struct chanban *chanban_add(struct channel *chan, const char *mask, int type);
@@ -52,5 +52,6 @@ void strshare_init(void);
 stringref strshare_get(const char *str);
 stringref strshare_ref(stringref str);
 void strshare_unref(stringref str);
+void strshare_stats(void (*)(const char *, void *), void *);
 
 #endif /* !ATHEME_INC_COMMON_H */
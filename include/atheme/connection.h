@@ -52,6 +52,13 @@ struct connection
 	struct connection *             listener;
 	void *                          userdata;
 	mowgli_eventloop_pollable_t *   pollable;
+	size_t                          sendq_len;
+	mowgli_node_t                   node;
+	mowgli_node_t                   listener_node;
+	mowgli_list_t                   children;
+	unsigned int                    accepts;
+	uint64_t                        bytes_in;
+	uint64_t                        bytes_out;
 };
 
 #define CF_UPLINK     0x00000001U
@@ -20,9 +20,13 @@ extern bool strict_mode;
 enum database_transaction
 {
 	DB_READ,
-	DB_WRITE
+	DB_WRITE,
+	DB_SNAPSHOT     // like DB_WRITE, but serialised to memory and written out in the background
 };
 
+// leading bytes of a database written with general::db_compression (a zstd frame)
+#define DB_COMPRESSED_MAGIC     "\x28\xB5\x2F\xFD"
+
 struct database_vtable
 {
 	const char *    name;
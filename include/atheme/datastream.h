@@ -14,9 +14,11 @@
 #include <atheme/structures.h>
 
 void sendq_add(struct connection *cptr, char *buf, size_t len);
+void sendq_add_file(struct connection *cptr, int fd, off_t offset, size_t len);
 void sendq_add_eof(struct connection *cptr);
 void sendq_flush(struct connection *cptr);
 bool sendq_nonempty(struct connection *cptr);
+size_t sendq_length(struct connection *cptr);
 void sendq_set_limit(struct connection *cptr, size_t len);
 
 int recvq_length(struct connection *cptr);
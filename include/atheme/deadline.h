@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * One-shot per-object timeouts.
+ */
+
+#ifndef ATHEME_INC_DEADLINE_H
+#define ATHEME_INC_DEADLINE_H 1
+
+#include <atheme/stdheaders.h>
+#include <atheme/timeheap.h>
+
+typedef void (*deadline_fn)(void *arg);
+
+struct deadline
+{
+	struct timeheap_node    node;
+	deadline_fn             fn;
+	void *                  arg;
+	const char *            name;
+};
+
+void deadline_init(void);
+struct deadline *deadline_add(const char *name, deadline_fn fn, void *arg, time_t when);
+void deadline_move(struct deadline *d, time_t when);
+void deadline_delete(struct deadline *d);
+void deadline_stats(void (*stats_cb)(const char *, void *), void *privdata);
+
+#endif /* !ATHEME_INC_DEADLINE_H */
@@ -67,11 +67,18 @@ struct ConfOption
 	unsigned int    flood_time;             // time determining flood
 	unsigned int    ratelimit_uses;         // uses of a ratelimited command
 	unsigned int    ratelimit_period;       // period in which ratelimit_uses are done
+	unsigned int    pacing_burst;           // reply lines a user gets before pacing starts
+	unsigned int    pacing_rate;            // paced reply lines per second per user (0 = off)
+	unsigned int    pacing_bulk_rate;       // mass notice lines per second (0 = off)
+	unsigned int    pacing_queue_max;       // paced lines queued per user (0 = no limit)
+	unsigned int    pacing_queue_total;     // paced lines queued altogether (0 = no limit)
 	unsigned int    kline_time;             // default expire for klines
 	unsigned int    vhost_change;           // days in which a user must wait between vhost changes
 	unsigned int    clone_time;             // default expire for clone exemptions
 	unsigned int    commit_interval;        // interval between commits
+	unsigned int    db_compression;         // zstd level for opensex database writes (0 = plain text)
 	bool            db_save_blocking;       // whether to always use a blocking database commit
+	bool            db_save_threaded;       // whether to write the database from a thread instead of forking
 	bool            silent;                 // stop sending WALLOPS?
 	bool            join_chans;             // join registered channels?
 	bool            leave_chans;            // leave channels when empty?
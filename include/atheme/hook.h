@@ -76,6 +76,17 @@ struct hook_channel_req
 	struct sourceinfo * si;
 };
 
+struct hook_channel_split
+{
+	/* Called once per channel before the members on SF_SPLITTING servers
+	 * are removed in bulk; channel_part is not called for them, so any
+	 * module that keeps state on channel_part must handle this too. By
+	 * the time user_delete is called for those users, their channel
+	 * lists are already empty. */
+	struct channel *    chan;
+	unsigned int        parting;    // number of members about to go
+};
+
 struct hook_channel_succession_req
 {
 	struct mychan * mc;
@@ -238,4 +249,11 @@ void hook_call_event(const char *, void *);
 void hook_stop(void);
 void hook_continue(void *newptr);
 
+/* If set, called as each event starts (done is false) and once its handlers
+ * have all run (done is true), with how many events it is nested in (0 if it
+ * was raised from outside any other hook). For benchmarks, which take their
+ * own timestamps; the core does not read any clock for this.
+ */
+extern void (*hook_timing_fn)(const char *event, bool done, unsigned int depth);
+
 #endif /* !ATHEME_INC_HOOK_H */
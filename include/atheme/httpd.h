@@ -33,4 +33,14 @@ struct httpddata
 	bool            sent_reply;
 };
 
+/* Exported by misc/httpd as httpd_core_functions. A route is matched
+ * against the path of a request (without any query string); adding a
+ * handler that is already routed moves it to its current path.
+ */
+struct httpd_core_functions
+{
+	void          (*route_add)(const struct path_handler *);
+	void          (*route_del)(const struct path_handler *);
+};
+
 #endif /* !ATHEME_INC_HTTPD_H */
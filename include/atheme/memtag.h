@@ -0,0 +1,87 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Live memory accounting per subsystem and per module.
+ */
+
+#ifndef ATHEME_INC_MEMTAG_H
+#define ATHEME_INC_MEMTAG_H 1
+
+#include <atheme/stdheaders.h>
+
+/* A tag counts the objects and bytes its callers currently hold. Callers
+ * pass the size they asked the allocator for (for heaps, the element size);
+ * allocator overhead is not included.
+ */
+struct memtag
+{
+	const char *    owner;          // "core", or the name of the module
+	const char *    name;
+	size_t          objects;
+	size_t          bytes;
+	size_t          peak;           // high-water mark of bytes
+	mowgli_node_t   node;
+};
+
+enum memtag_core
+{
+	MEMTAG_USERS = 0,
+	MEMTAG_CHANNELS,
+	MEMTAG_CHANUSERS,
+	MEMTAG_CHANBANS,
+	MEMTAG_STRSHARE,
+	MEMTAG_METADATA,
+	MEMTAG_MYUSERS,
+	MEMTAG_MYNICKS,
+	MEMTAG_MYCHANS,
+	MEMTAG_CHANACS,
+	MEMTAG_MEMOS,
+	MEMTAG_SENDQ,
+	MEMTAG_SERVERS,
+	MEMTAG_KLINES,
+	MEMTAG_XLINES,
+	MEMTAG_QLINES,
+	MEMTAG_CERTFPS,
+	MEMTAG_AUTHCOOKIES,
+	MEMTAG_CORE_COUNT
+};
+
+extern struct memtag memtag_core[MEMTAG_CORE_COUNT];
+
+static inline void
+memtag_alloc(struct memtag *const restrict tag, const size_t len)
+{
+	tag->objects++;
+	tag->bytes += len;
+
+	if (tag->bytes > tag->peak)
+		tag->peak = tag->bytes;
+}
+
+static inline void
+memtag_free(struct memtag *const restrict tag, const size_t len)
+{
+	tag->objects--;
+	tag->bytes -= len;
+}
+
+// for memory which grows or shrinks without changing the number of objects
+static inline void
+memtag_resize(struct memtag *const restrict tag, const size_t oldlen, const size_t newlen)
+{
+	tag->bytes -= oldlen;
+	tag->bytes += newlen;
+
+	if (tag->bytes > tag->peak)
+		tag->peak = tag->bytes;
+}
+
+struct memtag *memtag_get(const char *owner, const char *name);
+void memtag_release(struct memtag *tag);
+void memtag_foreach(void (*cb)(const struct memtag *, void *), void *privdata);
+void memtag_stats(void (*stats_cb)(const char *, void *), void *privdata);
+
+#endif /* !ATHEME_INC_MEMTAG_H */
@@ -19,13 +19,15 @@ struct metadata
 	char *          value;
 };
 
+struct metadata_table;
+
 typedef void (*atheme_object_destructor_fn)(void *);
 
 struct atheme_object
 {
 	int                             refcount;
 	atheme_object_destructor_fn     destructor;
-	mowgli_patricia_t *             metadata;
+	struct metadata_table *         metadata;
 	mowgli_patricia_t *             privatedata;
 #ifdef OBJECT_DEBUG
 	mowgli_node_t                   dnode;
@@ -44,6 +46,22 @@ struct metadata *metadata_add(void *target, const char *name, const char *value)
 void metadata_delete(void *target, const char *name);
 struct metadata *metadata_find(void *target, const char *name);
 void metadata_delete_all(void *target);
+unsigned int metadata_count(void *target);
+
+struct metadata_iteration_state
+{
+	struct atheme_object *  obj;
+	unsigned int            pos;
+	struct metadata *       cur;
+};
+
+void metadata_foreach_start(void *target, struct metadata_iteration_state *state);
+void metadata_foreach_next(struct metadata_iteration_state *state);
+
+/* Iterates over an object's metadata in name order. Deleting the
+ * current entry from inside the loop is allowed. */
+#define METADATA_FOREACH(md, state, target) \
+	for (metadata_foreach_start((target), (state)); ((md) = (state)->cur) != NULL; metadata_foreach_next((state)))
 
 void *privatedata_get(void *target, const char *key);
 void privatedata_set(void *target, const char *key, void *data);
@@ -0,0 +1,38 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Output pacing for long replies and mass notices.
+ */
+
+#ifndef ATHEME_INC_PACING_H
+#define ATHEME_INC_PACING_H 1
+
+#include <atheme/stdheaders.h>
+#include <atheme/structures.h>
+
+/* Lower values are more urgent; when contexts nest, the least urgent one
+ * wins, so a notice sent on behalf of a bulk operation stays bulk.
+ */
+enum send_class
+{
+	SEND_CLASS_IMMEDIATE    = 0,    // protocol traffic, SASL, etc.; never delayed
+	SEND_CLASS_INTERACTIVE  = 1,    // replies to a user's command; paced per target
+	SEND_CLASS_BULK         = 2,    // mass notices; paced globally, behind everything else
+};
+
+struct send_pacing
+{
+	enum send_class         cls;
+	const struct user *     target;
+};
+
+void pacing_init(void);
+void send_pacing_enter(enum send_class cls, const struct user *target, struct send_pacing *saved);
+void send_pacing_leave(const struct send_pacing *saved);
+bool pacing_defer(const char *buf, size_t len);
+void pacing_stats(void (*stats_cb)(const char *, void *), void *privdata);
+
+#endif /* !ATHEME_INC_PACING_H */
@@ -35,6 +35,7 @@ struct server
 #define SF_EOB2        0x00000004U /* Is EOB but an uplink is not (for P10) */
 #define SF_JUPE_PENDING 0x00000008U /* Sent SQUIT request, will introduce jupe when it dies (unconnect semantics) */
 #define SF_MASKED      0x00000010U /* Is masked, has no own name (for ircnet) */
+#define SF_SPLITTING   0x00000020U /* Being removed in a netsplit, users are going away in bulk */
 
 /* tld list struct */
 struct tld
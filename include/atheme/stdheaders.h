@@ -68,6 +68,16 @@
 #  include <netinet/in.h>
 #endif
 
+#ifdef HAVE_POLL_H
+// struct pollfd, poll(), POLL*
+#  include <poll.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+// pthread_t, pthread_create(), pthread_join(), ...
+#  include <pthread.h>
+#endif
+
 #ifdef HAVE_REGEX_H
 // regex_t, regcomp(), regexec(), regerror(), regfree()
 #  include <regex.h>
@@ -118,6 +128,11 @@
 #  include <sys/resource.h>
 #endif
 
+#ifdef HAVE_SYS_SENDFILE_H
+// sendfile()
+#  include <sys/sendfile.h>
+#endif
+
 #ifdef HAVE_SYS_SOCKET_H
 // SHUT_*, struct mmsghdr, socket(), socketpair(), bind(), connect(), ...
 #  include <sys/socket.h>
@@ -133,6 +148,11 @@
 #  include <sys/time.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+// struct iovec, readv(), writev(), ...
+#  include <sys/uio.h>
+#endif
+
 #ifdef HAVE_SYS_WAIT_H
 // W*, wait(), waitpid(), ...
 #  include <sys/wait.h>
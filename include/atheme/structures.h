@@ -34,6 +34,9 @@ struct connection;
 // Defined in atheme/crypto.h
 struct crypt_impl;
 
+// Defined in atheme/deadline.h
+struct deadline;
+
 // Defined in atheme/culture.h
 struct language;
 struct translation;
@@ -78,6 +81,9 @@ struct v4_moduleheader;
 struct atheme_object;
 struct metadata;
 
+// Defined in atheme/pacing.h
+struct send_pacing;
+
 // Defined in atheme/pcommand.h
 struct proto_cmd;
 
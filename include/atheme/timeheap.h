@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Indexed binary min-heap keyed on a time.
+ */
+
+#ifndef ATHEME_INC_TIMEHEAP_H
+#define ATHEME_INC_TIMEHEAP_H 1
+
+#include <atheme/stdheaders.h>
+
+/* A node is embedded in whatever is being scheduled, and records its own
+ * slot in the heap, so that it can be moved or removed in O(log n). Use
+ * TIMEHEAP_ENTRY() to get from a node back to the structure holding it.
+ */
+struct timeheap_node
+{
+	time_t          when;
+	size_t          index;          // slot + 1, or 0 if not in a heap
+};
+
+struct timeheap
+{
+	struct timeheap_node **     nodes;
+	size_t                      len;
+	size_t                      alloc;
+};
+
+#define TIMEHEAP_ENTRY(ptr, type, member) \
+	((type *) (void *) ((char *) (ptr) - offsetof(type, member)))
+
+static inline struct timeheap_node *
+timeheap_first(const struct timeheap *const restrict heap)
+{
+	return heap->len ? heap->nodes[0] : NULL;
+}
+
+static inline bool
+timeheap_queued(const struct timeheap_node *const restrict node)
+{
+	return node->index != 0;
+}
+
+void timeheap_schedule(struct timeheap *heap, struct timeheap_node *node, time_t when);
+void timeheap_remove(struct timeheap *heap, struct timeheap_node *node);
+
+#endif /* !ATHEME_INC_TIMEHEAP_H */
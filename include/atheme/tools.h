@@ -20,6 +20,8 @@
 
 /* email stuff */
 int sendemail(struct user *u, struct myuser *mu, const char *type, const char *email, const char *param);
+bool email_queue_add(const char *rcpt, const char *msg, size_t len);
+long email_queue_deliver(void);
 
 /* email types (meaning of param argument) */
 #define EMAIL_REGISTER	"register"	/* register an account/nick (verification code) */
@@ -30,6 +32,7 @@ int sendemail(struct user *u, struct myuser *mu, const char *type, const char *e
 
 /* cidr.c */
 int valid_ip_or_mask(const char *src);
+unsigned int parse_ip_cidr(const char *src, unsigned char *dst, unsigned int *cidrlen);
 
 enum log_type
 {
@@ -170,6 +173,7 @@ int tokenize(char *message, char **parv);
 /* ubase64.c */
 const char *uinttobase64(char *buf, uint64_t v, int64_t count);
 unsigned int base64touint(const char *buf);
+bool base64touint_exact(const char *buf, size_t len, unsigned int *out);
 void decode_p10_ip(const char *b64, char ipstring[HOSTIPLEN + 1]);
 
 #if !HAVE_VSNPRINTF
@@ -29,6 +29,18 @@ static mowgli_heap_t *myuser_name_heap;	/* HEAP_USER / 2 */
 static mowgli_heap_t *mychan_heap;	/* HEAP_CHANNEL */
 static mowgli_heap_t *chanacs_heap;	/* HEAP_CHANACS */
 
+enum expiry_type
+{
+	EXPIRY_MYUSER,
+	EXPIRY_MYNICK,
+	EXPIRY_MYCHAN,
+};
+
+static void expiry_remove(struct expiry_node *e);
+static void expiry_config_ready(void *unused);
+static void expiry_user_register(struct myuser *mu);
+static void expiry_user_rename(struct hook_user_rename *hdata);
+
 /*
  * init_accounts()
  *
@@ -64,6 +76,10 @@ init_accounts(void)
 	oldnameslist = mowgli_patricia_create(irccasecanon);
 	mclist = mowgli_patricia_create(irccasecanon);
 	certfplist = mowgli_patricia_create(strcasecanon);
+
+	hook_add_config_ready(expiry_config_ready);
+	hook_add_user_register(expiry_user_register);
+	hook_add_user_rename(expiry_user_rename);
 }
 
 /*
@@ -115,6 +131,7 @@ myuser_add_id(const char *id, const char *name, const char *pass, const char *em
 		slog(LG_DEBUG, "myuser_add(): %s -> %s", name, email);
 
 	mu = mowgli_heap_alloc(myuser_heap);
+	memtag_alloc(&memtag_core[MEMTAG_MYUSERS], sizeof *mu);
 	atheme_object_init(atheme_object(mu), name, (atheme_object_destructor_fn) myuser_delete);
 
 	entity(mu)->type = ENT_USER;
@@ -132,6 +149,7 @@ myuser_add_id(const char *id, const char *name, const char *pass, const char *em
 		entity(mu)->id[0] = '\0';
 
 	mu->registered = CURRTIME;
+	mu->lastlogin = CURRTIME;
 	mu->flags = flags;
 	if (mu->flags & MU_ENFORCE)
 	{
@@ -162,6 +180,10 @@ myuser_add_id(const char *id, const char *name, const char *pass, const char *em
 
 	myuser_name_restore(entity(mu)->name, mu);
 
+	mu->expiry.type = EXPIRY_MYUSER;
+	mu->expiry.obj = mu;
+	myuser_expiry_update(mu);
+
 	cnt.myuser++;
 
 	return mu;
@@ -274,6 +296,7 @@ myuser_delete(struct myuser *mu)
 
 		mowgli_node_delete(n, &mu->memos);
 		mowgli_node_free(n);
+		memtag_free(&memtag_core[MEMTAG_MEMOS], sizeof *memo);
 		sfree(memo);
 	}
 
@@ -312,6 +335,8 @@ myuser_delete(struct myuser *mu)
 	if (nicks[0] != '\0')
 		slog(LG_REGISTER, "DELETE: \2%s\2 from \2%s\2", nicks, entity(mu)->name);
 
+	expiry_remove(&mu->expiry);
+
 	/* entity(mu)->name is the index for this dtree */
 	myentity_del(entity(mu));
 
@@ -319,6 +344,7 @@ myuser_delete(struct myuser *mu)
 	strshare_unref(mu->email_canonical);
 	strshare_unref(entity(mu)->name);
 
+	memtag_free(&memtag_core[MEMTAG_MYUSERS], sizeof *mu);
 	mowgli_heap_free(myuser_heap, mu);
 
 	cnt.myuser--;
@@ -681,17 +707,23 @@ mynick_add(struct myuser *mu, const char *name)
 		slog(LG_DEBUG, "mynick_add(): %s -> %s", name, entity(mu)->name);
 
 	mn = mowgli_heap_alloc(mynick_heap);
+	memtag_alloc(&memtag_core[MEMTAG_MYNICKS], sizeof *mn);
 	atheme_object_init(atheme_object(mn), name, (atheme_object_destructor_fn) mynick_delete);
 
 	mowgli_strlcpy(mn->nick, name, sizeof mn->nick);
 	mn->owner = mu;
 	mn->registered = CURRTIME;
+	mn->lastseen = CURRTIME;
 
 	mowgli_patricia_add(nicklist, mn->nick, mn);
 	mowgli_node_add(mn, &mn->node, &mu->nicks);
 
 	myuser_name_restore(mn->nick, mu);
 
+	mn->expiry.type = EXPIRY_MYNICK;
+	mn->expiry.obj = mn;
+	mynick_expiry_update(mn);
+
 	cnt.mynick++;
 
 	return mn;
@@ -721,9 +753,12 @@ mynick_delete(struct mynick *mn)
 
 	myuser_name_remember(mn->nick, mn->owner);
 
+	expiry_remove(&mn->expiry);
+
 	mowgli_patricia_delete(nicklist, mn->nick);
 	mowgli_node_delete(&mn->node, &mn->owner->nicks);
 
+	memtag_free(&memtag_core[MEMTAG_MYNICKS], sizeof *mn);
 	mowgli_heap_free(mynick_heap, mn);
 
 	cnt.mynick--;
@@ -866,7 +901,7 @@ myuser_name_restore(const char *name, struct myuser *mu)
 {
 	struct myuser_name *mun;
 	struct metadata *md, *md2;
-	mowgli_patricia_iteration_state_t state;
+	struct metadata_iteration_state state;
 	char *copy;
 
 	mun = myuser_name_find(name);
@@ -891,7 +926,7 @@ myuser_name_restore(const char *name, struct myuser *mu)
 
 	if (atheme_object(mun)->metadata)
 	{
-		MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mun)->metadata)
+		METADATA_FOREACH(md, &state, mun)
 		{
 			/* prefer current metadata to saved */
 			if (!metadata_find(mu, md->name))
@@ -929,6 +964,7 @@ mycertfp_add(struct myuser *mu, const char *certfp)
 	return_val_if_fail(certfp != NULL, NULL);
 
 	mcfp = mowgli_heap_alloc(mycertfp_heap);
+	memtag_alloc(&memtag_core[MEMTAG_CERTFPS], sizeof *mcfp);
 	mcfp->mu = mu;
 	mcfp->certfp = sstrdup(certfp);
 
@@ -949,6 +985,7 @@ mycertfp_delete(struct mycertfp *mcfp)
 	mowgli_patricia_delete(certfplist, mcfp->certfp);
 
 	sfree(mcfp->certfp);
+	memtag_free(&memtag_core[MEMTAG_CERTFPS], sizeof *mcfp);
 	mowgli_heap_free(mycertfp_heap, mcfp);
 }
 
@@ -984,10 +1021,13 @@ mychan_delete(struct mychan *mc)
 
 	metadata_delete_all(mc);
 
+	expiry_remove(&mc->expiry);
+
 	mowgli_patricia_delete(mclist, mc->name);
 
 	strshare_unref(mc->name);
 
+	memtag_free(&memtag_core[MEMTAG_MYCHANS], sizeof *mc);
 	mowgli_heap_free(mychan_heap, mc);
 
 	cnt.mychan--;
@@ -1005,10 +1045,12 @@ mychan_add(char *name)
 		slog(LG_DEBUG, "mychan_add(): %s", name);
 
 	mc = mowgli_heap_alloc(mychan_heap);
+	memtag_alloc(&memtag_core[MEMTAG_MYCHANS], sizeof *mc);
 
 	atheme_object_init(atheme_object(mc), name, (atheme_object_destructor_fn) mychan_delete);
 	mc->name = strshare_get(name);
 	mc->registered = CURRTIME;
+	mc->used = CURRTIME;
 	mc->chan = channel_find(name);
 
 	if (mc->chan != NULL)
@@ -1016,6 +1058,10 @@ mychan_add(char *name)
 
 	mowgli_patricia_add(mclist, mc->name, mc);
 
+	mc->expiry.type = EXPIRY_MYCHAN;
+	mc->expiry.obj = mc;
+	mychan_expiry_update(mc);
+
 	cnt.mychan++;
 
 	return mc;
@@ -1398,6 +1444,7 @@ chanacs_delete(struct chanacs *ca)
 
 	sfree(ca->host);
 
+	memtag_free(&memtag_core[MEMTAG_CHANACS], sizeof *ca);
 	mowgli_heap_free(chanacs_heap, ca);
 
 	cnt.chanacs--;
@@ -1437,6 +1484,7 @@ chanacs_add(struct mychan *mychan, struct myentity *mt, unsigned int level, time
 		slog(LG_DEBUG, "chanacs_add(): %s -> %s", mychan->name, mt->name);
 
 	ca = mowgli_heap_alloc(chanacs_heap);
+	memtag_alloc(&memtag_core[MEMTAG_CHANACS], sizeof *ca);
 
 	atheme_object_init(atheme_object(ca), mt->name, (atheme_object_destructor_fn) chanacs_delete);
 	ca->mychan = mychan;
@@ -1492,6 +1540,7 @@ chanacs_add_host(struct mychan *mychan, const char *host, unsigned int level, ti
 		slog(LG_DEBUG, "chanacs_add_host(): %s -> %s", mychan->name, host);
 
 	ca = mowgli_heap_alloc(chanacs_heap);
+	memtag_alloc(&memtag_core[MEMTAG_CHANACS], sizeof *ca);
 
 	atheme_object_init(atheme_object(ca), host, (atheme_object_destructor_fn) chanacs_delete);
 	ca->mychan = mychan;
@@ -2015,13 +2064,161 @@ chanacs_change_simple(struct mychan *mychan, struct myentity *mt, const char *ho
 	return chanacs_change(mychan, mt, hostmask, &a, &r, ca_all, setter);
 }
 
-static int
-expire_myuser_cb(struct myentity *mt, void *unused)
+/* Expiry scheduling.
+ *
+ * Instead of walking every account, nick and channel once an hour, each
+ * of them carries a struct expiry_node that places it in a min-heap keyed
+ * on the earliest time it could possibly expire (last use + expiry
+ * period). expire_tick() checks a bounded number of due entries every
+ * second; anything that survives is moved to its new due time.
+ *
+ * The heap is the same one deadlines use (timeheap.c); the node records its
+ * slot, so an object is queued at most once and can be moved or removed in
+ * O(log n). Objects are queued when they are
+ * created and leave the queue when they are destroyed. Nothing is queued
+ * while the relevant expiry period is 0, except unverified accounts and
+ * channels that need their last used time refreshed.
+ *
+ * A due time may be earlier than necessary: the object is simply checked
+ * and moved forward. That is why code that marks an object as used does
+ * not need to touch the queue, while code that backdates the last use (the
+ * database loaders) calls the *_expiry_update() functions below.
+ */
+
+#define EXPIRY_BATCH            100U
+#define EXPIRY_RECHECK          SECONDS_PER_HOUR
+
+/* see the last used time refresh in expire_mychan() */
+#define EXPIRY_REFRESH          (SECONDS_PER_DAY - SECONDS_PER_HOUR - SECONDS_PER_MINUTE)
+
+static struct timeheap expiry_heap;
+
+static struct
 {
-	struct hook_expiry_req req;
-	struct myuser *mu = user(mt);
+	uint64_t        checked;
+	uint64_t        myusers;
+	uint64_t        mynicks;
+	uint64_t        mychans;
+	unsigned int    last_batch;
+} expiry_stats;
+
+static inline struct expiry_node *
+expiry_first(void)
+{
+	struct timeheap_node *const node = timeheap_first(&expiry_heap);
 
-	return_val_if_fail(isuser(mt), 0);
+	return node ? TIMEHEAP_ENTRY(node, struct expiry_node, node) : NULL;
+}
+
+static void
+expiry_remove(struct expiry_node *e)
+{
+	timeheap_remove(&expiry_heap, &e->node);
+}
+
+/* queue the object to be checked at `due', or dequeue it if that is 0 */
+static void
+expiry_schedule(struct expiry_node *e, time_t due)
+{
+	if (due == 0)
+		expiry_remove(e);
+	else
+		timeheap_schedule(&expiry_heap, &e->node, due);
+}
+
+/* like expiry_schedule(), but never moves an entry later */
+static void
+expiry_update(struct expiry_node *e, time_t due)
+{
+	if (due != 0 && timeheap_queued(&e->node) && e->node.when <= due)
+		return;
+
+	expiry_schedule(e, due);
+}
+
+static time_t
+expiry_due_myuser(const struct myuser *mu)
+{
+	time_t due = 0;
+
+	if (nicksvs.expiry > 0)
+		due = mu->lastlogin + (time_t) nicksvs.expiry;
+	if ((mu->flags & MU_WAITAUTH) && (due == 0 || mu->registered + SECONDS_PER_DAY < due))
+		due = mu->registered + SECONDS_PER_DAY;
+
+	return due;
+}
+
+static time_t
+expiry_due_mynick(const struct mynick *mn)
+{
+	/* the main nick goes with the account, see expire_mynick() */
+	if (nicksvs.expiry == 0 || !irccasecmp(mn->nick, entity(mn->owner)->name))
+		return 0;
+
+	return mn->lastseen + (time_t) nicksvs.expiry;
+}
+
+/* an idle channel needs no last used time refresh until someone joins it */
+static time_t
+expiry_due_mychan(const struct mychan *mc, bool idle)
+{
+	time_t due = 0;
+
+	if (!idle)
+		due = mc->used + EXPIRY_REFRESH;
+	if (chansvs.expiry > 0 && (due == 0 || mc->used + (time_t) chansvs.expiry < due))
+		due = mc->used + (time_t) chansvs.expiry;
+
+	return due;
+}
+
+/*
+ * myuser_expiry_update(struct myuser *mu)
+ * mynick_expiry_update(struct mynick *mn)
+ * mychan_expiry_update(struct mychan *mc)
+ *
+ * Makes sure the object is checked for expiry no later than its current
+ * last use time allows.
+ *
+ * Inputs:
+ *      - account, nick or channel
+ *
+ * Outputs:
+ *      - nothing
+ *
+ * Side Effects:
+ *      - the object is queued, moved earlier or dequeued
+ */
+void
+myuser_expiry_update(struct myuser *mu)
+{
+	return_if_fail(mu != NULL);
+
+	expiry_update(&mu->expiry, expiry_due_myuser(mu));
+}
+
+void
+mynick_expiry_update(struct mynick *mn)
+{
+	return_if_fail(mn != NULL);
+
+	expiry_update(&mn->expiry, expiry_due_mynick(mn));
+}
+
+void
+mychan_expiry_update(struct mychan *mc)
+{
+	return_if_fail(mc != NULL);
+
+	expiry_update(&mc->expiry, expiry_due_mychan(mc, false));
+}
+
+/* returns true if the account was expired */
+static bool
+expire_myuser(struct myuser *mu)
+{
+	struct hook_expiry_req req;
 
 	/* If they're logged in, update lastlogin time.
 	 * To decrease db traffic, may want to only do
@@ -2031,18 +2228,18 @@ expire_myuser_cb(struct myentity *mt, void *unused)
 	if (MOWGLI_LIST_LENGTH(&mu->logins) > 0)
 	{
 		mu->lastlogin = CURRTIME;
-		return 0;
+		return false;
 	}
 
 	if (MU_HOLD & mu->flags)
-		return 0;
+		return false;
 
 	req.data.mu = mu;
 	req.do_expire = 1;
 	hook_call_user_check_expire(&req);
 
 	if (!req.do_expire)
-		return 0;
+		return false;
 
 	if ((nicksvs.expiry > 0 && mu->lastlogin < CURRTIME && (unsigned int)(CURRTIME - mu->lastlogin) >= nicksvs.expiry) ||
 			(mu->flags & MU_WAITAUTH && (CURRTIME - mu->registered) >= SECONDS_PER_DAY))
@@ -2051,7 +2248,7 @@ expire_myuser_cb(struct myentity *mt, void *unused)
 		 * otherwise someone can reregister
 		 * them and take the privs -- jilles */
 		if (is_conf_soper(mu))
-			return 0;
+			return false;
 
 		slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2 ", entity(mu)->name, mu->email);
 		slog(LG_VERBOSE, "expire_check(): expiring account %s (unused %ds, email %s, nicks %zu, chanacs %zu)",
@@ -2059,106 +2256,261 @@ expire_myuser_cb(struct myentity *mt, void *unused)
 				mu->email, MOWGLI_LIST_LENGTH(&mu->nicks),
 				MOWGLI_LIST_LENGTH(&entity(mu)->chanacs));
 		atheme_object_dispose(mu);
+		return true;
 	}
 
-	return 0;
+	return false;
 }
 
-void
-expire_check(void *arg)
+/* returns true if the nick was expired */
+static bool
+expire_mynick(struct mynick *mn)
 {
-	struct mynick *mn;
-	struct mychan *mc;
-	struct user *u;
-	mowgli_patricia_iteration_state_t state;
 	struct hook_expiry_req req;
+	struct user *u;
 
-	/* Let them know about this and the likely subsequent db_save()
-	 * right away -- jilles */
-	if (curr_uplink != NULL && curr_uplink->conn != NULL)
-		sendq_flush(curr_uplink->conn);
+	req.do_expire = 1;
+	req.data.mn = mn;
+
+	hook_call_nick_check_expire(&req);
 
-	myentity_foreach_t(ENT_USER, expire_myuser_cb, NULL);
+	if (!req.do_expire)
+		return false;
 
-	MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+	if (nicksvs.expiry > 0 && mn->lastseen < CURRTIME &&
+			(unsigned int)(CURRTIME - mn->lastseen) >= nicksvs.expiry)
 	{
-		req.do_expire = 1;
-		req.data.mn = mn;
+		if (MU_HOLD & mn->owner->flags)
+			return false;
 
-		hook_call_nick_check_expire(&req);
+		/* do not drop main nick like this */
+		if (!irccasecmp(mn->nick, entity(mn->owner)->name))
+			return false;
 
-		if (!req.do_expire)
-			continue;
-
-		if (nicksvs.expiry > 0 && mn->lastseen < CURRTIME &&
-				(unsigned int)(CURRTIME - mn->lastseen) >= nicksvs.expiry)
+		u = user_find_named(mn->nick);
+		if (u != NULL && u->myuser == mn->owner)
 		{
-			if (MU_HOLD & mn->owner->flags)
-				continue;
+			/* still logged in, bleh */
+			mn->lastseen = CURRTIME;
+			mn->owner->lastlogin = CURRTIME;
+			return false;
+		}
 
-			/* do not drop main nick like this */
-			if (!irccasecmp(mn->nick, entity(mn->owner)->name))
-				continue;
+		slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mn->nick, entity(mn->owner)->name);
+		slog(LG_VERBOSE, "expire_check(): expiring nick %s (unused %lds, account %s)",
+				mn->nick, (long)(CURRTIME - mn->lastseen),
+				entity(mn->owner)->name);
+		atheme_object_unref(mn);
+		return true;
+	}
 
-			u = user_find_named(mn->nick);
-			if (u != NULL && u->myuser == mn->owner)
-			{
-				/* still logged in, bleh */
-				mn->lastseen = CURRTIME;
-				mn->owner->lastlogin = CURRTIME;
-				continue;
-			}
+	return false;
+}
 
-			slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mn->nick, entity(mn->owner)->name);
-			slog(LG_VERBOSE, "expire_check(): expiring nick %s (unused %lds, account %s)",
-					mn->nick, (long)(CURRTIME - mn->lastseen),
-					entity(mn->owner)->name);
-			atheme_object_unref(mn);
+/* returns true if the channel was expired */
+static bool
+expire_mychan(struct mychan *mc)
+{
+	struct hook_expiry_req req;
+
+	req.do_expire = 1;
+	req.data.mc = mc;
+
+	hook_call_channel_check_expire(&req);
+
+	if (!req.do_expire)
+		return false;
+
+	if ((unsigned int) (CURRTIME - mc->used) >= EXPIRY_REFRESH)
+	{
+		/* keep last used time accurate to
+		 * within a day, making sure an active
+		 * channel will never get "Last used"
+		 * in /cs info -- jilles */
+		if (mychan_isused(mc))
+		{
+			mc->used = CURRTIME;
+			slog(LG_DEBUG, "expire_check(): updating last used time on %s because it appears to be still in use", mc->name);
+			return false;
 		}
 	}
 
-	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+	if (chansvs.expiry > 0 && mc->used < CURRTIME &&
+			(unsigned int)(CURRTIME - mc->used) >= chansvs.expiry)
 	{
-		req.do_expire = 1;
-		req.data.mc = mc;
+		if (MC_HOLD & mc->flags)
+			return false;
 
-		hook_call_channel_check_expire(&req);
+		slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mc->name, mychan_founder_names(mc));
+		slog(LG_VERBOSE, "expire_check(): expiring channel %s (unused %lds, founder %s, chanacs %zu)",
+				mc->name, (long)(CURRTIME - mc->used),
+				mychan_founder_names(mc),
+				MOWGLI_LIST_LENGTH(&mc->chanacs));
 
-		if (!req.do_expire)
-			continue;
+		hook_call_channel_drop(mc);
+		if (mc->chan != NULL && !(mc->chan->flags & CHAN_LOG))
+			part(mc->name, chansvs.nick);
+
+		atheme_object_unref(mc);
+		return true;
+	}
+
+	return false;
+}
+
+/* check up to `limit' due entries, returns the number checked */
+static unsigned int
+expiry_run(unsigned int limit)
+{
+	struct expiry_node *e;
+	struct myuser *mu;
+	struct mynick *mn;
+	struct mychan *mc;
+	unsigned int done = 0;
+	time_t due;
 
-		if ((unsigned int) (CURRTIME - mc->used) >= (SECONDS_PER_DAY - SECONDS_PER_HOUR - SECONDS_PER_MINUTE))
+	while (done < limit && (e = expiry_first()) != NULL && e->node.when <= CURRTIME)
+	{
+		done++;
+		due = 0;
+
+		/* dequeue first: expiring an object frees the node with it */
+		expiry_remove(e);
+
+		switch (e->type)
 		{
-			/* keep last used time accurate to
-			 * within a day, making sure an active
-			 * channel will never get "Last used"
-			 * in /cs info -- jilles */
-			if (mychan_isused(mc))
+		case EXPIRY_MYUSER:
+			mu = e->obj;
+			if (expire_myuser(mu))
 			{
-				mc->used = CURRTIME;
-				slog(LG_DEBUG, "expire_check(): updating last used time on %s because it appears to be still in use", mc->name);
+				expiry_stats.myusers++;
 				continue;
 			}
+			due = expiry_due_myuser(mu);
+			break;
+		case EXPIRY_MYNICK:
+			mn = e->obj;
+			if (expire_mynick(mn))
+			{
+				expiry_stats.mynicks++;
+				continue;
+			}
+			due = expiry_due_mynick(mn);
+			break;
+		case EXPIRY_MYCHAN:
+			mc = e->obj;
+			if (expire_mychan(mc))
+			{
+				expiry_stats.mychans++;
+				continue;
+			}
+			due = expiry_due_mychan(mc, (CURRTIME - mc->used) >= EXPIRY_REFRESH);
+			break;
 		}
 
-		if (chansvs.expiry > 0 && mc->used < CURRTIME &&
-				(unsigned int)(CURRTIME - mc->used) >= chansvs.expiry)
-		{
-			if (MC_HOLD & mc->flags)
-				continue;
+		/* held, in use or vetoed by a hook: look again later */
+		if (due != 0 && due <= CURRTIME)
+			due = CURRTIME + EXPIRY_RECHECK;
 
-			slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mc->name, mychan_founder_names(mc));
-			slog(LG_VERBOSE, "expire_check(): expiring channel %s (unused %lds, founder %s, chanacs %zu)",
-					mc->name, (long)(CURRTIME - mc->used),
-					mychan_founder_names(mc),
-					MOWGLI_LIST_LENGTH(&mc->chanacs));
+		expiry_schedule(e, due);
+	}
 
-			hook_call_channel_drop(mc);
-			if (mc->chan != NULL && !(mc->chan->flags & CHAN_LOG))
-				part(mc->name, chansvs.nick);
+	expiry_stats.checked += done;
+	expiry_stats.last_batch = done;
 
-			atheme_object_unref(mc);
-		}
+	return done;
+}
+
+/* runs every second from the event loop, doing a bounded amount of work */
+void
+expire_tick(void *arg)
+{
+	(void) expiry_run(EXPIRY_BATCH);
+}
+
+/* checks everything that is due right now, however much that is */
+void
+expire_check(void *arg)
+{
+	/* Let them know about this and the likely subsequent db_save()
+	 * right away -- jilles */
+	if (curr_uplink != NULL && curr_uplink->conn != NULL)
+		sendq_flush(curr_uplink->conn);
+
+	(void) expiry_run(UINT_MAX);
+}
+
+void
+expire_stats(void (*stats_cb)(const char *, void *), void *privdata)
+{
+	const struct expiry_node *const first = expiry_first();
+	char buf[BUFSIZE];
+
+	snprintf(buf, sizeof buf, "expiry queue %zu, next due in %lds",
+			expiry_heap.len,
+			first ? (long)(first->node.when - CURRTIME) : 0L);
+	stats_cb(buf, privdata);
+
+	snprintf(buf, sizeof buf, "expiry checked %" PRIu64 " (last tick %u), expired %" PRIu64 " accounts, %"
+			PRIu64 " nicks, %" PRIu64 " channels",
+			expiry_stats.checked, expiry_stats.last_batch,
+			expiry_stats.myusers, expiry_stats.mynicks, expiry_stats.mychans);
+	stats_cb(buf, privdata);
+}
+
+static void
+expiry_user_register(struct myuser *mu)
+{
+	/* picks up MU_WAITAUTH */
+	myuser_expiry_update(mu);
+}
+
+static void
+expiry_user_rename(struct hook_user_rename *hdata)
+{
+	mowgli_node_t *n;
+
+	/* the old main nick can expire on its own now, the new one cannot */
+	MOWGLI_ITER_FOREACH(n, hdata->mu->nicks.head)
+		mynick_expiry_update(n->data);
+}
+
+static int
+expiry_config_myuser_cb(struct myentity *mt, void *unused)
+{
+	myuser_expiry_update(user(mt));
+	return 0;
+}
+
+static void
+expiry_config_ready(void *unused)
+{
+	static unsigned int nick_expiry = 0;
+	static unsigned int chan_expiry = 0;
+	struct mynick *mn;
+	struct mychan *mc;
+	mowgli_patricia_iteration_state_t state;
+
+	/* Only a changed period needs the queue touched, and only where
+	 * things may now be due earlier than queued (or not at all). Longer
+	 * periods are left to fix themselves as entries come due.
+	 */
+	if (nicksvs.expiry != nick_expiry)
+	{
+		myentity_foreach_t(ENT_USER, expiry_config_myuser_cb, NULL);
+
+		MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+			mynick_expiry_update(mn);
+
+		nick_expiry = nicksvs.expiry;
+	}
+
+	if (chansvs.expiry != chan_expiry)
+	{
+		MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+			mychan_expiry_update(mc);
+
+		chan_expiry = chansvs.expiry;
 	}
 }
 
@@ -2191,6 +2543,7 @@ check_myuser_cb(struct myentity *mt, void *unused)
 			mn = mynick_add(mu, entity(mu)->name);
 			mn->registered = mu->registered;
 			mn->lastseen = mu->lastlogin;
+			mynick_expiry_update(mn);
 		}
 		else if (mn->owner != mu)
 		{
@@ -2199,6 +2552,7 @@ check_myuser_cb(struct myentity *mt, void *unused)
 			mn = mynick_add(mu, entity(mu)->name);
 			mn->registered = mu->registered;
 			mn->lastseen = mu->lastlogin;
+			mynick_expiry_update(mn);
 		}
 	}
 
@@ -311,6 +311,8 @@ atheme_setup(void)
 #ifdef ENABLE_NLS
 	language_init();
 #endif
+	deadline_init();
+	pacing_init();
 	init_nodes();
 	init_confprocess();
 	init_newconf();
@@ -323,6 +325,7 @@ atheme_setup(void)
 
 	authcookie_init();
 	common_ctcp_init();
+	email_init();
 }
 
 static void
@@ -533,13 +536,8 @@ atheme_main(int argc, char *argv[])
 	if (db_save && !readonly)
 		mowgli_timer_add(base_eventloop, "db_save", db_save_periodic, NULL, config_options.commit_interval);
 
-	/* check expires every hour */
-	mowgli_timer_add(base_eventloop, "expire_check", expire_check, NULL, SECONDS_PER_HOUR);
-
-	/* check k/x/q line expires every minute */
-	mowgli_timer_add(base_eventloop, "kline_expire", kline_expire, NULL, SECONDS_PER_MINUTE);
-	mowgli_timer_add(base_eventloop, "xline_expire", xline_expire, NULL, SECONDS_PER_MINUTE);
-	mowgli_timer_add(base_eventloop, "qline_expire", qline_expire, NULL, SECONDS_PER_MINUTE);
+	/* work through due expires a little at a time */
+	mowgli_timer_add(base_eventloop, "expire_tick", expire_tick, NULL, 1);
 
 	/* check authcookie expires every ten minutes */
 	mowgli_timer_add(base_eventloop, "authcookie_expire", authcookie_expire, NULL, 10 * SECONDS_PER_MINUTE);
@@ -47,6 +47,7 @@ struct authcookie *
 authcookie_create(struct myuser *mu)
 {
 	struct authcookie *const au = mowgli_heap_alloc(authcookie_heap);
+	memtag_alloc(&memtag_core[MEMTAG_AUTHCOOKIES], sizeof *au);
 	au->ticket = random_string(AUTHCOOKIE_LENGTH);
 	au->myuser = mu;
 	au->expire = CURRTIME + SECONDS_PER_HOUR;
@@ -131,6 +132,7 @@ authcookie_destroy(struct authcookie * ac)
 
 	mowgli_node_delete(&ac->node, &authcookie_list);
 	sfree(ac->ticket);
+	memtag_free(&memtag_core[MEMTAG_AUTHCOOKIES], sizeof *ac);
 	mowgli_heap_free(authcookie_heap, ac);
 }
 
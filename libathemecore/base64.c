@@ -70,6 +70,333 @@ base64_alphabet_invert(const char alphabet[const restrict static 65],
 	return true;
 }
 
+/* The scalar loops below handle every input, one group of 4 characters (or
+ * 3 bytes) at a time. Where the CPU has them, vector kernels are tried first
+ * at each step: they take as many whole blocks as they can that are nothing
+ * but alphabet characters (no whitespace, padding or end of string) and stop
+ * at the first block that is not, or when the output has no room left for a
+ * whole block. The scalar loop then takes one group and hands back to them,
+ * so the result is always what the scalar loop alone would have produced.
+ *
+ * The kernels look characters up in the caller's alphabet and inverse
+ * alphabet, so the alternate alphabets take the same path as the default
+ * one. The best kernel the CPU supports is picked on first use.
+ */
+
+typedef size_t (*base64_decode_block_fn)(const char *, size_t, unsigned char *, size_t, const unsigned char *);
+typedef size_t (*base64_encode_block_fn)(const unsigned char *, size_t, char *, size_t, const char *);
+
+struct base64_kernel
+{
+	const char *                    name;
+	bool                          (*supported)(void);
+	base64_decode_block_fn          decode;         // returns characters consumed, a multiple of 4
+	base64_encode_block_fn          encode;         // returns bytes consumed, a multiple of 3
+};
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__has_attribute) && defined(__has_include)
+#  if __has_attribute(__target__) && __has_include(<immintrin.h>)
+#    define BASE64_X86_KERNELS 1
+#  endif
+#endif
+
+#ifdef BASE64_X86_KERNELS
+
+#include <immintrin.h>
+
+#define BASE64_TARGET(isa)      __attribute__((__target__(isa)))
+
+static bool
+base64_cpu_has_ssse3(void)
+{
+	(void) __builtin_cpu_init();
+
+	return __builtin_cpu_supports("ssse3");
+}
+
+static bool
+base64_cpu_has_avx2(void)
+{
+	(void) __builtin_cpu_init();
+
+	return __builtin_cpu_supports("avx2");
+}
+
+/* Looks up each byte of idx in a table of 16 * parts entries; the bytes
+ * must be below 16 * parts. PSHUFB indexes with the low 4 bits, and the
+ * high 4 bits pick which 16-byte part of the table the result comes from.
+ */
+static inline __m128i BASE64_TARGET("ssse3")
+base64_lookup_ssse3(const __m128i idx, const __m128i *const restrict table, const int parts)
+{
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(idx, 4), _mm_set1_epi8(0x0F));
+	__m128i res = _mm_setzero_si128();
+
+	for (int i = 0; i < parts; i++)
+		res = _mm_or_si128(res, _mm_and_si128(_mm_shuffle_epi8(table[i], idx),
+		                                      _mm_cmpeq_epi8(hi, _mm_set1_epi8((char) i))));
+
+	return res;
+}
+
+static inline __m256i BASE64_TARGET("avx2")
+base64_lookup_avx2(const __m256i idx, const __m256i *const restrict table, const int parts)
+{
+	const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(idx, 4), _mm256_set1_epi8(0x0F));
+	__m256i res = _mm256_setzero_si256();
+
+	for (int i = 0; i < parts; i++)
+		res = _mm256_or_si256(res, _mm256_and_si256(_mm256_shuffle_epi8(table[i], idx),
+		                                            _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char) i))));
+
+	return res;
+}
+
+static size_t BASE64_TARGET("ssse3")
+base64_decode_block_ssse3(const char *const restrict src, const size_t src_len, unsigned char *const restrict dst,
+                          const size_t dst_len, const unsigned char *const restrict inverse_alphabet)
+{
+	__m128i table[8];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (int i = 0; i < 8; i++)
+		table[i] = _mm_loadu_si128((const void *) (inverse_alphabet + (16 * i)));
+
+	while ((src_len - done) >= 16 && (dst == NULL || (dst_len - written) >= 12))
+	{
+		const __m128i in = _mm_loadu_si128((const void *) (src + done));
+		__m128i val;
+
+		if (_mm_movemask_epi8(in))
+			// Out of 7-bit ASCII range
+			break;
+
+		val = base64_lookup_ssse3(in, table, 8);
+
+		if (_mm_movemask_epi8(val))
+			// Not in the alphabet (whitespace, padding, or invalid)
+			break;
+
+		if (dst != NULL)
+		{
+			// 4 x 6 bits -> 24 bits in each 32-bit lane, then the 3 bytes of each in order
+			val = _mm_maddubs_epi16(val, _mm_set1_epi32(0x01400140));
+			val = _mm_madd_epi16(val, _mm_set1_epi32(0x00011000));
+			val = _mm_shuffle_epi8(val, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+			const uint32_t tail = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(val, 8));
+
+			(void) _mm_storel_epi64((void *) (dst + written), val);
+			(void) memcpy(dst + written + 8, &tail, sizeof tail);
+		}
+
+		done += 16;
+		written += 12;
+	}
+
+	return done;
+}
+
+static size_t BASE64_TARGET("ssse3")
+base64_encode_block_ssse3(const unsigned char *const restrict src, const size_t src_len, char *const restrict dst,
+                          const size_t dst_len, const char *const restrict alphabet)
+{
+	__m128i table[4];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (int i = 0; i < 4; i++)
+		table[i] = _mm_loadu_si128((const void *) (alphabet + (16 * i)));
+
+	// 12 bytes are used out of each 16 loaded
+	while ((src_len - done) >= 16 && (dst_len - written) >= 16)
+	{
+		__m128i in = _mm_loadu_si128((const void *) (src + done));
+		__m128i idx, out;
+
+		// Spread 3 bytes over each 32-bit lane and cut them into 4 x 6 bits, one per byte
+		in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+		idx = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)),
+		                                   _mm_set1_epi32(0x04000040)),
+		                   _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)),
+		                                   _mm_set1_epi32(0x01000010)));
+
+		out = base64_lookup_ssse3(idx, table, 4);
+
+		(void) _mm_storeu_si128((void *) (dst + written), out);
+
+		done += 12;
+		written += 16;
+	}
+
+	return done;
+}
+
+static size_t BASE64_TARGET("avx2")
+base64_decode_block_avx2(const char *const restrict src, const size_t src_len, unsigned char *const restrict dst,
+                         const size_t dst_len, const unsigned char *const restrict inverse_alphabet)
+{
+	__m256i table[8];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (int i = 0; i < 8; i++)
+		table[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *) (inverse_alphabet + (16 * i))));
+
+	while ((src_len - done) >= 32 && (dst == NULL || (dst_len - written) >= 24))
+	{
+		const __m256i in = _mm256_loadu_si256((const void *) (src + done));
+		__m256i val;
+
+		if (_mm256_movemask_epi8(in))
+			// Out of 7-bit ASCII range
+			break;
+
+		val = base64_lookup_avx2(in, table, 8);
+
+		if (_mm256_movemask_epi8(val))
+			// Not in the alphabet (whitespace, padding, or invalid)
+			break;
+
+		if (dst != NULL)
+		{
+			// As above, per 128-bit lane; then the 2 x 12 bytes are moved together
+			val = _mm256_maddubs_epi16(val, _mm256_set1_epi32(0x01400140));
+			val = _mm256_madd_epi16(val, _mm256_set1_epi32(0x00011000));
+			val = _mm256_shuffle_epi8(val, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			                                                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+			val = _mm256_permutevar8x32_epi32(val, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+			(void) _mm_storeu_si128((void *) (dst + written), _mm256_castsi256_si128(val));
+			(void) _mm_storel_epi64((void *) (dst + written + 16), _mm256_extracti128_si256(val, 1));
+		}
+
+		done += 32;
+		written += 24;
+	}
+
+	return done;
+}
+
+static size_t BASE64_TARGET("avx2")
+base64_encode_block_avx2(const unsigned char *const restrict src, const size_t src_len, char *const restrict dst,
+                         const size_t dst_len, const char *const restrict alphabet)
+{
+	__m256i table[4];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (int i = 0; i < 4; i++)
+		table[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *) (alphabet + (16 * i))));
+
+	// 12 bytes for each 128-bit lane; the second lane loads 16 from 12 bytes in
+	while ((src_len - done) >= 28 && (dst_len - written) >= 32)
+	{
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const void *) (src + done))),
+		                                     _mm_loadu_si128((const void *) (src + done + 12)), 1);
+		__m256i idx, out;
+
+		in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		                                              1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+		idx = _mm256_or_si256(_mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)),
+		                                         _mm256_set1_epi32(0x04000040)),
+		                      _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)),
+		                                         _mm256_set1_epi32(0x01000010)));
+
+		out = base64_lookup_avx2(idx, table, 4);
+
+		(void) _mm256_storeu_si256((void *) (dst + written), out);
+
+		done += 24;
+		written += 32;
+	}
+
+	return done;
+}
+
+#endif /* BASE64_X86_KERNELS */
+
+static bool
+base64_cpu_any(void)
+{
+	return true;
+}
+
+// In order of preference; the last one is always supported
+static const struct base64_kernel base64_kernels[] = {
+
+#ifdef BASE64_X86_KERNELS
+	{ "avx2",   &base64_cpu_has_avx2,  &base64_decode_block_avx2,  &base64_encode_block_avx2  },
+	{ "ssse3",  &base64_cpu_has_ssse3, &base64_decode_block_ssse3, &base64_encode_block_ssse3 },
+#endif
+	{ "scalar", &base64_cpu_any,       NULL,                       NULL                       },
+};
+
+static const struct base64_kernel *base64_kernel = NULL;
+
+static const struct base64_kernel *
+base64_kernel_get(void)
+{
+	if (base64_kernel != NULL)
+		return base64_kernel;
+
+	for (size_t i = 0; i < ARRAY_SIZE(base64_kernels); i++)
+	{
+		if (base64_kernels[i].supported())
+		{
+			base64_kernel = &base64_kernels[i];
+			break;
+		}
+	}
+
+	return base64_kernel;
+}
+
+size_t
+base64_kernel_count(void)
+{
+	return ARRAY_SIZE(base64_kernels);
+}
+
+const char *
+base64_kernel_name(const size_t kernel)
+{
+	return_val_if_fail(kernel < ARRAY_SIZE(base64_kernels), NULL);
+
+	return base64_kernels[kernel].name;
+}
+
+bool
+base64_kernel_supported(const size_t kernel)
+{
+	return_val_if_fail(kernel < ARRAY_SIZE(base64_kernels), false);
+
+	return base64_kernels[kernel].supported();
+}
+
+size_t
+base64_kernel_current(void)
+{
+	return (size_t) (base64_kernel_get() - base64_kernels);
+}
+
+bool
+base64_kernel_select(const size_t kernel)
+{
+	if (kernel == BASE64_KERNEL_AUTO)
+	{
+		base64_kernel = NULL;
+		return true;
+	}
+
+	if (kernel >= ARRAY_SIZE(base64_kernels) || ! base64_kernels[kernel].supported())
+		return false;
+
+	base64_kernel = &base64_kernels[kernel];
+	return true;
+}
+
 static size_t ATHEME_FATTR_WUR
 base64_decode_run(const char *restrict src, void *const restrict out, const size_t out_len,
                   const unsigned char inverse_alphabet[const restrict static 128])
@@ -77,6 +404,8 @@ base64_decode_run(const char *restrict src, void *const restrict out, const size
 	unsigned char *const dst = (unsigned char *) out;
 	const size_t dst_len = out_len;
 
+	const base64_decode_block_fn decode_block = base64_kernel_get()->decode;
+
 	size_t src_len = strlen(src);
 	size_t written = 0;
 
@@ -85,6 +414,19 @@ base64_decode_run(const char *restrict src, void *const restrict out, const size
 		unsigned char och[4];
 		size_t done;
 
+		if (decode_block != NULL)
+		{
+			const size_t used = decode_block(src, src_len, (dst != NULL) ? (dst + written) : NULL,
+			                                 (dst != NULL) ? (dst_len - written) : 0, inverse_alphabet);
+
+			src += used;
+			src_len -= used;
+			written += ((used / 4) * 3);
+
+			if (src_len == 0)
+				break;
+		}
+
 		for (done = 0; done < 4; done++)
 		{
 			while (isspace((int) src[done]))
@@ -219,6 +561,20 @@ base64_encode_run(const void *const restrict in, const size_t in_len, char *cons
 		// Definitely not enough room
 		return BASE64_FAIL;
 
+	if (dst != NULL)
+	{
+		const base64_encode_block_fn encode_block = base64_kernel_get()->encode;
+
+		if (encode_block != NULL)
+		{
+			const size_t used = encode_block(src, src_len, dst, dst_len, alphabet);
+
+			src += used;
+			src_len -= used;
+			written += ((used / 3) * 4);
+		}
+	}
+
 	while (src_len >= 3)
 	{
 		if (dst != NULL)
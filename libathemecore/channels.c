@@ -97,6 +97,7 @@ channel_add(const char *name, time_t ts, struct server *creator)
 	slog(LG_DEBUG, "channel_add(): %s by %s", name, creator->name);
 
 	c = mowgli_heap_alloc(chan_heap);
+	memtag_alloc(&memtag_core[MEMTAG_CHANNELS], sizeof *c);
 
 	c->name = sstrdup(name);
 	c->ts = ts;
@@ -166,6 +167,7 @@ channel_delete(struct channel *c)
 		soft_assert(is_internal_client(cu->user) && !me.connected);
 		mowgli_node_delete(&cu->cnode, &c->members);
 		mowgli_node_delete(&cu->unode, &cu->user->channels);
+		memtag_free(&memtag_core[MEMTAG_CHANUSERS], sizeof *cu);
 		mowgli_heap_free(chanuser_heap, cu);
 		cnt.chanuser--;
 	}
@@ -187,6 +189,7 @@ channel_delete(struct channel *c)
 	sfree(c->topic);
 	sfree(c->topic_setter);
 
+	memtag_free(&memtag_core[MEMTAG_CHANNELS], sizeof *c);
 	mowgli_heap_free(chan_heap, c);
 
 	cnt.chan--;
@@ -235,6 +238,7 @@ chanban_add(struct channel *chan, const char *mask, int type)
 	slog(LG_DEBUG, "chanban_add(): %s +%c %s", chan->name, type, mask);
 
 	c = mowgli_heap_alloc(chanban_heap);
+	memtag_alloc(&memtag_core[MEMTAG_CHANBANS], sizeof *c);
 
 	c->chan = chan;
 	c->mask = sstrdup(mask);
@@ -267,6 +271,7 @@ chanban_delete(struct chanban * c)
 	mowgli_node_delete(&c->node, &c->chan->bans);
 
 	sfree(c->mask);
+	memtag_free(&memtag_core[MEMTAG_CHANBANS], sizeof *c);
 	mowgli_heap_free(chanban_heap, c);
 }
 
@@ -391,6 +396,7 @@ chanuser_add(struct channel *chan, const char *nick)
 	slog(LG_DEBUG, "chanuser_add(): %s -> %s", chan->name, u->nick);
 
 	cu = mowgli_heap_alloc(chanuser_heap);
+	memtag_alloc(&memtag_core[MEMTAG_CHANUSERS], sizeof *cu);
 
 	cu->chan = chan;
 	cu->user = u;
@@ -454,6 +460,7 @@ chanuser_delete(struct channel *chan, struct user *user)
 	mowgli_node_delete(&cu->cnode, &chan->members);
 	mowgli_node_delete(&cu->unode, &user->channels);
 
+	memtag_free(&memtag_core[MEMTAG_CHANUSERS], sizeof *cu);
 	mowgli_heap_free(chanuser_heap, cu);
 
 	chan->nummembers--;
@@ -471,6 +478,82 @@ chanuser_delete(struct channel *chan, struct user *user)
 	}
 }
 
+/*
+ * chanuser_delete_split(struct channel *chan)
+ *
+ * Removes every member of a channel whose server is being split off.
+ *
+ * Inputs:
+ *     - channel to clean up
+ *
+ * Outputs:
+ *     - nothing
+ *
+ * Side Effects:
+ *     - the channel_split hook is called once, before any member
+ *       is removed; channel_part is not called
+ *     - channel user objects of users on SF_SPLITTING servers are
+ *       removed from the channel's userlist and the users' channellists
+ *     - if the channel is then empty and not permanent, channel_delete()
+ *       is called (q.v.)
+ */
+void
+chanuser_delete_split(struct channel *chan)
+{
+	struct chanuser *cu;
+	mowgli_node_t *n, *tn;
+	struct hook_channel_split hdata;
+
+	return_if_fail(chan != NULL);
+
+	chan->flags &= ~CHAN_SPLITTING;
+
+	hdata.chan = chan;
+	hdata.parting = 0;
+
+	MOWGLI_ITER_FOREACH(n, chan->members.head)
+	{
+		cu = n->data;
+
+		if (cu->user->server->flags & SF_SPLITTING)
+			hdata.parting++;
+	}
+
+	if (hdata.parting == 0)
+		return;
+
+	/* this is called BEFORE we remove the users */
+	hook_call_channel_split(&hdata);
+
+	slog(LG_DEBUG, "chanuser_delete_split(): %s -> %u split (%u)", chan->name, hdata.parting,
+			chan->nummembers - hdata.parting);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->members.head)
+	{
+		cu = n->data;
+
+		if (!(cu->user->server->flags & SF_SPLITTING))
+			continue;
+
+		mowgli_node_delete(&cu->cnode, &chan->members);
+		mowgli_node_delete(&cu->unode, &cu->user->channels);
+
+		memtag_free(&memtag_core[MEMTAG_CHANUSERS], sizeof *cu);
+		mowgli_heap_free(chanuser_heap, cu);
+
+		chan->nummembers--;
+		cnt.chanuser--;
+	}
+
+	if (chan->nummembers == 0 && !(chan->modes & ircd->perm_mode))
+	{
+		/* empty channels die */
+		slog(LG_DEBUG, "chanuser_delete_split(): `%s' is empty, removing", chan->name);
+
+		channel_delete(chan);
+	}
+}
+
 /*
  * chanuser_find(struct channel *chan, struct user *user)
  *
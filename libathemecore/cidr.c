@@ -394,6 +394,58 @@ valid_ip_or_mask(const char *src)
 		return inet_pton4(ipaddr, buf);
 }
 
+/* parse_ip_cidr()
+ *
+ * Input - ip address or cidr mask, buffer of at least 16 bytes
+ * Output - 0 = Invalid, otherwise the address length in bits (32 or 128)
+ *
+ * The mask length is stored in *cidrlen (the full address length if no mask
+ * was given) and all bits of the address beyond it are cleared.
+ */
+unsigned int
+parse_ip_cidr(const char *src, unsigned char *dst, unsigned int *cidrlen)
+{
+	char ipaddr[HOSTLEN + 7];
+	unsigned char buf[IN6ADDRSZ];
+	char *mask, *end;
+	unsigned long len;
+	unsigned int addrbits;
+	unsigned int i;
+
+	if (mowgli_strlcpy(ipaddr, src, sizeof ipaddr) >= sizeof ipaddr)
+		return 0;
+
+	addrbits = (strchr(ipaddr, ':') != NULL) ? 128 : 32;
+	len = addrbits;
+
+	if ((mask = strchr(ipaddr, '/')))
+	{
+		*mask++ = '\0';
+
+		if (!isdigit((unsigned char)*mask))
+			return 0;
+
+		len = strtoul(mask, &end, 10);
+		if (*end != '\0' || len > addrbits)
+			return 0;
+	}
+
+	memset(buf, 0, sizeof buf);
+
+	if (addrbits == 128 && !inet_pton6(ipaddr, buf))
+		return 0;
+	if (addrbits == 32 && !inet_pton4(ipaddr, buf))
+		return 0;
+
+	for (i = len; i < addrbits; i++)
+		buf[i / 8] &= ~(0x80U >> (i % 8));
+
+	memcpy(dst, buf, IN6ADDRSZ);
+	*cidrlen = len;
+
+	return addrbits;
+}
+
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
  * vim:ts=8
  * vim:sw=8
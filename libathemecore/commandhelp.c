@@ -18,7 +18,37 @@
 
 #define COMMAND_SHORTHELP_WRAP_COLS 64U
 
+enum help_line_type
+{
+	HELP_LINE_TEXT,
+	HELP_LINE_IF,
+	HELP_LINE_ELSE,
+	HELP_LINE_ENDIF,
+};
+
+struct help_line
+{
+	enum help_line_type     type;
+	bool                    has_nick;       // contains &nick&, which depends on the service
+	size_t                  offset;         // into help_file->text; for HELP_LINE_IF, the condition
+};
+
+/* A help file as read from disk: stripped and split into lines once, then
+ * shared by every HELP request for it until the next rehash. A file that
+ * could not be opened is remembered too (with no lines and missing set),
+ * so that the fallback from a translation to English does not cost a
+ * failed fopen() each time.
+ */
+struct help_file
+{
+	bool                    missing;
+	char *                  text;
+	struct help_line *      lines;
+	size_t                  nlines;
+};
+
 static unsigned int help_display_depth = 0;
+static mowgli_patricia_t *help_files = NULL;
 
 static inline bool
 can_execute_command(struct sourceinfo *const restrict si, const struct command *const restrict cmd)
@@ -112,19 +142,135 @@ help_evaluate_condition(struct sourceinfo *const restrict si, const char *restri
 	return false;
 }
 
+static void
+help_file_free(struct help_file *const restrict hf)
+{
+	(void) sfree(hf->text);
+	(void) sfree(hf->lines);
+	(void) sfree(hf);
+}
+
+static void
+help_file_free_cb(const char ATHEME_VATTR_UNUSED *const restrict key, void *const restrict data,
+                  void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) help_file_free(data);
+}
+
+static struct help_file *
+help_file_read(const char *const restrict fullpath)
+{
+	struct help_file *const hf = smalloc(sizeof *hf);
+	size_t textlen = 0;
+	size_t textalloc = 0;
+	size_t linealloc = 0;
+	char buf[BUFSIZE];
+	FILE *fh;
+
+	if (! (fh = fopen(fullpath, "r")))
+	{
+		(void) slog(LG_DEBUG, "%s: fopen('%s'): %s", MOWGLI_FUNC_NAME, fullpath, strerror(errno));
+
+		hf->missing = true;
+		return hf;
+	}
+
+	while (fgets(buf, sizeof buf, fh))
+	{
+		struct help_line line = { .type = HELP_LINE_TEXT };
+		const char *text = buf;
+
+		(void) strip(buf);
+
+		if (strncasecmp(text, "#if", 3) == 0)
+		{
+			line.type = HELP_LINE_IF;
+			text += 3;
+		}
+		else if (strncasecmp(text, "#endif", 6) == 0)
+		{
+			line.type = HELP_LINE_ENDIF;
+			text = "";
+		}
+		else if (strncasecmp(text, "#else", 5) == 0)
+		{
+			line.type = HELP_LINE_ELSE;
+			text = "";
+		}
+		else
+			line.has_nick = (strstr(text, "&nick&") != NULL);
+
+		const size_t len = strlen(text) + 1;
+
+		if (textlen + len > textalloc)
+		{
+			textalloc = (textalloc ? textalloc * 2 : 1024) + len;
+			hf->text = srealloc(hf->text, textalloc);
+		}
+
+		if (hf->nlines == linealloc)
+		{
+			linealloc = linealloc ? linealloc * 2 : 32;
+			hf->lines = sreallocarray(hf->lines, linealloc, sizeof *hf->lines);
+		}
+
+		(void) memcpy(hf->text + textlen, text, len);
+		line.offset = textlen;
+		textlen += len;
+
+		hf->lines[hf->nlines++] = line;
+	}
+
+	if (ferror(fh))
+		(void) slog(LG_DEBUG, "%s: fgets('%s'): %s", MOWGLI_FUNC_NAME, fullpath, strerror(errno));
+
+	(void) fclose(fh);
+
+	return hf;
+}
+
+static const struct help_file *
+help_file_find(const char *const restrict fullpath)
+{
+	struct help_file *hf;
+
+	if (! help_files)
+		help_files = mowgli_patricia_create(&noopcanon);
+
+	if ((hf = mowgli_patricia_retrieve(help_files, fullpath)) != NULL)
+		return hf->missing ? NULL : hf;
+
+	hf = help_file_read(fullpath);
+
+	(void) mowgli_patricia_add(help_files, fullpath, hf);
+
+	return hf->missing ? NULL : hf;
+}
+
+// Forgets all cached help files; they are read again when next requested
+void
+help_files_flush(void)
+{
+	if (! help_files)
+		return;
+
+	(void) mowgli_patricia_destroy(help_files, &help_file_free_cb, NULL);
+
+	help_files = NULL;
+}
+
 static void
 help_display_path(struct sourceinfo *const restrict si, const char *const restrict cmd,
                   const char *const restrict path, const char *const restrict service_name)
 {
 	char fullpath[PATH_MAX];
-	FILE *fh = NULL;
+	const struct help_file *hf = NULL;
 
 	if (*path == '/')
 	{
 		(void) mowgli_strlcpy(fullpath, path, sizeof fullpath);
 
-		if (! (fh = fopen(fullpath, "r")))
-			(void) slog(LG_DEBUG, "%s: fopen('%s'): %s", MOWGLI_FUNC_NAME, fullpath, strerror(errno));
+		hf = help_file_find(fullpath);
 	}
 	else
 	{
@@ -144,22 +290,18 @@ help_display_path(struct sourceinfo *const restrict si, const char *const restri
 		{
 			(void) snprintf(fullpath, sizeof fullpath, "%s/help/%s/%s", SHAREDIR, lang, subname);
 
-			if (! (fh = fopen(fullpath, "r")))
-				(void) slog(LG_DEBUG, "%s: fopen('%s'): %s", MOWGLI_FUNC_NAME,
-				                      fullpath, strerror(errno));
+			hf = help_file_find(fullpath);
 		}
 
-		if (! fh)
+		if (! hf)
 		{
 			(void) snprintf(fullpath, sizeof fullpath, "%s/help/%s", SHAREDIR, subname);
 
-			if (! (fh = fopen(fullpath, "r")))
-				(void) slog(LG_DEBUG, "%s: fopen('%s'): %s", MOWGLI_FUNC_NAME,
-				                      fullpath, strerror(errno));
+			hf = help_file_find(fullpath);
 		}
 	}
 
-	if (! fh)
+	if (! hf)
 	{
 		(void) command_fail(si, fault_nosuch_target, _("Could not open help file for \2%s\2."), cmd);
 		(void) help_display_newline(si);
@@ -171,53 +313,55 @@ help_display_path(struct sourceinfo *const restrict si, const char *const restri
 	unsigned int ifnest = 0;
 	char buf[BUFSIZE];
 
-	while (fgets(buf, sizeof buf, fh))
+	for (size_t i = 0; i < hf->nlines; i++)
 	{
-		(void) strip(buf);
-		(void) replace(buf, sizeof buf, "&nick&", service_name);
+		const struct help_line *const line = &hf->lines[i];
+		const char *text = hf->text + line->offset;
 
-		if (strncasecmp(buf, "#if", 3) == 0)
+		switch (line->type)
 		{
-			if (ifnest_false || ! help_evaluate_condition(si, buf + 3))
-				ifnest_false++;
+			case HELP_LINE_IF:
+				if (ifnest_false || ! help_evaluate_condition(si, text))
+					ifnest_false++;
 
-			ifnest++;
-			continue;
-		}
+				ifnest++;
+				continue;
 
-		if (strncasecmp(buf, "#endif", 6) == 0)
-		{
-			if (ifnest_false)
-				ifnest_false--;
+			case HELP_LINE_ENDIF:
+				if (ifnest_false)
+					ifnest_false--;
 
-			if (ifnest)
-				ifnest--;
+				if (ifnest)
+					ifnest--;
 
-			continue;
-		}
+				continue;
 
-		if (strncasecmp(buf, "#else", 5) == 0)
-		{
-			if (ifnest && ifnest_false < 2)
-				ifnest_false ^= 1;
+			case HELP_LINE_ELSE:
+				if (ifnest && ifnest_false < 2)
+					ifnest_false ^= 1;
 
-			continue;
+				continue;
+
+			case HELP_LINE_TEXT:
+				break;
 		}
 
 		if (ifnest_false)
 			continue;
 
-		if (*buf)
-			(void) command_success_nodata(si, "%s", buf);
+		if (line->has_nick)
+		{
+			(void) mowgli_strlcpy(buf, text, sizeof buf);
+			(void) replace(buf, sizeof buf, "&nick&", service_name);
+			text = buf;
+		}
+
+		if (*text)
+			(void) command_success_nodata(si, "%s", text);
 		else
 			(void) help_display_newline(si);
 	}
 
-	if (ferror(fh))
-		(void) slog(LG_DEBUG, "%s: fgets('%s'): %s", MOWGLI_FUNC_NAME, fullpath, strerror(errno));
-
-	(void) fclose(fh);
-
 	(void) help_display_newline(si);
 }
 
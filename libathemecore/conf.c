@@ -287,6 +287,11 @@ init_newconf(void)
 	add_duration_conf_item("FLOOD_TIME", &conf_gi_table, 0, &config_options.flood_time, "s", 10);
 	add_uint_conf_item("RATELIMIT_USES", &conf_gi_table, 0, &config_options.ratelimit_uses, 0, INT_MAX, 0);
 	add_duration_conf_item("RATELIMIT_PERIOD", &conf_gi_table, 0, &config_options.ratelimit_period, "s", 0);
+	add_uint_conf_item("PACING_BURST", &conf_gi_table, 0, &config_options.pacing_burst, 1, INT_MAX, 60);
+	add_uint_conf_item("PACING_RATE", &conf_gi_table, 0, &config_options.pacing_rate, 0, INT_MAX, 15);
+	add_uint_conf_item("PACING_BULK_RATE", &conf_gi_table, 0, &config_options.pacing_bulk_rate, 0, INT_MAX, 100);
+	add_uint_conf_item("PACING_QUEUE_MAX", &conf_gi_table, 0, &config_options.pacing_queue_max, 0, INT_MAX, 500);
+	add_uint_conf_item("PACING_QUEUE_TOTAL", &conf_gi_table, 0, &config_options.pacing_queue_total, 0, INT_MAX, 20000);
 	add_duration_conf_item("VHOST_CHANGE", &conf_gi_table, 0, &config_options.vhost_change, "d", 0);
 	add_duration_conf_item("KLINE_TIME", &conf_gi_table, 0, &config_options.kline_time, "d", 0);
 	add_bool_conf_item("KLINE_WITH_IDENT", &conf_gi_table, 0, &config_options.kline_with_ident, false);
@@ -294,6 +299,8 @@ init_newconf(void)
 	add_duration_conf_item("CLONE_TIME", &conf_gi_table, 0, &config_options.clone_time, "m", 0);
 	add_duration_conf_item("COMMIT_INTERVAL", &conf_gi_table, 0, &config_options.commit_interval, "m", 300);
 	add_bool_conf_item("DB_SAVE_BLOCKING", &conf_gi_table, 0, &config_options.db_save_blocking, false);
+	add_bool_conf_item("DB_SAVE_THREADED", &conf_gi_table, 0, &config_options.db_save_threaded, false);
+	add_uint_conf_item("DB_COMPRESSION", &conf_gi_table, 0, &config_options.db_compression, 0, 19, 0);
 	add_dupstr_conf_item("OPERSTRING", &conf_gi_table, 0, &config_options.operstring, "is an IRC Operator");
 	add_dupstr_conf_item("SERVICESTRING", &conf_gi_table, 0, &config_options.servicestring, "is a Network Service");
 
@@ -922,6 +929,9 @@ conf_rehash(void)
 	conf_init();
 	mark_all_illegal();
 	log_shutdown();
+	email_templates_flush();
+	email_worker_stop();
+	help_files_flush();
 
 	/* now reload */
 	log_open();
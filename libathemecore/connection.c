@@ -24,6 +24,87 @@
 
 mowgli_list_t connection_list;
 
+/* fd -> connection map, grown on demand; connection_find() is a single
+ * array index instead of a walk over connection_list */
+static struct connection **connection_table = NULL;
+static size_t connection_table_size = 0;
+
+/* accept(2) counts for the last ACCEPT_WINDOW seconds, one slot per second */
+#define ACCEPT_WINDOW 60
+
+static unsigned int accept_ring[ACCEPT_WINDOW];
+static time_t accept_ring_stamp[ACCEPT_WINDOW];
+static unsigned int accept_total = 0;
+
+/* traffic of connections that have already been closed */
+static uint64_t closed_bytes_in = 0;
+static uint64_t closed_bytes_out = 0;
+
+static void
+connection_table_set(int fd, struct connection *cptr)
+{
+	size_t newsize;
+
+	if (fd < 0)
+		return;
+
+	if ((size_t) fd >= connection_table_size)
+	{
+		if (cptr == NULL)
+			return;
+
+		newsize = connection_table_size ? connection_table_size : 64;
+		while (newsize <= (size_t) fd)
+			newsize *= 2;
+
+		connection_table = sreallocarray(connection_table, newsize, sizeof *connection_table);
+		memset(connection_table + connection_table_size, 0,
+				(newsize - connection_table_size) * sizeof *connection_table);
+		connection_table_size = newsize;
+	}
+
+	connection_table[fd] = cptr;
+}
+
+static void
+connection_accept_record(struct connection *listener)
+{
+	const unsigned int slot = (unsigned int) (CURRTIME % ACCEPT_WINDOW);
+
+	if (accept_ring_stamp[slot] != CURRTIME)
+	{
+		accept_ring_stamp[slot] = CURRTIME;
+		accept_ring[slot] = 0;
+	}
+
+	accept_ring[slot]++;
+	accept_total++;
+	listener->accepts++;
+}
+
+static unsigned int
+connection_accept_rate(void)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < ACCEPT_WINDOW; i++)
+		if (accept_ring_stamp[i] > CURRTIME - ACCEPT_WINDOW)
+			count += accept_ring[i];
+
+	return count;
+}
+
+/* detach a connection from the listener it was accepted on */
+static void
+connection_unlink_listener(struct connection *cptr)
+{
+	if (cptr->listener == NULL)
+		return;
+
+	mowgli_node_delete(&cptr->listener_node, &cptr->listener->children);
+	cptr->listener = NULL;
+}
+
 static int
 socket_setnonblocking(mowgli_descriptor_t sck)
 {
@@ -133,7 +214,8 @@ connection_add(const char *name, int fd, unsigned int flags,
 		socket_setnonblocking(cptr->fd);
 	}
 
-	mowgli_node_add(cptr, mowgli_node_create(), &connection_list);
+	mowgli_node_add(cptr, &cptr->node, &connection_list);
+	connection_table_set(fd, cptr);
 
 	return cptr;
 }
@@ -153,18 +235,10 @@ connection_add(const char *name, int fd, unsigned int flags,
 struct connection *
 connection_find(int fd)
 {
-	struct connection *cptr;
-	mowgli_node_t *nptr;
-
-	MOWGLI_ITER_FOREACH(nptr, connection_list.head)
-	{
-		cptr = nptr->data;
-
-		if (cptr->fd == fd)
-			return cptr;
-	}
+	if (fd < 0 || (size_t) fd >= connection_table_size)
+		return NULL;
 
-	return NULL;
+	return connection_table[fd];
 }
 
 /*
@@ -182,7 +256,7 @@ connection_find(int fd)
 void
 connection_close(struct connection *cptr)
 {
-	mowgli_node_t *nptr;
+	mowgli_node_t *n, *tn;
 	int errno1, errno2;
 #ifdef SO_ERROR
 	socklen_t len = sizeof(errno2);
@@ -194,8 +268,7 @@ connection_close(struct connection *cptr)
 		return;
 	}
 
-	nptr = mowgli_node_find(cptr, &connection_list);
-	if (!nptr)
+	if (connection_find(cptr->fd) != cptr)
 	{
 		slog(LG_ERROR, "connection_close(): connection %p is not registered!",
 			cptr);
@@ -225,8 +298,16 @@ connection_close(struct connection *cptr)
 	shutdown(cptr->fd, SHUT_RDWR);
 	close(cptr->fd);
 
-	mowgli_node_delete(nptr, &connection_list);
-	mowgli_node_free(nptr);
+	connection_table_set(cptr->fd, NULL);
+	mowgli_node_delete(&cptr->node, &connection_list);
+
+	/* orphan anything still accepted on this listener */
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, cptr->children.head)
+		connection_unlink_listener(n->data);
+	connection_unlink_listener(cptr);
+
+	closed_bytes_in += cptr->bytes_in;
+	closed_bytes_out += cptr->bytes_out;
 
 	sendqrecvq_free(cptr);
 
@@ -249,20 +330,15 @@ connection_close(struct connection *cptr)
 void
 connection_close_children(struct connection *cptr)
 {
-	mowgli_node_t *n;
-	struct connection *cptr2;
+	mowgli_node_t *n, *tn;
 
 	if (cptr == NULL)
 		return;
 
 	if (CF_IS_LISTENING(cptr))
 	{
-		MOWGLI_ITER_FOREACH(n, connection_list.head)
-		{
-			cptr2 = n->data;
-			if (cptr2->listener == cptr)
-				connection_close(cptr2);
-		}
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, cptr->children.head)
+			connection_close(n->data);
 	}
 	connection_close(cptr);
 }
@@ -303,7 +379,7 @@ connection_close_soon(struct connection *cptr)
 	if (cptr->close_handler)
 		cptr->close_handler(cptr);
 	cptr->close_handler = NULL;
-	cptr->listener = NULL;
+	connection_unlink_listener(cptr);
 }
 
 /*
@@ -322,20 +398,15 @@ connection_close_soon(struct connection *cptr)
 void
 connection_close_soon_children(struct connection *cptr)
 {
-	mowgli_node_t *n;
-	struct connection *cptr2;
+	mowgli_node_t *n, *tn;
 
 	if (cptr == NULL)
 		return;
 
 	if (CF_IS_LISTENING(cptr))
 	{
-		MOWGLI_ITER_FOREACH(n, connection_list.head)
-		{
-			cptr2 = n->data;
-			if (cptr2->listener == cptr)
-				connection_close_soon(cptr2);
-		}
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, cptr->children.head)
+			connection_close_soon(n->data);
 	}
 	connection_close_soon(cptr);
 }
@@ -630,7 +701,7 @@ connection_accept_tcp(struct connection *cptr,
 	struct connection *newptr;
 	int s;
 
-	if (!(s = accept(cptr->fd, NULL, NULL)))
+	if ((s = accept(cptr->fd, NULL, NULL)) < 0)
 	{
 		slog(LG_INFO, "connection_accept_tcp(): accept failed");
 		return NULL;
@@ -644,7 +715,12 @@ connection_accept_tcp(struct connection *cptr,
 
 	mowgli_strlcpy(buf, "incoming connection", BUFSIZE);
 	newptr = connection_add(buf, s, 0, read_handler, write_handler);
+	if (newptr == NULL)
+		return NULL;
+
 	newptr->listener = cptr;
+	mowgli_node_add(newptr, &newptr->listener_node, &cptr->children);
+	connection_accept_record(cptr);
 	return newptr;
 }
 
@@ -705,9 +781,16 @@ connection_setselect_write(struct connection *cptr,
 void
 connection_stats(void (*stats_cb)(const char *, void *), void *privdata)
 {
+	/* sendq depth histogram buckets, in bytes */
+	static const size_t sendq_buckets[] = { 1, 4096, 65536, 1048576 };
+	unsigned int sendq_hist[ARRAY_SIZE(sendq_buckets) + 1] = { 0 };
+	unsigned int listeners = 0;
+	uint64_t bytes_in = closed_bytes_in;
+	uint64_t bytes_out = closed_bytes_out;
 	mowgli_node_t *n;
-	char buf[160];
-	char buf2[20];
+	size_t i, sendq;
+	char buf[256];
+	char buf2[80];
 
 	MOWGLI_ITER_FOREACH(n, connection_list.head)
 	{
@@ -719,6 +802,19 @@ connection_stats(void (*stats_cb)(const char *, void *), void *privdata)
 			snprintf(buf2, sizeof buf2, " listener %d", c->listener->fd);
 			mowgli_strlcat(buf, buf2, sizeof buf);
 		}
+		if (CF_IS_LISTENING(c))
+		{
+			snprintf(buf2, sizeof buf2, " children %zu accepts %u",
+					MOWGLI_LIST_LENGTH(&c->children), c->accepts);
+			mowgli_strlcat(buf, buf2, sizeof buf);
+			listeners++;
+		}
+		else
+		{
+			snprintf(buf2, sizeof buf2, " sendq %zu in %" PRIu64 " out %" PRIu64,
+					sendq_length(c), c->bytes_in, c->bytes_out);
+			mowgli_strlcat(buf, buf2, sizeof buf);
+		}
 		if (c->flags & (CF_CONNECTING | CF_DEAD | CF_NONEWLINE | CF_SEND_EOF | CF_SEND_DEAD))
 		{
 			mowgli_strlcat(buf, " status", sizeof buf);
@@ -734,7 +830,27 @@ connection_stats(void (*stats_cb)(const char *, void *), void *privdata)
 				mowgli_strlcat(buf, " send_eof", sizeof buf);
 		}
 		stats_cb(buf, privdata);
+
+		bytes_in += c->bytes_in;
+		bytes_out += c->bytes_out;
+
+		sendq = sendq_length(c);
+		for (i = 0; i < ARRAY_SIZE(sendq_buckets) && sendq >= sendq_buckets[i]; i++)
+			;
+		sendq_hist[i]++;
 	}
+
+	snprintf(buf, sizeof buf, "total %zu connections, %u listeners, %u accepted (%u in last %ds)",
+			MOWGLI_LIST_LENGTH(&connection_list), listeners, accept_total,
+			connection_accept_rate(), ACCEPT_WINDOW);
+	stats_cb(buf, privdata);
+
+	snprintf(buf, sizeof buf, "total %" PRIu64 " bytes in, %" PRIu64 " bytes out", bytes_in, bytes_out);
+	stats_cb(buf, privdata);
+
+	snprintf(buf, sizeof buf, "sendq empty %u, <4K %u, <64K %u, <1M %u, >=1M %u",
+			sendq_hist[0], sendq_hist[1], sendq_hist[2], sendq_hist[3], sendq_hist[4]);
+	stats_cb(buf, privdata);
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
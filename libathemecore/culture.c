@@ -19,6 +19,24 @@
 static mowgli_patricia_t *itranslation_tree; /* internal translations, userserv/nickserv etc */
 static mowgli_patricia_t *translation_tree; /* language translations */
 
+/* translation_get() results, so that each distinct string costs one
+ * lookup instead of two; a string with no translation maps to the
+ * address of translation_none. Emptied whenever either tree changes,
+ * which includes every rehash.
+ */
+static mowgli_patricia_t *translation_cache;
+static const char translation_none[] = "";
+
+static void
+translation_cache_flush(void)
+{
+	if (mowgli_patricia_size(translation_cache) == 0)
+		return;
+
+	mowgli_patricia_destroy(translation_cache, NULL, NULL);
+	translation_cache = mowgli_patricia_create(noopcanon);
+}
+
 /*
  * translation_init()
  *
@@ -39,6 +57,7 @@ translation_init(void)
 {
 	itranslation_tree = mowgli_patricia_create(noopcanon);
 	translation_tree = mowgli_patricia_create(noopcanon);
+	translation_cache = mowgli_patricia_create(noopcanon);
 }
 
 /*
@@ -58,15 +77,23 @@ const char *
 translation_get(const char *str)
 {
 	struct translation *t;
+	const char *res;
+
+	if ((res = mowgli_patricia_retrieve(translation_cache, str)) != NULL)
+		return res == translation_none ? str : res;
+
+	res = translation_none;
 
 	/* See if an internal substitution is present. */
 	if ((t = mowgli_patricia_retrieve(itranslation_tree, str)) != NULL)
-		str = t->replacement;
+		res = t->replacement;
 
-	if ((t = mowgli_patricia_retrieve(translation_tree, str)) != NULL)
-		return t->replacement;
+	if ((t = mowgli_patricia_retrieve(translation_tree, res != translation_none ? res : str)) != NULL)
+		res = t->replacement;
 
-	return str;
+	mowgli_patricia_add(translation_cache, str, (void *) res);
+
+	return res == translation_none ? str : res;
 }
 
 /*
@@ -90,6 +117,7 @@ itranslation_create(const char *str, const char *trans)
 	t->replacement = sstrdup(trans);
 
 	mowgli_patricia_add(itranslation_tree, t->name, t);
+	translation_cache_flush();
 }
 
 /*
@@ -112,6 +140,8 @@ itranslation_destroy(const char *str)
 	if (t == NULL)
 		return;
 
+	translation_cache_flush();
+
 	sfree(t->name);
 	sfree(t->replacement);
 	sfree(t);
@@ -146,6 +176,7 @@ translation_create(const char *str, const char *trans)
 	t->replacement = sstrdup(buf);
 
 	mowgli_patricia_add(translation_tree, t->name, t);
+	translation_cache_flush();
 }
 
 /*
@@ -168,6 +199,8 @@ translation_destroy(const char *str)
 	if (t == NULL)
 		return;
 
+	translation_cache_flush();
+
 	sfree(t->name);
 	sfree(t->replacement);
 	sfree(t);
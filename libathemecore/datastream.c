@@ -24,21 +24,120 @@
 # define ENOBUFS	WSAENOBUFS
 #endif
 
+/* Maximum number of sendq chunks handed to a single writev(2) call.
+ * Kernel socket buffers rarely take more than a few hundred KB at once,
+ * so there is no point in building a longer vector than this even when
+ * the platform would allow it.
+ */
+#define SENDQ_IOVMAX 64
+
+#ifdef HAVE_SYS_UIO_H
+# if defined(IOV_MAX) && IOV_MAX < SENDQ_IOVMAX
+#  undef SENDQ_IOVMAX
+#  define SENDQ_IOVMAX IOV_MAX
+# endif
+#endif
+
 /* sendq struct */
 struct sendq {
 	mowgli_node_t node;
 	int firstused; /* offset of first used byte */
 	int firstfree; /* 1 + offset of last used byte */
+	int fd; /* for a file segment, the file to send from; else -1 */
+	off_t offset; /* file segment: next byte of the file to send */
+	size_t filelen; /* file segment: bytes of it left to send */
 	char buf[SENDQSIZE];
 };
 
+/* send and receive queue chunks are recycled through this heap instead
+ * of going back to malloc(3) every time a line is queued or flushed */
+static mowgli_heap_t *sendq_heap = NULL;
+
+static struct sendq *
+sendq_chunk_alloc(mowgli_list_t *list)
+{
+	struct sendq *sq;
+
+	if (sendq_heap == NULL)
+		sendq_heap = mowgli_heap_create(sizeof(struct sendq), 32, BH_LAZY);
+
+	sq = mowgli_heap_alloc(sendq_heap);
+	sq->fd = -1;
+	memtag_alloc(&memtag_core[MEMTAG_SENDQ], sizeof *sq);
+	mowgli_node_add(sq, &sq->node, list);
+
+	return sq;
+}
+
+static void
+sendq_chunk_free(struct sendq *sq, mowgli_list_t *list)
+{
+	if (sq->fd != -1)
+		close(sq->fd);
+
+	mowgli_node_delete(&sq->node, list);
+	memtag_free(&memtag_core[MEMTAG_SENDQ], sizeof *sq);
+	mowgli_heap_free(sendq_heap, sq);
+}
+
+/* Drop `len' bytes from the head of the sendq after a successful write,
+ * releasing drained chunks but keeping the last one around for reuse. */
+static void
+sendq_consume(struct connection *cptr, size_t len)
+{
+	mowgli_node_t *n, *tn;
+	struct sendq *sq;
+	size_t l;
+
+	cptr->sendq_len -= len;
+	cptr->bytes_out += len;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, cptr->sendq.head)
+	{
+		if (len == 0)
+			break;
+
+		sq = n->data;
+
+		if (sq->fd != -1)
+		{
+			l = sq->filelen;
+			if (l > len)
+				l = len;
+			sq->offset += l;
+			sq->filelen -= l;
+			len -= l;
+
+			if (sq->filelen == 0)
+				sendq_chunk_free(sq, &cptr->sendq);
+
+			continue;
+		}
+
+		l = sq->firstfree - sq->firstused;
+		if (l > len)
+			l = len;
+		sq->firstused += l;
+		len -= l;
+
+		if (sq->firstused == sq->firstfree)
+		{
+			if (MOWGLI_LIST_LENGTH(&cptr->sendq) > 1)
+				sendq_chunk_free(sq, &cptr->sendq);
+			else
+				/* keep one struct sendq */
+				sq->firstused = sq->firstfree = 0;
+		}
+	}
+}
+
 void
 sendq_add(struct connection * cptr, char *buf, size_t len)
 {
 	mowgli_node_t *n;
 	struct sendq *sq;
 	size_t l;
-	int pos = 0;
+	size_t pos = 0;
 
 	return_if_fail(cptr != NULL);
 
@@ -51,8 +150,7 @@ sendq_add(struct connection * cptr, char *buf, size_t len)
 	if (len == 0)
 		return;
 
-	if (cptr->sendq_limit != 0 &&
-			MOWGLI_LIST_LENGTH(&cptr->sendq) * SENDQSIZE + len > cptr->sendq_limit)
+	if (cptr->sendq_limit != 0 && cptr->sendq_len + len > cptr->sendq_limit)
 	{
 		slog(LG_INFO, "sendq_add(): sendq limit exceeded on connection %s[%d]",
 				cptr->name, cptr->fd);
@@ -63,8 +161,10 @@ sendq_add(struct connection * cptr, char *buf, size_t len)
 	if (!sendq_nonempty(cptr))
 		connection_setselect_write(cptr, sendq_flush);
 
+	cptr->sendq_len += len;
+
 	n = cptr->sendq.tail;
-	if (n != NULL)
+	if (n != NULL && ((struct sendq *) n->data)->fd == -1)
 	{
 		sq = n->data;
 		l = SENDQSIZE - sq->firstfree;
@@ -78,8 +178,7 @@ sendq_add(struct connection * cptr, char *buf, size_t len)
 
 	while (len > 0)
 	{
-		sq = smalloc(sizeof *sq);
-		mowgli_node_add(sq, &sq->node, &cptr->sendq);
+		sq = sendq_chunk_alloc(&cptr->sendq);
 		l = SENDQSIZE;
 		if (l > len)
 			l = len;
@@ -90,6 +189,92 @@ sendq_add(struct connection * cptr, char *buf, size_t len)
 	}
 }
 
+/* Queues `len' bytes of the open file `fd', starting at `offset', to be
+ * sent after everything queued so far, without reading them into memory
+ * where the platform has sendfile(2). The sendq takes ownership of fd and
+ * closes it once the segment is sent or the connection goes away. The
+ * segment counts towards the sendq length, and against its limit, just as
+ * the same bytes would if they were queued with sendq_add().
+ */
+void
+sendq_add_file(struct connection *cptr, int fd, off_t offset, size_t len)
+{
+	struct sendq *sq;
+
+	return_if_fail(cptr != NULL);
+	return_if_fail(fd != -1);
+
+	if (cptr->flags & (CF_DEAD | CF_SEND_EOF))
+	{
+		slog(LG_DEBUG, "sendq_add_file(): attempted to send to fd %d which is already dead", cptr->fd);
+		close(fd);
+		return;
+	}
+
+	if (len == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	if (cptr->sendq_limit != 0 && cptr->sendq_len + len > cptr->sendq_limit)
+	{
+		slog(LG_INFO, "sendq_add_file(): sendq limit exceeded on connection %s[%d]",
+				cptr->name, cptr->fd);
+		cptr->flags |= CF_DEAD;
+		close(fd);
+		return;
+	}
+
+	if (!sendq_nonempty(cptr))
+		connection_setselect_write(cptr, sendq_flush);
+
+	cptr->sendq_len += len;
+
+	sq = sendq_chunk_alloc(&cptr->sendq);
+	sq->fd = fd;
+	sq->offset = offset;
+	sq->filelen = len;
+}
+
+/* Sends what it can of the file segment at the head of the sendq. Without
+ * sendfile(2), the next piece of the file is read into the segment's own
+ * buffer, which it does not otherwise use.
+ */
+static ssize_t
+sendq_send_file(struct connection *cptr, struct sendq *sq, size_t *want)
+{
+	ssize_t l;
+
+#ifdef HAVE_SYS_SENDFILE_H
+	off_t offset = sq->offset;
+
+	*want = sq->filelen;
+	l = sendfile(cptr->fd, sq->fd, &offset, sq->filelen);
+#else
+	*want = sq->filelen;
+	if (*want > SENDQSIZE)
+		*want = SENDQSIZE;
+
+	if (lseek(sq->fd, sq->offset, SEEK_SET) == -1)
+		return -1;
+
+	l = read(sq->fd, sq->buf, *want);
+	if (l > 0)
+		l = send(cptr->fd, sq->buf, l, 0);
+#endif
+
+	/* the file got shorter since it was queued; there is nothing more
+	 * to send, but the other side is still expecting it */
+	if (l == 0)
+	{
+		errno = EIO;
+		l = -1;
+	}
+
+	return l;
+}
+
 void
 sendq_add_eof(struct connection * cptr)
 {
@@ -108,24 +293,80 @@ sendq_add_eof(struct connection * cptr)
 void
 sendq_flush(struct connection * cptr)
 {
-        mowgli_node_t *n, *tn;
-        struct sendq *sq;
-        int l;
+	mowgli_node_t *n;
+	struct sendq *sq;
+	ssize_t l;
+	size_t want;
+#ifdef HAVE_SYS_UIO_H
+	struct iovec iov[SENDQ_IOVMAX];
+	struct sendq *file;
+	int iovcnt;
+#endif
 
 	return_if_fail(cptr != NULL);
 
-        MOWGLI_ITER_FOREACH_SAFE(n, tn, cptr->sendq.head)
-        {
-                sq = (struct sendq *)n->data;
+	while (cptr->sendq_len > 0)
+	{
+		want = 0;
+
+#ifdef HAVE_SYS_UIO_H
+		iovcnt = 0;
+
+		file = NULL;
+
+		MOWGLI_ITER_FOREACH(n, cptr->sendq.head)
+		{
+			sq = n->data;
+
+			/* a file segment goes out on its own, once
+			 * everything queued before it has */
+			if (sq->fd != -1)
+			{
+				if (iovcnt == 0)
+					file = sq;
+				break;
+			}
+
+			if (sq->firstused == sq->firstfree)
+				continue;
+
+			iov[iovcnt].iov_base = sq->buf + sq->firstused;
+			iov[iovcnt].iov_len = sq->firstfree - sq->firstused;
+			want += iov[iovcnt].iov_len;
+
+			if (++iovcnt == SENDQ_IOVMAX)
+				break;
+		}
+
+		if (file != NULL)
+			l = sendq_send_file(cptr, file, &want);
+		else
+			l = writev(cptr->fd, iov, iovcnt);
+#else
+		sq = NULL;
+
+		MOWGLI_ITER_FOREACH(n, cptr->sendq.head)
+		{
+			sq = n->data;
+
+			if (sq->fd != -1 || sq->firstused != sq->firstfree)
+				break;
+		}
 
-                if (sq->firstused == sq->firstfree)
-                        break;
+		if (sq->fd != -1)
+			l = sendq_send_file(cptr, sq, &want);
+		else
+		{
+			want = sq->firstfree - sq->firstused;
+			l = send(cptr->fd, sq->buf + sq->firstused, want, 0);
+		}
+#endif
 
-                if ((l = send(cptr->fd, sq->buf + sq->firstused, sq->firstfree - sq->firstused, 0)) == -1)
-                {
-                        int err = ioerrno();
+		if (l == -1)
+		{
+			int err = ioerrno();
 
-                        if (!mowgli_eventloop_ignore_errno(err))
+			if (!mowgli_eventloop_ignore_errno(err))
 			{
 				slog(LG_DEBUG, "sendq_flush(): write error %d (%s) on connection %s[%d]",
 						err, strerror(err),
@@ -133,24 +374,16 @@ sendq_flush(struct connection * cptr)
 				cptr->flags |= CF_DEAD;
 			}
 
-                        return;
-                }
+			return;
+		}
 
-                sq->firstused += l;
-                if (sq->firstused == sq->firstfree)
-                {
-			if (MOWGLI_LIST_LENGTH(&cptr->sendq) > 1)
-			{
-                        	mowgli_node_delete(&sq->node, &cptr->sendq);
-				sfree(sq);
-			}
-			else
-				/* keep one struct sendq */
-				sq->firstused = sq->firstfree = 0;
-                }
-                else
-                        return;
-        }
+		sendq_consume(cptr, (size_t) l);
+
+		/* short write: the socket buffer is full, wait for the next
+		 * write event rather than spinning on EAGAIN */
+		if ((size_t) l < want)
+			return;
+	}
 	if (cptr->flags & CF_SEND_EOF)
 	{
 		/* shut down write end, kill entire connection
@@ -168,18 +401,17 @@ sendq_flush(struct connection * cptr)
 bool
 sendq_nonempty(struct connection *cptr)
 {
-	mowgli_node_t *n;
-	struct sendq *sq;
-
 	if (cptr->flags & CF_SEND_DEAD)
 		return false;
 	if (cptr->flags & CF_SEND_EOF)
 		return true;
-	n = cptr->sendq.head;
-	if (n == NULL)
-		return false;
-	sq = n->data;
-	return sq->firstfree > sq->firstused;
+	return cptr->sendq_len > 0;
+}
+
+size_t
+sendq_length(struct connection *cptr)
+{
+	return cptr->sendq_len;
 }
 
 void
@@ -236,8 +468,7 @@ recvq_put(struct connection *cptr)
 	}
 	if (sq == NULL)
 	{
-		sq = smalloc(sizeof *sq);
-		mowgli_node_add(sq, &sq->node, &cptr->recvq);
+		sq = sendq_chunk_alloc(&cptr->recvq);
 		l = SENDQSIZE;
 	}
 	errno = 0;
@@ -253,7 +484,10 @@ recvq_put(struct connection *cptr)
 		return;
 	}
 	else if (l > 0)
+	{
 		sq->firstfree += l;
+		cptr->bytes_in += l;
+	}
 
 	if (cptr->recvq_handler)
 	{
@@ -297,8 +531,7 @@ recvq_get(struct connection *cptr, char *buf, size_t len)
 		{
 			if (MOWGLI_LIST_LENGTH(&cptr->recvq) > 1)
 			{
-				mowgli_node_delete(&sq->node, &cptr->recvq);
-				sfree(sq);
+				sendq_chunk_free(sq, &cptr->recvq);
 			}
 			else
 				/* keep one struct sendq */
@@ -357,8 +590,7 @@ recvq_getline(struct connection *cptr, char *buf, size_t len)
 		{
 			if (MOWGLI_LIST_LENGTH(&cptr->recvq) > 1)
 			{
-				mowgli_node_delete(&sq->node, &cptr->recvq);
-				sfree(sq);
+				sendq_chunk_free(sq, &cptr->recvq);
 			}
 			else
 				/* keep one struct sendq */
@@ -380,17 +612,17 @@ sendqrecvq_free(struct connection *cptr)
 	{
 		sq = nptr->data;
 
-		mowgli_node_delete(&sq->node, &cptr->recvq);
-		sfree(sq);
+		sendq_chunk_free(sq, &cptr->recvq);
 	}
 
 	MOWGLI_ITER_FOREACH_SAFE(nptr, nptr2, cptr->sendq.head)
 	{
 		sq = nptr->data;
 
-		mowgli_node_delete(&sq->node, &cptr->sendq);
-		sfree(sq);
+		sendq_chunk_free(sq, &cptr->sendq);
 	}
+
+	cptr->sendq_len = 0;
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
@@ -0,0 +1,205 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * deadline.c: One-shot per-object timeouts.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+/*
+ * Things like AKILLs, timed AKICKs and nickname enforcement each used to
+ * keep their own sorted list (insertion O(n)) or be swept by a periodic
+ * timer walking every object. Instead they register a deadline here: all
+ * pending deadlines live in one binary min-heap (timeheap.c) keyed on expiry
+ * time, and a single eventloop timer is kept armed for the earliest of them.
+ *
+ * Each struct deadline embeds its heap node, so it can be moved or cancelled
+ * in O(log n). Callbacks run after the deadline has been
+ * removed and freed, so they may freely add or delete other deadlines.
+ */
+
+static struct timeheap deadline_heap;
+
+static mowgli_heap_t *deadline_obj_heap = NULL;
+static mowgli_eventloop_timer_t *deadline_timer = NULL;
+static time_t deadline_armed = 0;
+
+static struct
+{
+	uint64_t        fired;
+	uint64_t        cancelled;
+} deadline_counts;
+
+static void deadline_run(void *arg);
+
+static inline struct deadline *
+deadline_first(void)
+{
+	struct timeheap_node *const node = timeheap_first(&deadline_heap);
+
+	return node ? TIMEHEAP_ENTRY(node, struct deadline, node) : NULL;
+}
+
+/* make sure the eventloop timer fires no later than the earliest deadline */
+static void
+deadline_arm(void)
+{
+	const struct deadline *const first = deadline_first();
+	time_t when;
+
+	if (first == NULL)
+		return;
+
+	when = first->node.when;
+
+	if (deadline_timer != NULL)
+	{
+		if (deadline_armed <= when)
+			return;
+
+		mowgli_timer_destroy(base_eventloop, deadline_timer);
+	}
+
+	deadline_armed = when;
+	deadline_timer = mowgli_timer_add_once(base_eventloop, "deadline_run", deadline_run, NULL,
+	                                       when > CURRTIME ? when - CURRTIME : 0);
+}
+
+static void
+deadline_run(void *arg)
+{
+	struct deadline *d;
+	deadline_fn fn;
+	void *fnarg;
+
+	// a once-only timer is freed by the eventloop after this returns
+	deadline_timer = NULL;
+
+	while ((d = deadline_first()) != NULL && d->node.when <= CURRTIME)
+	{
+		fn = d->fn;
+		fnarg = d->arg;
+
+		timeheap_remove(&deadline_heap, &d->node);
+		mowgli_heap_free(deadline_obj_heap, d);
+		deadline_counts.fired++;
+
+		fn(fnarg);
+	}
+
+	deadline_arm();
+}
+
+void
+deadline_init(void)
+{
+	deadline_obj_heap = sharedheap_get(sizeof(struct deadline));
+
+	if (deadline_obj_heap == NULL)
+	{
+		slog(LG_ERROR, "deadline_init(): block allocator failed.");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * deadline_add()
+ *
+ * Inputs:
+ *       a name for debugging, callback, callback argument and the time at
+ *       which to call it
+ *
+ * Outputs:
+ *       handle for deadline_move() and deadline_delete()
+ *
+ * Side Effects:
+ *       fn(arg) is called once, at or shortly after the given time, unless
+ *       the deadline is deleted first. The handle is invalid once fn has
+ *       been called.
+ */
+struct deadline *
+deadline_add(const char *name, deadline_fn fn, void *arg, time_t when)
+{
+	struct deadline *const d = mowgli_heap_alloc(deadline_obj_heap);
+
+	d->node.index = 0;
+	d->fn = fn;
+	d->arg = arg;
+	d->name = name;
+
+	timeheap_schedule(&deadline_heap, &d->node, when);
+	deadline_arm();
+
+	return d;
+}
+
+/*
+ * deadline_move()
+ *
+ * Inputs:
+ *       pending deadline, new time at which it should fire
+ *
+ * Outputs:
+ *       none
+ *
+ * Side Effects:
+ *       the deadline is rescheduled
+ */
+void
+deadline_move(struct deadline *d, time_t when)
+{
+	return_if_fail(d != NULL);
+
+	if (d->node.when == when)
+		return;
+
+	timeheap_schedule(&deadline_heap, &d->node, when);
+	deadline_arm();
+}
+
+/*
+ * deadline_delete()
+ *
+ * Inputs:
+ *       pending deadline
+ *
+ * Outputs:
+ *       none
+ *
+ * Side Effects:
+ *       the deadline is cancelled and freed without its callback being run
+ */
+void
+deadline_delete(struct deadline *d)
+{
+	return_if_fail(d != NULL);
+
+	timeheap_remove(&deadline_heap, &d->node);
+	mowgli_heap_free(deadline_obj_heap, d);
+	deadline_counts.cancelled++;
+
+	/* the timer is left armed; if it fires early it simply rearms */
+}
+
+void
+deadline_stats(void (*stats_cb)(const char *, void *), void *privdata)
+{
+	const struct deadline *const first = deadline_first();
+	char buf[BUFSIZE];
+
+	snprintf(buf, sizeof buf, "deadlines %zu pending (next %s in %lds), %" PRIu64 " fired, %" PRIu64 " cancelled",
+			deadline_heap.len,
+			first ? first->name : "none",
+			first ? (long)(first->node.when - CURRTIME) : 0L,
+			deadline_counts.fired, deadline_counts.cancelled);
+	stats_cb(buf, privdata);
+}
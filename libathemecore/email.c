@@ -0,0 +1,1064 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2005-2014 Atheme Project (http://atheme.org/)
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * email.c: Email templates and the outgoing mail queue.
+ *
+ * Messages are rendered from templates that are parsed once and kept in
+ * memory, then written to a spool directory under the data directory.
+ * A long-lived delivery worker process hands spooled messages to the MTA
+ * and removes each one once delivered. Messages that could not be
+ * delivered stay in the spool and are retried later.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+#define EMAIL_QUEUE_DIR         "mailqueue"
+#define EMAIL_QUEUE_BATCH       50U                     // messages per MTA session
+#define EMAIL_QUEUE_RETRY       (5U * SECONDS_PER_MINUTE)
+#define EMAIL_QUEUE_MAXAGE      SECONDS_PER_DAY
+#define EMAIL_SMTP_TIMEOUT      60                      // seconds to wait for each reply from the MTA
+#define EMAIL_WORKER_RESTART    SECONDS_PER_MINUTE      // before replacing a worker that failed
+
+enum email_var
+{
+	EMAIL_VAR_LITERAL = 0,
+	EMAIL_VAR_FROM,
+	EMAIL_VAR_TO,
+	EMAIL_VAR_REPLYTO,
+	EMAIL_VAR_DATE,
+	EMAIL_VAR_ACCOUNTNAME,
+	EMAIL_VAR_ENTITYNAME,
+	EMAIL_VAR_NETNAME,
+	EMAIL_VAR_PARAM,
+	EMAIL_VAR_SOURCEINFO,
+	EMAIL_VAR_SERVICE,
+};
+
+struct email_token
+{
+	const char *    token;
+	enum email_var  var;
+	const char *    service;
+};
+
+static const struct email_token email_tokens[] = {
+	{ "&from&",             EMAIL_VAR_FROM,         NULL            },
+	{ "&to&",               EMAIL_VAR_TO,           NULL            },
+	{ "&replyto&",          EMAIL_VAR_REPLYTO,      NULL            },
+	{ "&date&",             EMAIL_VAR_DATE,         NULL            },
+	{ "&accountname&",      EMAIL_VAR_ACCOUNTNAME,  NULL            },
+	{ "&entityname&",       EMAIL_VAR_ENTITYNAME,   NULL            },
+	{ "&netname&",          EMAIL_VAR_NETNAME,      NULL            },
+	{ "&param&",            EMAIL_VAR_PARAM,        NULL            },
+	{ "&sourceinfo&",       EMAIL_VAR_SOURCEINFO,   NULL            },
+	{ "&alissvs&",          EMAIL_VAR_SERVICE,      "alis"          },
+	{ "&botsvs&",           EMAIL_VAR_SERVICE,      "botserv"       },
+	{ "&chanfix&",          EMAIL_VAR_SERVICE,      "chanfix"       },
+	{ "&chansvs&",          EMAIL_VAR_SERVICE,      "chanserv"      },
+	{ "&gamesvs&",          EMAIL_VAR_SERVICE,      "gameserv"      },
+	{ "&groupsvs&",         EMAIL_VAR_SERVICE,      "groupserv"     },
+	{ "&helpsvs&",          EMAIL_VAR_SERVICE,      "helpserv"      },
+	{ "&hostsvs&",          EMAIL_VAR_SERVICE,      "hostserv"      },
+	{ "&infosvs&",          EMAIL_VAR_SERVICE,      "infoserv"      },
+	{ "&memosvs&",          EMAIL_VAR_SERVICE,      "memoserv"      },
+	{ "&nicksvs&",          EMAIL_VAR_SERVICE,      "nickserv"      },
+	{ "&opersvs&",          EMAIL_VAR_SERVICE,      "operserv"      },
+	{ "&rpgsvs&",           EMAIL_VAR_SERVICE,      "rpgserv"       },
+	{ "&statsvs&",          EMAIL_VAR_SERVICE,      "statserv"      },
+	{ NULL,                 EMAIL_VAR_LITERAL,      NULL            },
+};
+
+// A run of literal text or a single substitution in a compiled template
+struct email_segment
+{
+	mowgli_node_t                   node;
+	const struct email_token *      token;
+	char *                          text;
+	size_t                          len;
+};
+
+struct email_template
+{
+	char            type[BUFSIZE];
+	mowgli_list_t   segments;
+};
+
+struct email_vars
+{
+	const char *    from;
+	const char *    to;
+	const char *    date;
+	const char *    accountname;
+	const char *    entityname;
+	const char *    param;
+	const char *    sourceinfo;
+};
+
+static mowgli_patricia_t *email_templates = NULL;
+
+#ifndef MOWGLI_OS_WIN
+static mowgli_eventloop_timer_t *email_worker_timer = NULL;
+static pid_t email_worker_pid = 0;
+static int email_worker_fd = -1;
+static unsigned int email_queue_seq = 0;
+
+// Set in the worker once the MTA has shown that it does not speak SMTP
+static bool email_mta_nosmtp = false;
+#endif
+
+static void
+email_segment_add(struct email_template *const restrict et, const struct email_token *const restrict token,
+                  const char *const restrict text, const size_t len)
+{
+	struct email_segment *const es = smalloc(sizeof *es);
+
+	es->token = token;
+	es->text = smalloc(len + 1);
+	es->len = len;
+
+	(void) memcpy(es->text, text, len);
+
+	(void) mowgli_node_add(es, &es->node, &et->segments);
+}
+
+static void
+email_template_free(struct email_template *const restrict et)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, et->segments.head)
+	{
+		struct email_segment *const es = n->data;
+
+		(void) mowgli_node_delete(n, &et->segments);
+
+		(void) sfree(es->text);
+		(void) sfree(es);
+	}
+
+	(void) sfree(et);
+}
+
+static void
+email_template_free_cb(const char ATHEME_VATTR_UNUSED *const restrict key, void *const restrict data,
+                       void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) email_template_free(data);
+}
+
+static struct email_template *
+email_template_compile(const char *const restrict type)
+{
+	char pathbuf[BUFSIZE];
+	char buf[BUFSIZE];
+	FILE *in;
+
+	(void) snprintf(pathbuf, sizeof pathbuf, "%s/%s", SHAREDIR "/email", type);
+
+	if ((in = fopen(pathbuf, "r")) == NULL)
+		return NULL;
+
+	struct email_template *const et = smalloc(sizeof *et);
+
+	(void) mowgli_strlcpy(et->type, type, sizeof et->type);
+
+	while (fgets(buf, sizeof buf, in))
+	{
+		const char *lit = buf;
+		const char *ptr = buf;
+
+		(void) strip(buf);
+
+		while ((ptr = strchr(ptr, '&')) != NULL)
+		{
+			const struct email_token *token;
+
+			for (token = email_tokens; token->token != NULL; token++)
+				if (strncmp(ptr, token->token, strlen(token->token)) == 0)
+					break;
+
+			if (token->token == NULL)
+			{
+				ptr++;
+				continue;
+			}
+
+			if (ptr > lit)
+				(void) email_segment_add(et, NULL, lit, (size_t) (ptr - lit));
+
+			(void) email_segment_add(et, token, token->token, strlen(token->token));
+
+			ptr += strlen(token->token);
+			lit = ptr;
+		}
+
+		(void) mowgli_strlcat(buf, "\n", sizeof buf);
+		(void) email_segment_add(et, NULL, lit, strlen(lit));
+	}
+
+	(void) fclose(in);
+
+	return et;
+}
+
+static struct email_template *
+email_template_find(const char *const restrict type)
+{
+	struct email_template *et;
+
+	if (! email_templates)
+		email_templates = mowgli_patricia_create(&noopcanon);
+
+	if ((et = mowgli_patricia_retrieve(email_templates, type)) != NULL)
+		return et;
+
+	if ((et = email_template_compile(type)) == NULL)
+		return NULL;
+
+	(void) mowgli_patricia_add(email_templates, et->type, et);
+
+	return et;
+}
+
+// Forgets all compiled templates; they are read again when next used
+void
+email_templates_flush(void)
+{
+	if (! email_templates)
+		return;
+
+	(void) mowgli_patricia_destroy(email_templates, &email_template_free_cb, NULL);
+
+	email_templates = NULL;
+}
+
+static void
+email_template_render(const struct email_template *const restrict et, const struct email_vars *const restrict ev,
+                      mowgli_string_t *const restrict out)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, et->segments.head)
+	{
+		const struct email_segment *const es = n->data;
+		const char *value = NULL;
+
+		if (es->token == NULL)
+		{
+			(void) out->append(out, es->text, es->len);
+			continue;
+		}
+
+		switch (es->token->var)
+		{
+			case EMAIL_VAR_FROM:
+				value = ev->from;
+				break;
+			case EMAIL_VAR_TO:
+				value = ev->to;
+				break;
+			case EMAIL_VAR_REPLYTO:
+				value = me.adminemail;
+				break;
+			case EMAIL_VAR_DATE:
+				value = ev->date;
+				break;
+			case EMAIL_VAR_ACCOUNTNAME:
+				value = ev->accountname;
+				break;
+			case EMAIL_VAR_ENTITYNAME:
+				value = ev->entityname;
+				break;
+			case EMAIL_VAR_NETNAME:
+				value = me.netname;
+				break;
+			case EMAIL_VAR_PARAM:
+				value = ev->param;
+				break;
+			case EMAIL_VAR_SOURCEINFO:
+				value = ev->sourceinfo;
+				break;
+			case EMAIL_VAR_SERVICE:
+			{
+				const struct service *const svs = service_find(es->token->service);
+
+				if (svs != NULL)
+					value = svs->me->nick;
+
+				break;
+			}
+			case EMAIL_VAR_LITERAL:
+				break;
+		}
+
+		// Unknown services are left as they were written, as before
+		if (value == NULL)
+			value = es->text;
+
+		(void) out->append(out, value, strlen(value));
+	}
+}
+
+#ifndef MOWGLI_OS_WIN
+static const char *
+email_queue_path(void)
+{
+	static char path[BUFSIZE];
+
+	(void) snprintf(path, sizeof path, "%s/%s", datadir, EMAIL_QUEUE_DIR);
+
+	return path;
+}
+
+/* Spools a rendered message for delivery to rcpt. The first line of a spool
+ * file is the envelope recipient and the message follows it. Spool files are
+ * named after the time they were written, the process that wrote them and a
+ * sequence number, so names from an earlier run of services never collide
+ * with new ones.
+ */
+bool
+email_queue_add(const char *const restrict rcpt, const char *const restrict msg, const size_t len)
+{
+	char tmppath[BUFSIZE];
+	char path[BUFSIZE];
+	FILE *out;
+	int fd;
+	bool ok = true;
+
+	if (mkdir(email_queue_path(), 0700) != 0 && errno != EEXIST)
+	{
+		(void) slog(LG_ERROR, "%s: cannot create mail queue directory %s: %s", MOWGLI_FUNC_NAME,
+		                      email_queue_path(), strerror(errno));
+		return false;
+	}
+
+	(void) snprintf(tmppath, sizeof tmppath, "%s/tmp.XXXXXX", email_queue_path());
+	(void) snprintf(path, sizeof path, "%s/%lu.%lu.%u.0", email_queue_path(), (unsigned long) time(NULL),
+	                                                        (unsigned long) getpid(), ++email_queue_seq);
+
+	if ((fd = mkstemp(tmppath)) < 0)
+	{
+		(void) slog(LG_ERROR, "%s: cannot create %s: %s", MOWGLI_FUNC_NAME, tmppath, strerror(errno));
+		return false;
+	}
+
+	if ((out = fdopen(fd, "w")) == NULL)
+	{
+		(void) slog(LG_ERROR, "%s: cannot write %s: %s", MOWGLI_FUNC_NAME, tmppath, strerror(errno));
+		(void) close(fd);
+		(void) unlink(tmppath);
+		return false;
+	}
+
+	if (fprintf(out, "%s\n", rcpt) < 0 || (len && fwrite(msg, len, 1, out) != 1))
+		ok = false;
+	if (fclose(out) != 0)
+		ok = false;
+
+	if (! ok || rename(tmppath, path) != 0)
+	{
+		(void) slog(LG_ERROR, "%s: cannot spool %s: %s", MOWGLI_FUNC_NAME, path, strerror(errno));
+		(void) unlink(tmppath);
+		return false;
+	}
+
+	return true;
+}
+
+// A running MTA and, for an SMTP session, its buffered replies
+struct email_mta
+{
+	pid_t   pid;
+	FILE *  to;
+	int     fromfd;
+	bool    failed;
+	size_t  buflen;
+	char    buf[BUFSIZE];
+};
+
+static bool
+email_mta_spawn(struct email_mta *const restrict mta, const bool smtp)
+{
+	int infds[2];
+	int outfds[2] = { -1, -1 };
+
+	if (pipe(infds) < 0)
+		return false;
+
+	if (smtp && pipe(outfds) < 0)
+	{
+		(void) close(infds[0]);
+		(void) close(infds[1]);
+		return false;
+	}
+
+	switch ((mta->pid = fork()))
+	{
+		case -1:
+			(void) close(infds[0]);
+			(void) close(infds[1]);
+
+			if (smtp)
+			{
+				(void) close(outfds[0]);
+				(void) close(outfds[1]);
+			}
+
+			return false;
+
+		case 0:
+			(void) dup2(infds[0], 0);
+			(void) close(infds[0]);
+			(void) close(infds[1]);
+
+			if (smtp)
+			{
+				(void) dup2(outfds[1], 1);
+				(void) close(outfds[0]);
+				(void) close(outfds[1]);
+				(void) execl(me.mta, me.mta, "-bs", NULL);
+			}
+			else
+				(void) execl(me.mta, me.mta, "-t", "-f", me.register_email, NULL);
+
+			_exit(255);
+	}
+
+	(void) close(infds[0]);
+
+	if (smtp)
+		(void) close(outfds[1]);
+
+	mta->to = fdopen(infds[1], "w");
+	mta->fromfd = outfds[0];
+	mta->failed = (mta->to == NULL);
+	mta->buflen = 0;
+
+	if (mta->to == NULL)
+		(void) close(infds[1]);
+
+	return true;
+}
+
+// Closes the pipes to the MTA and waits for it; true if it exited successfully
+static bool
+email_mta_finish(struct email_mta *const restrict mta)
+{
+	int status;
+
+	if (mta->to != NULL)
+		(void) fclose(mta->to);
+	if (mta->fromfd != -1)
+		(void) close(mta->fromfd);
+
+	// An MTA that stopped answering would not notice its input being closed
+	if (mta->failed && mta->fromfd != -1)
+		(void) kill(mta->pid, SIGTERM);
+
+	while (waitpid(mta->pid, &status, 0) < 0)
+	{
+		if (errno != EINTR)
+			return false;
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Reads an SMTP reply, which may span several lines; returns its code or -1
+static int
+email_mta_reply(struct email_mta *const restrict mta)
+{
+	for (;;)
+	{
+		const char *const eol = memchr(mta->buf, '\n', mta->buflen);
+
+		if (eol != NULL)
+		{
+			const size_t linelen = (size_t) (eol - mta->buf) + 1;
+			const char *const line = mta->buf;
+			int code = -1;
+			bool last = false;
+
+			if (linelen >= 4 && isdigit((unsigned char) line[0]) && isdigit((unsigned char) line[1]) &&
+			    isdigit((unsigned char) line[2]))
+			{
+				code = ((line[0] - '0') * 100) + ((line[1] - '0') * 10) + (line[2] - '0');
+				last = (line[3] != '-');
+			}
+
+			(void) memmove(mta->buf, eol + 1, mta->buflen - linelen);
+			mta->buflen -= linelen;
+
+			if (code == -1)
+				break;
+			if (last)
+				return code;
+
+			continue;
+		}
+
+		if (mta->buflen == sizeof mta->buf)
+			break;
+
+		struct pollfd pfd = { .fd = mta->fromfd, .events = POLLIN };
+		const int rc = poll(&pfd, 1, EMAIL_SMTP_TIMEOUT * 1000);
+
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			break;
+
+		const ssize_t n = read(mta->fromfd, mta->buf + mta->buflen, sizeof mta->buf - mta->buflen);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+
+		mta->buflen += (size_t) n;
+	}
+
+	mta->failed = true;
+	return -1;
+}
+
+static int ATHEME_FATTR_PRINTF(2, 3)
+email_mta_command(struct email_mta *const restrict mta, const char *const restrict format, ...)
+{
+	va_list ap;
+
+	if (mta->failed)
+		return -1;
+
+	va_start(ap, format);
+	(void) vfprintf(mta->to, format, ap);
+	va_end(ap);
+
+	if (fputs("\r\n", mta->to) == EOF || fflush(mta->to) != 0)
+	{
+		mta->failed = true;
+		return -1;
+	}
+
+	return email_mta_reply(mta);
+}
+
+/* Copies the rest of a spool file to the MTA. For SMTP, line endings become
+ * CRLF and lines starting with a dot get another one, as DATA requires.
+ */
+static bool
+email_mta_copy(struct email_mta *const restrict mta, FILE *const restrict in, const bool smtp)
+{
+	char line[BUFSIZE];
+	bool bol = true;
+
+	while (fgets(line, sizeof line, in) != NULL)
+	{
+		size_t len = strlen(line);
+		const bool eol = (len && line[len - 1] == '\n');
+
+		if (! smtp)
+		{
+			if (fwrite(line, len, 1, mta->to) != 1)
+				return false;
+
+			continue;
+		}
+
+		if (eol)
+			len--;
+		if (eol && len && line[len - 1] == '\r')
+			len--;
+
+		if (bol && line[0] == '.' && fputc('.', mta->to) == EOF)
+			return false;
+		if (len && fwrite(line, len, 1, mta->to) != 1)
+			return false;
+		if (eol && fputs("\r\n", mta->to) == EOF)
+			return false;
+
+		bol = eol;
+	}
+
+	if (smtp && ! bol && fputs("\r\n", mta->to) == EOF)
+		return false;
+
+	return ferror(in) == 0;
+}
+
+static bool
+email_smtp_open(struct email_mta *const restrict mta)
+{
+	if (! email_mta_spawn(mta, true))
+		return false;
+
+	if (email_mta_reply(mta) == 220 && email_mta_command(mta, "HELO %s", me.name) == 250)
+		return true;
+
+	mta->failed = true;
+	(void) email_mta_finish(mta);
+	return false;
+}
+
+static void
+email_smtp_close(struct email_mta *const restrict mta)
+{
+	(void) email_mta_command(mta, "QUIT");
+	(void) email_mta_finish(mta);
+}
+
+static bool
+email_smtp_deliver(struct email_mta *const restrict mta, const char *const restrict rcpt, FILE *const restrict in)
+{
+	int code;
+
+	if (email_mta_command(mta, "MAIL FROM:<%s>", me.register_email) != 250)
+		goto reset;
+
+	if ((code = email_mta_command(mta, "RCPT TO:<%s>", rcpt)) != 250 && code != 251)
+		goto reset;
+
+	if (email_mta_command(mta, "DATA") != 354)
+		goto reset;
+
+	if (! email_mta_copy(mta, in, true) || fputs(".\r\n", mta->to) == EOF || fflush(mta->to) != 0)
+	{
+		mta->failed = true;
+		return false;
+	}
+
+	return email_mta_reply(mta) == 250;
+
+reset:
+	(void) email_mta_command(mta, "RSET");
+	return false;
+}
+
+static bool
+email_pipe_deliver(FILE *const restrict in)
+{
+	struct email_mta mta;
+
+	if (! email_mta_spawn(&mta, false))
+		return false;
+
+	const bool ok = ! mta.failed && email_mta_copy(&mta, in, false) && fflush(mta.to) == 0;
+
+	return email_mta_finish(&mta) && ok;
+}
+
+/* Hands every spooled message that is due to the MTA, up to a batch at a
+ * time. One MTA process takes the whole batch over SMTP on its standard
+ * input ('mta -bs'); if it will not greet us, each message is piped to its
+ * own 'mta -t' instead, for as long as this process lives.
+ *
+ * Returns how many seconds remain until the next message is due, 0 if more
+ * are due right away, or -1 if nothing is waiting.
+ */
+long
+email_queue_deliver(void)
+{
+	const char *const queuepath = email_queue_path();
+	const time_t now = time(NULL);
+	struct email_mta mta;
+	struct dirent *ent;
+	unsigned int batch = 0;
+	bool session = false;
+	long next = -1;
+	DIR *dir;
+
+	if (me.mta == NULL || (dir = opendir(queuepath)) == NULL)
+		return -1;
+
+	while ((ent = readdir(dir)) != NULL)
+	{
+		char path[BUFSIZE];
+		char newpath[BUFSIZE];
+		char rcpt[BUFSIZE];
+		unsigned long created, pid;
+		unsigned int seq, attempts;
+		struct stat sb;
+		FILE *in;
+		bool ok;
+
+		(void) snprintf(path, sizeof path, "%s/%s", queuepath, ent->d_name);
+
+		if (sscanf(ent->d_name, "%lu.%lu.%u.%u", &created, &pid, &seq, &attempts) != 4)
+		{
+			// Left behind by a crash while spooling
+			if (strncmp(ent->d_name, "tmp.", 4) == 0 && stat(path, &sb) == 0 &&
+			    (time_t) (sb.st_mtime + EMAIL_QUEUE_MAXAGE) < now)
+				(void) unlink(path);
+
+			continue;
+		}
+
+		if (stat(path, &sb) != 0)
+			continue;
+
+		// Back off between attempts for messages the MTA would not accept
+		if (attempts)
+		{
+			const time_t due = sb.st_mtime + (time_t) (attempts * EMAIL_QUEUE_RETRY);
+
+			if (due > now)
+			{
+				if (next == -1 || (long) (due - now) < next)
+					next = (long) (due - now);
+
+				continue;
+			}
+		}
+
+		if (batch == EMAIL_QUEUE_BATCH || (session && mta.failed))
+		{
+			next = 0;
+			break;
+		}
+
+		if ((in = fopen(path, "r")) == NULL)
+			continue;
+
+		if (fgets(rcpt, sizeof rcpt, in) == NULL)
+		{
+			(void) fclose(in);
+			(void) unlink(path);
+			continue;
+		}
+
+		(void) strip(rcpt);
+
+		batch++;
+
+		if (! session && ! email_mta_nosmtp && ! (session = email_smtp_open(&mta)))
+			email_mta_nosmtp = true;
+
+		if (session)
+			ok = email_smtp_deliver(&mta, rcpt, in);
+		else
+			ok = email_pipe_deliver(in);
+
+		(void) fclose(in);
+
+		if (ok || (time_t) (created + EMAIL_QUEUE_MAXAGE) < now)
+		{
+			(void) unlink(path);
+			continue;
+		}
+
+		(void) snprintf(newpath, sizeof newpath, "%s/%lu.%lu.%u.%u", queuepath, created, pid, seq, attempts + 1);
+		(void) rename(path, newpath);
+		(void) utimes(newpath, NULL);
+
+		if (next == -1 || (long) ((attempts + 1) * EMAIL_QUEUE_RETRY) < next)
+			next = (long) ((attempts + 1) * EMAIL_QUEUE_RETRY);
+	}
+
+	(void) closedir(dir);
+
+	if (session)
+		(void) email_smtp_close(&mta);
+
+	return next;
+}
+
+/* The delivery worker. It lives as long as services does, delivering what
+ * is due and then sleeping until the next retry is due or services writes
+ * to the wake-up pipe after spooling a message. It exits once the pipe is
+ * closed, which services does on shutdown and when it is rehashed.
+ */
+static void ATHEME_FATTR_NORETURN
+email_worker_run(const int fd)
+{
+	for (;;)
+	{
+		const long next = email_queue_deliver();
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		char buf[64];
+		int timeout = -1;
+
+		if (next != -1)
+			timeout = (int) ((next < (long) EMAIL_QUEUE_RETRY) ? next : (long) EMAIL_QUEUE_RETRY) * 1000;
+
+		const int rc = poll(&pfd, 1, timeout);
+
+		if (rc < 0 && errno != EINTR)
+			_exit(1);
+		if (rc <= 0)
+			continue;
+
+		const ssize_t n = read(fd, buf, sizeof buf);
+
+		if (n == 0 || (n < 0 && errno != EINTR))
+			_exit(0);
+	}
+}
+
+static void email_worker_start(void);
+
+/* The worker runs for as long as services does, so it must not keep open
+ * anything it inherited: connections, logs, or a database lock that some
+ * module held at the time (which would then stay held for as long as the
+ * worker lives). Only stdio and its wake-up pipe are kept.
+ */
+static void
+email_worker_close_fds(const int keep)
+{
+	long max = sysconf(_SC_OPEN_MAX);
+
+	if (max < 0 || max > INT_MAX)
+		max = 1024;
+
+	for (int fd = 3; fd < (int) max; fd++)
+		if (fd != keep)
+			(void) close(fd);
+}
+
+static void
+email_worker_start_cb(void ATHEME_VATTR_UNUSED *const restrict unused)
+{
+	email_worker_timer = NULL;
+
+	(void) email_worker_start();
+}
+
+static void
+email_worker_waited(pid_t pid, int status, void *data)
+{
+	email_worker_pid = 0;
+
+	if (email_worker_fd != -1)
+	{
+		(void) close(email_worker_fd);
+		email_worker_fd = -1;
+	}
+
+	// It exits cleanly only when asked to, and is then replaced straight away
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	{
+		(void) email_worker_start();
+		return;
+	}
+
+	if (WIFEXITED(status))
+		(void) slog(LG_ERROR, "%s: mail delivery worker exited with status %d", MOWGLI_FUNC_NAME,
+		                      WEXITSTATUS(status));
+	else
+		(void) slog(LG_ERROR, "%s: mail delivery worker died", MOWGLI_FUNC_NAME);
+
+	if (! email_worker_timer)
+		email_worker_timer = mowgli_timer_add_once(base_eventloop, "email_worker_start",
+		                                           &email_worker_start_cb, NULL, EMAIL_WORKER_RESTART);
+}
+
+static void
+email_worker_start(void)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (email_worker_pid != 0 || email_worker_timer != NULL || me.mta == NULL)
+		return;
+
+	if (pipe(fds) < 0)
+	{
+		(void) slog(LG_ERROR, "%s: pipe() failed: %s", MOWGLI_FUNC_NAME, strerror(errno));
+		return;
+	}
+
+	switch ((pid = fork()))
+	{
+		case -1:
+			(void) slog(LG_ERROR, "%s: fork() failed: %s", MOWGLI_FUNC_NAME, strerror(errno));
+			(void) close(fds[0]);
+			(void) close(fds[1]);
+			email_worker_timer = mowgli_timer_add_once(base_eventloop, "email_worker_start",
+			                                           &email_worker_start_cb, NULL, EMAIL_WORKER_RESTART);
+			return;
+
+		case 0:
+			(void) reset_signal_handlers();
+			(void) email_worker_close_fds(fds[0]);
+			(void) fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+			(void) email_worker_run(fds[0]);
+	}
+
+	(void) close(fds[0]);
+	(void) fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	(void) fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+	email_worker_pid = pid;
+	email_worker_fd = fds[1];
+
+	(void) childproc_add(pid, "email worker", &email_worker_waited, NULL);
+}
+
+// Tells the worker that a message has been spooled, starting one if needed
+static void
+email_worker_wake(void)
+{
+	if (email_worker_fd == -1)
+	{
+		(void) email_worker_start();
+		return;
+	}
+
+	// A full pipe already holds a wake-up the worker has yet to read
+	if (write(email_worker_fd, "", 1) != 1 && errno != EAGAIN)
+		(void) slog(LG_DEBUG, "%s: cannot wake the mail delivery worker: %s", MOWGLI_FUNC_NAME,
+		                      strerror(errno));
+}
+
+/* Asks the worker to exit once it has finished what it is doing. When it
+ * has, a new one is started with the current configuration.
+ */
+void
+email_worker_stop(void)
+{
+	if (email_worker_fd == -1)
+		return;
+
+	(void) close(email_worker_fd);
+
+	email_worker_fd = -1;
+}
+#endif /* !MOWGLI_OS_WIN */
+
+void
+email_init(void)
+{
+#ifndef MOWGLI_OS_WIN
+	// Anything left in the spool by a previous run is picked up once the configuration is loaded
+	email_worker_timer = mowgli_timer_add_once(base_eventloop, "email_worker_start", &email_worker_start_cb,
+	                                           NULL, 0);
+#endif
+}
+
+/* send the specified type of email.
+ *
+ * u is whoever caused this to be called, the corresponding service
+ *   in case of xmlrpc
+ * type is EMAIL_*, see include/tools.h
+ * mu is the recipient user
+ * param depends on type, also see include/tools.h
+ */
+int
+sendemail(struct user *u, struct myuser *mu, const char *type, const char *email, const char *param)
+{
+#ifndef MOWGLI_OS_WIN
+	char timebuf[BUFSIZE], to[BUFSIZE], from[BUFSIZE], sourceinfo[BUFSIZE];
+	const struct email_template *et;
+	mowgli_string_t *msg;
+	time_t t;
+	struct tm *tm;
+	int rc;
+	static time_t period_start = 0, lastwallops = 0;
+	static unsigned int emailcount = 0;
+	struct service *svs;
+
+	if (u == NULL || mu == NULL)
+		return 0;
+
+	if (me.mta == NULL)
+	{
+		if (strcmp(type, EMAIL_MEMO) && !is_internal_client(u))
+		{
+			svs = service_find("operserv");
+			notice(svs ? svs->nick : me.name, u->nick, "Sending email is administratively disabled.");
+		}
+		return 0;
+	}
+
+	if (!validemail(email))
+	{
+		if (strcmp(type, EMAIL_MEMO) && !is_internal_client(u))
+		{
+			svs = service_find("operserv");
+			notice(svs ? svs->nick : me.name, u->nick, "The email address is considered invalid.");
+		}
+		return 0;
+	}
+
+	if ((unsigned int)(CURRTIME - period_start) > me.emailtime)
+	{
+		emailcount = 0;
+		period_start = CURRTIME;
+	}
+	emailcount++;
+	if (emailcount > me.emaillimit)
+	{
+		if ((CURRTIME - lastwallops) > SECONDS_PER_MINUTE)
+		{
+			wallops("Rejecting email for %s[%s@%s] due to too high load (type '%s' to %s <%s>)",
+					u->nick, u->user, u->vhost,
+					type, entity(mu)->name, email);
+			slog(LG_ERROR, "sendemail(): rejecting email for %s[%s@%s] (%s) due to too high load (type '%s' to %s <%s>)",
+					u->nick, u->user, u->vhost,
+					u->ip ? u->ip : u->host,
+					type, entity(mu)->name, email);
+			lastwallops = CURRTIME;
+		}
+		return 0;
+	}
+
+	if ((et = email_template_find(type)) == NULL)
+	{
+		slog(LG_ERROR, "sendemail(): rejecting email for %s[%s@%s] (%s), due to unknown type '%s'",
+			       u->nick, u->user, u->vhost, email, type);
+		return 0;
+	}
+
+	slog(LG_INFO, "sendemail(): email for %s[%s@%s] (%s) type %s to %s <%s>",
+			u->nick, u->user, u->vhost, u->ip ? u->ip : u->host,
+			type, entity(mu)->name, email);
+
+	/* set up the email headers */
+	time(&t);
+	tm = localtime(&t);
+	strftime(timebuf, sizeof timebuf, "%a, %d %b %Y %H:%M:%S %z", tm);
+
+	snprintf(from, sizeof from, "\"%s Network Services\" <%s>",
+			me.netname, me.register_email);
+	snprintf(to, sizeof to, "\"%s\" <%s>", entity(mu)->name, email);
+	/* \ is special here; escape it */
+	replace(to, sizeof to, "\\", "\\\\");
+	snprintf(sourceinfo, sizeof sourceinfo, "%s[%s@%s]", u->nick, u->user, u->vhost);
+
+	const struct email_vars ev = {
+		.from           = from,
+		.to             = to,
+		.date           = timebuf,
+		.accountname    = entity(mu)->name,
+		.entityname     = u->myuser ? entity(u->myuser)->name : u->nick,
+		.param          = param,
+		.sourceinfo     = sourceinfo,
+	};
+
+	/* now set up the email */
+	msg = mowgli_string_create();
+	email_template_render(et, &ev, msg);
+
+	rc = email_queue_add(email, msg->str, msg->pos) ? 1 : 0;
+	msg->destroy(msg);
+
+	if (rc == 1)
+		(void) email_worker_wake();
+
+	if (rc == 0)
+		slog(LG_ERROR, "sendemail(): mail queue failure");
+	return rc;
+#else
+# warning implement me :(
+	return 0;
+#endif
+}
@@ -666,211 +666,6 @@ has_ctrl_chars(const char *text)
 	return false;
 }
 
-#ifndef MOWGLI_OS_WIN
-static void
-sendemail_waited(pid_t pid, int status, void *data)
-{
-	char *email;
-
-	email = data;
-	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
-		slog(LG_INFO, "sendemail_waited(): email for %s failed", email);
-	sfree(email);
-}
-#endif
-
-/* send the specified type of email.
- *
- * u is whoever caused this to be called, the corresponding service
- *   in case of xmlrpc
- * type is EMAIL_*, see include/tools.h
- * mu is the recipient user
- * param depends on type, also see include/tools.h
- */
-int
-sendemail(struct user *u, struct myuser *mu, const char *type, const char *email, const char *param)
-{
-#ifndef MOWGLI_OS_WIN
-	char *date = NULL;
-	char timebuf[BUFSIZE], to[BUFSIZE], from[BUFSIZE], buf[BUFSIZE], pathbuf[BUFSIZE], sourceinfo[BUFSIZE];
-	FILE *in, *out;
-	time_t t;
-	struct tm *tm;
-	int pipfds[2];
-	pid_t pid;
-	int rc;
-	static time_t period_start = 0, lastwallops = 0;
-	static unsigned int emailcount = 0;
-	struct service *svs;
-
-	if (u == NULL || mu == NULL)
-		return 0;
-
-	if (me.mta == NULL)
-	{
-		if (strcmp(type, EMAIL_MEMO) && !is_internal_client(u))
-		{
-			svs = service_find("operserv");
-			notice(svs ? svs->nick : me.name, u->nick, "Sending email is administratively disabled.");
-		}
-		return 0;
-	}
-
-	if (!validemail(email))
-	{
-		if (strcmp(type, EMAIL_MEMO) && !is_internal_client(u))
-		{
-			svs = service_find("operserv");
-			notice(svs ? svs->nick : me.name, u->nick, "The email address is considered invalid.");
-		}
-		return 0;
-	}
-
-	if ((unsigned int)(CURRTIME - period_start) > me.emailtime)
-	{
-		emailcount = 0;
-		period_start = CURRTIME;
-	}
-	emailcount++;
-	if (emailcount > me.emaillimit)
-	{
-		if ((CURRTIME - lastwallops) > SECONDS_PER_MINUTE)
-		{
-			wallops("Rejecting email for %s[%s@%s] due to too high load (type '%s' to %s <%s>)",
-					u->nick, u->user, u->vhost,
-					type, entity(mu)->name, email);
-			slog(LG_ERROR, "sendemail(): rejecting email for %s[%s@%s] (%s) due to too high load (type '%s' to %s <%s>)",
-					u->nick, u->user, u->vhost,
-					u->ip ? u->ip : u->host,
-					type, entity(mu)->name, email);
-			lastwallops = CURRTIME;
-		}
-		return 0;
-	}
-
-	snprintf(pathbuf, sizeof pathbuf, "%s/%s", SHAREDIR "/email", type);
-	if ((in = fopen(pathbuf, "r")) == NULL)
-	{
-		slog(LG_ERROR, "sendemail(): rejecting email for %s[%s@%s] (%s), due to unknown type '%s'",
-			       u->nick, u->user, u->vhost, email, type);
-		return 0;
-	}
-
-	slog(LG_INFO, "sendemail(): email for %s[%s@%s] (%s) type %s to %s <%s>",
-			u->nick, u->user, u->vhost, u->ip ? u->ip : u->host,
-			type, entity(mu)->name, email);
-
-	/* set up the email headers */
-	time(&t);
-	tm = localtime(&t);
-	strftime(timebuf, sizeof timebuf, "%a, %d %b %Y %H:%M:%S %z", tm);
-
-	date = timebuf;
-
-	snprintf(from, sizeof from, "\"%s Network Services\" <%s>",
-			me.netname, me.register_email);
-	snprintf(to, sizeof to, "\"%s\" <%s>", entity(mu)->name, email);
-	/* \ is special here; escape it */
-	replace(to, sizeof to, "\\", "\\\\");
-	snprintf(sourceinfo, sizeof sourceinfo, "%s[%s@%s]", u->nick, u->user, u->vhost);
-
-	/* now set up the email */
-	if (pipe(pipfds) < 0)
-	{
-		fclose(in);
-		return 0;
-	}
-	switch (pid = fork())
-	{
-		case -1:
-			fclose(in);
-			return 0;
-		case 0:
-			connection_close_all_fds();
-			close(pipfds[1]);
-			dup2(pipfds[0], 0);
-			execl(me.mta, me.mta, "-t", "-f", me.register_email, NULL);
-			_exit(255);
-	}
-	close(pipfds[0]);
-	childproc_add(pid, "email", sendemail_waited, sstrdup(email));
-	out = fdopen(pipfds[1], "w");
-
-	while (fgets(buf, BUFSIZE, in))
-	{
-		strip(buf);
-
-		replace(buf, sizeof buf, "&from&", from);
-		replace(buf, sizeof buf, "&to&", to);
-		replace(buf, sizeof buf, "&replyto&", me.adminemail);
-		replace(buf, sizeof buf, "&date&", date);
-		replace(buf, sizeof buf, "&accountname&", entity(mu)->name);
-		replace(buf, sizeof buf, "&entityname&", u->myuser ? entity(u->myuser)->name : u->nick);
-		replace(buf, sizeof buf, "&netname&", me.netname);
-		replace(buf, sizeof buf, "&param&", param);
-		replace(buf, sizeof buf, "&sourceinfo&", sourceinfo);
-
-		if ((svs = service_find("alis")) != NULL)
-			replace(buf, sizeof buf, "&alissvs&", svs->me->nick);
-
-		if ((svs = service_find("botserv")) != NULL)
-			replace(buf, sizeof buf, "&botsvs&", svs->me->nick);
-
-		if ((svs = service_find("chanfix")) != NULL)
-			replace(buf, sizeof buf, "&chanfix&", svs->me->nick);
-
-		if ((svs = service_find("chanserv")) != NULL)
-			replace(buf, sizeof buf, "&chansvs&", svs->me->nick);
-
-		if ((svs = service_find("gameserv")) != NULL)
-			replace(buf, sizeof buf, "&gamesvs&", svs->me->nick);
-
-		if ((svs = service_find("groupserv")) != NULL)
-			replace(buf, sizeof buf, "&groupsvs&", svs->me->nick);
-
-		if ((svs = service_find("helpserv")) != NULL)
-			replace(buf, sizeof buf, "&helpsvs&", svs->me->nick);
-
-		if ((svs = service_find("hostserv")) != NULL)
-			replace(buf, sizeof buf, "&hostsvs&", svs->me->nick);
-
-		if ((svs = service_find("infoserv")) != NULL)
-			replace(buf, sizeof buf, "&infosvs&", svs->me->nick);
-
-		if ((svs = service_find("memoserv")) != NULL)
-			replace(buf, sizeof buf, "&memosvs&", svs->me->nick);
-
-		if ((svs = service_find("nickserv")) != NULL)
-			replace(buf, sizeof buf, "&nicksvs&", svs->me->nick);
-
-		if ((svs = service_find("operserv")) != NULL)
-			replace(buf, sizeof buf, "&opersvs&", svs->me->nick);
-
-		if ((svs = service_find("rpgserv")) != NULL)
-			replace(buf, sizeof buf, "&rpgsvs&", svs->me->nick);
-
-		if ((svs = service_find("statserv")) != NULL)
-			replace(buf, sizeof buf, "&statsvs&", svs->me->nick);
-
-		fprintf(out, "%s\n", buf);
-	}
-
-	fclose(in);
-
-	rc = 1;
-	if (ferror(out))
-		rc = 0;
-	if (fclose(out) < 0)
-		rc = 0;
-	if (rc == 0)
-		slog(LG_ERROR, "sendemail(): mta failure");
-	return rc;
-#else
-# warning implement me :(
-	return 0;
-#endif
-}
-
 /* various access level checkers */
 bool
 is_founder(struct mychan *mychan, struct myentity *mt)
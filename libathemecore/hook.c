@@ -38,6 +38,8 @@ typedef struct {
 
 static mowgli_list_t hook_run_stack = { NULL, NULL, 0 };
 
+void (*hook_timing_fn)(const char *event, bool done, unsigned int depth) = NULL;
+
 void
 hooks_init(void)
 {
@@ -158,6 +160,7 @@ hook_call_event(const char *event, void *dptr)
 	hook_run_ctx_t ctx;
 	mowgli_node_t *n, *tn;
 	void (*func)(void *data);
+	void (*const timing)(const char *, bool, unsigned int) = hook_timing_fn;
 
 	return_if_fail(event != NULL);
 
@@ -165,6 +168,9 @@ hook_call_event(const char *event, void *dptr)
 	if (ctx.hook == NULL)
 		return;
 
+	if (timing != NULL)
+		(void) timing(ctx.hook->name, false, (unsigned int) MOWGLI_LIST_LENGTH(&hook_run_stack));
+
 	ctx.dptr = dptr;
 	ctx.flags = HF_RUN;
 
@@ -181,6 +187,9 @@ hook_call_event(const char *event, void *dptr)
 
 out:
 	mowgli_node_delete(&ctx.node, &hook_run_stack);
+
+	if (timing != NULL)
+		(void) timing(ctx.hook->name, true, (unsigned int) MOWGLI_LIST_LENGTH(&hook_run_stack));
 }
 
 static inline hook_run_ctx_t *
@@ -14,13 +14,26 @@
 #include <atheme/stdheaders.h>
 
 /* internal functions */
+void email_init(void);
+void email_templates_flush(void);
+void email_worker_stop(void);
 void event_init(void);
+void help_files_flush(void);
 void hooks_init(void);
 void init_dlink_nodes(void);
 void init_netio(void);
 void init_socket_queues(void);
+void sts_write(const char *buf, size_t len);
 void init_signal_handlers(void);
+void reset_signal_handlers(void);
 
 void language_init(void);
 
+void numeric_server_add(struct server *s);
+void numeric_server_delete(struct server *s);
+struct server *numeric_server_find(const char *id);
+void numeric_user_add(struct user *u);
+void numeric_user_delete(struct user *u);
+struct user *numeric_user_find(const char *id);
+
 #endif /* !ATHEME_LAC_INTERNAL_H */
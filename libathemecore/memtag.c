@@ -0,0 +1,156 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * memtag.c: Live memory accounting per subsystem and per module.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+/*
+ * The core tags are a fixed array; accounting is an increment and an add
+ * at the call site, so it is always on. Modules get their tags from
+ * memtag_get(), which hands back the existing tag for an owner and name
+ * if there is one: a module that keeps its objects across a reload picks
+ * its counts up where it left them, and should only memtag_release() its
+ * tags when it is unloaded for good.
+ */
+
+struct memtag memtag_core[MEMTAG_CORE_COUNT] = {
+	[MEMTAG_USERS]          = { .owner = "core", .name = "users" },
+	[MEMTAG_CHANNELS]       = { .owner = "core", .name = "channels" },
+	[MEMTAG_CHANUSERS]      = { .owner = "core", .name = "chanusers" },
+	[MEMTAG_CHANBANS]       = { .owner = "core", .name = "chanbans" },
+	[MEMTAG_STRSHARE]       = { .owner = "core", .name = "strshare" },
+	[MEMTAG_METADATA]       = { .owner = "core", .name = "metadata" },
+	[MEMTAG_MYUSERS]        = { .owner = "core", .name = "myusers" },
+	[MEMTAG_MYNICKS]        = { .owner = "core", .name = "mynicks" },
+	[MEMTAG_MYCHANS]        = { .owner = "core", .name = "mychans" },
+	[MEMTAG_CHANACS]        = { .owner = "core", .name = "chanacs" },
+	[MEMTAG_MEMOS]          = { .owner = "core", .name = "memos" },
+	[MEMTAG_SENDQ]          = { .owner = "core", .name = "sendq" },
+	[MEMTAG_SERVERS]        = { .owner = "core", .name = "servers" },
+	[MEMTAG_KLINES]         = { .owner = "core", .name = "klines" },
+	[MEMTAG_XLINES]         = { .owner = "core", .name = "xlines" },
+	[MEMTAG_QLINES]         = { .owner = "core", .name = "qlines" },
+	[MEMTAG_CERTFPS]        = { .owner = "core", .name = "certfps" },
+	[MEMTAG_AUTHCOOKIES]    = { .owner = "core", .name = "authcookies" },
+};
+
+static mowgli_list_t memtag_modules;
+
+/*
+ * memtag_get()
+ *
+ * Inputs:
+ *       the name of the module asking, and a name for the tag
+ *
+ * Outputs:
+ *       the tag
+ *
+ * Side Effects:
+ *       the tag is created if it does not exist yet
+ */
+struct memtag *
+memtag_get(const char *const restrict owner, const char *const restrict name)
+{
+	mowgli_node_t *n;
+	struct memtag *tag;
+	size_t ownerlen, namelen;
+	char *buf;
+
+	return_val_if_fail(owner != NULL, NULL);
+	return_val_if_fail(name != NULL, NULL);
+
+	MOWGLI_ITER_FOREACH(n, memtag_modules.head)
+	{
+		tag = n->data;
+
+		if (! strcmp(tag->owner, owner) && ! strcmp(tag->name, name))
+			return tag;
+	}
+
+	ownerlen = strlen(owner) + 1;
+	namelen = strlen(name) + 1;
+
+	// the names are kept in the same allocation, right behind the tag
+	tag = smalloc(sizeof *tag + ownerlen + namelen);
+	buf = (char *) (tag + 1);
+
+	tag->owner = memcpy(buf, owner, ownerlen);
+	tag->name = memcpy(buf + ownerlen, name, namelen);
+
+	(void) mowgli_node_add(tag, &tag->node, &memtag_modules);
+
+	return tag;
+}
+
+void
+memtag_release(struct memtag *const restrict tag)
+{
+	return_if_fail(tag != NULL);
+
+	if (tag->objects || tag->bytes)
+		(void) slog(LG_DEBUG, "memtag_release(): %s/%s released with %zu objects (%zu bytes) still allocated",
+		            tag->owner, tag->name, tag->objects, tag->bytes);
+
+	(void) mowgli_node_delete(&tag->node, &memtag_modules);
+
+	(void) sfree(tag);
+}
+
+void
+memtag_foreach(void (*cb)(const struct memtag *, void *), void *privdata)
+{
+	mowgli_node_t *n;
+
+	for (size_t i = 0; i < MEMTAG_CORE_COUNT; i++)
+		(void) cb(&memtag_core[i], privdata);
+
+	MOWGLI_ITER_FOREACH(n, memtag_modules.head)
+		(void) cb(n->data, privdata);
+}
+
+struct memtag_stats_state
+{
+	void            (*stats_cb)(const char *, void *);
+	void *          privdata;
+	size_t          objects;
+	size_t          bytes;
+};
+
+static void
+memtag_stats_line(const struct memtag *const restrict tag, void *const restrict arg)
+{
+	struct memtag_stats_state *const state = arg;
+	char name[BUFSIZE];
+	char buf[BUFSIZE];
+
+	(void) snprintf(name, sizeof name, "%s/%s", tag->owner, tag->name);
+	(void) snprintf(buf, sizeof buf, "%-28s %9zu objects %12zu bytes (peak %zu)",
+	                name, tag->objects, tag->bytes, tag->peak);
+	(void) state->stats_cb(buf, state->privdata);
+
+	state->objects += tag->objects;
+	state->bytes += tag->bytes;
+}
+
+void
+memtag_stats(void (*stats_cb)(const char *, void *), void *privdata)
+{
+	struct memtag_stats_state state = { .stats_cb = stats_cb, .privdata = privdata };
+	char buf[BUFSIZE];
+
+	(void) memtag_foreach(&memtag_stats_line, &state);
+
+	(void) snprintf(buf, sizeof buf, "%-28s %9zu objects %12zu bytes", "total", state.objects, state.bytes);
+	(void) stats_cb(buf, privdata);
+}
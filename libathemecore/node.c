@@ -24,6 +24,12 @@ static mowgli_heap_t *kline_heap = NULL;	/* 16 */
 static mowgli_heap_t *xline_heap = NULL;	/* 16 */
 static mowgli_heap_t *qline_heap = NULL;	/* 16 */
 
+static void kline_deadline(void *arg);
+static void xline_deadline(void *arg);
+static void qline_deadline(void *arg);
+static void xline_destroy(struct xline *x);
+static void qline_destroy(struct qline *q);
+
 /*************
  * L I S T S *
  *************/
@@ -123,6 +129,7 @@ kline_add_with_id(const char *user, const char *host, const char *reason, long d
 	slog(LG_DEBUG, "kline_add(): %s@%s -> %s (%ld)", user, host, reason, duration);
 
 	k = mowgli_heap_alloc(kline_heap);
+	memtag_alloc(&memtag_core[MEMTAG_KLINES], sizeof *k);
 
 	mowgli_node_add(k, n, &klnlist);
 
@@ -135,6 +142,8 @@ kline_add_with_id(const char *user, const char *host, const char *reason, long d
 	k->expires = CURRTIME + duration;
 	k->number = id;
 
+	kline_schedule_expiry(k);
+
 	cnt.kline++;
 
 
@@ -174,6 +183,9 @@ kline_delete(struct kline *k)
 	if (me.connected && (k->duration == 0 || k->expires > CURRTIME))
 		unkline_sts("*", k->user, k->host);
 
+	if (k->deadline != NULL)
+		deadline_delete(k->deadline);
+
 	n = mowgli_node_find(k, &klnlist);
 	mowgli_node_delete(n, &klnlist);
 	mowgli_node_free(n);
@@ -183,6 +195,7 @@ kline_delete(struct kline *k)
 	sfree(k->reason);
 	sfree(k->setby);
 
+	memtag_free(&memtag_core[MEMTAG_KLINES], sizeof *k);
 	mowgli_heap_free(kline_heap, k);
 
 	cnt.kline--;
@@ -241,34 +254,58 @@ kline_find_user(struct user *u)
 	return NULL;
 }
 
-void
-kline_expire(void *arg)
+static void
+kline_expire_one(struct kline *k)
 {
-	struct kline *k;
-	char *reason;
-	mowgli_node_t *n, *tn;
+	/* TODO: determine validity of k->reason */
+	const char *reason = k->reason ? k->reason : "(none)";
 
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, klnlist.head)
-	{
-		k = (struct kline *)n->data;
+	slog(LG_INFO, "KLINE:EXPIRE: \2%s@%s\2 set \2%s\2 ago by \2%s\2 (reason: %s)",
+		k->user, k->host, time_ago(k->settime), k->setby, reason);
 
-		if (k->duration == 0)
-			continue;
+	verbose_wallops("AKILL expired on \2%s@%s\2, set by \2%s\2 (reason: %s)",
+		k->user, k->host, k->setby, reason);
 
-		if (k->expires <= CURRTIME)
-		{
-			/* TODO: determine validity of k->reason */
-			reason = k->reason ? k->reason : "(none)";
+	kline_delete(k);
+}
 
-			slog(LG_INFO, "KLINE:EXPIRE: \2%s@%s\2 set \2%s\2 ago by \2%s\2 (reason: %s)",
-				k->user, k->host, time_ago(k->settime), k->setby, reason);
+static void
+kline_deadline(void *arg)
+{
+	struct kline *k = arg;
+
+	k->deadline = NULL;
 
-			verbose_wallops("AKILL expired on \2%s@%s\2, set by \2%s\2 (reason: %s)",
-				k->user, k->host, k->setby, reason);
+	if (k->duration == 0)
+		return;
+
+	if (k->expires > CURRTIME)
+		kline_schedule_expiry(k);
+	else
+		kline_expire_one(k);
+}
 
-			kline_delete(k);
-		}
+/*
+ * (Re)arm the expiry deadline of a kline from its duration and expires
+ * fields. Must be called again by anything that changes those after
+ * kline_add(), such as the database loaders.
+ */
+void
+kline_schedule_expiry(struct kline *k)
+{
+	return_if_fail(k != NULL);
+
+	if (k->duration == 0)
+	{
+		if (k->deadline != NULL)
+			deadline_delete(k->deadline);
+
+		k->deadline = NULL;
 	}
+	else if (k->deadline != NULL)
+		deadline_move(k->deadline, k->expires);
+	else
+		k->deadline = deadline_add("kline_expire", kline_deadline, k, k->expires);
 }
 
 /*************
@@ -285,6 +322,7 @@ xline_add(const char *realname, const char *reason, long duration, const char *s
 	slog(LG_DEBUG, "xline_add(): %s -> %s (%ld)", realname, reason, duration);
 
 	x = mowgli_heap_alloc(xline_heap);
+	memtag_alloc(&memtag_core[MEMTAG_XLINES], sizeof *x);
 
 	mowgli_node_add(x, n, &xlnlist);
 
@@ -296,6 +334,8 @@ xline_add(const char *realname, const char *reason, long duration, const char *s
 	x->expires = CURRTIME + duration;
 	x->number = ++xcnt;
 
+	xline_schedule_expiry(x);
+
 	cnt.xline++;
 
 	if (me.connected)
@@ -308,7 +348,6 @@ void
 xline_delete(const char *realname)
 {
 	struct xline *x = xline_find(realname);
-	mowgli_node_t *n;
 
 	if (!x)
 	{
@@ -316,12 +355,23 @@ xline_delete(const char *realname)
 		return;
 	}
 
+	xline_destroy(x);
+}
+
+static void
+xline_destroy(struct xline *x)
+{
+	mowgli_node_t *n;
+
 	slog(LG_DEBUG, "xline_delete(): %s -> %s", x->realname, x->reason);
 
 	/* only unxline if ircd has not already removed this -- jilles */
 	if (me.connected && (x->duration == 0 || x->expires > CURRTIME))
 		unxline_sts("*", x->realname);
 
+	if (x->deadline != NULL)
+		deadline_delete(x->deadline);
+
 	n = mowgli_node_find(x, &xlnlist);
 	mowgli_node_delete(n, &xlnlist);
 	mowgli_node_free(n);
@@ -330,6 +380,7 @@ xline_delete(const char *realname)
 	sfree(x->reason);
 	sfree(x->setby);
 
+	memtag_free(&memtag_core[MEMTAG_XLINES], sizeof *x);
 	mowgli_heap_free(xline_heap, x);
 
 	cnt.xline--;
@@ -389,30 +440,50 @@ xline_find_user(struct user *u)
 	return NULL;
 }
 
-void
-xline_expire(void *arg)
+static void
+xline_expire_one(struct xline *x)
 {
-	struct xline *x;
-	mowgli_node_t *n, *tn;
+	slog(LG_INFO, "XLINE:EXPIRE: \2%s\2 set \2%s\2 ago by \2%s\2",
+		x->realname, time_ago(x->settime), x->setby);
 
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, xlnlist.head)
-	{
-		x = (struct xline *)n->data;
+	verbose_wallops("XLINE expired on \2%s\2, set by \2%s\2",
+		x->realname, x->setby);
 
-		if (x->duration == 0)
-			continue;
+	xline_destroy(x);
+}
+
+static void
+xline_deadline(void *arg)
+{
+	struct xline *x = arg;
 
-		if (x->expires <= CURRTIME)
-		{
-			slog(LG_INFO, "XLINE:EXPIRE: \2%s\2 set \2%s\2 ago by \2%s\2",
-				x->realname, time_ago(x->settime), x->setby);
+	x->deadline = NULL;
+
+	if (x->duration == 0)
+		return;
+
+	if (x->expires > CURRTIME)
+		xline_schedule_expiry(x);
+	else
+		xline_expire_one(x);
+}
+
+void
+xline_schedule_expiry(struct xline *x)
+{
+	return_if_fail(x != NULL);
 
-			verbose_wallops("XLINE expired on \2%s\2, set by \2%s\2",
-				x->realname, x->setby);
+	if (x->duration == 0)
+	{
+		if (x->deadline != NULL)
+			deadline_delete(x->deadline);
 
-			xline_delete(x->realname);
-		}
+		x->deadline = NULL;
 	}
+	else if (x->deadline != NULL)
+		deadline_move(x->deadline, x->expires);
+	else
+		x->deadline = deadline_add("xline_expire", xline_deadline, x, x->expires);
 }
 
 /*************
@@ -429,6 +500,7 @@ qline_add(const char *mask, const char *reason, long duration, const char *setby
 	slog(LG_DEBUG, "qline_add(): %s -> %s (%ld)", mask, reason, duration);
 
 	q = mowgli_heap_alloc(qline_heap);
+	memtag_alloc(&memtag_core[MEMTAG_QLINES], sizeof *q);
 	mowgli_node_add(q, n, &qlnlist);
 
 	q->mask = sstrdup(mask);
@@ -439,6 +511,8 @@ qline_add(const char *mask, const char *reason, long duration, const char *setby
 	q->expires = CURRTIME + duration;
 	q->number = ++qcnt;
 
+	qline_schedule_expiry(q);
+
 	cnt.qline++;
 
 	if (me.connected)
@@ -451,7 +525,6 @@ void
 qline_delete(const char *mask)
 {
 	struct qline *q = qline_find(mask);
-	mowgli_node_t *n;
 
 	if (!q)
 	{
@@ -459,12 +532,23 @@ qline_delete(const char *mask)
 		return;
 	}
 
+	qline_destroy(q);
+}
+
+static void
+qline_destroy(struct qline *q)
+{
+	mowgli_node_t *n;
+
 	slog(LG_DEBUG, "qline_delete(): %s -> %s", q->mask, q->reason);
 
 	/* only unqline if ircd has not already removed this -- jilles */
 	if (me.connected && (q->duration == 0 || q->expires > CURRTIME))
 		unqline_sts("*", q->mask);
 
+	if (q->deadline != NULL)
+		deadline_delete(q->deadline);
+
 	n = mowgli_node_find(q, &qlnlist);
 	mowgli_node_delete(n, &qlnlist);
 	mowgli_node_free(n);
@@ -473,6 +557,7 @@ qline_delete(const char *mask)
 	sfree(q->reason);
 	sfree(q->setby);
 
+	memtag_free(&memtag_core[MEMTAG_QLINES], sizeof *q);
 	mowgli_heap_free(qline_heap, q);
 
 	cnt.qline--;
@@ -571,30 +656,50 @@ qline_find_channel(struct channel *c)
 	return NULL;
 }
 
-void
-qline_expire(void *arg)
+static void
+qline_expire_one(struct qline *q)
 {
-	struct qline *q;
-	mowgli_node_t *n, *tn;
+	slog(LG_INFO, "QLINE:EXPIRE: \2%s\2 set \2%s\2 ago by \2%s\2",
+		q->mask, time_ago(q->settime), q->setby);
 
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, qlnlist.head)
-	{
-		q = (struct qline *)n->data;
+	verbose_wallops("QLINE expired on \2%s\2, set by \2%s\2",
+		q->mask, q->setby);
 
-		if (q->duration == 0)
-			continue;
+	qline_destroy(q);
+}
+
+static void
+qline_deadline(void *arg)
+{
+	struct qline *q = arg;
+
+	q->deadline = NULL;
 
-		if (q->expires <= CURRTIME)
-		{
-			slog(LG_INFO, "QLINE:EXPIRE: \2%s\2 set \2%s\2 ago by \2%s\2",
-				q->mask, time_ago(q->settime), q->setby);
+	if (q->duration == 0)
+		return;
+
+	if (q->expires > CURRTIME)
+		qline_schedule_expiry(q);
+	else
+		qline_expire_one(q);
+}
 
-			verbose_wallops("QLINE expired on \2%s\2, set by \2%s\2",
-				q->mask, q->setby);
+void
+qline_schedule_expiry(struct qline *q)
+{
+	return_if_fail(q != NULL);
+
+	if (q->duration == 0)
+	{
+		if (q->deadline != NULL)
+			deadline_delete(q->deadline);
 
-			qline_delete(q->mask);
-		}
+		q->deadline = NULL;
 	}
+	else if (q->deadline != NULL)
+		deadline_move(q->deadline, q->expires);
+	else
+		q->deadline = deadline_add("qline_expire", qline_deadline, q, q->expires);
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
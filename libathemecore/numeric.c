@@ -0,0 +1,317 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * numeric.c: Direct-indexed directory of SIDs and UIDs.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+/*
+ * P10 numerics (2 base64 characters of server, 3 of client) and TS6-style
+ * SIDs and UIDs (3 and 6 characters of [0-9A-Z]) are fixed-width numbers.
+ * Decoded, they index straight into tables, so resolving the source and
+ * targets of every line does not have to walk the sidlist and uidlist
+ * tries.
+ *
+ * The tables are radix trees of up to three levels of pages, allocated as
+ * they are first used. One maps the server part to a struct numeric_server
+ * holding that server and a second tree of the clients behind it.
+ *
+ * The tries in servers.c and users.c stay authoritative: anything which
+ * does not decode, or is not found here, is looked up there as before.
+ */
+
+#define NUMERIC_PAGE_BITS       10U
+#define NUMERIC_PAGE_SIZE       (1U << NUMERIC_PAGE_BITS)
+#define NUMERIC_PAGE_MASK       (NUMERIC_PAGE_SIZE - 1U)
+#define NUMERIC_TOP_SIZE        (1U << (32U - (2U * NUMERIC_PAGE_BITS)))
+
+struct numeric_leaf
+{
+	void *                  slot[NUMERIC_PAGE_SIZE];
+};
+
+struct numeric_mid
+{
+	struct numeric_leaf *   leaf[NUMERIC_PAGE_SIZE];
+};
+
+struct numeric_tree
+{
+	struct numeric_mid *    mid[NUMERIC_TOP_SIZE];
+	size_t                  count;
+};
+
+struct numeric_server
+{
+	struct server *         server;
+	struct numeric_tree *   clients;
+};
+
+static struct numeric_tree *numeric_servers = NULL;
+
+static void *
+numeric_tree_get(const struct numeric_tree *const restrict t, const uint32_t key)
+{
+	const struct numeric_mid *const mid = t->mid[key >> (2U * NUMERIC_PAGE_BITS)];
+	const struct numeric_leaf *leaf;
+
+	if (mid == NULL)
+		return NULL;
+
+	if ((leaf = mid->leaf[(key >> NUMERIC_PAGE_BITS) & NUMERIC_PAGE_MASK]) == NULL)
+		return NULL;
+
+	return leaf->slot[key & NUMERIC_PAGE_MASK];
+}
+
+static void
+numeric_tree_set(struct numeric_tree *const restrict t, const uint32_t key, void *const restrict value)
+{
+	struct numeric_mid **const mid = &t->mid[key >> (2U * NUMERIC_PAGE_BITS)];
+	struct numeric_leaf **leaf;
+	void **slot;
+
+	if (*mid == NULL)
+	{
+		if (value == NULL)
+			return;
+
+		*mid = smalloc(sizeof **mid);
+	}
+
+	leaf = &(*mid)->leaf[(key >> NUMERIC_PAGE_BITS) & NUMERIC_PAGE_MASK];
+
+	if (*leaf == NULL)
+	{
+		if (value == NULL)
+			return;
+
+		*leaf = smalloc(sizeof **leaf);
+	}
+
+	slot = &(*leaf)->slot[key & NUMERIC_PAGE_MASK];
+
+	if (*slot == NULL && value != NULL)
+		t->count++;
+	else if (*slot != NULL && value == NULL)
+		t->count--;
+
+	*slot = value;
+}
+
+static void
+numeric_tree_free(struct numeric_tree *const restrict t)
+{
+	for (size_t i = 0; i < NUMERIC_TOP_SIZE; i++)
+	{
+		if (t->mid[i] == NULL)
+			continue;
+
+		for (size_t j = 0; j < NUMERIC_PAGE_SIZE; j++)
+			(void) sfree(t->mid[i]->leaf[j]);
+
+		(void) sfree(t->mid[i]);
+	}
+
+	(void) sfree(t);
+}
+
+static bool
+numeric_base36(const char *const restrict buf, const size_t len, uint32_t *const restrict out)
+{
+	uint32_t v = 0;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		const char c = buf[i];
+
+		// both alphabets are case-sensitive, as are the tries
+		if (c >= '0' && c <= '9')
+			v = (v * 36U) + (uint32_t) (c - '0');
+		else if (c >= 'A' && c <= 'Z')
+			v = (v * 36U) + (uint32_t) (c - 'A') + 10U;
+		else
+			return false;
+	}
+
+	*out = v;
+	return true;
+}
+
+static bool
+numeric_decode(const char *const restrict buf, const size_t len, uint32_t *const restrict out)
+{
+	unsigned int v;
+
+	if (! ircd->uses_p10)
+		return numeric_base36(buf, len, out);
+
+	if (! base64touint_exact(buf, len, &v))
+		return false;
+
+	*out = v;
+	return true;
+}
+
+/* Splits an ID into its server and (if it is a UID) client parts. IDs of any
+ * other length, e.g. short P10 numerics or nicknames, are not handled here.
+ */
+static bool
+numeric_split(const char *const restrict id, const bool want_client, uint32_t *const restrict sid,
+              uint32_t *const restrict cid)
+{
+	size_t sidlen, uidlen, len;
+
+	if (ircd == NULL || ! ircd->uses_uid)
+		return false;
+
+	sidlen = ircd->uses_p10 ? 2 : 3;
+	uidlen = ircd->uses_p10 ? 5 : 9;
+
+	for (len = 0; len <= uidlen && id[len] != '\0'; len++)
+		;
+
+	if (len != (want_client ? uidlen : sidlen))
+		return false;
+
+	if (! numeric_decode(id, sidlen, sid))
+		return false;
+
+	if (want_client && ! numeric_decode(id + sidlen, uidlen - sidlen, cid))
+		return false;
+
+	return true;
+}
+
+static struct numeric_server *
+numeric_server_get(const uint32_t sid)
+{
+	struct numeric_server *ns;
+
+	if (numeric_servers == NULL)
+		numeric_servers = smalloc(sizeof *numeric_servers);
+
+	if ((ns = numeric_tree_get(numeric_servers, sid)) != NULL)
+		return ns;
+
+	ns = smalloc(sizeof *ns);
+	(void) numeric_tree_set(numeric_servers, sid, ns);
+
+	return ns;
+}
+
+static void
+numeric_server_release(const uint32_t sid, struct numeric_server *const restrict ns)
+{
+	if (ns->server != NULL || (ns->clients != NULL && ns->clients->count))
+		return;
+
+	if (ns->clients != NULL)
+		(void) numeric_tree_free(ns->clients);
+
+	(void) numeric_tree_set(numeric_servers, sid, NULL);
+	(void) sfree(ns);
+}
+
+void
+numeric_server_add(struct server *const restrict s)
+{
+	uint32_t sid;
+
+	if (s->sid == NULL || ! numeric_split(s->sid, false, &sid, NULL))
+		return;
+
+	numeric_server_get(sid)->server = s;
+}
+
+void
+numeric_server_delete(struct server *const restrict s)
+{
+	struct numeric_server *ns;
+	uint32_t sid;
+
+	if (s->sid == NULL || numeric_servers == NULL || ! numeric_split(s->sid, false, &sid, NULL))
+		return;
+
+	if ((ns = numeric_tree_get(numeric_servers, sid)) == NULL || ns->server != s)
+		return;
+
+	ns->server = NULL;
+	(void) numeric_server_release(sid, ns);
+}
+
+struct server *
+numeric_server_find(const char *const restrict id)
+{
+	const struct numeric_server *ns;
+	uint32_t sid;
+
+	if (numeric_servers == NULL || ! numeric_split(id, false, &sid, NULL))
+		return NULL;
+
+	if ((ns = numeric_tree_get(numeric_servers, sid)) == NULL)
+		return NULL;
+
+	return ns->server;
+}
+
+void
+numeric_user_add(struct user *const restrict u)
+{
+	struct numeric_server *ns;
+	uint32_t sid, cid;
+
+	if (u->uid == NULL || ! numeric_split(u->uid, true, &sid, &cid))
+		return;
+
+	ns = numeric_server_get(sid);
+
+	if (ns->clients == NULL)
+		ns->clients = smalloc(sizeof *ns->clients);
+
+	(void) numeric_tree_set(ns->clients, cid, u);
+}
+
+void
+numeric_user_delete(struct user *const restrict u)
+{
+	struct numeric_server *ns;
+	uint32_t sid, cid;
+
+	if (u->uid == NULL || numeric_servers == NULL || ! numeric_split(u->uid, true, &sid, &cid))
+		return;
+
+	if ((ns = numeric_tree_get(numeric_servers, sid)) == NULL || ns->clients == NULL)
+		return;
+
+	if (numeric_tree_get(ns->clients, cid) != u)
+		return;
+
+	(void) numeric_tree_set(ns->clients, cid, NULL);
+	(void) numeric_server_release(sid, ns);
+}
+
+struct user *
+numeric_user_find(const char *const restrict id)
+{
+	const struct numeric_server *ns;
+	uint32_t sid, cid;
+
+	if (numeric_servers == NULL || ! numeric_split(id, true, &sid, &cid))
+		return NULL;
+
+	if ((ns = numeric_tree_get(numeric_servers, sid)) == NULL || ns->clients == NULL)
+		return NULL;
+
+	return numeric_tree_get(ns->clients, cid);
+}
@@ -22,6 +22,31 @@ mowgli_list_t object_list = { NULL, NULL, 0 };
 
 static mowgli_heap_t *metadata_heap = NULL;	/* HEAP_CHANUSER */
 
+/* Metadata is kept in a small vector sorted by name, so iteration is in
+ * name order. Most objects have a handful of entries which are found by
+ * a linear scan; past
+ * METADATA_INLINE_MAX entries an open-addressed hash index on the
+ * case-folded name is built alongside the vector.
+ */
+
+#define METADATA_INLINE_MAX     8U
+#define METADATA_ALLOC_MIN      4U
+
+struct metadata_table
+{
+	unsigned int            count;
+	unsigned int            alloc;
+	unsigned int            hashsize;
+	struct metadata **      hash;
+	struct metadata *       items[];
+};
+
+static inline size_t
+metadata_table_size(const struct metadata_table *mt)
+{
+	return sizeof *mt + mt->alloc * sizeof mt->items[0] + mt->hashsize * sizeof *mt->hash;
+}
+
 void
 init_metadata(void)
 {
@@ -179,7 +204,8 @@ void
 atheme_object_dispose(void *object)
 {
 	struct atheme_object *obj;
-	mowgli_patricia_t *privatedata, *metadata;
+	mowgli_patricia_t *privatedata;
+	struct metadata_table *metadata;
 
 	return_if_fail(object != NULL);
 	obj = atheme_object(object);
@@ -212,31 +238,226 @@ atheme_object_dispose(void *object)
 		mowgli_patricia_destroy(privatedata, NULL, NULL);
 
 	if (metadata != NULL)
-		mowgli_patricia_destroy(metadata, NULL, NULL);
+	{
+		memtag_resize(&memtag_core[MEMTAG_METADATA], metadata_table_size(metadata), 0);
+
+		sfree(metadata->hash);
+		sfree(metadata);
+	}
+}
+
+static unsigned int
+metadata_hash(const char *name)
+{
+	/* FNV-1a over the lowercased name */
+	unsigned int hash = 2166136261U;
+
+	while (*name)
+	{
+		hash ^= (unsigned char) tolower((unsigned char) *name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static void
+metadata_hash_rebuild(struct metadata_table *mt)
+{
+	unsigned int i, j, mask;
+
+	memtag_resize(&memtag_core[MEMTAG_METADATA], mt->hashsize * sizeof *mt->hash, 0);
+
+	sfree(mt->hash);
+	mt->hash = NULL;
+	mt->hashsize = 0;
+
+	if (mt->count <= METADATA_INLINE_MAX)
+		return;
+
+	for (mt->hashsize = 16; mt->hashsize < mt->count * 2; mt->hashsize *= 2)
+		;
+
+	mt->hash = smalloc(mt->hashsize * sizeof *mt->hash);
+	memtag_resize(&memtag_core[MEMTAG_METADATA], 0, mt->hashsize * sizeof *mt->hash);
+
+	mask = mt->hashsize - 1;
+
+	for (i = 0; i < mt->count; i++)
+	{
+		for (j = metadata_hash(mt->items[i]->name) & mask; mt->hash[j] != NULL; j = (j + 1) & mask)
+			;
+
+		mt->hash[j] = mt->items[i];
+	}
+}
+
+/* Removes an entry from the hash index in place. Entries further along the
+ * same probe run are shifted back into the gap (backward-shift deletion),
+ * so the index never needs tombstones or a rebuild.
+ */
+static void
+metadata_hash_remove(struct metadata_table *mt, const struct metadata *md)
+{
+	const unsigned int mask = mt->hashsize - 1;
+	unsigned int i, j;
+
+	for (i = metadata_hash(md->name) & mask; mt->hash[i] != md; i = (i + 1) & mask)
+		;
+
+	for (j = (i + 1) & mask; mt->hash[j] != NULL; j = (j + 1) & mask)
+	{
+		const unsigned int home = metadata_hash(mt->hash[j]->name) & mask;
+
+		/* the entry at j may fill the gap at i unless its home slot
+		 * lies cyclically after i, i.e. in (i, j] */
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			mt->hash[i] = mt->hash[j];
+			i = j;
+		}
+	}
+
+	mt->hash[i] = NULL;
+}
+
+static void
+metadata_free(struct metadata *md)
+{
+	memtag_free(&memtag_core[MEMTAG_METADATA], sizeof *md + strlen(md->value) + 1);
+
+	strshare_unref(md->name);
+	sfree(md->value);
+
+	mowgli_heap_free(metadata_heap, md);
+}
+
+/* Finds an entry by name. If pos is not NULL, the entry's position in the
+ * vector is stored there too; with the hash index that costs a binary search
+ * of the vector, so only metadata_delete() asks for it.
+ */
+static struct metadata *
+metadata_table_lookup(const struct metadata_table *mt, const char *name, unsigned int *pos)
+{
+	struct metadata *md = NULL;
+	unsigned int i;
+	int cmp;
+
+	if (mt->hash != NULL)
+	{
+		const unsigned int mask = mt->hashsize - 1;
+
+		for (i = metadata_hash(name) & mask; mt->hash[i] != NULL; i = (i + 1) & mask)
+		{
+			if (!strcasecmp(mt->hash[i]->name, name))
+			{
+				md = mt->hash[i];
+				break;
+			}
+		}
+
+		if (md != NULL && pos != NULL)
+		{
+			unsigned int lo = 0, hi = mt->count;
+
+			/* the vector is sorted by name, and names are unique */
+			while (lo < hi)
+			{
+				const unsigned int mid = lo + (hi - lo) / 2;
+
+				if (strcasecmp(mt->items[mid]->name, md->name) < 0)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			*pos = lo;
+		}
+
+		return md;
+	}
+
+	/* names are interned, so a pointer match saves the string compare */
+	for (i = 0; i < mt->count; i++)
+	{
+		if (mt->items[i]->name == name)
+			cmp = 0;
+		else
+			cmp = strcasecmp(mt->items[i]->name, name);
+
+		if (cmp == 0)
+			md = mt->items[i];
+		if (cmp >= 0)
+			break;
+	}
+
+	if (pos != NULL)
+		*pos = i;
+
+	return md;
 }
 
 struct metadata *
 metadata_add(void *target, const char *name, const char *value)
 {
 	struct atheme_object *obj;
+	struct metadata_table *mt;
 	struct metadata *md;
+	unsigned int pos;
 
 	return_val_if_fail(name != NULL, NULL);
 	return_val_if_fail(value != NULL, NULL);
 
 	obj = atheme_object(target);
 
-	if (obj->metadata == NULL)
-		obj->metadata = mowgli_patricia_create(strcasecanon);
-	else if (metadata_find(target, name))
+	if (metadata_find(target, name))
 		metadata_delete(target, name);
 
+	mt = obj->metadata;
+	if (mt == NULL || mt->count == mt->alloc)
+	{
+		const unsigned int alloc = (mt == NULL) ? METADATA_ALLOC_MIN : mt->alloc * 2;
+
+		memtag_resize(&memtag_core[MEMTAG_METADATA], (mt == NULL) ? 0 : sizeof *mt + mt->alloc * sizeof mt->items[0],
+		              sizeof *mt + alloc * sizeof mt->items[0]);
+
+		mt = srealloc(mt, sizeof *mt + alloc * sizeof mt->items[0]);
+		if (obj->metadata == NULL)
+		{
+			mt->count = 0;
+			mt->hashsize = 0;
+			mt->hash = NULL;
+		}
+		mt->alloc = alloc;
+		obj->metadata = mt;
+	}
+
 	md = mowgli_heap_alloc(metadata_heap);
 
 	md->name = strshare_get(name);
 	md->value = sstrdup(value);
 
-	mowgli_patricia_add(obj->metadata, md->name, md);
+	memtag_alloc(&memtag_core[MEMTAG_METADATA], sizeof *md + strlen(md->value) + 1);
+
+	/* keep the vector sorted by name */
+	for (pos = mt->count; pos > 0 && strcasecmp(mt->items[pos - 1]->name, md->name) > 0; pos--)
+		mt->items[pos] = mt->items[pos - 1];
+
+	mt->items[pos] = md;
+	mt->count++;
+
+	if (mt->hash != NULL && mt->count * 2 <= mt->hashsize)
+	{
+		const unsigned int mask = mt->hashsize - 1;
+		unsigned int i;
+
+		for (i = metadata_hash(md->name) & mask; mt->hash[i] != NULL; i = (i + 1) & mask)
+			;
+
+		mt->hash[i] = md;
+	}
+	else if (mt->count > METADATA_INLINE_MAX)
+		metadata_hash_rebuild(mt);
 
 	return md;
 }
@@ -245,21 +466,33 @@ void
 metadata_delete(void *target, const char *name)
 {
 	struct atheme_object *obj;
-	struct metadata *md = metadata_find(target, name);
+	struct metadata_table *mt;
+	struct metadata *md;
+	unsigned int pos;
 
-	if (!md)
-		return;
+	return_if_fail(target != NULL);
+	return_if_fail(name != NULL);
 
 	obj = atheme_object(target);
+	mt = obj->metadata;
 
-	return_if_fail(obj->metadata != NULL);
+	if (mt == NULL)
+		return;
 
-	mowgli_patricia_delete(obj->metadata, name);
+	md = metadata_table_lookup(mt, name, &pos);
+	if (md == NULL)
+		return;
 
-	strshare_unref(md->name);
-	sfree(md->value);
+	mt->count--;
+	memmove(&mt->items[pos], &mt->items[pos + 1], (mt->count - pos) * sizeof mt->items[0]);
 
-	mowgli_heap_free(metadata_heap, md);
+	/* small tables go back to linear search */
+	if (mt->hash != NULL && mt->count <= METADATA_INLINE_MAX)
+		metadata_hash_rebuild(mt);
+	else if (mt->hash != NULL)
+		metadata_hash_remove(mt, md);
+
+	metadata_free(md);
 }
 
 struct metadata *
@@ -275,25 +508,66 @@ metadata_find(void *target, const char *name)
 	if (obj->metadata == NULL)
 		return NULL;
 
-	return mowgli_patricia_retrieve(obj->metadata, name);
+	return metadata_table_lookup(obj->metadata, name, NULL);
 }
 
 void
 metadata_delete_all(void *target)
 {
-	struct atheme_object *obj;
-	struct metadata *md;
-	mowgli_patricia_iteration_state_t state;
+	struct metadata_table *mt;
+	unsigned int i;
 
-	obj = atheme_object(target);
+	return_if_fail(target != NULL);
 
-	if (obj->metadata == NULL)
+	mt = atheme_object(target)->metadata;
+
+	if (mt == NULL)
 		return;
 
-	MOWGLI_PATRICIA_FOREACH(md, &state, obj->metadata)
+	for (i = 0; i < mt->count; i++)
+		metadata_free(mt->items[i]);
+
+	mt->count = 0;
+
+	if (mt->hash != NULL)
+		metadata_hash_rebuild(mt);
+}
+
+unsigned int
+metadata_count(void *target)
+{
+	struct atheme_object *obj = atheme_object(target);
+
+	return (obj->metadata != NULL) ? obj->metadata->count : 0;
+}
+
+void
+metadata_foreach_start(void *target, struct metadata_iteration_state *state)
+{
+	struct atheme_object *obj = atheme_object(target);
+
+	state->obj = obj;
+	state->pos = 0;
+	state->cur = (obj->metadata != NULL && obj->metadata->count != 0) ? obj->metadata->items[0] : NULL;
+}
+
+void
+metadata_foreach_next(struct metadata_iteration_state *state)
+{
+	const struct metadata_table *mt = state->obj->metadata;
+
+	if (mt == NULL)
 	{
-		metadata_delete(obj, md->name);
+		state->cur = NULL;
+		return;
 	}
+
+	/* if the current entry was deleted, the next one has already
+	 * moved down into its slot */
+	if (state->pos < mt->count && mt->items[state->pos] == state->cur)
+		state->pos++;
+
+	state->cur = (state->pos < mt->count) ? mt->items[state->pos] : NULL;
 }
 
 void *
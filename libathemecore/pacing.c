@@ -0,0 +1,441 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * pacing.c: Output pacing for long replies and mass notices.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+/*
+ * Everything sts() sends is tagged with the send class of the innermost
+ * send_pacing_enter() around it; with no context it is sent immediately,
+ * so protocol traffic and SASL are never held up.
+ *
+ * Interactive replies draw from a token bucket per target user (refilled
+ * at pacing_rate lines per second, holding at most pacing_burst). Once a
+ * user's bucket is empty, further lines to them are queued in order until
+ * it refills. Bulk output draws from one global bucket of pacing_bulk_rate
+ * lines per second, is only released once the queued interactive lines
+ * have had their turn, and waits while the uplink's sendq is backed up.
+ *
+ * Queues are drained by a once-per-second timer that only exists while
+ * something is queued or some bucket is not yet full. When a rehash turns
+ * pacing off for a class (a rate of 0), its queues are sent out in full
+ * straight away, so that they do not end up behind lines sent after them.
+ * They are bounded by
+ * pacing_queue_max lines per target and pacing_queue_total lines overall;
+ * lines past either limit are dropped, so that a user who keeps asking
+ * for huge listings (or a bulk send to a huge audience) cannot grow our
+ * memory use without bound.
+ */
+
+#define PACING_SENDQ_HIGHWATER  (64U * 1024U)
+
+struct pacing_line
+{
+	mowgli_node_t   node;
+	size_t          len;
+	char            buf[];
+};
+
+struct pacing_target
+{
+	char *          key;
+	mowgli_node_t   node;
+	mowgli_list_t   lines;
+	unsigned int    tokens;
+	time_t          refilled;
+};
+
+static struct send_pacing send_pacing = { SEND_CLASS_IMMEDIATE, NULL };
+
+static mowgli_patricia_t *pacing_targets = NULL;
+static mowgli_list_t pacing_target_list;
+static size_t pacing_target_queued = 0;
+
+static mowgli_list_t pacing_bulk;
+static unsigned int pacing_bulk_tokens = 0;
+static time_t pacing_bulk_refilled = 0;
+
+static mowgli_eventloop_timer_t *pacing_timer = NULL;
+
+static struct
+{
+	uint64_t        deferred[SEND_CLASS_BULK + 1];
+	uint64_t        dropped;        // target went away
+	uint64_t        overflowed;     // queue was full
+} pacing_counts;
+
+static void pacing_run(void *arg);
+
+static void
+pacing_refill(unsigned int *const restrict tokens, time_t *const restrict refilled,
+              const unsigned int rate, const unsigned int burst)
+{
+	if (CURRTIME <= *refilled)
+		return;
+
+	const uint64_t full = *tokens + (uint64_t) rate * (uint64_t) (CURRTIME - *refilled);
+
+	*tokens = (full > burst) ? burst : (unsigned int) full;
+	*refilled = CURRTIME;
+}
+
+static bool
+pacing_uplink_busy(void)
+{
+	size_t highwater = PACING_SENDQ_HIGHWATER;
+
+	if (curr_uplink == NULL || curr_uplink->conn == NULL)
+		return true;
+
+	if (config_options.uplink_sendq_limit && config_options.uplink_sendq_limit / 2 < highwater)
+		highwater = config_options.uplink_sendq_limit / 2;
+
+	return sendq_length(curr_uplink->conn) > highwater;
+}
+
+// whether one more line fits in a queue currently holding `queued' lines
+static bool
+pacing_room(const size_t queued)
+{
+	const size_t total = pacing_target_queued + MOWGLI_LIST_LENGTH(&pacing_bulk);
+
+	if (config_options.pacing_queue_max && send_pacing.cls == SEND_CLASS_INTERACTIVE &&
+	    queued >= config_options.pacing_queue_max)
+		return false;
+
+	if (config_options.pacing_queue_total && total >= config_options.pacing_queue_total)
+		return false;
+
+	return true;
+}
+
+static void
+pacing_arm(void)
+{
+	if (pacing_timer == NULL)
+		pacing_timer = mowgli_timer_add_once(base_eventloop, "pacing_run", pacing_run, NULL, 1);
+}
+
+static void
+pacing_enqueue(mowgli_list_t *const restrict list, const char *const restrict buf, const size_t len)
+{
+	struct pacing_line *const pl = smalloc(sizeof *pl + len);
+
+	pl->len = len;
+	(void) memcpy(pl->buf, buf, len);
+
+	(void) mowgli_node_add(pl, &pl->node, list);
+
+	pacing_counts.deferred[send_pacing.cls]++;
+	pacing_arm();
+}
+
+// sends up to *tokens lines from the head of list; returns how many were sent
+static size_t
+pacing_release(mowgli_list_t *const restrict list, unsigned int *const restrict tokens, const bool bulk)
+{
+	mowgli_node_t *n, *tn;
+	size_t sent = 0;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, list->head)
+	{
+		struct pacing_line *const pl = n->data;
+
+		if (! *tokens || (bulk && pacing_uplink_busy()))
+			break;
+
+		(void) mowgli_node_delete(&pl->node, list);
+
+		sts_write(pl->buf, pl->len);
+		(void) sfree(pl);
+
+		(*tokens)--;
+		sent++;
+	}
+
+	return sent;
+}
+
+static size_t
+pacing_discard(mowgli_list_t *const restrict list)
+{
+	mowgli_node_t *n, *tn;
+	size_t dropped = 0;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, list->head)
+	{
+		(void) mowgli_node_delete(n, list);
+		(void) sfree(n->data);
+		dropped++;
+	}
+
+	pacing_counts.dropped += dropped;
+	return dropped;
+}
+
+static void
+pacing_target_free(struct pacing_target *const restrict pt)
+{
+	pacing_target_queued -= pacing_discard(&pt->lines);
+
+	(void) mowgli_patricia_delete(pacing_targets, pt->key);
+	(void) mowgli_node_delete(&pt->node, &pacing_target_list);
+
+	(void) sfree(pt->key);
+	(void) sfree(pt);
+}
+
+static struct pacing_target *
+pacing_target_get(const struct user *const restrict u)
+{
+	const char *const key = CLIENT_NAME(u);
+	struct pacing_target *pt;
+
+	if ((pt = mowgli_patricia_retrieve(pacing_targets, key)) != NULL)
+		return pt;
+
+	pt = smalloc(sizeof *pt);
+	pt->key = sstrdup(key);
+	pt->tokens = config_options.pacing_burst;
+	pt->refilled = CURRTIME;
+
+	(void) mowgli_patricia_add(pacing_targets, pt->key, pt);
+	(void) mowgli_node_add(pt, &pt->node, &pacing_target_list);
+
+	pacing_arm();
+	return pt;
+}
+
+static void
+pacing_process(void)
+{
+	mowgli_node_t *n, *tn;
+
+	if (! me.connected)
+	{
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, pacing_target_list.head)
+			(void) pacing_target_free(n->data);
+
+		(void) pacing_discard(&pacing_bulk);
+		return;
+	}
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, pacing_target_list.head)
+	{
+		struct pacing_target *const pt = n->data;
+
+		if (! config_options.pacing_rate)
+		{
+			unsigned int all = UINT_MAX;
+
+			pacing_target_queued -= pacing_release(&pt->lines, &all, false);
+			(void) pacing_target_free(pt);
+			continue;
+		}
+
+		(void) pacing_refill(&pt->tokens, &pt->refilled, config_options.pacing_rate, config_options.pacing_burst);
+		pacing_target_queued -= pacing_release(&pt->lines, &pt->tokens, false);
+
+		// forget targets that are back to where a new one would start
+		if (! MOWGLI_LIST_LENGTH(&pt->lines) && pt->tokens >= config_options.pacing_burst)
+			(void) pacing_target_free(pt);
+	}
+
+	if (! config_options.pacing_bulk_rate)
+	{
+		unsigned int all = UINT_MAX;
+
+		(void) pacing_release(&pacing_bulk, &all, false);
+	}
+	else
+	{
+		(void) pacing_refill(&pacing_bulk_tokens, &pacing_bulk_refilled, config_options.pacing_bulk_rate,
+		                     config_options.pacing_bulk_rate);
+		(void) pacing_release(&pacing_bulk, &pacing_bulk_tokens, true);
+	}
+
+	if (MOWGLI_LIST_LENGTH(&pacing_target_list) || MOWGLI_LIST_LENGTH(&pacing_bulk))
+		(void) pacing_arm();
+}
+
+static void
+pacing_run(void ATHEME_VATTR_UNUSED *const restrict arg)
+{
+	// a once-only timer is freed by the eventloop after this returns
+	pacing_timer = NULL;
+
+	(void) pacing_process();
+}
+
+// a rate may have been set to 0, and nothing would release what it left queued
+static void
+pacing_config_ready(void ATHEME_VATTR_UNUSED *const restrict unused)
+{
+	(void) pacing_process();
+}
+
+/* Queued lines are addressed by UID, or by nickname on protocols without
+ * UIDs; neither may reach whoever is known by that name next.
+ */
+static void
+pacing_user_delete(struct user *const restrict u)
+{
+	struct pacing_target *const pt = mowgli_patricia_retrieve(pacing_targets, CLIENT_NAME(u));
+
+	if (pt != NULL)
+		(void) pacing_target_free(pt);
+}
+
+static void
+pacing_user_nickchange(struct hook_user_nick *const restrict data)
+{
+	struct pacing_target *pt;
+
+	if (data->u == NULL || data->u->uid != NULL)
+		return;
+
+	if ((pt = mowgli_patricia_retrieve(pacing_targets, data->oldnick)) != NULL)
+		(void) pacing_target_free(pt);
+}
+
+void
+pacing_init(void)
+{
+	pacing_targets = mowgli_patricia_create(&irccasecanon);
+
+	(void) hook_add_user_delete(&pacing_user_delete);
+	(void) hook_add_user_nickchange(&pacing_user_nickchange);
+	(void) hook_add_config_ready(&pacing_config_ready);
+}
+
+/*
+ * send_pacing_enter()
+ *
+ * Inputs:
+ *       send class and target user (or NULL) for the lines about to be
+ *       sent, somewhere to save the enclosing context
+ *
+ * Outputs:
+ *       none
+ *
+ * Side Effects:
+ *       lines sent with sts() until the matching send_pacing_leave() are
+ *       paced according to the given class, or that of the enclosing
+ *       context if it is less urgent
+ */
+void
+send_pacing_enter(const enum send_class cls, const struct user *const restrict target,
+                  struct send_pacing *const restrict saved)
+{
+	*saved = send_pacing;
+
+	if (cls > send_pacing.cls)
+		send_pacing.cls = cls;
+
+	send_pacing.target = target;
+}
+
+void
+send_pacing_leave(const struct send_pacing *const restrict saved)
+{
+	send_pacing = *saved;
+}
+
+/*
+ * pacing_defer()
+ *
+ * Inputs:
+ *       a complete line (with CR-LF) that sts() is about to send
+ *
+ * Outputs:
+ *       true if the line was queued to be sent later (or dropped because
+ *       the queue it belongs in is full), false if it should be sent now
+ *
+ * Side Effects:
+ *       tokens are taken from the relevant bucket
+ */
+bool
+pacing_defer(const char *const restrict buf, const size_t len)
+{
+	struct pacing_target *pt;
+
+	switch (send_pacing.cls)
+	{
+		case SEND_CLASS_INTERACTIVE:
+			if (! config_options.pacing_rate || send_pacing.target == NULL)
+				return false;
+
+			pt = pacing_target_get(send_pacing.target);
+			(void) pacing_refill(&pt->tokens, &pt->refilled, config_options.pacing_rate,
+			                     config_options.pacing_burst);
+
+			if (! MOWGLI_LIST_LENGTH(&pt->lines) && pt->tokens)
+			{
+				pt->tokens--;
+				return false;
+			}
+
+			if (! pacing_room(MOWGLI_LIST_LENGTH(&pt->lines)))
+			{
+				pacing_counts.overflowed++;
+				return true;
+			}
+
+			(void) pacing_enqueue(&pt->lines, buf, len);
+			pacing_target_queued++;
+			return true;
+
+		case SEND_CLASS_BULK:
+			if (! config_options.pacing_bulk_rate)
+				return false;
+
+			(void) pacing_refill(&pacing_bulk_tokens, &pacing_bulk_refilled, config_options.pacing_bulk_rate,
+			                     config_options.pacing_bulk_rate);
+
+			if (! MOWGLI_LIST_LENGTH(&pacing_bulk) && ! pacing_target_queued && pacing_bulk_tokens &&
+			    ! pacing_uplink_busy())
+			{
+				pacing_bulk_tokens--;
+				return false;
+			}
+
+			if (! pacing_room(MOWGLI_LIST_LENGTH(&pacing_bulk)))
+			{
+				pacing_counts.overflowed++;
+				return true;
+			}
+
+			(void) pacing_enqueue(&pacing_bulk, buf, len);
+			return true;
+
+		case SEND_CLASS_IMMEDIATE:
+			break;
+	}
+
+	return false;
+}
+
+void
+pacing_stats(void (*stats_cb)(const char *, void *), void *privdata)
+{
+	char buf[BUFSIZE];
+
+	(void) snprintf(buf, sizeof buf, "pacing: %zu interactive lines queued for %zu users, %zu bulk lines queued; "
+	                "%" PRIu64 "/%" PRIu64 " deferred, %" PRIu64 " dropped for departed users, %" PRIu64
+	                " dropped over the queue limits",
+	                pacing_target_queued, MOWGLI_LIST_LENGTH(&pacing_target_list), MOWGLI_LIST_LENGTH(&pacing_bulk),
+	                pacing_counts.deferred[SEND_CLASS_INTERACTIVE], pacing_counts.deferred[SEND_CLASS_BULK],
+	                pacing_counts.dropped, pacing_counts.overflowed);
+	(void) stats_cb(buf, privdata);
+}
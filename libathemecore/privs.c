@@ -26,13 +26,28 @@ static struct operclass *user_r = NULL;
 static struct operclass *authenticated_r = NULL;
 static struct operclass *ircop_r = NULL;
 
+/* Privilege names are interned to small integer IDs the first time an
+ * operclass mentions them, and each operclass keeps a bitset of the IDs
+ * it grants; a privilege check is then one lookup of the name plus a bit
+ * test, rather than tokenising the operclass's privilege string. IDs
+ * are never reused, so the table only grows with the number of distinct
+ * privilege names ever configured.
+ */
+static mowgli_patricia_t *priv_ids = NULL;      // name -> ID + 1
+static char **priv_names = NULL;
+static unsigned int priv_count = 0;
+static unsigned int priv_alloc = 0;
+
+#define PRIV_ID_NONE    UINT_MAX
+
 void
 init_privs(void)
 {
 	operclass_heap = sharedheap_get(sizeof(struct operclass));
 	soper_heap = sharedheap_get(sizeof(struct soper));
+	priv_ids = mowgli_patricia_create(strcasecanon);
 
-	if (!operclass_heap || !soper_heap)
+	if (!operclass_heap || !soper_heap || !priv_ids)
 	{
 		slog(LG_INFO, "init_privs(): block allocator failed.");
 		exit(EXIT_FAILURE);
@@ -44,6 +59,80 @@ init_privs(void)
 	ircop_r = operclass_add("ircop", "", OPERCLASS_BUILTIN);
 }
 
+/*******************
+ * P R I V   I D S *
+ *******************/
+
+static unsigned int
+priv_lookup(const char *priv)
+{
+	const uintptr_t id = (uintptr_t) mowgli_patricia_retrieve(priv_ids, priv);
+
+	return id ? (unsigned int) (id - 1) : PRIV_ID_NONE;
+}
+
+static unsigned int
+priv_intern(const char *priv)
+{
+	unsigned int id = priv_lookup(priv);
+
+	if (id != PRIV_ID_NONE)
+		return id;
+
+	if (priv_count == priv_alloc)
+	{
+		priv_alloc = priv_alloc ? priv_alloc * 2 : 64;
+		priv_names = sreallocarray(priv_names, priv_alloc, sizeof *priv_names);
+	}
+
+	id = priv_count++;
+	priv_names[id] = sstrdup(priv);
+	(void) mowgli_patricia_add(priv_ids, priv, (void *) ((uintptr_t) id + 1));
+
+	return id;
+}
+
+static inline bool
+has_priv_id(const struct operclass *operclass, unsigned int id)
+{
+	if (operclass == NULL || id == PRIV_ID_NONE || id / 64 >= operclass->privwords)
+		return false;
+
+	return (operclass->privbits[id / 64] >> (id % 64)) & 1U;
+}
+
+// (re)build the bitset from the privilege string; inheritance is already folded into it by the config parser
+static void
+operclass_compile(struct operclass *operclass)
+{
+	char *privs, *priv, *saveptr = NULL;
+	unsigned int id;
+	size_t words;
+
+	sfree(operclass->privbits);
+	operclass->privbits = NULL;
+	operclass->privwords = 0;
+
+	privs = sstrdup(operclass->privs);
+
+	for (priv = strtok_r(privs, " \t\r\n", &saveptr); priv != NULL; priv = strtok_r(NULL, " \t\r\n", &saveptr))
+	{
+		id = priv_intern(priv);
+
+		if (id / 64 >= operclass->privwords)
+		{
+			words = id / 64 + 1;
+			operclass->privbits = sreallocarray(operclass->privbits, words, sizeof *operclass->privbits);
+			memset(operclass->privbits + operclass->privwords, 0, (words - operclass->privwords) * sizeof *operclass->privbits);
+			operclass->privwords = words;
+		}
+
+		operclass->privbits[id / 64] |= UINT64_C(1) << (id % 64);
+	}
+
+	sfree(privs);
+}
+
 /*************************
  * O P E R C L A S S E S *
  *************************/
@@ -69,6 +158,7 @@ operclass_add(const char *name, const char *privs, int flags)
 		sfree(operclass->privs);
 		operclass->privs = sstrdup(privs);
 		operclass->flags = flags | (builtin ? OPERCLASS_BUILTIN : 0);
+		operclass_compile(operclass);
 
 		return operclass;
 	}
@@ -79,6 +169,7 @@ operclass_add(const char *name, const char *privs, int flags)
 	operclass->name = sstrdup(name);
 	operclass->privs = sstrdup(privs);
 	operclass->flags = flags;
+	operclass_compile(operclass);
 
 	mowgli_node_add(operclass, &operclass->node, &operclasslist);
 
@@ -118,6 +209,7 @@ operclass_delete(struct operclass *operclass)
 
 	sfree(operclass->name);
 	sfree(operclass->privs);
+	sfree(operclass->privbits);
 
 	mowgli_heap_free(operclass_heap, operclass);
 	cnt.operclass--;
@@ -293,11 +385,10 @@ is_conf_soper(struct myuser *myuser)
 bool
 has_priv_operclass(struct operclass *operclass, const char *priv)
 {
-	if (operclass == NULL)
+	if (operclass == NULL || priv == NULL)
 		return false;
-	if (string_in_list(priv, operclass->privs))
-		return true;
-	return false;
+
+	return has_priv_id(operclass, priv_lookup(priv));
 }
 
 bool
@@ -333,6 +424,7 @@ bool
 has_priv_user(struct user *u, const char *priv)
 {
 	struct operclass *operclass;
+	unsigned int id;
 
 	if (priv == NULL)
 		return true;
@@ -340,13 +432,17 @@ has_priv_user(struct user *u, const char *priv)
 	if (u == NULL)
 		return false;
 
-	if (has_priv_operclass(user_r, priv))
+	// no operclass grants a privilege that was never interned
+	if ((id = priv_lookup(priv)) == PRIV_ID_NONE)
+		return false;
+
+	if (has_priv_id(user_r, id))
 		return true;
 
-	if (is_ircop(u) && has_priv_operclass(ircop_r, priv))
+	if (is_ircop(u) && has_priv_id(ircop_r, id))
 		return true;
 
-	if (u->myuser != NULL && has_priv_operclass(authenticated_r, priv))
+	if (u->myuser != NULL && has_priv_id(authenticated_r, id))
 		return true;
 
 	if (u->myuser && is_soper(u->myuser))
@@ -358,7 +454,7 @@ has_priv_user(struct user *u, const char *priv)
 			return false;
 		if (u->myuser->soper->password != NULL && !(u->flags & UF_SOPER_PASS))
 			return false;
-		if (has_priv_operclass(operclass, priv))
+		if (has_priv_id(operclass, id))
 			return true;
 	}
 
@@ -369,13 +465,16 @@ bool
 has_priv_myuser(struct myuser *mu, const char *priv)
 {
 	struct operclass *operclass;
+	unsigned int id;
 
 	if (priv == NULL)
 		return true;
 	if (mu == NULL)
 		return false;
+	if ((id = priv_lookup(priv)) == PRIV_ID_NONE)
+		return false;
 
-	if (has_priv_operclass(authenticated_r, priv))
+	if (has_priv_id(authenticated_r, id))
 		return true;
 
 	if (!is_soper(mu))
@@ -383,7 +482,7 @@ has_priv_myuser(struct myuser *mu, const char *priv)
 	operclass = mu->soper->operclass;
 	if (operclass == NULL)
 		return false;
-	if (has_priv_operclass(operclass, priv))
+	if (has_priv_id(operclass, id))
 		return true;
 
 	return false;
@@ -392,21 +491,17 @@ has_priv_myuser(struct myuser *mu, const char *priv)
 bool
 has_all_operclass(struct sourceinfo *si, struct operclass *operclass)
 {
-	char *privs2;
-	char *priv;
-
-	privs2 = sstrdup(operclass->privs);
-	priv = strtok(privs2, " ");
-	while (priv != NULL)
+	for (size_t w = 0; w < operclass->privwords; w++)
 	{
-		if (!has_priv(si, priv))
+		for (unsigned int b = 0; b < 64; b++)
 		{
-			sfree(privs2);
-			return false;
+			if (!((operclass->privbits[w] >> b) & 1U))
+				continue;
+			if (!has_priv(si, priv_names[w * 64 + b]))
+				return false;
 		}
-		priv = strtok(NULL, " ");
 	}
-	sfree(privs2);
+
 	return true;
 }
 
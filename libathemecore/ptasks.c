@@ -107,6 +107,18 @@ connection_stats_cb(const char *line, void *privdata)
 	numeric_sts(me.me, 249, ((struct user *)privdata), "F :%s", line);
 }
 
+static void
+stats_m_cb(const char *line, void *privdata)
+{
+	numeric_sts(me.me, 249, ((struct user *)privdata), "M :%s", line);
+}
+
+static void
+stats_t_cb(const char *line, void *privdata)
+{
+	numeric_sts(me.me, 249, ((struct user *)privdata), "T :%s", line);
+}
+
 void
 handle_stats(struct user *u, char req)
 {
@@ -220,6 +232,14 @@ handle_stats(struct user *u, char req)
 
 		  break;
 
+	  case 'M':
+	  case 'm':
+		  if (!has_priv_user(u, PRIV_SERVER_AUSPEX))
+			  break;
+
+		  memtag_stats(stats_m_cb, u);
+		  break;
+
 	  case 'o':
 	  case 'O':
 		  if (!has_priv_user(u, PRIV_VIEWPRIVS))
@@ -267,6 +287,11 @@ handle_stats(struct user *u, char req)
 		  numeric_sts(me.me, 249, u, "T :mychan     %7u", cnt.mychan);
 		  numeric_sts(me.me, 249, u, "T :chanacs    %7u", cnt.chanacs);
 
+		  strshare_stats(stats_t_cb, u);
+		  expire_stats(stats_t_cb, u);
+		  deadline_stats(stats_t_cb, u);
+		  pacing_stats(stats_t_cb, u);
+
 #ifdef OBJECT_DEBUG
 		  numeric_sts(me.me, 249, u, "T :objects    %7zu", MOWGLI_LIST_LENGTH(&object_list));
 #endif
@@ -15,6 +15,20 @@
 #include <atheme.h>
 #include "internal.h"
 
+/* queue a complete line for the uplink, bypassing pacing */
+void
+sts_write(const char *buf, size_t len)
+{
+	return_if_fail(curr_uplink != NULL);
+	return_if_fail(curr_uplink->conn != NULL);
+
+	cnt.bout += len;
+
+	sendq_add(curr_uplink->conn, (char *) buf, len);
+
+	slog(LG_RAWDATA, "<- %.*s", (int) len, buf);
+}
+
 /* send a line to the server, append the \r\n */
 int ATHEME_FATTR_PRINTF(1, 2)
 sts(const char *fmt, ...)
@@ -39,11 +53,10 @@ sts(const char *fmt, ...)
 	buf[len++] = '\n';
 	buf[len] = '\0';
 
-	cnt.bout += len;
-
-	sendq_add(curr_uplink->conn, buf, len);
+	if (pacing_defer(buf, (size_t) len))
+		return 0;
 
-	slog(LG_RAWDATA, "<- %.*s", len, buf);
+	sts_write(buf, (size_t) len);
 
 	return 0;
 }
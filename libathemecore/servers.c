@@ -99,11 +99,13 @@ server_add(const char *name, unsigned int hops, struct server *uplink, const cha
 		slog(LG_DEBUG, "server_add(): %s, root", name);
 
 	s = mowgli_heap_alloc(serv_heap);
+	memtag_alloc(&memtag_core[MEMTAG_SERVERS], sizeof *s);
 
 	if (id != NULL)
 	{
 		s->sid = sstrdup(id);
 		mowgli_patricia_add(sidlist, s->sid, s);
+		numeric_server_add(s);
 	}
 
 	/* check to see if it's hidden */
@@ -175,12 +177,45 @@ server_delete(const char *name)
 	server_delete_serv(s);
 }
 
+/* Mark a server and everything behind it as splitting, and collect the
+ * channels that have members there so they can be cleaned up one channel
+ * at a time instead of one membership at a time. */
+static void
+server_split_mark(struct server *s, mowgli_list_t *chans)
+{
+	struct user *u;
+	struct chanuser *cu;
+	mowgli_node_t *n, *n2;
+
+	s->flags |= SF_SPLITTING;
+
+	MOWGLI_ITER_FOREACH(n, s->userlist.head)
+	{
+		u = n->data;
+
+		MOWGLI_ITER_FOREACH(n2, u->channels.head)
+		{
+			cu = n2->data;
+
+			if (cu->chan->flags & CHAN_SPLITTING)
+				continue;
+
+			cu->chan->flags |= CHAN_SPLITTING;
+			mowgli_node_add(cu->chan, mowgli_node_create(), chans);
+		}
+	}
+
+	MOWGLI_ITER_FOREACH(n, s->children.head)
+		server_split_mark(n->data, chans);
+}
+
 static void
 server_delete_serv(struct server *s)
 {
 	struct server *child;
 	struct user *u;
 	mowgli_node_t *n, *tn;
+	mowgli_list_t chans = { NULL, NULL, 0 };
 
 	if (s == me.me)
 	{
@@ -204,6 +239,22 @@ server_delete_serv(struct server *s)
 
 	hook_call_server_delete((&(struct hook_server_delete){ .s = s }));
 
+	/* if this is the top of the split, empty out the channels in bulk
+	 * first; the user_delete() calls below then have no memberships
+	 * left to tear down. Real QUITs still go through chanuser_delete().
+	 */
+	if (!(s->flags & SF_SPLITTING))
+	{
+		server_split_mark(s, &chans);
+
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, chans.head)
+		{
+			chanuser_delete_split(n->data);
+			mowgli_node_delete(n, &chans);
+			mowgli_node_free(n);
+		}
+	}
+
 	/* first go through it's users and kill all of them */
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, s->userlist.head)
 	{
@@ -227,7 +278,10 @@ server_delete_serv(struct server *s)
 		mowgli_patricia_delete(servlist, s->name);
 
 	if (s->sid)
+	{
 		mowgli_patricia_delete(sidlist, s->sid);
+		numeric_server_delete(s);
+	}
 
 	if (s->uplink)
 	{
@@ -246,6 +300,7 @@ server_delete_serv(struct server *s)
 	sfree(s->desc);
 	sfree(s->sid);
 
+	memtag_free(&memtag_core[MEMTAG_SERVERS], sizeof *s);
 	mowgli_heap_free(serv_heap, s);
 
 	cnt.server--;
@@ -271,6 +326,9 @@ server_find(const char *name)
 {
 	struct server *s;
 
+	if ((s = numeric_server_find(name)) != NULL)
+		return s;
+
 	s = mowgli_patricia_retrieve(sidlist, name);
 	if (s != NULL)
 		return s;
@@ -910,6 +910,24 @@ sourceinfo_create(void)
 	return out;
 }
 
+/* Sends one line of a command reply to an IRC user. These are paced per
+ * user, so that a long listing cannot hold up everyone else's output.
+ */
+static void
+command_reply_line(struct sourceinfo *si, const char *text)
+{
+	struct send_pacing saved;
+
+	send_pacing_enter(SEND_CLASS_INTERACTIVE, si->su, &saved);
+
+	if (use_privmsg && si->smu != NULL && si->smu->flags & MU_USE_PRIVMSG)
+		msg(si->service->nick, si->su->nick, "%s", text);
+	else
+		notice_user_sts(si->service->me, si->su, text);
+
+	send_pacing_leave(&saved);
+}
+
 void ATHEME_FATTR_PRINTF(3, 4)
 command_fail(struct sourceinfo *si, enum cmd_faultcode code, const char *fmt, ...)
 {
@@ -928,10 +946,7 @@ command_fail(struct sourceinfo *si, enum cmd_faultcode code, const char *fmt, ..
 	if (si->su == NULL)
 		return;
 
-	if (use_privmsg && si->smu != NULL && si->smu->flags & MU_USE_PRIVMSG)
-		msg(si->service->nick, si->su->nick, "%s", buf);
-	else
-		notice_user_sts(si->service->me, si->su, buf);
+	command_reply_line(si, buf);
 }
 
 void ATHEME_FATTR_PRINTF(2, 3)
@@ -976,10 +991,7 @@ command_success_nodata(struct sourceinfo *si, const char *fmt, ...)
 		}
 		if (*p == '\0')
 			p = space; /* replace empty lines with a space */
-		if (use_privmsg && si->smu != NULL && si->smu->flags & MU_USE_PRIVMSG)
-			msg(si->service->nick, si->su->nick, "%s", p);
-		else
-			notice_user_sts(si->service->me, si->su, p);
+		command_reply_line(si, p);
 		p = q;
 	} while (p != NULL);
 }
@@ -1002,10 +1014,7 @@ command_success_string(struct sourceinfo *si, const char *result, const char *fm
 	if (si->su == NULL)
 		return;
 
-	if (use_privmsg && si->smu != NULL && si->smu->flags & MU_USE_PRIVMSG)
-		msg(si->service->nick, si->su->nick, "%s", buf);
-	else
-		notice_user_sts(si->service->me, si->su, buf);
+	command_reply_line(si, buf);
 }
 
 static void
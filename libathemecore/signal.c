@@ -120,6 +120,45 @@ init_signal_handlers(void)
 #endif
 }
 
+/*
+ * For a child process that does not exec: puts back the default action for
+ * everything init_signal_handlers() handles, except that a write to a closed
+ * pipe stays an error instead of killing it.
+ */
+void
+reset_signal_handlers(void)
+{
+#ifndef MOWGLI_OS_WIN
+#ifdef SIGHUP
+	(void) signal(SIGHUP, SIG_DFL);
+#endif
+
+#ifdef SIGINT
+	(void) signal(SIGINT, SIG_DFL);
+#endif
+
+#ifdef SIGTERM
+	(void) signal(SIGTERM, SIG_DFL);
+#endif
+
+#ifdef SIGPIPE
+	(void) signal(SIGPIPE, SIG_IGN);
+#endif
+
+#ifdef SIGCHLD
+	(void) signal(SIGCHLD, SIG_DFL);
+#endif
+
+#ifdef SIGUSR1
+	(void) signal(SIGUSR1, SIG_DFL);
+#endif
+
+#ifdef SIGUSR2
+	(void) signal(SIGUSR2, SIG_DFL);
+#endif
+#endif
+}
+
 void
 check_signals(void)
 {
@@ -16,38 +16,195 @@
 #include <atheme.h>
 #include "internal.h"
 
-static mowgli_patricia_t *strshare_dict = NULL;
+/* Shared strings live in an open-addressed hash table (linear probing,
+ * backward-shift deletion so there are no tombstones). Each string is
+ * stored right behind its header, which carries the refcount, length and
+ * hash, and comes from one of a few fixed-size heaps picked by length.
+ */
+
+#define STRSHARE_TABLE_MIN      1024U
 
 struct strshare
 {
-	int refcount;
+	unsigned int refcount;
+	unsigned int hash;
+	size_t len;
 };
 
+/* allocation size classes, header and terminating NUL included */
+static const size_t strshare_classes[] = { 32, 48, 64, 96, 128, 192, 256 };
+
+static mowgli_heap_t *strshare_heaps[ARRAY_SIZE(strshare_classes)];
+
+static struct strshare **strshare_table = NULL;
+static size_t strshare_size = 0;
+static size_t strshare_count = 0;
+
+static uint64_t strshare_lookups = 0;
+static uint64_t strshare_hits = 0;
+static size_t strshare_refs = 0;
+static size_t strshare_bytes = 0;
+static size_t strshare_saved = 0;
+
+static inline unsigned int
+strshare_hash(const char *str, size_t len)
+{
+	/* FNV-1a */
+	unsigned int hash = 2166136261U;
+
+	while (len--)
+	{
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static inline unsigned int
+strshare_class(size_t len)
+{
+	const size_t need = sizeof(struct strshare) + len + 1;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(strshare_classes); i++)
+		if (need <= strshare_classes[i])
+			break;
+
+	return i;
+}
+
+/* what a string of this length actually takes up, header included */
+static inline size_t
+strshare_alloc_size(unsigned int class, size_t len)
+{
+	if (class < ARRAY_SIZE(strshare_classes))
+		return strshare_classes[class];
+
+	return sizeof(struct strshare) + len + 1;
+}
+
+static void
+strshare_table_insert(struct strshare **table, size_t mask, struct strshare *ss)
+{
+	size_t i = ss->hash & mask;
+
+	while (table[i] != NULL)
+		i = (i + 1) & mask;
+
+	table[i] = ss;
+}
+
+static void
+strshare_table_grow(void)
+{
+	struct strshare **table;
+	size_t size, i;
+
+	size = strshare_size ? strshare_size * 2 : STRSHARE_TABLE_MIN;
+	table = smalloc(size * sizeof *table);
+
+	for (i = 0; i < strshare_size; i++)
+		if (strshare_table[i] != NULL)
+			strshare_table_insert(table, size - 1, strshare_table[i]);
+
+	sfree(strshare_table);
+	memtag_resize(&memtag_core[MEMTAG_STRSHARE], strshare_size * sizeof *table, size * sizeof *table);
+
+	strshare_table = table;
+	strshare_size = size;
+}
+
+static void
+strshare_table_delete(struct strshare *ss)
+{
+	const size_t mask = strshare_size - 1;
+	size_t i = ss->hash & mask;
+	size_t j, k;
+
+	while (strshare_table[i] != ss)
+		i = (i + 1) & mask;
+
+	/* pull later entries of the same probe run back into the hole */
+	for (j = i;;)
+	{
+		j = (j + 1) & mask;
+		if (strshare_table[j] == NULL)
+			break;
+
+		k = strshare_table[j]->hash & mask;
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		strshare_table[i] = strshare_table[j];
+		i = j;
+	}
+
+	strshare_table[i] = NULL;
+}
+
 void
 strshare_init(void)
 {
-	strshare_dict = mowgli_patricia_create(noopcanon);
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(strshare_classes); i++)
+		strshare_heaps[i] = mowgli_heap_create(strshare_classes[i], 1024, BH_LAZY);
+
+	strshare_table_grow();
 }
 
 stringref
 strshare_get(const char *str)
 {
 	struct strshare *ss;
+	unsigned int hash, class;
+	size_t len, i, mask;
 
 	if (str == NULL)
 		return NULL;
 
-	ss = mowgli_patricia_retrieve(strshare_dict, str);
-	if (ss != NULL)
-		ss->refcount++;
-	else
+	len = strlen(str);
+	hash = strshare_hash(str, len);
+	mask = strshare_size - 1;
+
+	strshare_lookups++;
+
+	for (i = hash & mask; (ss = strshare_table[i]) != NULL; i = (i + 1) & mask)
 	{
-		ss = smalloc((sizeof *ss) + strlen(str) + 1);
-		ss->refcount = 1;
-		strcpy((char *)(ss + 1), str);
-		mowgli_patricia_add(strshare_dict, (char *)(ss + 1), ss);
+		if (ss->hash == hash && ss->len == len && !memcmp(ss + 1, str, len))
+		{
+			ss->refcount++;
+			strshare_hits++;
+			strshare_refs++;
+			strshare_saved += len + 1;
+
+			return (char *)(ss + 1);
+		}
 	}
 
+	class = strshare_class(len);
+	if (class < ARRAY_SIZE(strshare_classes))
+		ss = mowgli_heap_alloc(strshare_heaps[class]);
+	else
+		ss = smalloc((sizeof *ss) + len + 1);
+
+	memtag_alloc(&memtag_core[MEMTAG_STRSHARE], strshare_alloc_size(class, len));
+
+	ss->refcount = 1;
+	ss->hash = hash;
+	ss->len = len;
+	memcpy(ss + 1, str, len + 1);
+
+	/* keep the load factor at or below 3/4 */
+	if ((strshare_count + 1) * 4 > strshare_size * 3)
+		strshare_table_grow();
+
+	strshare_table_insert(strshare_table, strshare_size - 1, ss);
+	strshare_count++;
+	strshare_refs++;
+	strshare_bytes += len + 1;
+
 	return (char *)(ss + 1);
 }
 
@@ -62,6 +219,8 @@ strshare_ref(stringref str)
 	/* intermediate cast to suppress gcc -Wcast-qual */
 	ss = (struct strshare *)(uintptr_t)str - 1;
 	ss->refcount++;
+	strshare_refs++;
+	strshare_saved += ss->len + 1;
 
 	return str;
 }
@@ -70,6 +229,7 @@ void
 strshare_unref(stringref str)
 {
 	struct strshare *ss;
+	unsigned int class;
 
 	if (str == NULL)
 		return;
@@ -77,11 +237,41 @@ strshare_unref(stringref str)
 	/* intermediate cast to suppress gcc -Wcast-qual */
 	ss = (struct strshare *)(uintptr_t)str - 1;
 	ss->refcount--;
-	if (ss->refcount == 0)
+	strshare_refs--;
+
+	if (ss->refcount != 0)
 	{
-		mowgli_patricia_delete(strshare_dict, str);
-		sfree(ss);
+		strshare_saved -= ss->len + 1;
+		return;
 	}
+
+	strshare_table_delete(ss);
+	strshare_count--;
+	strshare_bytes -= ss->len + 1;
+
+	class = strshare_class(ss->len);
+	memtag_free(&memtag_core[MEMTAG_STRSHARE], strshare_alloc_size(class, ss->len));
+
+	if (class < ARRAY_SIZE(strshare_classes))
+		mowgli_heap_free(strshare_heaps[class], ss);
+	else
+		sfree(ss);
+}
+
+void
+strshare_stats(void (*stats_cb)(const char *, void *), void *privdata)
+{
+	char buf[BUFSIZE];
+
+	snprintf(buf, sizeof buf, "strshare   %7zu (%zu refs, %zu slots, %zu bytes)",
+			strshare_count, strshare_refs, strshare_size, strshare_bytes);
+	stats_cb(buf, privdata);
+
+	snprintf(buf, sizeof buf, "strshare hits %" PRIu64 "/%" PRIu64 " (%.1f%%), %zu bytes saved",
+			strshare_hits, strshare_lookups,
+			strshare_lookups ? 100.0 * strshare_hits / strshare_lookups : 0.0,
+			strshare_saved);
+	stats_cb(buf, privdata);
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
@@ -0,0 +1,147 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * timeheap.c: Indexed binary min-heap keyed on a time.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+/*
+ * Shared by the deadlines (deadline.c) and the expiry queue (account.c):
+ * both keep many objects ordered by the time something is next due for
+ * them, and need to move or drop any one of them cheaply.
+ */
+
+#define TIMEHEAP_ALLOC_MIN      256U
+
+static inline void
+timeheap_place(struct timeheap *const restrict heap, struct timeheap_node *const restrict node, const size_t i)
+{
+	heap->nodes[i] = node;
+	node->index = i + 1;
+}
+
+static void
+timeheap_sift_up(struct timeheap *const restrict heap, size_t i)
+{
+	struct timeheap_node *const node = heap->nodes[i];
+
+	for (; i > 0 && heap->nodes[(i - 1) / 2]->when > node->when; i = (i - 1) / 2)
+		timeheap_place(heap, heap->nodes[(i - 1) / 2], i);
+
+	timeheap_place(heap, node, i);
+}
+
+static void
+timeheap_sift_down(struct timeheap *const restrict heap, size_t i)
+{
+	struct timeheap_node *const node = heap->nodes[i];
+	size_t child;
+
+	for (; (child = 2 * i + 1) < heap->len; i = child)
+	{
+		if (child + 1 < heap->len && heap->nodes[child + 1]->when < heap->nodes[child]->when)
+			child++;
+		if (node->when <= heap->nodes[child]->when)
+			break;
+
+		timeheap_place(heap, heap->nodes[child], i);
+	}
+
+	timeheap_place(heap, node, i);
+}
+
+/*
+ * timeheap_schedule()
+ *
+ * Inputs:
+ *       heap, node, and the time it is due
+ *
+ * Outputs:
+ *       none
+ *
+ * Side Effects:
+ *       the node is added to the heap, or moved within it if it is already
+ *       there
+ */
+void
+timeheap_schedule(struct timeheap *const restrict heap, struct timeheap_node *const restrict node, const time_t when)
+{
+	return_if_fail(heap != NULL);
+	return_if_fail(node != NULL);
+
+	if (timeheap_queued(node))
+	{
+		const time_t old = node->when;
+
+		node->when = when;
+
+		if (when < old)
+			timeheap_sift_up(heap, node->index - 1);
+		else if (when > old)
+			timeheap_sift_down(heap, node->index - 1);
+
+		return;
+	}
+
+	if (heap->len == heap->alloc)
+	{
+		heap->alloc = heap->alloc ? heap->alloc * 2 : TIMEHEAP_ALLOC_MIN;
+		heap->nodes = sreallocarray(heap->nodes, heap->alloc, sizeof *heap->nodes);
+	}
+
+	node->when = when;
+	heap->nodes[heap->len] = node;
+	timeheap_sift_up(heap, heap->len++);
+}
+
+/*
+ * timeheap_remove()
+ *
+ * Inputs:
+ *       heap, node
+ *
+ * Outputs:
+ *       none
+ *
+ * Side Effects:
+ *       the node is taken out of the heap, if it is in it
+ */
+void
+timeheap_remove(struct timeheap *const restrict heap, struct timeheap_node *const restrict node)
+{
+	struct timeheap_node *last;
+	size_t i;
+
+	return_if_fail(heap != NULL);
+	return_if_fail(node != NULL);
+
+	if (! timeheap_queued(node))
+		return;
+
+	i = node->index - 1;
+	node->index = 0;
+
+	return_if_fail(i < heap->len && heap->nodes[i] == node);
+
+	last = heap->nodes[--heap->len];
+
+	if (last == node)
+		return;
+
+	timeheap_place(heap, last, i);
+
+	if (i > 0 && heap->nodes[(i - 1) / 2]->when > last->when)
+		timeheap_sift_up(heap, i);
+	else
+		timeheap_sift_down(heap, i);
+}
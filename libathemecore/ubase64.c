@@ -66,6 +66,30 @@ base64touint(const char *buf)
 	return v;
 }
 
+/* Like base64touint(), but decodes exactly len (at most 5) characters and
+ * fails if any of them is not in the alphabet.
+ */
+bool
+base64touint_exact(const char *buf, size_t len, unsigned int *out)
+{
+	unsigned int v = 0;
+	int bits;
+
+	if (len > 5)
+		return false;
+
+	while (len-- > 0)
+	{
+		if ((bits = ub64_lookuptab[255 & *buf++]) == '\377')
+			return false;
+
+		v = v << 6 | bits;
+	}
+
+	*out = v;
+	return true;
+}
+
 void
 decode_p10_ip(const char *b64, char ipstring[HOSTIPLEN + 1])
 {
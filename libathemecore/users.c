@@ -152,12 +152,14 @@ user_add(const char *nick, const char *user, const char *host,
 	}
 
 	u = mowgli_heap_alloc(user_heap);
+	memtag_alloc(&memtag_core[MEMTAG_USERS], sizeof *u);
 	atheme_object_init(atheme_object(u), nick, &user_delete_cb);
 
 	if (uid != NULL)
 	{
 		u->uid = strshare_get(uid);
 		mowgli_patricia_add(uidlist, u->uid, u);
+		numeric_user_add(u);
 	}
 
 	u->nick = strshare_get(nick);
@@ -247,7 +249,10 @@ user_delete(struct user *u, const char *comment)
 	mowgli_patricia_delete(userlist, u->nick);
 
 	if (u->uid != NULL)
+	{
 		mowgli_patricia_delete(uidlist, u->uid);
+		numeric_user_delete(u);
+	}
 
 	mowgli_node_delete(&u->snode, &u->server->userlist);
 
@@ -278,6 +283,7 @@ user_delete(struct user *u, const char *comment)
 	strshare_unref(u->chost);
 	strshare_unref(u->ip);
 
+	memtag_free(&memtag_core[MEMTAG_USERS], sizeof *u);
 	mowgli_heap_free(user_heap, u);
 
 	cnt.user--;
@@ -310,6 +316,9 @@ user_find(const char *nick)
 
 	if (ircd->uses_uid)
 	{
+		if ((u = numeric_user_find(nick)) != NULL)
+			return u;
+
 		u = mowgli_patricia_retrieve(uidlist, nick);
 
 		if (u != NULL)
@@ -370,13 +379,19 @@ user_changeuid(struct user *u, const char *uid)
 	return_if_fail(u != NULL);
 
 	if (u->uid != NULL)
+	{
 		mowgli_patricia_delete(uidlist, u->uid);
+		numeric_user_delete(u);
+	}
 
 	strshare_unref(u->uid);
 	u->uid = strshare_get(uid);
 
 	if (u->uid != NULL)
+	{
 		mowgli_patricia_add(uidlist, u->uid, u);
+		numeric_user_add(u);
+	}
 }
 
 /*
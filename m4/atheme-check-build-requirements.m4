@@ -26,6 +26,7 @@ AC_DEFUN([ATHEME_CHECK_BUILD_REQUIREMENTS], [
     AC_CHECK_HEADERS([locale.h], [], [], [])
     AC_CHECK_HEADERS([netdb.h], [], [], [])
     AC_CHECK_HEADERS([netinet/in.h], [], [], [])
+    AC_CHECK_HEADERS([poll.h], [], [], [])
     AC_CHECK_HEADERS([regex.h], [], [], [])
     AC_CHECK_HEADERS([signal.h], [], [], [])
     AC_CHECK_HEADERS([stdarg.h], [], [], [])
@@ -38,9 +39,11 @@ AC_DEFUN([ATHEME_CHECK_BUILD_REQUIREMENTS], [
     AC_CHECK_HEADERS([strings.h], [], [], [])
     AC_CHECK_HEADERS([sys/file.h], [], [], [])
     AC_CHECK_HEADERS([sys/resource.h], [], [], [])
+    AC_CHECK_HEADERS([sys/sendfile.h], [], [], [])
     AC_CHECK_HEADERS([sys/stat.h], [], [], [])
     AC_CHECK_HEADERS([sys/time.h], [], [], [])
     AC_CHECK_HEADERS([sys/types.h], [], [], [])
+    AC_CHECK_HEADERS([sys/uio.h], [], [], [])
     AC_CHECK_HEADERS([sys/wait.h], [], [], [])
     AC_CHECK_HEADERS([time.h], [], [], [])
     AC_CHECK_HEADERS([unistd.h], [], [], [])
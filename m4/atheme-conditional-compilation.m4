@@ -19,6 +19,12 @@ AC_DEFUN([ATHEME_COND_CRYPTO_BENCHMARK_ENABLE], [
     AC_SUBST([CRYPTO_BENCHMARK_COND_D])
 ])
 
+AC_DEFUN([ATHEME_COND_DEVELOPER_TOOLS_ENABLE], [
+
+    DEVELOPER_TOOLS_COND_D="email-test dnsbl-test split-benchmark db-benchmark replay-benchmark jsonrpc-benchmark xmlrpc-benchmark base64-benchmark"
+    AC_SUBST([DEVELOPER_TOOLS_COND_D])
+])
+
 AC_DEFUN([ATHEME_COND_ECDH_X25519_TOOL_ENABLE], [
 
     ECDH_X25519_TOOL_COND_D="ecdh-x25519-tool"
@@ -0,0 +1,41 @@
+# SPDX-License-Identifier: ISC
+# SPDX-URL: https://spdx.org/licenses/ISC.html
+#
+# Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+#
+# -*- Atheme IRC Services -*-
+# Atheme Build System Component
+
+AC_DEFUN([ATHEME_FEATURETEST_DEVELOPER_TOOLS], [
+
+    LIBS_SAVED="${LIBS}"
+
+    DEVELOPER_TOOLS="No"
+
+    AC_ARG_ENABLE([developer-tools],
+        [AS_HELP_STRING([--enable-developer-tools], [Build the benchmark and test programs (not installed)])],
+        [], [enable_developer_tools="no"])
+
+    case "x${enable_developer_tools}" in
+        xyes | xno)
+            ;;
+        *)
+            AC_MSG_ERROR([invalid option for --enable-developer-tools])
+            ;;
+    esac
+
+    AS_IF([test "${enable_developer_tools}" = "yes"], [
+        AC_SEARCH_LIBS([clock_gettime], [rt], [
+            AS_IF([test "x${ac_cv_search_clock_gettime}" != "xnone required"], [
+                CLOCK_GETTIME_LIBS="${ac_cv_search_clock_gettime}"
+            ])
+
+            DEVELOPER_TOOLS="Yes"
+            ATHEME_COND_DEVELOPER_TOOLS_ENABLE
+        ], [
+            AC_MSG_FAILURE([--enable-developer-tools was given but clock_gettime(2) is not available])
+        ])
+    ])
+
+    LIBS="${LIBS_SAVED}"
+])
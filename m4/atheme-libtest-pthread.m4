@@ -0,0 +1,27 @@
+# SPDX-License-Identifier: ISC
+# SPDX-URL: https://spdx.org/licenses/ISC.html
+#
+# Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+#
+# -*- Atheme IRC Services -*-
+# Atheme Build System Component
+
+AC_DEFUN([ATHEME_LIBTEST_PTHREAD], [
+
+    LIBS_SAVED="${LIBS}"
+
+    LIBPTHREAD_LIBS=""
+
+    AC_SEARCH_LIBS([pthread_create], [pthread], [
+        AC_CHECK_HEADERS([pthread.h], [
+            AC_DEFINE([HAVE_LIBPTHREAD], [1], [Define to 1 if POSIX threads appear to be usable])
+            AS_IF([test "x${ac_cv_search_pthread_create}" != "xnone required"], [
+                LIBPTHREAD_LIBS="${ac_cv_search_pthread_create}"
+            ])
+        ], [], [])
+    ], [])
+
+    AC_SUBST([LIBPTHREAD_LIBS])
+
+    LIBS="${LIBS_SAVED}"
+])
@@ -0,0 +1,97 @@
+# SPDX-License-Identifier: ISC
+# SPDX-URL: https://spdx.org/licenses/ISC.html
+#
+# Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+#
+# -*- Atheme IRC Services -*-
+# Atheme Build System Component
+
+AC_DEFUN([ATHEME_LIBTEST_ZSTD], [
+
+    CFLAGS_SAVED="${CFLAGS}"
+    LIBS_SAVED="${LIBS}"
+
+    LIBZSTD="No"
+    LIBZSTD_PATH=""
+
+    AC_ARG_WITH([zstd],
+        [AS_HELP_STRING([--without-zstd], [Do not attempt to detect libzstd (for compressed databases)])],
+        [], [with_zstd="auto"])
+
+    case "x${with_zstd}" in
+        xno | xyes | xauto)
+            ;;
+        x/*)
+            LIBZSTD_PATH="${with_zstd}"
+            with_zstd="yes"
+            ;;
+        *)
+            AC_MSG_ERROR([invalid option for --with-zstd])
+            ;;
+    esac
+
+    AS_IF([test "${with_zstd}" != "no"], [
+        AS_IF([test -n "${LIBZSTD_PATH}"], [
+            # Allow for user to provide custom installation directory
+            AS_IF([test -d "${LIBZSTD_PATH}/include" -a -d "${LIBZSTD_PATH}/lib"], [
+                LIBZSTD_CFLAGS="-I${LIBZSTD_PATH}/include"
+                LIBZSTD_LIBS="-L${LIBZSTD_PATH}/lib -lzstd"
+            ], [
+                AC_MSG_ERROR([${LIBZSTD_PATH} is not a suitable directory for libzstd])
+            ])
+        ], [test -n "${PKG_CONFIG}"], [
+            # Allow for the user to "override" pkg-config without it being installed
+            PKG_CHECK_MODULES([LIBZSTD], [libzstd], [], [LIBZSTD="No"])
+        ])
+        AS_IF([test -n "${LIBZSTD_CFLAGS+set}" -a -n "${LIBZSTD_LIBS+set}"], [
+            # Only proceed with library tests if custom paths were given or pkg-config succeeded
+            LIBZSTD="Yes"
+        ], [
+            LIBZSTD="No"
+            AS_IF([test "${with_zstd}" != "no" && test "${with_zstd}" != "auto"], [
+                AC_MSG_FAILURE([--with-zstd was given but libzstd could not be found])
+            ])
+        ])
+    ])
+
+    AS_IF([test "${LIBZSTD}" = "Yes"], [
+        CFLAGS="${LIBZSTD_CFLAGS} ${CFLAGS}"
+        LIBS="${LIBZSTD_LIBS} ${LIBS}"
+
+        AC_MSG_CHECKING([if libzstd appears to be usable])
+        AC_LINK_IFELSE([
+            AC_LANG_PROGRAM([[
+                #ifdef HAVE_STDDEF_H
+                #  include <stddef.h>
+                #endif
+                #include <zstd.h>
+            ]], [[
+                ZSTD_CCtx *const cctx = ZSTD_createCCtx();
+                (void) ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+                (void) ZSTD_compress2(cctx, NULL, 0, NULL, 0);
+                (void) ZSTD_freeCCtx(cctx);
+            ]])
+        ], [
+            AC_MSG_RESULT([yes])
+            LIBZSTD="Yes"
+            AC_DEFINE([HAVE_LIBZSTD], [1], [Define to 1 if libzstd appears to be usable])
+        ], [
+            AC_MSG_RESULT([no])
+            LIBZSTD="No"
+            AS_IF([test "${with_zstd}" != "no" && test "${with_zstd}" != "auto"], [
+                AC_MSG_FAILURE([--with-zstd was given but libzstd does not appear to be usable])
+            ])
+        ])
+    ])
+
+    AS_IF([test "${LIBZSTD}" = "No"], [
+        LIBZSTD_CFLAGS=""
+        LIBZSTD_LIBS=""
+    ])
+
+    AC_SUBST([LIBZSTD_CFLAGS])
+    AC_SUBST([LIBZSTD_LIBS])
+
+    CFLAGS="${CFLAGS_SAVED}"
+    LIBS="${LIBS_SAVED}"
+])
@@ -70,6 +70,7 @@ Configuration of ${PACKAGE_STRING}:
     Perl support ............: ${LIBPERL}
     QR Code support .........: ${LIBQRENCODE}
     Sodium support ..........: ${LIBSODIUM}
+    Zstandard support .......: ${LIBZSTD}
 
   Password Cryptography:
     Argon2 support ..........: ${LIBARGON2}
@@ -87,6 +88,7 @@ Configuration of ${PACKAGE_STRING}:
   Program Features:
     Contrib Modules .........: ${CONTRIB_MODULES}
     Crypto Benchmarking .....: ${CRYPTO_BENCHMARKING}
+    Developer Tools .........: ${DEVELOPER_TOOLS}
     Digest Frontend .........: ${DIGEST_FRONTEND}
     ECDH-X25519 Tool ........: ${ECDH_X25519_TOOL}
     ECDSA-NIST256P Tools ....: ${ECDSA_NIST256P_TOOLS}
@@ -49,6 +49,7 @@ corestorage_db_save(struct database_handle *db)
 	struct soper *soper;
 	mowgli_node_t *n, *tn;
 	mowgli_patricia_iteration_state_t state;
+	struct metadata_iteration_state mdstate;
 	struct myentity_iteration_state mestate;
 
 	errno = 0;
@@ -102,7 +103,7 @@ corestorage_db_save(struct database_handle *db)
 
 		if (atheme_object(mu)->metadata)
 		{
-			MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mu)->metadata)
+			METADATA_FOREACH(md, &mdstate, mu)
 			{
 				db_start_row(db, "MDU");
 				db_write_word(db, entity(mu)->name);
@@ -171,7 +172,7 @@ corestorage_db_save(struct database_handle *db)
 
 	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
 	{
-		mowgli_patricia_iteration_state_t state2;
+		struct metadata_iteration_state state2;
 
 		char *flags = gflags_tostr(mc_flags, mc->flags);
 
@@ -219,7 +220,7 @@ corestorage_db_save(struct database_handle *db)
 
 			if (atheme_object(ca)->metadata)
 			{
-				MOWGLI_PATRICIA_FOREACH(md, &state2, atheme_object(ca)->metadata)
+				METADATA_FOREACH(md, &state2, ca)
 				{
 					db_start_row(db, "MDA");
 					db_write_word(db, ca->mychan->name);
@@ -233,7 +234,7 @@ corestorage_db_save(struct database_handle *db)
 
 		if (atheme_object(mc)->metadata)
 		{
-			MOWGLI_PATRICIA_FOREACH(md, &state2, atheme_object(mc)->metadata)
+			METADATA_FOREACH(md, &state2, mc)
 			{
 				db_start_row(db, "MDC");
 				db_write_word(db, mc->name);
@@ -247,7 +248,7 @@ corestorage_db_save(struct database_handle *db)
 	// Old names
 	MOWGLI_PATRICIA_FOREACH(mun, &state, oldnameslist)
 	{
-		mowgli_patricia_iteration_state_t state2;
+		struct metadata_iteration_state state2;
 
 		db_start_row(db, "NAM");
 		db_write_word(db, mun->name);
@@ -255,7 +256,7 @@ corestorage_db_save(struct database_handle *db)
 
 		if (atheme_object(mun)->metadata)
 		{
-			MOWGLI_PATRICIA_FOREACH(md, &state2, atheme_object(mun)->metadata)
+			METADATA_FOREACH(md, &state2, mun)
 			{
 				db_start_row(db, "MDN");
 				db_write_word(db, mun->name);
@@ -491,6 +492,7 @@ corestorage_h_mu(struct database_handle *db, const char *type)
 	mu = myuser_add_id(uid, name, pass, email, flags);
 	mu->registered = reg;
 	mu->lastlogin = login;
+	myuser_expiry_update(mu);
 	if (language)
 		mu->language = language_add(language);
 }
@@ -517,6 +519,7 @@ corestorage_h_me(struct database_handle *db, const char *type)
 	}
 
 	mz = smalloc(sizeof *mz);
+	memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *mz);
 	mowgli_strlcpy(mz->sender, src, sizeof mz->sender);
 	mowgli_strlcpy(mz->text, text, sizeof mz->text);
 	mz->sent = sent;
@@ -595,6 +598,7 @@ corestorage_h_mn(struct database_handle *db, const char *type)
 	mn = mynick_add(mu, nick);
 	mn->registered = reg;
 	mn->lastseen = seen;
+	mynick_expiry_update(mn);
 }
 
 static void
@@ -680,6 +684,7 @@ corestorage_h_mc(struct database_handle *db, const char *type)
 
 	mc->registered = db_sread_time(db);
 	mc->used = db_sread_time(db);
+	mychan_expiry_update(mc);
 	if (dbv >= 8) {
 		sflags = db_sread_word(db);
 		if (!gflags_fromstr(mc_flags, sflags, &flags))
@@ -916,6 +921,7 @@ corestorage_h_kl(struct database_handle *db, const char *type)
 	k = kline_add_with_id(user, host, buf, duration, setby, id ? id : ++me.kline_id);
 	k->settime = settime;
 	k->expires = k->settime + k->duration;
+	kline_schedule_expiry(k);
 }
 
 static void
@@ -949,6 +955,7 @@ corestorage_h_xl(struct database_handle *db, const char *type)
 	x = xline_add(realname, buf, duration, setby);
 	x->settime = settime;
 	x->expires = x->settime + x->duration;
+	xline_schedule_expiry(x);
 
 	if (id)
 		x->number = id;
@@ -985,6 +992,7 @@ corestorage_h_ql(struct database_handle *db, const char *type)
 	q = qline_add(mask, buf, duration, setby);
 	q->settime = settime;
 	q->expires = q->settime + q->duration;
+	qline_schedule_expiry(q);
 
 	if (id)
 		q->number = id;
@@ -1028,6 +1036,26 @@ corestorage_db_write_blocking(void *filename)
 	db_close(db);
 }
 
+/* Serialise the database into memory and leave writing it to the backend,
+ * which does so from a separate thread. Returns false if the backend cannot
+ * do this (no snapshot support, or no threads), so the caller can fall back.
+ */
+static bool
+corestorage_db_write_snapshot(void *filename)
+{
+	struct database_handle *db;
+
+	if (! (db = db_open(filename, DB_SNAPSHOT)))
+		return false;
+
+	corestorage_db_save(db);
+	hook_call_db_write(db);
+
+	db_close(db);
+
+	return true;
+}
+
 #ifdef HAVE_FORK
 static void
 corestorage_db_saved_cb(pid_t pid, int status, void *data)
@@ -1046,6 +1074,9 @@ static void
 corestorage_db_write(void *filename, enum db_save_strategy strategy)
 {
 #ifndef HAVE_FORK
+	if (strategy != DB_SAVE_BLOCKING && corestorage_db_write_snapshot(filename))
+		return;
+
 	corestorage_db_write_blocking(filename);
 #else
 
@@ -1071,6 +1102,9 @@ corestorage_db_write(void *filename, enum db_save_strategy strategy)
 		return;
 	}
 
+	if (config_options.db_save_threaded && corestorage_db_write_snapshot(filename))
+		return;
+
 	pid_t pid = fork();
 	switch (pid)
 	{
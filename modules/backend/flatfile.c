@@ -157,6 +157,7 @@ flatfile_db_load(const char *filename)
 
 				mu->registered = registered;
 				mu->lastlogin = lastlogin;
+				myuser_expiry_update(mu);
 
 				if (strcmp(failnum, "0"))
 					metadata_add(mu, "private:loginfail:failnum", failnum);
@@ -210,6 +211,7 @@ flatfile_db_load(const char *filename)
 				continue;
 
 			mz = smalloc(sizeof *mz);
+			memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *mz);
 
 			mowgli_strlcpy(mz->sender, sender, sizeof mz->sender);
 			mowgli_strlcpy(mz->text, text, sizeof mz->text);
@@ -286,6 +288,7 @@ flatfile_db_load(const char *filename)
 			mn = mynick_add(mu, nick);
 			mn->registered = atoi(treg);
 			mn->lastseen = atoi(tseen);
+			mynick_expiry_update(mn);
 		}
 		else if (!strcmp("MCFP", item))
 		{
@@ -363,6 +366,7 @@ flatfile_db_load(const char *filename)
 
 				mc->registered = atoi(strtok(NULL, " "));
 				mc->used = atoi(strtok(NULL, " "));
+				mychan_expiry_update(mc);
 				mc->flags = atoi(strtok(NULL, " "));
 
 				mc->mlock_on = atoi(strtok(NULL, " "));
@@ -623,6 +627,7 @@ flatfile_db_load(const char *filename)
 
 			// XXX this is not nice, oh well -- jilles
 			k->expires = k->settime + k->duration;
+			kline_schedule_expiry(k);
 
 			kin++;
 		}
@@ -653,6 +658,7 @@ flatfile_db_load(const char *filename)
 
 			// XXX this is not nice, oh well -- jilles
 			x->expires = x->settime + x->duration;
+			xline_schedule_expiry(x);
 
 			xin++;
 		}
@@ -683,6 +689,7 @@ flatfile_db_load(const char *filename)
 
 			// XXX this is not nice, oh well -- jilles
 			q->expires = q->settime + q->duration;
+			qline_schedule_expiry(q);
 
 			qin++;
 		}
@@ -12,6 +12,18 @@
 
 #include <atheme.h>
 
+#ifdef HAVE_LIBZSTD
+#  include <zstd.h>
+#endif
+
+// Compressed databases are written as one zstd frame per block of this size
+#define OPENSEX_ZSTD_BLOCK      (1024U * 1024U)
+
+// the lock must not outlive us in a child (such as the mail delivery worker)
+#ifndef O_CLOEXEC
+#  define O_CLOEXEC             0
+#endif
+
 struct opensex
 {
 	// Lexing state
@@ -20,6 +32,27 @@ struct opensex
 	char *token;
 	FILE *f;
 
+	// Staging state (DB_SNAPSHOT, compressed DB_WRITE): rows are appended here instead of to f
+	char *image;
+	size_t imagelen;
+	size_t imagealloc;
+	struct timeval started;
+
+#ifdef HAVE_LIBZSTD
+	// Compression state; rows are staged in image and flushed a block at a time
+	ZSTD_CCtx *zc;
+	char *zbuf;
+	size_t zbuflen;
+	bool zfailed;
+
+	// Decompression state
+	ZSTD_DCtx *zd;
+	ZSTD_inBuffer zin;
+	ZSTD_outBuffer zout;            // holds one whole decoded block
+	size_t zoutread;
+	unsigned int zblock;            // frames (blocks) fully decoded so far
+#endif
+
 	// Interpreting state
 	unsigned int grver;
 };
@@ -28,6 +61,40 @@ struct opensex
 static int lockfd;
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+
+/* A serialised database on its way to disk. The writer thread only touches
+ * the job it was started with, and tells the main loop it is done by
+ * writing a byte to snapshot_pipe; everything else happens on the main
+ * thread, so no locking is needed.
+ */
+struct opensex_snapshot
+{
+	char *          path;
+	char *          image;
+	size_t          len;
+	int             capture_ms;
+	int             write_ms;
+	unsigned int    level;          // zstd level, or 0 to write plain text
+	size_t          outlen;         // bytes that ended up on disk
+	const char *    errstep;        // set by the writer thread on failure
+	int             errnum;
+	const char *    errdetail;      // used instead of strerror(errnum) if that is 0
+};
+
+static pthread_t snapshot_thread;
+static pid_t snapshot_pid = 0;
+static struct opensex_snapshot *snapshot_running = NULL;
+static struct opensex_snapshot *snapshot_queued = NULL;
+static int snapshot_pipe[2] = { -1, -1 };
+static mowgli_eventloop_pollable_t *snapshot_pollable = NULL;
+static mowgli_eventloop_timer_t *snapshot_teardown_timer = NULL;
+
+static void opensex_snapshot_start(struct opensex_snapshot *snap);
+static void opensex_snapshot_wait(void);
+
+#endif /* HAVE_LIBPTHREAD */
+
 static void
 opensex_db_parse(struct database_handle *db)
 {
@@ -51,6 +118,103 @@ opensex_h_grver(struct database_handle *db, const char *type)
 		slog(LG_ERROR, "opensex: grammar version %u is unsupported.  dazed and confused, but trying to continue.", rs->grver);
 }
 
+#ifdef HAVE_LIBZSTD
+static ZSTD_CCtx *
+opensex_zstd_cctx(unsigned int level)
+{
+	ZSTD_CCtx *const zc = ZSTD_createCCtx();
+
+	if (zc == NULL)
+		return NULL;
+
+	// a checksum in every frame lets a damaged block be pinpointed on load
+	if (ZSTD_isError(ZSTD_CCtx_setParameter(zc, ZSTD_c_compressionLevel, (int) level)) ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(zc, ZSTD_c_checksumFlag, 1)))
+	{
+		(void) ZSTD_freeCCtx(zc);
+		return NULL;
+	}
+
+	return zc;
+}
+
+/* Decode the next frame in full before handing any of it out, so that its
+ * checksum has been verified before a single row of it is processed.
+ */
+static int
+opensex_zstd_refill(struct database_handle *hdl, struct opensex *rs)
+{
+	bool started;
+	size_t ret;
+
+	rs->zout.pos = 0;
+	rs->zoutread = 0;
+
+	while (rs->zout.pos == 0)
+	{
+		started = false;
+
+		do
+		{
+			if (rs->zout.pos == rs->zout.size)
+			{
+				rs->zout.size *= 2;
+				rs->zout.dst = srealloc(rs->zout.dst, rs->zout.size);
+			}
+
+			if (rs->zin.pos == rs->zin.size)
+			{
+				rs->zin.size = fread((void *) rs->zin.src, 1, ZSTD_DStreamInSize(), rs->f);
+				rs->zin.pos = 0;
+
+				if (rs->zin.size == 0)
+				{
+					if (started && ! ferror(rs->f))
+					{
+						slog(LG_ERROR, "opensex-read-next-row: %s is truncated in compressed block %u", hdl->file, rs->zblock + 1);
+						slog(LG_ERROR, "opensex-read-next-row: exiting to avoid data loss");
+						exit(EXIT_FAILURE);
+					}
+
+					return EOF;
+				}
+			}
+
+			ret = ZSTD_decompressStream(rs->zd, &rs->zout, &rs->zin);
+			started = true;
+
+			if (ZSTD_isError(ret))
+			{
+				slog(LG_ERROR, "opensex-read-next-row: error at %s line %u, compressed block %u: %s", hdl->file, hdl->line + 1, rs->zblock + 1, ZSTD_getErrorName(ret));
+				slog(LG_ERROR, "opensex-read-next-row: exiting to avoid data loss");
+				exit(EXIT_FAILURE);
+			}
+		}
+		while (ret != 0);
+
+		rs->zblock++;
+	}
+
+	return (unsigned char) ((const char *) rs->zout.dst)[rs->zoutread++];
+}
+#endif /* HAVE_LIBZSTD */
+
+static inline int
+opensex_getc(struct database_handle *hdl, struct opensex *rs)
+{
+#ifdef HAVE_LIBZSTD
+	if (rs->zd != NULL)
+	{
+		if (rs->zoutread < rs->zout.pos)
+			return (unsigned char) ((const char *) rs->zout.dst)[rs->zoutread++];
+
+		return opensex_zstd_refill(hdl, rs);
+	}
+#endif
+
+	return getc(rs->f);
+}
+
 static bool
 opensex_read_next_row(struct database_handle *hdl)
 {
@@ -58,7 +222,7 @@ opensex_read_next_row(struct database_handle *hdl)
 	unsigned int n = 0;
 	struct opensex *rs = (struct opensex *)hdl->priv;
 
-	while ((c = getc(rs->f)) != EOF && c != '\n')
+	while ((c = opensex_getc(hdl, rs)) != EOF && c != '\n')
 	{
 		rs->buf[n++] = c;
 		if (n == rs->bufsize)
@@ -159,6 +323,36 @@ opensex_read_time(struct database_handle *db, time_t *res)
 	return *s && !*rp;
 }
 
+static void
+opensex_emit(struct opensex *rs, const char *s1, const char *s2)
+{
+	size_t len1, len2;
+
+	if (rs->image == NULL)
+	{
+		fputs(s1, rs->f);
+		if (s2 != NULL)
+			fputs(s2, rs->f);
+		return;
+	}
+
+	len1 = strlen(s1);
+	len2 = s2 != NULL ? strlen(s2) : 0;
+
+	if (rs->imagelen + len1 + len2 > rs->imagealloc)
+	{
+		while (rs->imagelen + len1 + len2 > rs->imagealloc)
+			rs->imagealloc *= 2;
+
+		rs->image = srealloc(rs->image, rs->imagealloc);
+	}
+
+	memcpy(rs->image + rs->imagelen, s1, len1);
+	if (len2)
+		memcpy(rs->image + rs->imagelen + len1, s2, len2);
+	rs->imagelen += len1 + len2;
+}
+
 static bool
 opensex_start_row(struct database_handle *db, const char *type)
 {
@@ -168,7 +362,7 @@ opensex_start_row(struct database_handle *db, const char *type)
 	return_val_if_fail(type != NULL, false);
 	rs = (struct opensex *)db->priv;
 
-	fprintf(rs->f, "%s ", type);
+	opensex_emit(rs, type, " ");
 
 	return true;
 }
@@ -183,7 +377,7 @@ opensex_write_cell(struct database_handle *db, const char *data, bool multiword)
 	return_val_if_fail(db != NULL, false);
 	rs = (struct opensex *)db->priv;
 
-	fprintf(rs->f, "%s%s", data != NULL ? data : "*", !multiword ? " " : "");
+	opensex_emit(rs, data != NULL ? data : "*", !multiword ? " " : "");
 
 	return true;
 }
@@ -224,6 +418,36 @@ opensex_write_time(struct database_handle *db, time_t tm)
 	return opensex_write_cell(db, buf, false);
 }
 
+#ifdef HAVE_LIBZSTD
+static void
+opensex_zstd_flush(struct database_handle *db, struct opensex *rs)
+{
+	size_t ret;
+
+	if (rs->imagelen == 0 || rs->zfailed)
+		return;
+
+	if (ZSTD_compressBound(rs->imagelen) > rs->zbuflen)
+	{
+		rs->zbuflen = ZSTD_compressBound(rs->imagelen);
+		rs->zbuf = srealloc(rs->zbuf, rs->zbuflen);
+	}
+
+	ret = ZSTD_compress2(rs->zc, rs->zbuf, rs->zbuflen, rs->image, rs->imagelen);
+
+	if (ZSTD_isError(ret))
+	{
+		slog(LG_ERROR, "db_save(): cannot compress '%s': %s", db->file, ZSTD_getErrorName(ret));
+		wallops("\2DATABASE ERROR\2: db_save(): cannot compress '%s': %s", db->file, ZSTD_getErrorName(ret));
+		rs->zfailed = true;
+		return;
+	}
+
+	(void) fwrite(rs->zbuf, 1, ret, rs->f);
+	rs->imagelen = 0;
+}
+#endif /* HAVE_LIBZSTD */
+
 static bool
 opensex_commit_row(struct database_handle *db)
 {
@@ -232,7 +456,12 @@ opensex_commit_row(struct database_handle *db)
 	return_val_if_fail(db != NULL, false);
 	rs = (struct opensex *)db->priv;
 
-	fprintf(rs->f, "\n");
+	opensex_emit(rs, "\n", NULL);
+
+#ifdef HAVE_LIBZSTD
+	if (rs->zc != NULL && rs->imagelen >= OPENSEX_ZSTD_BLOCK)
+		opensex_zstd_flush(db, rs);
+#endif
 
 	return true;
 }
@@ -262,6 +491,7 @@ opensex_db_open_read(const char *filename)
 	FILE *f;
 	int errno1;
 	char path[BUFSIZE];
+	char magic[sizeof DB_COMPRESSED_MAGIC - 1];
 
 	snprintf(path, BUFSIZE, "%s/%s", datadir, filename != NULL ? filename : "services.db");
 	f = fopen(path, "r");
@@ -300,6 +530,29 @@ opensex_db_open_read(const char *filename)
 	rs->buf = smalloc(rs->bufsize);
 	rs->f = f;
 
+	// a plain text database can never start with a zstd frame header
+	if (fread(magic, 1, sizeof magic, f) == sizeof magic && ! memcmp(magic, DB_COMPRESSED_MAGIC, sizeof magic))
+	{
+#ifdef HAVE_LIBZSTD
+		if (! (rs->zd = ZSTD_createDCtx()))
+		{
+			slog(LG_ERROR, "db-open-read: cannot allocate a decompression context for '%s'", path);
+			exit(EXIT_FAILURE);
+		}
+
+		rs->zin.src = smalloc(ZSTD_DStreamInSize());
+		rs->zout.dst = smalloc(ZSTD_DStreamOutSize());
+		rs->zout.size = ZSTD_DStreamOutSize();
+
+		slog(LG_INFO, "db-open-read: database '%s' is compressed", path);
+#else
+		slog(LG_ERROR, "db-open-read: database '%s' is compressed, but services was built without libzstd", path);
+		exit(EXIT_FAILURE);
+#endif
+	}
+
+	rewind(f);
+
 	db = smalloc(sizeof *db);
 	db->priv = rs;
 	db->vt = &opensex_vt;
@@ -327,16 +580,21 @@ opensex_db_open_write(const char *filename)
 	mowgli_strlcpy(path, bpath, sizeof path);
 	mowgli_strlcat(path, ".new", sizeof path);
 
+#ifdef HAVE_LIBPTHREAD
+	// a blocking write supersedes whatever the writer thread has left to do
+	opensex_snapshot_wait();
+#endif
+
 #ifdef HAVE_FLOCK
 	mowgli_strlcpy(lpath, bpath, sizeof lpath);
 	mowgli_strlcat(lpath, ".lock", sizeof lpath);
 
-	lockfd = open(lpath, O_RDONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	lockfd = open(lpath, O_RDONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 
 	flock(lockfd, LOCK_EX);
 #endif
 
-	fd = open(path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 	if (fd < 0 || ! (f = fdopen(fd, "w")))
 	{
 		errno1 = errno;
@@ -352,6 +610,19 @@ opensex_db_open_write(const char *filename)
 	rs->f = f;
 	rs->grver = 1;
 
+#ifdef HAVE_LIBZSTD
+	if (config_options.db_compression != 0)
+	{
+		if ((rs->zc = opensex_zstd_cctx(config_options.db_compression)) != NULL)
+		{
+			rs->imagealloc = OPENSEX_ZSTD_BLOCK + BUFSIZE;
+			rs->image = smalloc(rs->imagealloc);
+		}
+		else
+			slog(LG_ERROR, "db-open-write: cannot set up zstd level %u; writing '%s' uncompressed", config_options.db_compression, path);
+	}
+#endif
+
 	db = smalloc(sizeof *db);
 	db->priv = rs;
 	db->vt = &opensex_vt;
@@ -365,12 +636,390 @@ opensex_db_open_write(const char *filename)
 	return db;
 }
 
+#ifdef HAVE_LIBPTHREAD
+static void
+opensex_snapshot_free(struct opensex_snapshot *snap)
+{
+	sfree(snap->image);
+	sfree(snap->path);
+	sfree(snap);
+}
+
+static bool
+opensex_snapshot_write_all(struct opensex_snapshot *snap, int fd, const char *p, size_t left)
+{
+	ssize_t ret;
+
+	while (left > 0)
+	{
+		if ((ret = write(fd, p, left)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			snap->errstep = "write";
+			snap->errnum = errno;
+			return false;
+		}
+
+		p += ret;
+		left -= (size_t) ret;
+		snap->outlen += (size_t) ret;
+	}
+
+	return true;
+}
+
+#ifdef HAVE_LIBZSTD
+static bool
+opensex_snapshot_write_zstd(struct opensex_snapshot *snap, int fd)
+{
+	ZSTD_CCtx *zc;
+	char *out;
+	size_t outcap, off, len, ret;
+	bool ok = false;
+
+	// plain malloc(), as smalloc() would log and abort from the wrong thread
+	outcap = ZSTD_compressBound(OPENSEX_ZSTD_BLOCK);
+
+	if (! (zc = opensex_zstd_cctx(snap->level)) || ! (out = malloc(outcap)))
+	{
+		snap->errstep = "ZSTD_createCCtx";
+		snap->errnum = ENOMEM;
+		(void) ZSTD_freeCCtx(zc);
+		return false;
+	}
+
+	for (off = 0; off < snap->len; off += len)
+	{
+		len = snap->len - off < OPENSEX_ZSTD_BLOCK ? snap->len - off : OPENSEX_ZSTD_BLOCK;
+		ret = ZSTD_compress2(zc, out, outcap, snap->image + off, len);
+
+		if (ZSTD_isError(ret))
+		{
+			snap->errstep = "ZSTD_compress2";
+			snap->errdetail = ZSTD_getErrorName(ret);
+			goto done;
+		}
+
+		if (! opensex_snapshot_write_all(snap, fd, out, ret))
+			goto done;
+	}
+
+	ok = true;
+
+done:
+	(void) ZSTD_freeCCtx(zc);
+	free(out);
+	return ok;
+}
+#endif /* HAVE_LIBZSTD */
+
+static void
+opensex_snapshot_write(struct opensex_snapshot *snap)
+{
+	char path[BUFSIZE];
+	struct timeval started, elapsed;
+	bool written;
+	int fd;
+#ifdef HAVE_FLOCK
+	char lpath[BUFSIZE];
+	int lfd;
+#endif
+
+	// nothing in here may call into the rest of services; see above
+	s_time(&started);
+
+	snprintf(path, sizeof path, "%s.new", snap->path);
+
+#ifdef HAVE_FLOCK
+	snprintf(lpath, sizeof lpath, "%s.lock", snap->path);
+
+	if ((lfd = open(lpath, O_RDONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP)) >= 0)
+		(void) flock(lfd, LOCK_EX);
+#endif
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP)) < 0)
+	{
+		snap->errstep = "open";
+		snap->errnum = errno;
+		goto out;
+	}
+
+#ifdef HAVE_LIBZSTD
+	if (snap->level != 0)
+		written = opensex_snapshot_write_zstd(snap, fd);
+	else
+#endif
+		written = opensex_snapshot_write_all(snap, fd, snap->image, snap->len);
+
+	if (! written)
+	{
+		(void) close(fd);
+		goto out;
+	}
+
+	if (fsync(fd) < 0)
+	{
+		snap->errstep = "fsync";
+		snap->errnum = errno;
+		(void) close(fd);
+		goto out;
+	}
+
+	if (close(fd) < 0)
+	{
+		snap->errstep = "close";
+		snap->errnum = errno;
+		goto out;
+	}
+
+	// now, replace the old database with the new one, using an atomic rename
+	if (srename(path, snap->path) < 0)
+	{
+		snap->errstep = "rename";
+		snap->errnum = errno;
+	}
+
+out:
+#ifdef HAVE_FLOCK
+	if (lfd >= 0)
+		(void) close(lfd);
+#endif
+
+	e_time(started, &elapsed);
+	snap->write_ms = tv2ms(&elapsed);
+}
+
+static void *
+opensex_snapshot_thread(void *arg)
+{
+	opensex_snapshot_write(arg);
+
+	while (write(snapshot_pipe[1], "", 1) < 0 && errno == EINTR)
+		;
+
+	return NULL;
+}
+
+/* The pipe only exists while a write is running or queued. It is torn down
+ * from a timer, as the last write usually finishes inside the pollable's
+ * own callback.
+ */
+static void
+opensex_snapshot_teardown(void *unused)
+{
+	snapshot_teardown_timer = NULL;
+
+	if (snapshot_running != NULL || snapshot_pollable == NULL)
+		return;
+
+	mowgli_pollable_destroy(base_eventloop, snapshot_pollable);
+	snapshot_pollable = NULL;
+
+	(void) close(snapshot_pipe[0]);
+	(void) close(snapshot_pipe[1]);
+	snapshot_pipe[0] = snapshot_pipe[1] = -1;
+}
+
+static void
+opensex_snapshot_finish(struct opensex_snapshot *snap)
+{
+	if (snap->errstep != NULL)
+	{
+		const char *const reason = snap->errnum ? strerror(snap->errnum) : snap->errdetail;
+
+		slog(LG_ERROR, "db_save(): background write of '%s' failed at %s(): %s", snap->path, snap->errstep, reason);
+		wallops("\2DATABASE ERROR\2: db_save(): background write of '%s' failed at %s(): %s", snap->path, snap->errstep, reason);
+	}
+	else
+	{
+		slog(LG_DEBUG, "db_save(): finished threaded DB write: %zu bytes (%zu on disk), captured in %d ms, written in %d ms", snap->len, snap->outlen, snap->capture_ms, snap->write_ms);
+		hook_call_db_saved();
+	}
+
+	opensex_snapshot_free(snap);
+
+	if (snapshot_queued != NULL)
+	{
+		struct opensex_snapshot *const next = snapshot_queued;
+
+		snapshot_queued = NULL;
+		opensex_snapshot_start(next);
+		return;
+	}
+
+	if (snapshot_pollable != NULL && snapshot_teardown_timer == NULL)
+		snapshot_teardown_timer = mowgli_timer_add_once(base_eventloop, "opensex_snapshot_teardown",
+		                                                opensex_snapshot_teardown, NULL, 0);
+}
+
+// runs on the main thread once the writer thread has signalled completion
+static void
+opensex_snapshot_reap(void)
+{
+	struct opensex_snapshot *const snap = snapshot_running;
+	char c;
+
+	return_if_fail(snap != NULL);
+
+	while (read(snapshot_pipe[0], &c, 1) < 0 && errno == EINTR)
+		;
+
+	(void) pthread_join(snapshot_thread, NULL);
+	snapshot_running = NULL;
+
+	opensex_snapshot_finish(snap);
+}
+
+static void
+opensex_snapshot_ready(mowgli_eventloop_t *eventloop, mowgli_eventloop_io_t *io,
+	mowgli_eventloop_io_dir_t dir, void *userdata)
+{
+	opensex_snapshot_reap();
+}
+
+static void
+opensex_snapshot_start(struct opensex_snapshot *snap)
+{
+	if (snapshot_pollable == NULL)
+	{
+		if (pipe(snapshot_pipe) < 0)
+		{
+			slog(LG_ERROR, "db_save(): pipe() failed (%s); writing database synchronously", strerror(errno));
+			snapshot_pipe[0] = snapshot_pipe[1] = -1;
+			goto blocking;
+		}
+
+		snapshot_pollable = mowgli_pollable_create(base_eventloop, snapshot_pipe[0], NULL);
+		mowgli_pollable_setselect(base_eventloop, snapshot_pollable, MOWGLI_EVENTLOOP_IO_READ, opensex_snapshot_ready);
+	}
+
+	snapshot_running = snap;
+	snapshot_pid = getpid();
+
+	if (pthread_create(&snapshot_thread, NULL, opensex_snapshot_thread, snap) == 0)
+		return;
+
+	slog(LG_ERROR, "db_save(): pthread_create() failed; writing database synchronously");
+	snapshot_running = NULL;
+
+blocking:
+	opensex_snapshot_write(snap);
+	opensex_snapshot_finish(snap);
+}
+
+/* Wait for the writer thread to finish and drop any queued snapshot; used
+ * before the database is written synchronously.
+ */
+static void
+opensex_snapshot_wait(void)
+{
+	if (snapshot_queued != NULL)
+	{
+		opensex_snapshot_free(snapshot_queued);
+		snapshot_queued = NULL;
+	}
+
+	// a forked child has no writer thread, only the parent's bookkeeping
+	if (snapshot_running == NULL || snapshot_pid != getpid())
+		return;
+
+	opensex_snapshot_reap();
+}
+
+static struct database_handle * ATHEME_FATTR_MALLOC
+opensex_db_open_snapshot(const char *filename)
+{
+	struct database_handle *db;
+	struct opensex *rs;
+	char bpath[BUFSIZE];
+
+	snprintf(bpath, BUFSIZE, "%s/%s", datadir, filename != NULL ? filename : "services.db");
+
+	/* this capture supersedes any image still waiting for the writer; free
+	 * it now so that at most two images (running and capturing) exist
+	 */
+	if (snapshot_queued != NULL)
+	{
+		opensex_snapshot_free(snapshot_queued);
+		snapshot_queued = NULL;
+	}
+
+	rs = smalloc(sizeof *rs);
+	rs->grver = 1;
+	rs->imagealloc = 1024 * 1024;
+	rs->image = smalloc(rs->imagealloc);
+	s_time(&rs->started);
+
+	db = smalloc(sizeof *db);
+	db->priv = rs;
+	db->vt = &opensex_vt;
+	db->txn = DB_SNAPSHOT;
+	db->file = sstrdup(bpath);
+
+	db_start_row(db, "GRVER");
+	db_write_uint(db, rs->grver);
+	db_commit_row(db);
+
+	return db;
+}
+
+static void
+opensex_db_close_snapshot(struct database_handle *db)
+{
+	struct opensex *const rs = db->priv;
+	struct opensex_snapshot *const snap = smalloc(sizeof *snap);
+	struct timeval elapsed;
+
+	e_time(rs->started, &elapsed);
+
+	snap->path = db->file;
+	snap->image = rs->image;
+	snap->len = rs->imagelen;
+	snap->capture_ms = tv2ms(&elapsed);
+#ifdef HAVE_LIBZSTD
+	snap->level = config_options.db_compression;
+#endif
+
+	sfree(rs);
+	sfree(db);
+
+	if (snapshot_running == NULL)
+	{
+		opensex_snapshot_start(snap);
+		return;
+	}
+
+	// only the newest image is worth writing once the current one is done
+	slog(LG_DEBUG, "db_save(): previous threaded write unfinished, queueing this one");
+
+	if (snapshot_queued != NULL)
+		opensex_snapshot_free(snapshot_queued);
+
+	snapshot_queued = snap;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static struct database_handle *
 opensex_db_open(const char *filename, enum database_transaction txn)
 {
-	if (txn == DB_WRITE)
-		return opensex_db_open_write(filename);
-	return opensex_db_open_read(filename);
+	switch (txn)
+	{
+		case DB_WRITE:
+			return opensex_db_open_write(filename);
+
+		case DB_SNAPSHOT:
+#ifdef HAVE_LIBPTHREAD
+			return opensex_db_open_snapshot(filename);
+#else
+			return NULL;
+#endif
+
+		case DB_READ:
+		default:
+			return opensex_db_open_read(filename);
+	}
 }
 
 static void
@@ -383,15 +1032,46 @@ opensex_db_close(struct database_handle *db)
 	return_if_fail(db != NULL);
 	rs = db->priv;
 
+#ifdef HAVE_LIBPTHREAD
+	if (db->txn == DB_SNAPSHOT)
+	{
+		opensex_db_close_snapshot(db);
+		return;
+	}
+#endif
+
 	mowgli_strlcpy(oldpath, db->file, sizeof oldpath);
 	mowgli_strlcat(oldpath, ".new", sizeof oldpath);
 
 	mowgli_strlcpy(newpath, db->file, sizeof newpath);
 
+#ifdef HAVE_LIBZSTD
+	if (rs->zc != NULL)
+	{
+		opensex_zstd_flush(db, rs);
+
+		(void) ZSTD_freeCCtx(rs->zc);
+		sfree(rs->zbuf);
+		sfree(rs->image);
+	}
+
+	if (rs->zd != NULL)
+	{
+		(void) ZSTD_freeDCtx(rs->zd);
+		sfree((void *) rs->zin.src);
+		sfree(rs->zout.dst);
+	}
+#endif
+
 	fclose(rs->f);
 
 	if (db->txn == DB_WRITE)
 	{
+#ifdef HAVE_LIBZSTD
+		if (rs->zfailed)
+			slog(LG_ERROR, "db_save(): leaving the previous contents of '%s' in place", newpath);
+		else
+#endif
 		// now, replace the old database with the new one, using an atomic rename
 		if (srename(oldpath, newpath) < 0)
 		{
@@ -1014,6 +1014,50 @@ bs_part(struct hook_channel_joinpart *hdata)
 	}
 }
 
+static void
+bs_split(struct hook_channel_split *hdata)
+{
+	struct channel *c = hdata->chan;
+	struct chanuser *cu;
+	struct mychan *mc;
+	struct botserv_bot *bot;
+	mowgli_node_t *n;
+
+	mc = mychan_from(c);
+	if (mc == NULL)
+		return;
+
+	// chanserv's function handles those
+	if (metadata_find(mc, "private:botserv:bot-assigned") == NULL)
+		return;
+
+	bot = bs_mychan_find_bot(mc);
+	if ((CURRTIME - mc->used) >= SECONDS_PER_HOUR)
+	{
+		MOWGLI_ITER_FOREACH(n, c->members.head)
+		{
+			cu = n->data;
+
+			if ((cu->user->server->flags & SF_SPLITTING) &&
+					(chanacs_user_flags(mc, cu->user) & CA_USEDUPDATE))
+			{
+				mc->used = CURRTIME;
+				break;
+			}
+		}
+	}
+
+	if (config_options.leave_chans
+			&& !(mc->flags & MC_INHABIT)
+			&& (c->nummembers - c->numsvcmembers <= hdata->parting))
+	{
+		if (bot)
+			part(c->name, bot->nick);
+		else
+			part(c->name, chansvs.nick);
+	}
+}
+
 static struct command bs_bot = {
 	.name           = "BOT",
 	.desc           = N_("Maintains network bot list."),
@@ -1087,6 +1131,7 @@ mod_init(struct module *const restrict m)
 	hook_add_operserv_info(osinfo_hook);
 	hook_add_first_channel_join(bs_join);
 	hook_add_channel_part(bs_part);
+	hook_add_channel_split(bs_split);
 
 	modestack_mode_simple = bs_modestack_mode_simple;
 	modestack_mode_limit  = bs_modestack_mode_limit;
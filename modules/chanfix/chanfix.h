@@ -24,6 +24,13 @@
 #define CHANFIX_GATHER_INTERVAL (5U * SECONDS_PER_MINUTE)
 #define CHANFIX_EXPIRE_INTERVAL SECONDS_PER_HOUR
 
+/* Op time is accounted from join/mode events; the gather pass only checks
+ * that users still hold the ops it is counting for them. Ops we were not
+ * told about (e.g. given by services, or desynchs) are picked up by a full
+ * walk of the network this often.
+ */
+#define CHANFIX_RESYNC_INTERVAL SECONDS_PER_HOUR
+
 /* This value has been chosen such that the maximum score is about 8064,
  * which is the number of CHANFIX_GATHER_INTERVALs in CHANFIX_RETENTION_TIME.
  * Higher scores would decay more than they can gain (12 per hour).
@@ -37,6 +44,11 @@ struct chanfix_channel
 	char *name;
 
 	mowgli_list_t oprecords;
+	mowgli_patricia_t *oprecord_index;	// entity ID or user@host -> oprecord
+
+	mowgli_list_t opped;			// oprecords currently accruing op time
+	mowgli_node_t oppednode;
+
 	time_t ts;
 	time_t lastupdate;
 
@@ -60,6 +72,13 @@ struct chanfix_oprecord
 	time_t firstseen;
 	time_t lastevent;
 	unsigned int age;
+
+	// while opsince is non-zero, opuser holds ops and age grows lazily,
+	// up to opseen (the last time we know they were still opped)
+	struct user *opuser;
+	time_t opsince;
+	time_t opseen;
+	mowgli_node_t oppednode;
 };
 
 struct chanfix_persist_record
@@ -70,6 +89,8 @@ struct chanfix_persist_record
 	mowgli_heap_t *chanfix_oprecord_heap;
 
 	mowgli_patricia_t *chanfix_channels;
+	mowgli_list_t chanfix_opped_channels;
+	unsigned int chanfix_gather_passes;
 };
 
 extern struct service *chanfix;
@@ -79,6 +100,8 @@ void chanfix_gather_init(struct chanfix_persist_record *);
 void chanfix_gather_deinit(enum module_unload_intent, struct chanfix_persist_record *);
 
 void chanfix_oprecord_update(struct chanfix_channel *chan, struct user *u);
+void chanfix_oprecord_settle(struct chanfix_oprecord *orec);
+void chanfix_channel_settle(struct chanfix_channel *chan);
 void chanfix_oprecord_delete(struct chanfix_oprecord *orec);
 struct chanfix_oprecord *chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u);
 struct chanfix_oprecord *chanfix_oprecord_find(struct chanfix_channel *chan, struct user *u);
@@ -73,6 +73,8 @@ chanfix_calculate_score(struct chanfix_oprecord *orec)
 
 	return_val_if_fail(orec != NULL, 0);
 
+	chanfix_oprecord_settle(orec);
+
 	base = orec->age;
 	if (orec->entity != NULL)
 		base *= CHANFIX_ACCOUNT_WEIGHT;
@@ -185,6 +187,7 @@ chanfix_fix_channel(struct chanfix_channel *chan)
 				join(chan->name, chanfix->me->nick);
 			modestack_mode_param(chanfix->me->nick, chan->chan, MTYPE_ADD, 'o', CLIENT_NAME(cu->user));
 			cu->modes |= CSTATUS_OP;
+			chanfix_oprecord_update(chan, cu->user);
 			opped++;
 		}
 	}
@@ -517,6 +520,7 @@ chanfix_cmd_scores(struct sourceinfo *si, int parc, char *parv[])
 	}
 
 	// sort records by score.
+	chanfix_channel_settle(chan);
 	mowgli_list_sort(&chan->oprecords, chanfix_compare_records, NULL);
 
 	if (count > MOWGLI_LIST_LENGTH(&chan->oprecords))
@@ -581,6 +585,7 @@ chanfix_cmd_info(struct sourceinfo *si, int parc, char *parv[])
 	}
 
 	// sort records by score.
+	chanfix_channel_settle(chan);
 	mowgli_list_sort(&chan->oprecords, chanfix_compare_records, NULL);
 
 	command_success_nodata(si, _("Information on \2%s\2:"), chan->name);
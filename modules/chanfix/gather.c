@@ -16,11 +16,172 @@ static unsigned int loading_cfdbv = 0;
 
 static mowgli_heap_t *chanfix_channel_heap = NULL;
 static mowgli_heap_t *chanfix_oprecord_heap = NULL;
+
+static struct memtag *chanfix_channel_memtag = NULL;
+static struct memtag *chanfix_oprecord_memtag = NULL;
 static mowgli_eventloop_timer_t *chanfix_gather_timer = NULL;
 static mowgli_eventloop_timer_t *chanfix_expire_timer = NULL;
 
 mowgli_patricia_t *chanfix_channels = NULL;
 
+static unsigned int chanfix_gather_passes = 0;
+static mowgli_list_t chanfix_opped_channels;
+
+static void
+chanfix_oprecord_mask(char *const restrict buf, const size_t buflen, const char *const restrict user,
+                      const char *const restrict host)
+{
+	(void) snprintf(buf, buflen, "%s@%s", user, host);
+}
+
+/* An oprecord is indexed under its entity's ID (if any) and its user@host;
+ * where an older record already holds a key, that one keeps matching, as it
+ * did when the records were searched in order.
+ */
+static void
+chanfix_oprecord_index(struct chanfix_oprecord *orec)
+{
+	char mask[USERLEN + 1 + HOSTLEN + 1];
+	mowgli_patricia_t *const index = orec->chan->oprecord_index;
+
+	if (orec->entity != NULL && *orec->entity->id != '\0' &&
+			mowgli_patricia_retrieve(index, orec->entity->id) == NULL)
+		(void) mowgli_patricia_add(index, orec->entity->id, orec);
+
+	chanfix_oprecord_mask(mask, sizeof mask, orec->user, orec->host);
+
+	if (mowgli_patricia_retrieve(index, mask) == NULL)
+		(void) mowgli_patricia_add(index, mask, orec);
+}
+
+/* When the record holding a key goes away, the next oldest record sharing
+ * that key takes it over, so lookups keep finding what the ordered search
+ * would have found.
+ */
+static void
+chanfix_oprecord_unindex(struct chanfix_oprecord *orec)
+{
+	char mask[USERLEN + 1 + HOSTLEN + 1];
+	mowgli_patricia_t *const index = orec->chan->oprecord_index;
+	bool entity_freed = false, mask_freed = false;
+	mowgli_node_t *n;
+
+	if (orec->entity != NULL && mowgli_patricia_retrieve(index, orec->entity->id) == orec)
+	{
+		(void) mowgli_patricia_delete(index, orec->entity->id);
+		entity_freed = true;
+	}
+
+	chanfix_oprecord_mask(mask, sizeof mask, orec->user, orec->host);
+
+	if (mowgli_patricia_retrieve(index, mask) == orec)
+	{
+		(void) mowgli_patricia_delete(index, mask);
+		mask_freed = true;
+	}
+
+	MOWGLI_ITER_FOREACH(n, orec->chan->oprecords.head)
+	{
+		struct chanfix_oprecord *const other = n->data;
+
+		if (! entity_freed && ! mask_freed)
+			break;
+
+		if (other == orec)
+			continue;
+
+		if (entity_freed && other->entity == orec->entity)
+		{
+			(void) mowgli_patricia_add(index, orec->entity->id, other);
+			entity_freed = false;
+		}
+
+		if (mask_freed && ! irccasecmp(other->user, orec->user) && ! irccasecmp(other->host, orec->host))
+		{
+			(void) mowgli_patricia_add(index, mask, other);
+			mask_freed = false;
+		}
+	}
+}
+
+/* Credit one point for every whole CHANFIX_GATHER_INTERVAL the record is
+ * known to have been opped since we last looked, carrying the remainder
+ * forward. Deops are not reported to modules, so time after opseen is only
+ * credited once a later check finds the user still opped.
+ */
+void
+chanfix_oprecord_settle(struct chanfix_oprecord *orec)
+{
+	time_t intervals;
+
+	return_if_fail(orec != NULL);
+
+	if (orec->opsince == 0 || orec->opseen <= orec->opsince)
+		return;
+
+	intervals = (orec->opseen - orec->opsince) / CHANFIX_GATHER_INTERVAL;
+
+	if (intervals == 0)
+		return;
+
+	orec->age += intervals;
+	orec->opsince += intervals * CHANFIX_GATHER_INTERVAL;
+	orec->lastevent = orec->opseen;
+}
+
+void
+chanfix_channel_settle(struct chanfix_channel *chan)
+{
+	mowgli_node_t *n;
+
+	return_if_fail(chan != NULL);
+
+	MOWGLI_ITER_FOREACH(n, chan->opped.head)
+		chanfix_oprecord_settle(n->data);
+}
+
+static void
+chanfix_oprecord_start(struct chanfix_oprecord *orec, struct user *u)
+{
+	struct chanfix_channel *chan = orec->chan;
+
+	if (orec->opsince != 0)
+	{
+		orec->opseen = CURRTIME;
+		return;
+	}
+
+	orec->opuser = u;
+	orec->opsince = CURRTIME;
+	orec->opseen = CURRTIME;
+	orec->lastevent = CURRTIME;
+
+	if (MOWGLI_LIST_LENGTH(&chan->opped) == 0)
+		mowgli_node_add(chan, &chan->oppednode, &chanfix_opped_channels);
+
+	mowgli_node_add(orec, &orec->oppednode, &chan->opped);
+}
+
+static void
+chanfix_oprecord_stop(struct chanfix_oprecord *orec)
+{
+	struct chanfix_channel *chan = orec->chan;
+
+	if (orec->opsince == 0)
+		return;
+
+	chanfix_oprecord_settle(orec);
+
+	orec->opuser = NULL;
+	orec->opsince = 0;
+	orec->opseen = 0;
+
+	mowgli_node_delete(&orec->oppednode, &chan->opped);
+
+	if (MOWGLI_LIST_LENGTH(&chan->opped) == 0)
+		mowgli_node_delete(&chan->oppednode, &chanfix_opped_channels);
+}
+
 struct chanfix_oprecord *
 chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u)
 {
@@ -34,12 +195,14 @@ chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u)
 	}
 
 	orec = mowgli_heap_alloc(chanfix_oprecord_heap);
+	memtag_alloc(chanfix_oprecord_memtag, sizeof *orec);
 
 	orec->chan = chan;
 
 	orec->firstseen = CURRTIME;
 	orec->lastevent = CURRTIME;
 
+	// being seen opped for the first time is worth a point, as it always was
 	orec->age = 1;
 
 	if (u != NULL)
@@ -48,6 +211,8 @@ chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u)
 
 		mowgli_strlcpy(orec->user, u->user, sizeof orec->user);
 		mowgli_strlcpy(orec->host, u->vhost, sizeof orec->host);
+
+		chanfix_oprecord_index(orec);
 	}
 
 	mowgli_node_add(orec, &orec->node, &chan->oprecords);
@@ -58,25 +223,21 @@ chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u)
 struct chanfix_oprecord *
 chanfix_oprecord_find(struct chanfix_channel *chan, struct user *u)
 {
-	mowgli_node_t *n;
+	char mask[USERLEN + 1 + HOSTLEN + 1];
+	struct chanfix_oprecord *orec;
 
 	return_val_if_fail(chan != NULL, NULL);
 	return_val_if_fail(u != NULL, NULL);
 
-	MOWGLI_ITER_FOREACH(n, chan->oprecords.head)
-	{
-		struct chanfix_oprecord *orec = n->data;
-
-		if (orec->entity != NULL && orec->entity == entity(u->myuser))
-			return orec;
+	if (u->myuser != NULL && (orec = mowgli_patricia_retrieve(chan->oprecord_index, entity(u->myuser)->id)) != NULL)
+		return orec;
 
-		if (!irccasecmp(orec->user, u->user) && !irccasecmp(orec->host, u->vhost))
-			return orec;
-	}
+	chanfix_oprecord_mask(mask, sizeof mask, u->user, u->vhost);
 
-	return NULL;
+	return mowgli_patricia_retrieve(chan->oprecord_index, mask);
 }
 
+/* u holds ops in chan: start accruing op time for them if we are not already */
 void
 chanfix_oprecord_update(struct chanfix_channel *chan, struct user *u)
 {
@@ -88,16 +249,18 @@ chanfix_oprecord_update(struct chanfix_channel *chan, struct user *u)
 	orec = chanfix_oprecord_find(chan, u);
 	if (orec != NULL)
 	{
-		orec->age++;
-		orec->lastevent = CURRTIME;
-
 		if (orec->entity == NULL && u->myuser != NULL)
+		{
 			orec->entity = entity(u->myuser);
+			chanfix_oprecord_index(orec);
+		}
 
+		chanfix_oprecord_start(orec, u);
 		return;
 	}
 
-	chanfix_oprecord_create(chan, u);
+	orec = chanfix_oprecord_create(chan, u);
+	chanfix_oprecord_start(orec, u);
 	chan->lastupdate = CURRTIME;
 }
 
@@ -106,7 +269,11 @@ chanfix_oprecord_delete(struct chanfix_oprecord *orec)
 {
 	return_if_fail(orec != NULL);
 
+	chanfix_oprecord_stop(orec);
+	chanfix_oprecord_unindex(orec);
+
 	mowgli_node_delete(&orec->node, &orec->chan->oprecords);
+	memtag_free(chanfix_oprecord_memtag, sizeof *orec);
 	mowgli_heap_free(chanfix_oprecord_heap, orec);
 }
 
@@ -126,7 +293,10 @@ chanfix_channel_delete(struct chanfix_channel *c)
 		chanfix_oprecord_delete(orec);
 	}
 
+	mowgli_patricia_destroy(c->oprecord_index, NULL, NULL);
+
 	sfree(c->name);
+	memtag_free(chanfix_channel_memtag, sizeof *c);
 	mowgli_heap_free(chanfix_channel_heap, c);
 }
 
@@ -138,10 +308,13 @@ chanfix_channel_create(const char *name, struct channel *chan)
 	return_val_if_fail(name != NULL, NULL);
 
 	c = mowgli_heap_alloc(chanfix_channel_heap);
+	memtag_alloc(chanfix_channel_memtag, sizeof *c);
+
 	atheme_object_init(atheme_object(c), name, (atheme_object_destructor_fn) chanfix_channel_delete);
 
 	c->name = sstrdup(name);
 	c->chan = chan;
+	c->oprecord_index = mowgli_patricia_create(irccasecanon);
 	c->fix_started = 0;
 
 	if (c->chan != NULL)
@@ -191,6 +364,14 @@ chanfix_channel_delete_ev(struct channel *ch)
 
 	if ((chan = chanfix_channel_get(ch)) != NULL)
 	{
+		mowgli_node_t *n, *tn;
+
+		/* members of a channel being destroyed are removed without
+		 * a part event.
+		 */
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->opped.head)
+			chanfix_oprecord_stop(n->data);
+
 		chan->chan = NULL;
 		return;
 	}
@@ -198,26 +379,170 @@ chanfix_channel_delete_ev(struct channel *ch)
 	chanfix_channel_create(ch->name, NULL);
 }
 
+static struct chanfix_channel *
+chanfix_channel_gather(struct channel *ch)
+{
+	struct chanfix_channel *chan;
+
+	if (mychan_find(ch->name) != NULL)
+		return NULL;
+
+	if ((chan = chanfix_channel_get(ch)) == NULL)
+		chan = chanfix_channel_create(ch->name, ch);
+
+	return chan;
+}
+
+static void
+chanfix_channel_join_ev(struct hook_channel_joinpart *hdata)
+{
+	struct chanuser *cu = hdata->cu;
+	struct chanfix_channel *chan;
+
+	if (cu == NULL || !(cu->modes & CSTATUS_OP))
+		return;
+
+	if ((chan = chanfix_channel_gather(cu->chan)) != NULL)
+		chanfix_oprecord_update(chan, cu->user);
+}
+
+static void
+chanfix_channel_mode_change_ev(struct hook_channel_mode_change *hdata)
+{
+	struct chanfix_channel *chan;
+
+	if (hdata->mvalue != CSTATUS_OP)
+		return;
+
+	if ((chan = chanfix_channel_gather(hdata->cu->chan)) != NULL)
+		chanfix_oprecord_update(chan, hdata->cu->user);
+}
+
+static void
+chanfix_channel_part_ev(struct hook_channel_joinpart *hdata)
+{
+	struct chanuser *cu = hdata->cu;
+	struct chanfix_channel *chan;
+	mowgli_node_t *n, *tn;
+
+	if (cu == NULL || (chan = chanfix_channel_get(cu->chan)) == NULL)
+		return;
+
+	/* the user's mask may have changed since they were opped, so look
+	 * for them by pointer rather than through the index.
+	 */
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->opped.head)
+	{
+		struct chanfix_oprecord *orec = n->data;
+
+		if (orec->opuser != cu->user)
+			continue;
+
+		if (cu->modes & CSTATUS_OP)
+			orec->opseen = CURRTIME;
+
+		chanfix_oprecord_stop(orec);
+	}
+}
+
+/* Quitting users normally part every channel first, but do not rely on that
+ * to keep opuser from outliving the user.
+ */
+static void
+chanfix_user_delete_ev(struct user *u)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, u->channels.head)
+	{
+		struct chanuser *cu = n->data;
+		struct hook_channel_joinpart hdata = { .cu = cu };
+
+		chanfix_channel_part_ev(&hdata);
+	}
+}
+
+static void
+chanfix_channel_split_ev(struct hook_channel_split *hdata)
+{
+	struct chanfix_channel *chan;
+	mowgli_node_t *n, *tn;
+
+	if ((chan = chanfix_channel_get(hdata->chan)) == NULL)
+		return;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->opped.head)
+	{
+		struct chanfix_oprecord *orec = n->data;
+		struct chanuser *cu;
+
+		if (! (orec->opuser->server->flags & SF_SPLITTING))
+			continue;
+
+		if ((cu = chanuser_find(hdata->chan, orec->opuser)) != NULL && (cu->modes & CSTATUS_OP))
+			orec->opseen = CURRTIME;
+
+		chanfix_oprecord_stop(orec);
+	}
+}
+
+/* Deops are not reported to modules, so check that everyone we are counting
+ * op time for still holds ops (and that the channel has not since been
+ * registered). Every CHANFIX_RESYNC_INTERVAL, also walk the network for ops
+ * we did not see being given.
+ */
 void
 chanfix_gather(void *unused)
 {
 	struct channel *ch;
+	mowgli_node_t *n, *tn;
 	mowgli_patricia_iteration_state_t state;
-	unsigned int chans = 0, oprecords = 0;
+	unsigned int opped = 0, drifted = 0, chans = 0, oprecords = 0;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chanfix_opped_channels.head)
+	{
+		struct chanfix_channel *chan = n->data;
+		mowgli_node_t *on, *otn;
+		bool registered;
+
+		ch = chan->chan;
+		registered = ch == NULL || mychan_find(ch->name) != NULL;
+
+		MOWGLI_ITER_FOREACH_SAFE(on, otn, chan->opped.head)
+		{
+			struct chanfix_oprecord *orec = on->data;
+			struct chanuser *cu = registered ? NULL : chanuser_find(ch, orec->opuser);
+
+			if (cu != NULL && (cu->modes & CSTATUS_OP))
+			{
+				orec->opseen = CURRTIME;
+				chanfix_oprecord_settle(orec);
+				opped++;
+				continue;
+			}
+
+			// deopped at some point since opseen; only credit up to then
+
+			chanfix_oprecord_stop(orec);
+			drifted++;
+		}
+	}
+
+	if (++chanfix_gather_passes < CHANFIX_RESYNC_INTERVAL / CHANFIX_GATHER_INTERVAL)
+	{
+		slog(LG_DEBUG, "chanfix_gather(): %u oprecords accruing, %u no longer opped.", opped, drifted);
+		return;
+	}
+
+	chanfix_gather_passes = 0;
 
 	MOWGLI_PATRICIA_FOREACH(ch, &state, chanlist)
 	{
-		struct mychan *mc;
-		mowgli_node_t *n;
 		struct chanfix_channel *chan;
 
-		if ((mc = mychan_find(ch->name)) != NULL)
+		if ((chan = chanfix_channel_gather(ch)) == NULL)
 			continue;
 
-		chan = chanfix_channel_get(ch);
-		if (chan == NULL)
-			chan = chanfix_channel_create(ch->name, ch);
-
 		MOWGLI_ITER_FOREACH(n, ch->members.head)
 		{
 			struct chanuser *cu = n->data;
@@ -232,7 +557,8 @@ chanfix_gather(void *unused)
 		chans++;
 	}
 
-	slog(LG_DEBUG, "chanfix_gather(): gathered %u channels and %u oprecords.", chans, oprecords);
+	slog(LG_DEBUG, "chanfix_gather(): %u oprecords accruing, %u no longer opped; resynced %u channels and %u oprecords.",
+	     opped, drifted, chans, oprecords);
 }
 
 void
@@ -249,13 +575,16 @@ chanfix_expire(void *unused)
 		{
 			struct chanfix_oprecord *orec = n->data;
 
+			chanfix_oprecord_settle(orec);
+
 			/* Simple exponential decay, rounding the decay up
 			 * so that low scores expire sooner.
 			 */
 			orec->age -= (orec->age + CHANFIX_EXPIRE_DIVISOR - 1) /
 				CHANFIX_EXPIRE_DIVISOR;
 
-			if (orec->age > 0 && CURRTIME - orec->lastevent < CHANFIX_RETENTION_TIME)
+			if (orec->opsince != 0 ||
+					(orec->age > 0 && CURRTIME - orec->lastevent < CHANFIX_RETENTION_TIME))
 				continue;
 
 			chanfix_oprecord_delete(orec);
@@ -291,6 +620,8 @@ write_chanfixdb(struct database_handle *db)
 		db_write_time(db, chan->lastupdate);
 		db_commit_row(db);
 
+		chanfix_channel_settle(chan);
+
 		MOWGLI_ITER_FOREACH(n, chan->oprecords.head)
 		{
 			struct chanfix_oprecord *orec = n->data;
@@ -316,10 +647,10 @@ write_chanfixdb(struct database_handle *db)
 
 		if (atheme_object(chan)->metadata != NULL)
 		{
-			mowgli_patricia_iteration_state_t state2;
+			struct metadata_iteration_state state2;
 			struct metadata *md;
 
-			MOWGLI_PATRICIA_FOREACH(md, &state2, atheme_object(chan)->metadata)
+			METADATA_FOREACH(md, &state2, chan)
 			{
 				db_start_row(db, "CFMD");
 				db_write_word(db, chan->name);
@@ -384,6 +715,8 @@ db_h_cfop(struct database_handle *db, const char *type)
 	orec->lastevent = lastevent;
 
 	orec->age = age;
+
+	chanfix_oprecord_index(orec);
 }
 
 static void
@@ -406,18 +739,29 @@ chanfix_gather_init(struct chanfix_persist_record *rec)
 	hook_add_db_write(write_chanfixdb);
 	hook_add_channel_add(chanfix_channel_add_ev);
 	hook_add_channel_delete(chanfix_channel_delete_ev);
+	hook_add_channel_join(chanfix_channel_join_ev);
+	hook_add_channel_part(chanfix_channel_part_ev);
+	hook_add_channel_split(chanfix_channel_split_ev);
+	hook_add_user_delete(chanfix_user_delete_ev);
+	hook_add_channel_mode_change(chanfix_channel_mode_change_ev);
 
 	db_register_type_handler("CFDBV", db_h_cfdbv);
 	db_register_type_handler("CFCHAN", db_h_cfchan);
 	db_register_type_handler("CFOP", db_h_cfop);
 	db_register_type_handler("CFMD", db_h_cfmd);
 
+	// the same tags are handed back after a reload, counts and all
+	chanfix_channel_memtag = memtag_get("chanfix/main", "channels");
+	chanfix_oprecord_memtag = memtag_get("chanfix/main", "oprecords");
+
 	if (rec != NULL)
 	{
 		chanfix_channel_heap = rec->chanfix_channel_heap;
 		chanfix_oprecord_heap = rec->chanfix_oprecord_heap;
 
 		chanfix_channels = rec->chanfix_channels;
+		chanfix_opped_channels = rec->chanfix_opped_channels;
+		chanfix_gather_passes = rec->chanfix_gather_passes;
 		return;
 	}
 
@@ -436,6 +780,11 @@ chanfix_gather_deinit(const enum module_unload_intent intent, struct chanfix_per
 	hook_del_db_write(write_chanfixdb);
 	hook_del_channel_add(chanfix_channel_add_ev);
 	hook_del_channel_delete(chanfix_channel_delete_ev);
+	hook_del_channel_join(chanfix_channel_join_ev);
+	hook_del_channel_part(chanfix_channel_part_ev);
+	hook_del_channel_split(chanfix_channel_split_ev);
+	hook_del_user_delete(chanfix_user_delete_ev);
+	hook_del_channel_mode_change(chanfix_channel_mode_change_ev);
 
 	db_unregister_type_handler("CFDBV");
 	db_unregister_type_handler("CFCHAN");
@@ -451,6 +800,8 @@ chanfix_gather_deinit(const enum module_unload_intent intent, struct chanfix_per
 			rec->chanfix_oprecord_heap = chanfix_oprecord_heap;
 
 			rec->chanfix_channels = chanfix_channels;
+			rec->chanfix_opped_channels = chanfix_opped_channels;
+			rec->chanfix_gather_passes = chanfix_gather_passes;
 			break;
 
 		case MODULE_UNLOAD_INTENT_PERM:
@@ -458,6 +809,9 @@ chanfix_gather_deinit(const enum module_unload_intent intent, struct chanfix_per
 
 			mowgli_heap_destroy(chanfix_channel_heap);
 			mowgli_heap_destroy(chanfix_oprecord_heap);
+
+			memtag_release(chanfix_channel_memtag);
+			memtag_release(chanfix_oprecord_memtag);
 			break;
 	}
 }
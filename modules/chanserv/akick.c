@@ -18,15 +18,14 @@ struct akick_timeout
 
 	char host[NICKLEN + 1 + USERLEN + 1 + HOSTLEN + 1 + 4];
 
+	struct deadline *deadline;
 	mowgli_node_t node;
 };
 
-static time_t akickdel_next;
 static mowgli_list_t akickdel_list;
 
 static mowgli_heap_t *akick_timeout_heap = NULL;
 static mowgli_patricia_t *cs_akick_cmds = NULL;
-static mowgli_eventloop_timer_t *akick_timeout_check_timer = NULL;
 
 static void
 clear_bans_matching_entity(struct mychan *mc, struct myentity *mt)
@@ -103,92 +102,73 @@ cs_cmd_akick(struct sourceinfo *const restrict si, const int parc, char **const
 	(void) subcommand_dispatch_simple(chansvs.me, si, parc, parv, cs_akick_cmds, "AKICK");
 }
 
-static struct akick_timeout *
-akick_add_timeout(struct mychan *mc, struct myentity *mt, const char *host, time_t expireson)
+static void
+akick_timeout_free(struct akick_timeout *timeout)
 {
-	mowgli_node_t *n;
-	struct akick_timeout *timeout, *timeout2;
+	if (timeout->deadline != NULL)
+		deadline_delete(timeout->deadline);
 
-	timeout = mowgli_heap_alloc(akick_timeout_heap);
+	mowgli_node_delete(&timeout->node, &akickdel_list);
+	mowgli_heap_free(akick_timeout_heap, timeout);
+}
 
-	timeout->entity = mt;
-	timeout->chan = mc;
-	timeout->expiration = expireson;
+static void
+akick_timeout_expire(void *arg)
+{
+	struct akick_timeout *timeout = arg;
+	struct mychan *mc = timeout->chan;
+	struct chanacs *ca = NULL;
+	struct chanban *cb;
 
-	mowgli_strlcpy(timeout->host, host, sizeof timeout->host);
+	// the deadline has already fired and been freed
+	timeout->deadline = NULL;
 
-	MOWGLI_ITER_FOREACH_PREV(n, akickdel_list.tail)
+	if (timeout->entity == NULL)
 	{
-		timeout2 = n->data;
-		if (timeout2->expiration <= timeout->expiration)
-			break;
+		if ((ca = chanacs_find_host_literal(mc, timeout->host, CA_AKICK)) && mc->chan != NULL && (cb = chanban_find(mc->chan, ca->host, 'b')))
+		{
+			modestack_mode_param(chansvs.nick, mc->chan, MTYPE_DEL, cb->type, cb->mask);
+			chanban_delete(cb);
+		}
 	}
-	if (n == NULL)
-		mowgli_node_add_head(timeout, &timeout->node, &akickdel_list);
-	else if (n->next == NULL)
-		mowgli_node_add(timeout, &timeout->node, &akickdel_list);
 	else
-		mowgli_node_add_before(timeout, &timeout->node, &akickdel_list, n->next);
-
-	return timeout;
-}
+	{
+		ca = chanacs_find_literal(mc, timeout->entity, CA_AKICK);
+		if (ca == NULL)
+		{
+			akick_timeout_free(timeout);
+			return;
+		}
 
-static void
-akick_timeout_check(void *arg)
-{
-	mowgli_node_t *n, *tn;
-	struct akick_timeout *timeout;
-	struct chanacs *ca;
-	struct mychan *mc;
+		clear_bans_matching_entity(mc, timeout->entity);
+	}
 
-	struct chanban *cb;
-	akickdel_next = 0;
+	akick_timeout_free(timeout);
 
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, akickdel_list.head)
+	if (ca)
 	{
-		timeout = n->data;
-		mc = timeout->chan;
-
-		if (timeout->expiration > CURRTIME)
-		{
-			akickdel_next = timeout->expiration;
-			akick_timeout_check_timer = mowgli_timer_add_once(base_eventloop, "akick_timeout_check", akick_timeout_check, NULL, akickdel_next - CURRTIME);
-			break;
-		}
+		chanacs_modify_simple(ca, 0, CA_AKICK, NULL);
+		chanacs_close(ca);
+	}
+}
 
-		ca = NULL;
+static struct akick_timeout *
+akick_add_timeout(struct mychan *mc, struct myentity *mt, const char *host, time_t expireson)
+{
+	struct akick_timeout *timeout;
 
-		if (timeout->entity == NULL)
-		{
-			if ((ca = chanacs_find_host_literal(mc, timeout->host, CA_AKICK)) && mc->chan != NULL && (cb = chanban_find(mc->chan, ca->host, 'b')))
-			{
-				modestack_mode_param(chansvs.nick, mc->chan, MTYPE_DEL, cb->type, cb->mask);
-				chanban_delete(cb);
-			}
-		}
-		else
-		{
-			ca = chanacs_find_literal(mc, timeout->entity, CA_AKICK);
-			if (ca == NULL)
-			{
-				mowgli_node_delete(&timeout->node, &akickdel_list);
-				mowgli_heap_free(akick_timeout_heap, timeout);
+	timeout = mowgli_heap_alloc(akick_timeout_heap);
 
-				continue;
-			}
+	timeout->entity = mt;
+	timeout->chan = mc;
+	timeout->expiration = expireson;
 
-			clear_bans_matching_entity(mc, timeout->entity);
-		}
+	mowgli_strlcpy(timeout->host, host, sizeof timeout->host);
 
-		if (ca)
-		{
-			chanacs_modify_simple(ca, 0, CA_AKICK, NULL);
-			chanacs_close(ca);
-		}
+	mowgli_node_add(timeout, &timeout->node, &akickdel_list);
+	timeout->deadline = deadline_add("akick_timeout_expire", akick_timeout_expire, timeout, expireson);
 
-		mowgli_node_delete(&timeout->node, &akickdel_list);
-		mowgli_heap_free(akick_timeout_heap, timeout);
-	}
+	return timeout;
 }
 
 static void
@@ -363,7 +343,6 @@ cs_cmd_akick_add(struct sourceinfo *si, int parc, char *parv[])
 
 		if (duration > 0)
 		{
-			struct akick_timeout *timeout;
 			time_t expireson = ca2->tmodified+duration;
 
 			snprintf(expiry, sizeof expiry, "%ld", expireson);
@@ -373,16 +352,7 @@ cs_cmd_akick_add(struct sourceinfo *si, int parc, char *parv[])
 			logcommand(si, CMDLOG_SET, "AKICK:ADD: \2%s\2 on \2%s\2, expires in %s.", uname, mc->name,timediff(duration));
 			command_success_nodata(si, _("AKICK on \2%s\2 was successfully added for \2%s\2 and will expire in %s."), uname, mc->name,timediff(duration) );
 
-			timeout = akick_add_timeout(mc, NULL, uname, expireson);
-
-			if (akickdel_next == 0 || akickdel_next > timeout->expiration)
-			{
-				if (akickdel_next != 0)
-					mowgli_timer_destroy(base_eventloop, akick_timeout_check_timer);
-
-				akickdel_next = timeout->expiration;
-				akick_timeout_check_timer = mowgli_timer_add_once(base_eventloop, "akick_timeout_check", akick_timeout_check, NULL, akickdel_next - CURRTIME);
-			}
+			(void) akick_add_timeout(mc, NULL, uname, expireson);
 		}
 		else
 		{
@@ -429,7 +399,6 @@ cs_cmd_akick_add(struct sourceinfo *si, int parc, char *parv[])
 
 		if (duration > 0)
 		{
-			struct akick_timeout *timeout;
 			time_t expireson = ca2->tmodified+duration;
 
 			snprintf(expiry, sizeof expiry, "%ld", expireson);
@@ -439,16 +408,7 @@ cs_cmd_akick_add(struct sourceinfo *si, int parc, char *parv[])
 			verbose(mc, "\2%s\2 added \2%s\2 to the AKICK list, expires in %s.", get_source_name(si), mt->name, timediff(duration));
 			logcommand(si, CMDLOG_SET, "AKICK:ADD: \2%s\2 on \2%s\2, expires in %s", mt->name, mc->name, timediff(duration));
 
-			timeout = akick_add_timeout(mc, mt, mt->name, expireson);
-
-			if (akickdel_next == 0 || akickdel_next > timeout->expiration)
-			{
-				if (akickdel_next != 0)
-					mowgli_timer_destroy(base_eventloop, akick_timeout_check_timer);
-
-				akickdel_next = timeout->expiration;
-				akick_timeout_check_timer = mowgli_timer_add_once(base_eventloop, "akick_timeout_check", akick_timeout_check, NULL, akickdel_next - CURRTIME);
-			}
+			(void) akick_add_timeout(mc, mt, mt->name, expireson);
 		}
 		else
 		{
@@ -537,10 +497,7 @@ cs_cmd_akick_del(struct sourceinfo *si, int parc, char *parv[])
 		{
 			timeout = n->data;
 			if (!match(timeout->host, uname) && timeout->chan == mc)
-			{
-				mowgli_node_delete(&timeout->node, &akickdel_list);
-				mowgli_heap_free(akick_timeout_heap, timeout);
-			}
+				akick_timeout_free(timeout);
 		}
 
 		if (mc->chan != NULL && (cb = chanban_find(mc->chan, uname, 'b')))
@@ -564,10 +521,7 @@ cs_cmd_akick_del(struct sourceinfo *si, int parc, char *parv[])
 	{
 		timeout = n->data;
 		if (timeout->entity == mt && timeout->chan == mc)
-		{
-			mowgli_node_delete(&timeout->node, &akickdel_list);
-			mowgli_heap_free(akick_timeout_heap, timeout);
-		}
+			akick_timeout_free(timeout);
 	}
 
 	req.ca = ca;
@@ -893,8 +847,10 @@ mod_init(struct module *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	if (akick_timeout_check_timer)
-		(void) mowgli_timer_destroy(base_eventloop, akick_timeout_check_timer);
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, akickdel_list.head)
+		akick_timeout_free(n->data);
 
 	(void) hook_del_chanuser_sync(&chanuser_sync);
 
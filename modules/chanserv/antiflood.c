@@ -33,97 +33,166 @@ struct antiflood_enforce_method_impl
 	void (*unenforce)(struct channel *);
 };
 
-struct flood_message_queue
-{
-	char *name;
-	size_t max;
-	time_t last_used;
-	mowgli_list_t entries;
-};
+/* Each registered channel that has seen messages keeps a ring of the last
+ * ANTIFLOOD_MSG_COUNT of them, and counts of how many entries in the ring
+ * share each message hash and each source. The counts are kept in two small
+ * open-addressed tables, updated as entries enter and leave the ring.
+ *
+ * Sources are only ever current members of the channel: when a member
+ * leaves (part, kick, quit, netsplit or the channel going away) their
+ * entries are handed to the NULL source, so a freed struct user can never
+ * be matched by whoever is allocated at the same address next.
+ */
+#define ANTIFLOOD_MSG_COUNT     10U
+#define ANTIFLOOD_COUNT_SLOTS   32U     // power of 2, comfortably above ANTIFLOOD_MSG_COUNT
 
 struct flood_message
 {
-	stringref source;
-	char *message;
+	const struct user *source;      // a member of the channel, or NULL
+	uint32_t hash;
 	time_t time;
+};
+
+struct flood_count
+{
+	uintptr_t key;
+	unsigned int count;             // 0 if the slot is free
+};
+
+struct flood_message_queue
+{
+	struct mychan *mc;
+	time_t last_used;
+	struct deadline *unenforce;
 	mowgli_node_t node;
+
+	size_t head;                    // next slot to write; the oldest entry once full
+	size_t len;
+	struct flood_message ring[ANTIFLOOD_MSG_COUNT];
+
+	struct flood_count hashes[ANTIFLOOD_COUNT_SLOTS];
+	struct flood_count sources[ANTIFLOOD_COUNT_SLOTS];
 };
 
 static struct chanban *(*place_quietmask)(struct channel *, int, const char *) = NULL;
 
 static enum antiflood_enforce_method antiflood_enforce_method = ANTIFLOOD_ENFORCE_QUIET;
 
-static mowgli_heap_t *msg_heap = NULL;
 static mowgli_heap_t *mqueue_heap = NULL;
-static mowgli_patricia_t *mqueue_trie = NULL;
+static struct memtag *mqueue_memtag = NULL;
+static mowgli_list_t mqueue_list;
 static mowgli_patricia_t **cs_set_cmdtree = NULL;
 static mowgli_eventloop_timer_t *mqueue_gc_timer = NULL;
-static mowgli_eventloop_timer_t *antiflood_unenforce_timer = NULL;
 
 static time_t antiflood_msg_time = SECONDS_PER_MINUTE;
-static size_t antiflood_msg_count = 10;
 
-static void
-msg_destroy(struct flood_message *mesg, struct flood_message_queue *mq)
+// case-insensitive FNV-1a, so that messages differing only in case match
+static uint32_t
+msg_hash(const char *message)
 {
-	sfree(mesg->message);
-	strshare_unref(mesg->source);
-	mowgli_node_delete(&mesg->node, &mq->entries);
+	uint32_t hash = 0x811C9DC5U;
 
-	mowgli_heap_free(msg_heap, mesg);
+	for (; *message != '\0'; message++)
+	{
+		hash ^= (uint32_t) tolower((unsigned char) *message);
+		hash *= 0x01000193U;
+	}
+
+	return hash;
 }
 
-static struct flood_message *
-msg_create(struct flood_message_queue *mq, struct user *u, const char *message)
+static inline size_t
+count_slot(uintptr_t key)
 {
-	struct flood_message *mesg;
+	uint64_t k = key;
 
-	mesg = mowgli_heap_alloc(msg_heap);
-	mesg->message = sstrdup(message);
-	mesg->time = CURRTIME;
-	mesg->source = u->uid != NULL ? strshare_ref(u->uid) : strshare_ref(u->nick);
+	k ^= k >> 33;
+	k *= UINT64_C(0xFF51AFD7ED558CCD);
+	k ^= k >> 33;
 
-	if (MOWGLI_LIST_LENGTH(&mq->entries) > mq->max)
-	{
-		struct flood_message *head_mesg = mq->entries.head->data;
-		msg_destroy(head_mesg, mq);
-	}
+	return (size_t) (k & (ANTIFLOOD_COUNT_SLOTS - 1));
+}
 
-	mowgli_node_add(mesg, &mesg->node, &mq->entries);
-	mq->last_used = CURRTIME;
+static struct flood_count *
+count_find(struct flood_count *table, uintptr_t key)
+{
+	size_t i;
 
-	return mesg;
+	for (i = count_slot(key); table[i].count; i = (i + 1) & (ANTIFLOOD_COUNT_SLOTS - 1))
+		if (table[i].key == key)
+			return &table[i];
+
+	return &table[i];
 }
 
-static struct flood_message_queue *
-mqueue_create(const char *name)
+static unsigned int
+count_get(struct flood_count *table, uintptr_t key)
 {
-	struct flood_message_queue *mq;
-
-	mq = mowgli_heap_alloc(mqueue_heap);
-	mq->name = sstrdup(name);
-	mq->last_used = CURRTIME;
-	mq->max = antiflood_msg_count;
+	return count_find(table, key)->count;
+}
 
-	mowgli_patricia_add(mqueue_trie, mq->name, mq);
+static void
+count_add(struct flood_count *table, uintptr_t key)
+{
+	struct flood_count *fc = count_find(table, key);
 
-	return mq;
+	fc->key = key;
+	fc->count++;
 }
 
 static void
-mqueue_free(struct flood_message_queue *mq)
+count_del(struct flood_count *table, uintptr_t key)
 {
-	mowgli_node_t *n, *tn;
+	struct flood_count *fc = count_find(table, key);
+	size_t i, j, k;
+
+	return_if_fail(fc->count != 0);
+
+	if (--fc->count)
+		return;
 
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, mq->entries.head)
+	/* Close the gap by moving back any later entry in the same run that
+	 * could not otherwise be found from its home slot.
+	 */
+	i = (size_t) (fc - table);
+
+	for (j = (i + 1) & (ANTIFLOOD_COUNT_SLOTS - 1); table[j].count; j = (j + 1) & (ANTIFLOOD_COUNT_SLOTS - 1))
 	{
-		struct flood_message *mesg = n->data;
+		k = count_slot(table[j].key);
 
-		msg_destroy(mesg, mq);
+		if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j))
+		{
+			table[i] = table[j];
+			table[j].count = 0;
+			i = j;
+		}
 	}
+}
 
-	sfree(mq->name);
-	mowgli_heap_free(mqueue_heap, mq);
+static struct flood_message *
+msg_create(struct flood_message_queue *mq, struct user *u, const char *message)
+{
+	struct flood_message *mesg = &mq->ring[mq->head];
+
+	if (mq->len == ANTIFLOOD_MSG_COUNT)
+	{
+		count_del(mq->hashes, mesg->hash);
+		count_del(mq->sources, (uintptr_t) mesg->source);
+	}
+	else
+		mq->len++;
+
+	mesg->source = u;
+	mesg->hash = msg_hash(message);
+	mesg->time = CURRTIME;
+
+	count_add(mq->hashes, mesg->hash);
+	count_add(mq->sources, (uintptr_t) mesg->source);
+
+	mq->head = (mq->head + 1) % ANTIFLOOD_MSG_COUNT;
+	mq->last_used = CURRTIME;
+
+	return mesg;
 }
 
 static struct flood_message_queue *
@@ -131,9 +200,17 @@ mqueue_get(struct mychan *mc)
 {
 	struct flood_message_queue *mq;
 
-	mq = mowgli_patricia_retrieve(mqueue_trie, mc->name);
-	if (mq == NULL)
-		mq = mqueue_create(mc->name);
+	if (mc->antiflood != NULL)
+		return mc->antiflood;
+
+	mq = mowgli_heap_alloc(mqueue_heap);
+	memtag_alloc(mqueue_memtag, sizeof *mq);
+
+	mq->mc = mc;
+	mq->last_used = CURRTIME;
+
+	mowgli_node_add(mq, &mq->node, &mqueue_list);
+	mc->antiflood = mq;
 
 	return mq;
 }
@@ -141,77 +218,87 @@ mqueue_get(struct mychan *mc)
 static void
 mqueue_destroy(struct flood_message_queue *mq)
 {
-	mowgli_patricia_delete(mqueue_trie, mq->name);
+	if (mq->unenforce != NULL)
+		deadline_delete(mq->unenforce);
+
+	mq->mc->antiflood = NULL;
 
-	mqueue_free(mq);
+	mowgli_node_delete(&mq->node, &mqueue_list);
+	memtag_free(mqueue_memtag, sizeof *mq);
+	mowgli_heap_free(mqueue_heap, mq);
 }
 
 static void
-mqueue_trie_destroy_cb(const char *key, void *data, void *privdata)
+mqueue_gc(void *unused)
 {
-	struct flood_message_queue *mq = data;
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, mqueue_list.head)
+	{
+		struct flood_message_queue *mq = n->data;
+
+		// keep queues around until their bans have been lifted
+		if (mq->unenforce != NULL)
+			continue;
 
-	mqueue_free(mq);
+		if ((mq->last_used + SECONDS_PER_HOUR) < CURRTIME)
+			mqueue_destroy(mq);
+	}
 }
 
+// hand the entries of one source (or every source, if u is NULL) to NULL
 static void
-mqueue_gc(void *unused)
+mqueue_forget(struct flood_message_queue *mq, const struct user *u)
 {
-	mowgli_patricia_iteration_state_t iter;
-	struct flood_message_queue *mq;
+	size_t i;
 
-	MOWGLI_PATRICIA_FOREACH(mq, &iter, mqueue_trie)
+	for (i = 0; i < mq->len; i++)
 	{
-		if ((mq->last_used + SECONDS_PER_HOUR) < CURRTIME)
-			mqueue_destroy(mq);
+		struct flood_message *mesg = &mq->ring[i];
+
+		if (mesg->source == NULL || (u != NULL && mesg->source != u))
+			continue;
+
+		count_del(mq->sources, (uintptr_t) mesg->source);
+		count_add(mq->sources, (uintptr_t) NULL);
+		mesg->source = NULL;
 	}
 }
 
 static enum mqueue_enforce_strategy
-mqueue_should_enforce(struct flood_message_queue *mq)
+mqueue_should_enforce(struct flood_message_queue *mq, const struct flood_message *newest)
 {
-	struct flood_message *oldest, *newest;
-	time_t age_delta;
+	const struct flood_message *oldest;
+	unsigned int usr_matches;
+	size_t i;
 
-	if (MOWGLI_LIST_LENGTH(&mq->entries) < mq->max)
+	if (mq->len < ANTIFLOOD_MSG_COUNT)
 		return MQ_ENFORCE_NONE;
 
-	oldest = mq->entries.head->data;
-	newest = mq->entries.tail->data;
+	oldest = &mq->ring[mq->head];
 
-	if (oldest == NULL || newest == NULL || oldest == newest)
+	if (newest->time - oldest->time > antiflood_msg_time)
 		return MQ_ENFORCE_NONE;
 
-	age_delta = newest->time - oldest->time;
-
-	if (age_delta <= antiflood_msg_time)
-	{
-		mowgli_node_t *n;
-		size_t msg_matches = 0, usr_matches = 0;
-		time_t usr_first_seen = 0;
+	if (count_get(mq->hashes, newest->hash) > (ANTIFLOOD_MSG_COUNT / 2))
+		return MQ_ENFORCE_MSG;
 
-		MOWGLI_ITER_FOREACH(n, mq->entries.head)
-		{
-			struct flood_message *mesg = n->data;
-
-			if (!strcasecmp(mesg->message, newest->message))
-				msg_matches++;
-
-			if (mesg->source == newest->source)
-			{
-				usr_matches++;
+	usr_matches = count_get(mq->sources, (uintptr_t) newest->source);
+	if (usr_matches <= (ANTIFLOOD_MSG_COUNT / 2))
+		return MQ_ENFORCE_NONE;
 
-				if (!usr_first_seen)
-					usr_first_seen = mesg->time;
-			}
-		}
+	// only now look for when this source first appears in the ring
+	for (i = 0; i < ANTIFLOOD_MSG_COUNT; i++)
+	{
+		const struct flood_message *mesg = &mq->ring[(mq->head + i) % ANTIFLOOD_MSG_COUNT];
 
-		if (msg_matches > (antiflood_msg_count / 2))
-			return MQ_ENFORCE_MSG;
+		if (mesg->source != newest->source)
+			continue;
 
-		if (usr_matches > (antiflood_msg_count / 2) &&
-			((newest->time - usr_first_seen) < antiflood_msg_time / 4))
+		if ((newest->time - mesg->time) < antiflood_msg_time / 4)
 			return MQ_ENFORCE_LINE;
+
+		break;
 	}
 
 	return MQ_ENFORCE_NONE;
@@ -310,21 +397,21 @@ antiflood_enforce_method_impl_get(struct mychan *mc)
 }
 
 static void
-antiflood_unenforce_timer_cb(void *unused)
+antiflood_unenforce_cb(void *arg)
 {
-	mowgli_patricia_iteration_state_t state;
-	struct mychan *mc;
+	struct flood_message_queue *mq = arg;
+	const struct antiflood_enforce_method_impl *enf;
+	struct mychan *mc = mq->mc;
 
-	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
-	{
-		const struct antiflood_enforce_method_impl *enf = antiflood_enforce_method_impl_get(mc);
+	mq->unenforce = NULL;
 
-		if (mc->chan == NULL)
-			continue;
+	if (mc->chan == NULL)
+		return;
 
-		if (enf->unenforce != NULL)
-			enf->unenforce(mc->chan);
-	}
+	enf = antiflood_enforce_method_impl_get(mc);
+
+	if (enf->unenforce != NULL)
+		enf->unenforce(mc->chan);
 }
 
 static void
@@ -333,6 +420,7 @@ on_channel_message(struct hook_channel_message *data)
 	struct chanuser *cu;
 	struct mychan *mc;
 	struct flood_message_queue *mq;
+	struct flood_message *mesg;
 
 	return_if_fail(data != NULL);
 	return_if_fail(data->msg != NULL);
@@ -348,9 +436,7 @@ on_channel_message(struct hook_channel_message *data)
 		return;
 
 	mq = mqueue_get(mc);
-	return_if_fail(mq != NULL);
-
-	msg_create(mq, data->u, data->msg);
+	mesg = msg_create(mq, data->u, data->msg);
 
 	// never enforce against any user who has special CSTATUS flags.
 	if (cu->modes)
@@ -360,7 +446,7 @@ on_channel_message(struct hook_channel_message *data)
 	if (!(mc->flags & MC_ANTIFLOOD))
 		return;
 
-	if (mqueue_should_enforce(mq) != MQ_ENFORCE_NONE)
+	if (mqueue_should_enforce(mq, mesg) != MQ_ENFORCE_NONE)
 	{
 		const struct antiflood_enforce_method_impl *enf = antiflood_enforce_method_impl_get(mc);
 
@@ -368,18 +454,64 @@ on_channel_message(struct hook_channel_message *data)
 			return;
 
 		enf->enforce(data->u, data->c);
+
+		// lift the bans an hour after the flood stops
+		if (enf->unenforce == NULL)
+			return;
+
+		if (mq->unenforce != NULL)
+			deadline_move(mq->unenforce, CURRTIME + SECONDS_PER_HOUR);
+		else
+			mq->unenforce = deadline_add("antiflood_unenforce", antiflood_unenforce_cb, mq, CURRTIME + SECONDS_PER_HOUR);
 	}
 }
 
 static void
-on_channel_drop(struct mychan *mc)
+on_channel_part(struct hook_channel_joinpart *hdata)
+{
+	struct mychan *mc;
+
+	if (hdata->cu == NULL || (mc = mychan_from(hdata->cu->chan)) == NULL || mc->antiflood == NULL)
+		return;
+
+	mqueue_forget(mc->antiflood, hdata->cu->user);
+}
+
+static void
+on_channel_split(struct hook_channel_split *hdata)
 {
 	struct flood_message_queue *mq;
+	struct mychan *mc;
+	size_t i;
 
-	mq = mqueue_get(mc);
-	return_if_fail(mq != NULL);
+	if ((mc = mychan_from(hdata->chan)) == NULL || (mq = mc->antiflood) == NULL)
+		return;
+
+	// every non-NULL source is still a member here, so safe to look at
+	for (i = 0; i < mq->len; i++)
+	{
+		const struct user *u = mq->ring[i].source;
 
-	mqueue_destroy(mq);
+		if (u != NULL && (u->server->flags & SF_SPLITTING))
+			mqueue_forget(mq, u);
+	}
+}
+
+// members of a channel being destroyed are removed without a part event
+static void
+on_channel_delete(struct channel *c)
+{
+	struct mychan *mc;
+
+	if ((mc = mychan_from(c)) != NULL && mc->antiflood != NULL)
+		mqueue_forget(mc->antiflood, NULL);
+}
+
+static void
+on_channel_drop(struct mychan *mc)
+{
+	if (mc->antiflood != NULL)
+		mqueue_destroy(mc->antiflood);
 }
 
 static void
@@ -511,16 +643,15 @@ mod_init(struct module *m)
 	}
 
 	hook_add_channel_message(on_channel_message);
+	hook_add_channel_part(on_channel_part);
+	hook_add_channel_split(on_channel_split);
+	hook_add_channel_delete(on_channel_delete);
 	hook_add_channel_drop(on_channel_drop);
 
-	msg_heap = sharedheap_get(sizeof(struct flood_message));
-
 	mqueue_heap = sharedheap_get(sizeof(struct flood_message_queue));
-	mqueue_trie = mowgli_patricia_create(irccasecanon);
+	mqueue_memtag = memtag_get(m->name, "mqueues");
 	mqueue_gc_timer = mowgli_timer_add(base_eventloop, "mqueue_gc", mqueue_gc, NULL, 5 * SECONDS_PER_MINUTE);
 
-	antiflood_unenforce_timer = mowgli_timer_add(base_eventloop, "antiflood_unenforce", antiflood_unenforce_timer_cb, NULL, SECONDS_PER_HOUR);
-
 	command_add(&cs_set_antiflood, *cs_set_cmdtree);
 
 	add_conf_item("ANTIFLOOD_ENFORCE_METHOD", &chansvs.me->conf_table, c_ci_antiflood_enforce_method);
@@ -529,14 +660,22 @@ mod_init(struct module *m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
+	mowgli_node_t *n, *tn;
+
 	command_delete(&cs_set_antiflood, *cs_set_cmdtree);
 
 	hook_del_channel_message(on_channel_message);
+	hook_del_channel_part(on_channel_part);
+	hook_del_channel_split(on_channel_split);
+	hook_del_channel_delete(on_channel_delete);
 	hook_del_channel_drop(on_channel_drop);
 
-	mowgli_patricia_destroy(mqueue_trie, mqueue_trie_destroy_cb, NULL);
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, mqueue_list.head)
+		mqueue_destroy(n->data);
+
+	memtag_release(mqueue_memtag);
+
 	mowgli_timer_destroy(base_eventloop, mqueue_gc_timer);
-	mowgli_timer_destroy(base_eventloop, antiflood_unenforce_timer);
 
 	del_conf_item("ANTIFLOOD_ENFORCE_METHOD", &chansvs.me->conf_table);
 }
@@ -14,7 +14,7 @@ cs_cmd_clone(struct sourceinfo *si, int parc, char *parv[])
 {
 	struct mychan *mc, *mc2;
 	mowgli_node_t *n, *tn;
-	mowgli_patricia_iteration_state_t state;
+	struct metadata_iteration_state state;
 	struct metadata *md;
 	struct chanacs *ca;
 	char *source = parv[0];
@@ -104,7 +104,7 @@ cs_cmd_clone(struct sourceinfo *si, int parc, char *parv[])
 	}
 
 	// Copy ze metadata!
-	MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mc)->metadata)
+	METADATA_FOREACH(md, &state, mc)
 	{
 		if(!strncmp(md->name, "private:topic:", 14))
 		{
@@ -446,7 +446,12 @@ cs_join(struct hook_channel_joinpart *hdata)
 	}
 
 	if (flags & CA_USEDUPDATE)
+	{
 		mc->used = CURRTIME;
+
+		// an access holder is here now, keep the last used time fresh
+		mychan_expiry_update(mc);
+	}
 }
 
 static void
@@ -501,6 +506,54 @@ cs_part(struct hook_channel_joinpart *hdata)
 	part(cu->chan->name, chansvs.nick);
 }
 
+static void
+cs_split(struct hook_channel_split *hdata)
+{
+	struct channel *c = hdata->chan;
+	struct chanuser *cu;
+	struct mychan *mc;
+	mowgli_node_t *n;
+
+	mc = mychan_from(c);
+	if (mc == NULL)
+		return;
+	if (metadata_find(mc, "private:botserv:bot-assigned") != NULL)
+		return;
+
+	// one access holder going away is enough to mark the channel as used
+	if ((CURRTIME - mc->used) >= SECONDS_PER_HOUR)
+	{
+		MOWGLI_ITER_FOREACH(n, c->members.head)
+		{
+			cu = n->data;
+
+			if (!(cu->user->server->flags & SF_SPLITTING))
+				continue;
+
+			if (chanacs_user_flags(mc, cu->user) & CA_USEDUPDATE)
+			{
+				mc->used = CURRTIME;
+				break;
+			}
+		}
+	}
+
+	// same rules as cs_part(), for everyone that is splitting at once
+	if (!config_options.leave_chans)
+		return;
+
+	if (c->nummembers - c->numsvcmembers > hdata->parting)
+		return;
+
+	if (mc->flags & MC_INHABIT)
+	{
+		slog(LG_DEBUG, "cs_split(): not leaving channel %s due to MC_INHABIT flag", mc->name);
+		return;
+	}
+
+	part(c->name, chansvs.nick);
+}
+
 static struct user *
 get_changets_user(struct mychan *mc)
 {
@@ -828,6 +881,7 @@ mod_init(struct module ATHEME_VATTR_UNUSED *const restrict m)
 
 	hook_add_channel_join(cs_join);
 	hook_add_channel_part(cs_part);
+	hook_add_channel_split(cs_split);
 	hook_add_channel_register(cs_register);
 	hook_add_channel_succession(cs_succession);
 	hook_add_channel_add(cs_newchan);
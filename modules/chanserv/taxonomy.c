@@ -14,7 +14,7 @@ cs_cmd_taxonomy(struct sourceinfo *si, int parc, char *parv[])
 {
 	char *target = parv[0];
 	struct mychan *mc;
-	mowgli_patricia_iteration_state_t state;
+	struct metadata_iteration_state state;
 	struct metadata *md;
 	bool isoper;
 
@@ -46,7 +46,7 @@ cs_cmd_taxonomy(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_GET, "TAXONOMY: \2%s\2", mc->name);
 	command_success_nodata(si, _("Taxonomy for \2%s\2:"), target);
 
-	MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mc)->metadata)
+	METADATA_FOREACH(md, &state, mc)
 	{
                 if (!strncmp(md->name, "private:", 8) && !isoper)
                         continue;
@@ -42,6 +42,7 @@ gs_cmd_global(struct sourceinfo *si, const int parc, char *parv[])
 	char *params = parv[0];
 	static char *sender = NULL;
 	bool isfirst;
+	struct send_pacing pacing;
 	char buf[BUFSIZE];
 
 	if (!params)
@@ -88,6 +89,7 @@ gs_cmd_global(struct sourceinfo *si, const int parc, char *parv[])
 		}
 
 		isfirst = true;
+		send_pacing_enter(SEND_CLASS_BULK, NULL, &pacing);
 		MOWGLI_ITER_FOREACH(n, globlist.head)
 		{
 			global = (struct global_ *)n->data;
@@ -106,6 +108,7 @@ gs_cmd_global(struct sourceinfo *si, const int parc, char *parv[])
 			// log everything
 			logcommand(si, CMDLOG_ADMIN, "GLOBAL: \2%s\2", global->text);
 		}
+		send_pacing_leave(&pacing);
 		logcommand(si, CMDLOG_ADMIN, "GLOBAL: (\2%zu\2 lines sent)", MOWGLI_LIST_LENGTH(&globlist));
 
 		// destroy the list we made
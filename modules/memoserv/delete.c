@@ -87,6 +87,7 @@ ms_cmd_delete(struct sourceinfo *si, int parc, char *parv[])
 			mowgli_node_delete(n, &si->smu->memos);
 			mowgli_node_free(n);
 
+			memtag_free(&memtag_core[MEMTAG_MEMOS], sizeof *memo);
 			sfree(memo);
 		}
 
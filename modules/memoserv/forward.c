@@ -131,6 +131,7 @@ ms_cmd_forward(struct sourceinfo *si, int parc, char *parv[])
 			// should have some function for send here...  ask nenolod
 			memo = (struct mymemo *)n->data;
 			newmemo = smalloc(sizeof *newmemo);
+			memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *newmemo);
 
 			// Create memo
 			newmemo->sent = CURRTIME;
@@ -84,6 +84,7 @@ ms_cmd_read(struct sourceinfo *si, int parc, char *parv[])
 					{
 						// Malloc and populate memo struct
 						receipt = smalloc(sizeof *receipt);
+						memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *receipt);
 						receipt->sent = CURRTIME;
 						mowgli_strlcpy(receipt->sender, si->service->nick, sizeof receipt->sender);
 						snprintf(receipt->text, sizeof receipt->text, "%s has read a memo from you sent at %s", entity(si->smu)->name, strfbuf);
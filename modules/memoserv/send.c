@@ -122,6 +122,7 @@ ms_cmd_send(struct sourceinfo *si, int parc, char *parv[])
 
 		// Malloc and populate struct
 		memo = smalloc(sizeof *memo);
+		memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *memo);
 		memo->sent = CURRTIME;
 		mowgli_strlcpy(memo->sender, entity(si->smu)->name, sizeof memo->sender);
 		mowgli_strlcpy(memo->text, m, sizeof memo->text);
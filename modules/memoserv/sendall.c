@@ -22,6 +22,7 @@ ms_cmd_sendall(struct sourceinfo *si, int parc, char *parv[])
 	bool ignored;
 	struct service *memoserv;
 	struct myentity_iteration_state state;
+	struct send_pacing pacing;
 
 	// Grab args
 	char *m = parv[0];
@@ -72,6 +73,9 @@ ms_cmd_sendall(struct sourceinfo *si, int parc, char *parv[])
 	si->smu->memo_ratelimit_num++;
 	si->smu->memo_ratelimit_time = CURRTIME;
 
+	// the new-memo notices go out as bulk output, behind other users' replies
+	send_pacing_enter(SEND_CLASS_BULK, NULL, &pacing);
+
 	MYENTITY_FOREACH_T(mt, &state, ENT_USER)
 	{
 		struct myuser *tmu = user(mt);
@@ -114,6 +118,7 @@ ms_cmd_sendall(struct sourceinfo *si, int parc, char *parv[])
 
 		// Malloc and populate struct
 		memo = smalloc(sizeof *memo);
+		memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *memo);
 		memo->sent = CURRTIME;
 		memo->status = MEMO_CHANNEL;
 		mowgli_strlcpy(memo->sender, entity(si->smu)->name, sizeof memo->sender);
@@ -144,6 +149,8 @@ ms_cmd_sendall(struct sourceinfo *si, int parc, char *parv[])
 		              memoserv->disp, MOWGLI_LIST_LENGTH(&tmu->memos));
 	}
 
+	send_pacing_leave(&pacing);
+
 	// Tell user memo sent, return
 	if (sent > 4)
 		command_add_flood(si, FLOOD_HEAVY);
@@ -124,6 +124,7 @@ ms_cmd_sendgroup(struct sourceinfo *si, int parc, char *parv[])
 
 		// Malloc and populate struct
 		memo = smalloc(sizeof *memo);
+		memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *memo);
 		memo->sent = CURRTIME;
 		memo->status = MEMO_CHANNEL;
 		mowgli_strlcpy(memo->sender, entity(si->smu)->name, sizeof memo->sender);
@@ -22,6 +22,7 @@ ms_cmd_sendops(struct sourceinfo *si, int parc, char *parv[])
 	unsigned int sent = 0, tried = 0;
 	bool ignored, operoverride = false;
 	struct service *memoserv;
+	struct send_pacing pacing;
 
 	// Grab args
 	char *target = parv[0];
@@ -88,6 +89,9 @@ ms_cmd_sendops(struct sourceinfo *si, int parc, char *parv[])
 	si->smu->memo_ratelimit_num++;
 	si->smu->memo_ratelimit_time = CURRTIME;
 
+	// the new-memo notices go out as bulk output, behind other users' replies
+	send_pacing_enter(SEND_CLASS_BULK, NULL, &pacing);
+
 	MOWGLI_ITER_FOREACH(tn, mc->chanacs.head)
 	{
 		struct chanacs *ca = (struct chanacs *) tn->data;
@@ -131,6 +135,7 @@ ms_cmd_sendops(struct sourceinfo *si, int parc, char *parv[])
 
 		// Malloc and populate struct
 		memo = smalloc(sizeof *memo);
+		memtag_alloc(&memtag_core[MEMTAG_MEMOS], sizeof *memo);
 		memo->sent = CURRTIME;
 		memo->status = MEMO_CHANNEL;
 		mowgli_strlcpy(memo->sender, entity(si->smu)->name, sizeof memo->sender);
@@ -161,6 +166,8 @@ ms_cmd_sendops(struct sourceinfo *si, int parc, char *parv[])
 		              memoserv->disp, MOWGLI_LIST_LENGTH(&tmu->memos));
 	}
 
+	send_pacing_leave(&pacing);
+
 	// Tell user memo sent, return
 	if (sent > 4)
 		command_add_flood(si, FLOOD_HEAVY);
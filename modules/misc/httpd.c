@@ -9,10 +9,57 @@
 
 #include <atheme.h>
 
-#define REQUEST_MAX 65536 // maximum size of one call
+#define REQUEST_MAX     65536           // maximum size of one call
+#define IDLE_TIMEOUT    300             // seconds without input before an idle connection is closed
+#define CHUNK_BUF_INIT  4096            // initial request buffer for a chunked body
 
-static struct connection *listener = NULL;
-static mowgli_eventloop_timer_t *httpd_checkidle_timer = NULL;
+/* Where a connection is in the request it is reading. Requests are read
+ * one after another off the same connection, so a client may pipeline
+ * them; responses go out in the order the requests came in.
+ */
+enum httpd_state
+{
+	HTTPD_REQUEST_LINE = 0,
+	HTTPD_HEADERS,
+	HTTPD_BODY,
+	HTTPD_CHUNK_SIZE,
+	HTTPD_CHUNK_DATA,
+	HTTPD_CHUNK_END,
+	HTTPD_TRAILERS,
+	HTTPD_CLOSING,                  // no more requests; input is thrown away
+};
+
+struct httpd_listener
+{
+	struct connection *             conn;
+	mowgli_list_t                   idle;           // its connections, least recently active first
+	mowgli_eventloop_timer_t *      timer;
+};
+
+// The transports only know about the struct httpddata at the start of this
+struct httpd_client
+{
+	struct httpddata                hd;
+	struct httpd_listener *         owner;
+	const struct path_handler *     route;          // NULL if the request is for a file
+	enum httpd_state                state;
+	bool                            chunked;
+	size_t                          chunk_left;
+	size_t                          bufsize;        // allocated size of hd.requestbuf
+	mowgli_node_t                   idle_node;
+};
+
+struct httpd_route
+{
+	const struct path_handler *     handler;
+	char *                          path;           // the key it is stored under
+	mowgli_node_t                   node;
+	bool                            legacy;         // added through httpd_path_handlers
+};
+
+static struct httpd_listener *listener = NULL;
+static mowgli_patricia_t *httpd_routes = NULL;
+static mowgli_list_t httpd_route_list;
 
 // conf stuff
 static mowgli_list_t conf_httpd_table;
@@ -23,10 +70,6 @@ static struct {
 	unsigned int port;
 } httpd_config;
 
-// Imported by modules/transport/*rpc/*rpc.so */
-extern mowgli_list_t httpd_path_handlers;
-mowgli_list_t httpd_path_handlers;
-
 static void
 clear_httpddata(struct httpddata *hd)
 {
@@ -62,58 +105,6 @@ open_file(const char *filename)
 	return open(fname, O_RDONLY);
 }
 
-static void
-process_header(struct connection *cptr, char *line)
-{
-	struct httpddata *hd;
-	char *p;
-
-	hd = cptr->userdata;
-	p = strchr(line, ':');
-	if (p == NULL)
-		return;
-	*p = '\0';
-	p++;
-	while (*p == ' ')
-		p++;
-	if (!strcasecmp(line, "Connection"))
-	{
-		p = strtok(p, ", \t");
-		while (p != NULL)
-		{
-			if (!strcasecmp(p, "close"))
-			{
-				slog(LG_DEBUG, "process_header(): Connection: close requested by fd %d", cptr->fd);
-				hd->connection_close = true;
-			}
-			p = strtok(NULL, ", \t");
-		}
-	}
-	else if (!strcasecmp(line, "Content-Length"))
-	{
-		hd->length = atoi(p);
-	}
-	else if (!strcasecmp(line, "Content-Type"))
-	{
-		p = strtok(p, "; \t");
-		hd->correct_content_type = p != NULL && (!strcasecmp(p, "text/xml") || !strcasecmp(p, "application/json"));
-	}
-	else if (!strcasecmp(line, "Expect"))
-	{
-		hd->expect_100_continue = !strcasecmp(p, "100-continue");
-	}
-}
-
-static void
-check_close(struct connection *cptr)
-{
-	struct httpddata *hd;
-
-	hd = cptr->userdata;
-	if (hd->connection_close)
-		sendq_add_eof(cptr);
-}
-
 static void
 send_error(struct connection *cptr, unsigned int errorcode, const char *text, bool sendentity)
 {
@@ -143,6 +134,17 @@ send_error(struct connection *cptr, unsigned int errorcode, const char *text, bo
 	sendq_add(cptr, buf1, strlen(buf1));
 }
 
+// answers with an error and closes the connection once it has been sent
+static bool
+send_fatal(struct connection *cptr, struct httpd_client *client, unsigned int errorcode, const char *text)
+{
+	send_error(cptr, errorcode, text, true);
+	sendq_add_eof(cptr);
+
+	client->state = HTTPD_CLOSING;
+	return true;
+}
+
 static const char *
 content_type(const char *filename)
 {
@@ -168,60 +170,229 @@ content_type(const char *filename)
 	return "application/octet-stream";
 }
 
+static struct httpd_route *
+httpd_route_find(const struct path_handler *ph)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, httpd_route_list.head)
+	{
+		struct httpd_route *const route = n->data;
+
+		if (route->handler == ph)
+			return route;
+	}
+
+	return NULL;
+}
+
 static void
-httpd_recvqhandler(struct connection *cptr)
+httpd_route_add(const struct path_handler *ph)
 {
-	char buf[BUFSIZE * 2];
-	char outbuf[BUFSIZE * 2];
-	int count;
-	struct httpddata *hd;
-	char *p;
-	int in;
-	struct stat sb;
-	off_t count1;
+	struct httpd_route *route;
+
+	return_if_fail(ph != NULL);
+	return_if_fail(ph->path != NULL);
+	return_if_fail(ph->handler != NULL);
+
+	if ((route = httpd_route_find(ph)) != NULL)
+	{
+		if (!strcmp(route->path, ph->path))
+			return;
+
+		// the handler moved (e.g. its path was changed on rehash)
+		mowgli_patricia_delete(httpd_routes, route->path);
+		sfree(route->path);
+	}
+	else
+	{
+		route = smalloc(sizeof *route);
+		route->handler = ph;
+		mowgli_node_add(route, &route->node, &httpd_route_list);
+	}
+
+	route->path = sstrdup(ph->path);
+
+	if (!mowgli_patricia_add(httpd_routes, route->path, route))
+	{
+		slog(LG_ERROR, "httpd_route_add(): path %s is already handled", route->path);
+		mowgli_node_delete(&route->node, &httpd_route_list);
+		sfree(route->path);
+		sfree(route);
+	}
+}
+
+static void
+httpd_route_del(const struct path_handler *ph)
+{
+	struct httpd_route *route;
 	mowgli_node_t *n;
-	struct path_handler *ph = NULL;
-	bool is_get, is_post, handling_done = false;
 
-	hd = cptr->userdata;
+	return_if_fail(ph != NULL);
+
+	if ((route = httpd_route_find(ph)) == NULL)
+		return;
+
+	mowgli_patricia_delete(httpd_routes, route->path);
+	mowgli_node_delete(&route->node, &httpd_route_list);
+	sfree(route->path);
+	sfree(route);
+
+	if (listener == NULL)
+		return;
+
+	// requests still reading a body for this handler can not be answered any more
+	MOWGLI_ITER_FOREACH(n, listener->conn->children.head)
+	{
+		struct connection *const cptr = n->data;
+		struct httpd_client *const client = cptr->userdata;
+
+		if (client != NULL && client->route == ph && client->state != HTTPD_CLOSING)
+		{
+			client->route = NULL;
+			(void) send_fatal(cptr, client, 503, "Service Unavailable");
+		}
+	}
+}
+
+/* Deprecated; use httpd_core_functions. Transports built against older
+ * versions still put their struct path_handler on this list. The list is
+ * compared with the routes before each request is routed and before its
+ * handler is called: handlers that appeared on it are added as routes, and
+ * those that left it are removed, just as if route_add() and route_del()
+ * had been called.
+ */
+extern mowgli_list_t httpd_path_handlers;
+mowgli_list_t httpd_path_handlers;
+
+static void
+httpd_legacy_sync(void)
+{
+	struct httpd_route *route;
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, httpd_route_list.head)
+	{
+		route = n->data;
+
+		if (route->legacy && mowgli_node_find((void *) route->handler, &httpd_path_handlers) == NULL)
+			httpd_route_del(route->handler);
+	}
 
 	MOWGLI_ITER_FOREACH(n, httpd_path_handlers.head)
 	{
-		ph = (struct path_handler *)n->data;
-		handling_done = !strcmp(hd->filename, ph->path);
+		const struct path_handler *const ph = n->data;
 
-		if (handling_done)
-			break;
+		if ((route = httpd_route_find(ph)) != NULL && !route->legacy)
+			continue;
+
+		httpd_route_add(ph);
+
+		if (route == NULL && (route = httpd_route_find(ph)) != NULL)
+			route->legacy = true;
 	}
+}
+
+extern const struct httpd_core_functions httpd_core_functions;
+const struct httpd_core_functions httpd_core_functions = {
 
-	if (handling_done)
+	.route_add      = &httpd_route_add,
+	.route_del      = &httpd_route_del,
+};
+
+static void
+finish_request(struct connection *cptr, struct httpd_client *client)
+{
+	clear_httpddata(&client->hd);
+
+	client->route = NULL;
+	client->chunked = false;
+	client->chunk_left = 0;
+	client->bufsize = 0;
+	client->state = HTTPD_REQUEST_LINE;
+
+	/* make sure they're not sending more requests after
+	 * declaring they're not sending any more */
+	if (client->hd.connection_close)
 	{
-		if (hd->requestbuf != NULL)
-		{
-			count = recvq_get(cptr, hd->requestbuf + hd->lengthdone, hd->length - hd->lengthdone);
-			if (count <= 0)
-				return;
-			hd->lengthdone += count;
-			if (hd->lengthdone != hd->length)
-				return;
-			hd->requestbuf[hd->length] = '\0';
+		if (!(cptr->flags & CF_SEND_EOF))
+			sendq_add_eof(cptr);
 
-			ph->handler(cptr, hd->requestbuf);
+		client->state = HTTPD_CLOSING;
+	}
+}
 
-			clear_httpddata(hd);
-			return;
-		}
+static void
+dispatch_request(struct connection *cptr, struct httpd_client *client)
+{
+	client->hd.requestbuf[client->hd.lengthdone] = '\0';
+	client->hd.length = client->hd.lengthdone;
+
+	// a handler on the deprecated list may have left it while the body was read
+	httpd_legacy_sync();
+
+	if (client->route == NULL)
+		return;
+
+	client->route->handler(cptr, client->hd.requestbuf);
+
+	finish_request(cptr, client);
+}
+
+static void
+serve_file(struct connection *cptr, struct httpd_client *client, bool is_get)
+{
+	struct httpddata *const hd = &client->hd;
+	char outbuf[BUFSIZE];
+	struct stat sb;
+	int in;
+
+	in = open_file(hd->filename);
+	if (in == -1 || fstat(in, &sb) == -1 || !S_ISREG(sb.st_mode))
+	{
+		if (in != -1)
+			close(in);
+		slog(LG_DEBUG, "serve_file(): 404 for \2%s\2", hd->filename);
+		send_error(cptr, 404, "Not Found", is_get);
+		return;
 	}
+	slog(LG_INFO, "serve_file(): 200 for %s", hd->filename);
+
+	snprintf(outbuf, sizeof outbuf,
+	         "HTTP/1.1 200 OK\r\n"
+	         "Server: %s/%s\r\n"
+	         "Content-Type: %s\r\n"
+	         "Content-Length: %lu\r\n"
+	         "%s"
+	         "\r\n",
+	         PACKAGE_TARNAME, PACKAGE_VERSION,
+	         content_type(hd->filename),
+	         (unsigned long) sb.st_size,
+	         hd->connection_close ? "Connection: close\r\n" : "");
+
+	sendq_add(cptr, outbuf, strlen(outbuf));
+
+	// the file is not read here; the sendq hands it to the socket when it gets to it
+	if (is_get)
+		sendq_add_file(cptr, in, 0, (size_t) sb.st_size);
+	else
+		close(in);
+}
+
+static bool
+read_line(struct connection *cptr, struct httpd_client *client, char *buf, size_t size, int *len)
+{
+	int count;
 
-	count = recvq_getline(cptr, buf, sizeof buf - 1);
+	count = recvq_getline(cptr, buf, size - 1);
 	if (count <= 0)
-		return;
+		return false;
 	if (cptr->flags & CF_NONEWLINE)
 	{
-		slog(LG_INFO, "httpd_recvqhandler(): throwing out fd %d (%s) for excessive line length", cptr->fd, cptr->hbuf);
-		send_error(cptr, 400, "Bad request", true);
-		sendq_add_eof(cptr);
-		return;
+		slog(LG_INFO, "read_line(): throwing out fd %d (%s) for excessive line length", cptr->fd, cptr->hbuf);
+		(void) send_fatal(cptr, client, client->state == HTTPD_REQUEST_LINE ? 414 : 400,
+		                  client->state == HTTPD_REQUEST_LINE ? "URI Too Long" : "Bad request");
+		return false;
 	}
 
 	cnt.bin += count;
@@ -231,133 +402,339 @@ httpd_recvqhandler(struct connection *cptr)
 		count--;
 	buf[count] = '\0';
 
-	if (hd->method[0] == '\0')
+	*len = count;
+	return true;
+}
+
+static bool
+process_request_line(struct connection *cptr, struct httpd_client *client, char *line)
+{
+	struct httpddata *const hd = &client->hd;
+	struct httpd_route *route;
+	char *target, *version, *query;
+
+	// a client may send empty lines ahead of a request
+	if (*line == '\0')
+		return true;
+
+	if ((target = strchr(line, ' ')) == NULL)
+		return send_fatal(cptr, client, 400, "Bad request");
+
+	*target++ = '\0';
+
+	if ((version = strchr(target, ' ')) != NULL)
+		*version++ = '\0';
+
+	if ((query = strchr(target, '?')) != NULL)
+		*query = '\0';
+
+	if (*target == '\0' || strlen(line) >= sizeof hd->method)
+		return send_fatal(cptr, client, 400, "Bad request");
+	if (strlen(target) >= sizeof hd->filename)
+		return send_fatal(cptr, client, 414, "URI Too Long");
+
+	mowgli_strlcpy(hd->method, line, sizeof hd->method);
+	mowgli_strlcpy(hd->filename, target, sizeof hd->filename);
+
+	if (version == NULL || !strcmp(version, "HTTP/1.0"))
+		hd->connection_close = true;
+
+	httpd_legacy_sync();
+
+	route = mowgli_patricia_retrieve(httpd_routes, hd->filename);
+	client->route = (route != NULL) ? route->handler : NULL;
+	client->state = HTTPD_HEADERS;
+
+	slog(LG_DEBUG, "process_request_line(): request %s for %s", hd->method, hd->filename);
+	return true;
+}
+
+// true if the comma-separated list of tokens in value contains token
+static bool
+header_has_token(const char *value, const char *token)
+{
+	const size_t len = strlen(token);
+
+	while (*value != '\0')
 	{
-		/* make sure they're not sending more requests after
-		 * declaring they're not sending any more */
-		if (hd->connection_close)
-			return;
-		p = strtok(buf, " ");
-		if (p == NULL)
-			return;
-		mowgli_strlcpy(hd->method, p, sizeof hd->method);
-		p = strtok(NULL, " ");
-		if (p == NULL)
-			return;
-		mowgli_strlcpy(hd->filename, p, sizeof hd->filename);
-		p = strtok(NULL, "");
-		if (p == NULL || !strcmp(p, "HTTP/1.0"))
-			hd->connection_close = true;
-		slog(LG_DEBUG, "httpd_recvqhandler(): request %s for %s", hd->method, hd->filename);
+		size_t n;
+
+		value += strspn(value, ", \t");
+		n = strcspn(value, ", \t");
+
+		if (n == len && !strncasecmp(value, token, len))
+			return true;
+
+		value += n;
 	}
-	else if (count == 0)
-	{
-		is_get  = !strcmp(hd->method, "GET");
-		is_post = !strcmp(hd->method, "POST");
 
-		if (!is_post && !is_get)
-		{
-			send_error(cptr, 501, "Method Not Implemented", true);
-			sendq_add_eof(cptr);
-			return;
-		}
+	return false;
+}
 
-		hd->method[0] = '\0';
+static bool
+process_header(struct connection *cptr, struct httpd_client *client, char *line)
+{
+	struct httpddata *const hd = &client->hd;
+	char *p, *end;
 
-		if (!handling_done)
-		{
-			in = open_file(hd->filename);
-			if (in == -1 || fstat(in, &sb) == -1 || !S_ISREG(sb.st_mode))
-			{
-				if (in != -1)
-					close(in);
-				slog(LG_DEBUG, "httpd_recvqhandler(): 404 for \2%s\2", hd->filename);
-				send_error(cptr, 404, "Not Found", is_get);
-				check_close(cptr);
-				return;
-			}
-			slog(LG_INFO, "httpd_recvqhandler(): 200 for %s", hd->filename);
-
-			snprintf(outbuf, sizeof outbuf,
-			         "HTTP/1.1 200 OK\r\n"
-			         "Server: %s/%s\r\n"
-			         "Content-Type: %s\r\n"
-			         "Content-Length: %lu\r\n"
-			         "\r\n",
-			         PACKAGE_TARNAME, PACKAGE_VERSION,
-			         content_type(hd->filename),
-			         (unsigned long) sb.st_size);
-
-			sendq_add(cptr, outbuf, strlen(outbuf));
-			count1 = is_get ? sb.st_size : 0;
-			while (count1 > 0)
-			{
-				count = sizeof outbuf;
-				if (count > count1)
-					count = count1;
-				count = read(in, outbuf, count);
-				if (count <= 0)
-					break;
-				sendq_add(cptr, outbuf, count);
-				count1 -= count;
-			}
-			close(in);
-			if (count1 > 0)
-			{
-				slog(LG_INFO, "httpd_recvqhandler(): disconnecting fd %d (%s), read failed on %s", cptr->fd, cptr->hbuf, hd->filename);
-				cptr->flags |= CF_DEAD;
-			}
-			else
-				check_close(cptr);
-		}
-		else
+	p = strchr(line, ':');
+	if (p == NULL)
+		return true;
+	*p = '\0';
+	p++;
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	if (!strcasecmp(line, "Connection"))
+	{
+		if (header_has_token(p, "close"))
 		{
-			if (hd->length <= 0)
-			{
-				send_error(cptr, 411, "Length Required", true);
-				sendq_add_eof(cptr);
-				return;
-			}
-			if (hd->length > REQUEST_MAX)
-			{
-				send_error(cptr, 413, "Request Entity Too Large", true);
-				sendq_add_eof(cptr);
-				return;
-			}
-			if (!hd->correct_content_type)
-			{
-				send_error(cptr, 415, "Unsupported Media Type", true);
-				sendq_add_eof(cptr);
-				return;
-			}
-			if (hd->expect_100_continue)
-			{
-				snprintf(outbuf, sizeof outbuf,
-				         "HTTP/1.1 100 Continue\r\n"
-				         "Server: %s/%s\r\n"
-				         "\r\n",
-				         PACKAGE_TARNAME, PACKAGE_VERSION);
-
-				sendq_add(cptr, outbuf, strlen(outbuf));
-			}
-			hd->requestbuf = smalloc(hd->length + 1);
+			slog(LG_DEBUG, "process_header(): Connection: close requested by fd %d", cptr->fd);
+			hd->connection_close = true;
 		}
 	}
-	else
-		process_header(cptr, buf);
+	else if (!strcasecmp(line, "Content-Length"))
+	{
+		unsigned long length;
+
+		errno = 0;
+		length = strtoul(p, &end, 10);
+		if (errno != 0 || end == p || *p == '-' || length > INT_MAX)
+			return send_fatal(cptr, client, 400, "Bad request");
+		hd->length = (int) length;
+	}
+	else if (!strcasecmp(line, "Transfer-Encoding"))
+	{
+		// chunked is the only coding we can undo
+		const size_t len = strcspn(p, ", \t");
+
+		if (len != 7 || strncasecmp(p, "chunked", len) || p[len + strspn(p + len, " \t")] != '\0')
+			return send_fatal(cptr, client, 501, "Not Implemented");
+		client->chunked = true;
+	}
+	else if (!strcasecmp(line, "Content-Type"))
+	{
+		const size_t len = strcspn(p, "; \t");
+
+		hd->correct_content_type = (len == 8 && !strncasecmp(p, "text/xml", len))
+		                        || (len == 16 && !strncasecmp(p, "application/json", len));
+	}
+	else if (!strcasecmp(line, "Expect"))
+	{
+		hd->expect_100_continue = !strcasecmp(p, "100-continue");
+	}
+
+	return true;
+}
+
+static bool
+process_headers_done(struct connection *cptr, struct httpd_client *client)
+{
+	struct httpddata *const hd = &client->hd;
+	char outbuf[BUFSIZE];
+	bool is_get, is_post;
+
+	is_get  = !strcmp(hd->method, "GET");
+	is_post = !strcmp(hd->method, "POST");
+
+	if (!is_post && !is_get)
+		return send_fatal(cptr, client, 501, "Method Not Implemented");
+
+	// a length alongside a chunked body is ignored, but the sender is not to be trusted further
+	if (client->chunked)
+	{
+		if (hd->length != 0)
+			hd->connection_close = true;
+		hd->length = 0;
+	}
+
+	if (client->route == NULL)
+	{
+		// any body is not read; the request after it can not be found
+		if (hd->length > 0 || client->chunked)
+			hd->connection_close = true;
+
+		serve_file(cptr, client, is_get);
+		finish_request(cptr, client);
+		return true;
+	}
+
+	if (!client->chunked && hd->length <= 0)
+		return send_fatal(cptr, client, 411, "Length Required");
+	if (hd->length > REQUEST_MAX)
+		return send_fatal(cptr, client, 413, "Request Entity Too Large");
+	if (!hd->correct_content_type)
+		return send_fatal(cptr, client, 415, "Unsupported Media Type");
+
+	if (hd->expect_100_continue)
+	{
+		snprintf(outbuf, sizeof outbuf,
+		         "HTTP/1.1 100 Continue\r\n"
+		         "Server: %s/%s\r\n"
+		         "\r\n",
+		         PACKAGE_TARNAME, PACKAGE_VERSION);
+
+		sendq_add(cptr, outbuf, strlen(outbuf));
+	}
+
+	client->bufsize = client->chunked ? CHUNK_BUF_INIT : (size_t) hd->length + 1;
+	hd->requestbuf = smalloc(client->bufsize);
+	hd->lengthdone = 0;
+	client->state = client->chunked ? HTTPD_CHUNK_SIZE : HTTPD_BODY;
+	return true;
+}
+
+static bool
+process_chunk_size(struct connection *cptr, struct httpd_client *client, char *line)
+{
+	struct httpddata *const hd = &client->hd;
+	unsigned long size;
+	size_t need;
+	char *end;
+
+	// chunk extensions are allowed after the size and are ignored
+	errno = 0;
+	size = strtoul(line, &end, 16);
+	if (errno != 0 || end == line || !isxdigit((unsigned char) *line)
+	    || (*end != '\0' && *end != ';' && *end != ' ' && *end != '\t'))
+		return send_fatal(cptr, client, 400, "Bad request");
+
+	if (size == 0)
+	{
+		client->state = HTTPD_TRAILERS;
+		return true;
+	}
+
+	if (size > REQUEST_MAX || (size_t) hd->lengthdone + size > REQUEST_MAX)
+		return send_fatal(cptr, client, 413, "Request Entity Too Large");
+
+	need = (size_t) hd->lengthdone + size + 1;
+	if (need > client->bufsize)
+	{
+		while (client->bufsize < need)
+			client->bufsize *= 2;
+
+		hd->requestbuf = srealloc(hd->requestbuf, client->bufsize);
+	}
+
+	client->chunk_left = size;
+	client->state = HTTPD_CHUNK_DATA;
+	return true;
+}
+
+// reads what there is of the body; returns true once all of it is in
+static bool
+read_body(struct connection *cptr, struct httpd_client *client, size_t want)
+{
+	struct httpddata *const hd = &client->hd;
+	int count;
+
+	count = recvq_get(cptr, hd->requestbuf + hd->lengthdone, want);
+	if (count <= 0)
+		return false;
+
+	hd->lengthdone += count;
+	if (client->chunked)
+		client->chunk_left -= (size_t) count;
+
+	return (size_t) count == want;
+}
+
+// handles the next part of the request; returns false when more input is needed
+static bool
+httpd_step(struct connection *cptr, struct httpd_client *client)
+{
+	struct httpddata *const hd = &client->hd;
+	char buf[BUFSIZE * 2];
+	int len;
+
+	switch (client->state)
+	{
+		case HTTPD_REQUEST_LINE:
+			if (!read_line(cptr, client, buf, sizeof buf, &len))
+				return false;
+			return process_request_line(cptr, client, buf);
+
+		case HTTPD_HEADERS:
+			if (!read_line(cptr, client, buf, sizeof buf, &len))
+				return false;
+			if (len == 0)
+				return process_headers_done(cptr, client);
+			return process_header(cptr, client, buf);
+
+		case HTTPD_BODY:
+			if (!read_body(cptr, client, (size_t) (hd->length - hd->lengthdone)))
+				return false;
+			dispatch_request(cptr, client);
+			return true;
+
+		case HTTPD_CHUNK_SIZE:
+			if (!read_line(cptr, client, buf, sizeof buf, &len))
+				return false;
+			return process_chunk_size(cptr, client, buf);
+
+		case HTTPD_CHUNK_DATA:
+			if (!read_body(cptr, client, client->chunk_left))
+				return false;
+			client->state = HTTPD_CHUNK_END;
+			return true;
+
+		case HTTPD_CHUNK_END:
+			if (!read_line(cptr, client, buf, sizeof buf, &len))
+				return false;
+			if (len != 0)
+				return send_fatal(cptr, client, 400, "Bad request");
+			client->state = HTTPD_CHUNK_SIZE;
+			return true;
+
+		case HTTPD_TRAILERS:
+			// trailer fields are read and ignored
+			if (!read_line(cptr, client, buf, sizeof buf, &len))
+				return false;
+			if (len == 0)
+				dispatch_request(cptr, client);
+			return true;
+
+		case HTTPD_CLOSING:
+			while (recvq_get(cptr, buf, sizeof buf) > 0)
+				;
+			return false;
+	}
+
+	return false;
+}
+
+static void
+httpd_recvqhandler(struct connection *cptr)
+{
+	struct httpd_client *const client = cptr->userdata;
+
+	// most recently active at the tail; the idle check only looks at the head
+	if (client->owner != NULL && client->owner->idle.tail != &client->idle_node)
+	{
+		mowgli_node_delete(&client->idle_node, &client->owner->idle);
+		mowgli_node_add(cptr, &client->idle_node, &client->owner->idle);
+	}
+
+	// every complete request in the recvq is answered before returning
+	while (!(cptr->flags & CF_DEAD) && httpd_step(cptr, client))
+		;
 }
 
 static void
 httpd_closehandler(struct connection *cptr)
 {
-	struct httpddata *hd;
+	struct httpd_client *client;
 
 	slog(LG_DEBUG, "httpd_closehandler(): fd %d (%s) closed", cptr->fd, cptr->hbuf);
-	hd = cptr->userdata;
-	if (hd != NULL)
+	client = cptr->userdata;
+	if (client != NULL)
 	{
-		sfree(hd->requestbuf);
-		sfree(hd);
+		if (client->owner != NULL)
+			mowgli_node_delete(&client->idle_node, &client->owner->idle);
+		sfree(client->hd.requestbuf);
+		sfree(client->hd.replybuf);
+		sfree(client);
 	}
 	cptr->userdata = NULL;
 }
@@ -368,12 +745,18 @@ do_listen(struct connection *cptr)
 	struct connection *newptr;
 
 	newptr = connection_accept_tcp(cptr, recvq_put, NULL);
+	if (newptr == NULL)
+		return;
 	slog(LG_DEBUG, "do_listen(): accepted httpd from %s fd %d", newptr->hbuf, newptr->fd);
 
-	struct httpddata *const hd = smalloc(sizeof *hd);
-	hd->connection_close = false;
-	clear_httpddata(hd);
-	newptr->userdata = hd;
+	struct httpd_client *const client = smalloc(sizeof *client);
+	client->hd.connection_close = false;
+	clear_httpddata(&client->hd);
+	client->owner = cptr->userdata;
+	client->state = HTTPD_REQUEST_LINE;
+	if (client->owner != NULL)
+		mowgli_node_add(newptr, &client->idle_node, &client->owner->idle);
+	newptr->userdata = client;
 	newptr->recvq_handler = httpd_recvqhandler;
 	newptr->close_handler = httpd_closehandler;
 }
@@ -381,41 +764,57 @@ do_listen(struct connection *cptr)
 static void
 httpd_checkidle(void *arg)
 {
+	struct httpd_listener *const hl = arg;
 	mowgli_node_t *n, *tn;
 	struct connection *cptr;
 
-	(void)arg;
-	if (listener == NULL)
-		return;
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, connection_list.head)
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, hl->idle.head)
 	{
 		cptr = n->data;
-		if (cptr->listener == listener && cptr->last_recv + 300 < CURRTIME)
+
+		// the rest have been active more recently
+		if (cptr->last_recv + IDLE_TIMEOUT >= CURRTIME)
+			break;
+
+		if (sendq_nonempty(cptr))
 		{
-			if (sendq_nonempty(cptr))
-				cptr->last_recv = CURRTIME;
-			else
-				/* from a timeout function,
-				 * connection_close_soon() may take quite
-				 * a while, and connection_close() is safe
-				 * -- jilles */
-				connection_close(cptr);
+			struct httpd_client *const client = cptr->userdata;
+
+			cptr->last_recv = CURRTIME;
+			mowgli_node_delete(&client->idle_node, &hl->idle);
+			mowgli_node_add(cptr, &client->idle_node, &hl->idle);
 		}
+		else
+			/* from a timeout function,
+			 * connection_close_soon() may take quite
+			 * a while, and connection_close() is safe
+			 * -- jilles */
+			connection_close(cptr);
 	}
 }
 
 static void
 httpd_config_ready(void *vptr)
 {
+	struct connection *conn;
+
 	if (httpd_config.host != NULL && httpd_config.port != 0)
 	{
 		// Some code depends on struct connection -> listener == listener.
 		if (listener != NULL)
 			return;
-		listener = connection_open_listener_tcp(httpd_config.host,
+		conn = connection_open_listener_tcp(httpd_config.host,
 			httpd_config.port, do_listen);
-		if (listener == NULL)
+		if (conn == NULL)
+		{
 			slog(LG_ERROR, "httpd_config_ready(): failed to open listener on host %s port %u", httpd_config.host, httpd_config.port);
+			return;
+		}
+
+		listener = smalloc(sizeof *listener);
+		listener->conn = conn;
+		listener->timer = mowgli_timer_add(base_eventloop, "httpd_checkidle", httpd_checkidle, listener, SECONDS_PER_MINUTE);
+		conn->userdata = listener;
 	}
 	else
 		slog(LG_ERROR, "httpd_config_ready(): httpd {} block missing or invalid");
@@ -424,7 +823,7 @@ httpd_config_ready(void *vptr)
 static void
 mod_init(struct module ATHEME_VATTR_UNUSED *const restrict m)
 {
-	httpd_checkidle_timer = mowgli_timer_add(base_eventloop, "httpd_checkidle", httpd_checkidle, NULL, SECONDS_PER_MINUTE);
+	httpd_routes = mowgli_patricia_create(noopcanon);
 
 	// This module needs a rehash to initialize fully if loaded at run time
 	hook_add_config_ready(httpd_config_ready);
@@ -438,10 +837,23 @@ mod_init(struct module ATHEME_VATTR_UNUSED *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	mowgli_timer_destroy(base_eventloop, httpd_checkidle_timer);
+	mowgli_node_t *n, *tn;
 
 	hook_del_config_ready(httpd_config_ready);
-	connection_close_children(listener);
+
+	if (listener != NULL)
+	{
+		mowgli_timer_destroy(base_eventloop, listener->timer);
+		connection_close_children(listener->conn);
+		sfree(listener);
+		listener = NULL;
+	}
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, httpd_route_list.head)
+		httpd_route_del(((struct httpd_route *) n->data)->handler);
+
+	mowgli_patricia_destroy(httpd_routes, NULL, NULL);
+
 	del_conf_item("HOST", &conf_httpd_table);
 	del_conf_item("WWW_ROOT", &conf_httpd_table);
 	del_conf_item("PORT", &conf_httpd_table);
@@ -22,15 +22,14 @@ struct enforce_timeout
 	char nick[NICKLEN + 1];
 	char host[HOSTLEN + 1];
 	time_t timelimit;
+	struct deadline *deadline;
 	mowgli_node_t node;
 };
 
 static mowgli_heap_t *enforce_timeout_heap = NULL;
-static mowgli_eventloop_timer_t *enforce_timeout_check_timer = NULL;
 static mowgli_eventloop_timer_t *enforce_remove_enforcers_timer = NULL;
 
 static mowgli_list_t enforce_list;
-static time_t enforce_next;
 
 static mowgli_patricia_t **ns_set_cmdtree;
 
@@ -92,55 +91,54 @@ guest_nickname(struct user *u)
 }
 
 static void
-enforce_timeout_check(void *arg)
+enforce_timeout_free(struct enforce_timeout *timeout)
 {
-	mowgli_node_t *n, *tn;
-	struct enforce_timeout *timeout;
+	if (timeout->deadline != NULL)
+		deadline_delete(timeout->deadline);
+
+	mowgli_node_delete(&timeout->node, &enforce_list);
+	mowgli_heap_free(enforce_timeout_heap, timeout);
+}
+
+static void
+enforce_timeout_expire(void *arg)
+{
+	struct enforce_timeout *timeout = arg;
 	struct user *u;
 	struct mynick *mn;
 	bool valid;
 
-	enforce_next = 0;
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, enforce_list.head)
-	{
-		timeout = n->data;
-		if (timeout->timelimit > CURRTIME)
-		{
-			enforce_next = timeout->timelimit;
-			enforce_timeout_check_timer = mowgli_timer_add_once(base_eventloop, "enforce_timeout_check", enforce_timeout_check, NULL, enforce_next - CURRTIME);
-			break; // assume sorted list
-		}
-		u = user_find_named(timeout->nick);
-		mn = mynick_find(timeout->nick);
-		valid = u != NULL && mn != NULL && (!strcmp(u->host, timeout->host) || !strcmp(u->vhost, timeout->host));
-		mowgli_node_delete(&timeout->node, &enforce_list);
-		mowgli_heap_free(enforce_timeout_heap, timeout);
-		if (!valid)
-			continue;
-		if (is_internal_client(u))
-			continue;
-		if (u->myuser == mn->owner)
-			continue;
-		if (myuser_access_verify(u, mn->owner))
-			continue;
-		if (!metadata_find(mn->owner, "private:doenforce"))
-			continue;
-
-		notice(nicksvs.nick, u->nick, "You failed to identify in time for the nickname %s", mn->nick);
-		guest_nickname(u);
-		if (ircd->flags & IRCD_HOLDNICK)
-			holdnick_sts(nicksvs.me->me, u->flags & UF_WASENFORCED ? SECONDS_PER_HOUR : 30, u->nick, mn->owner);
-		else
-			u->flags |= UF_DOENFORCE;
-		u->flags |= UF_WASENFORCED;
-	}
+	// the deadline has already fired and been freed
+	timeout->deadline = NULL;
+
+	u = user_find_named(timeout->nick);
+	mn = mynick_find(timeout->nick);
+	valid = u != NULL && mn != NULL && (!strcmp(u->host, timeout->host) || !strcmp(u->vhost, timeout->host));
+	enforce_timeout_free(timeout);
+	if (!valid)
+		return;
+	if (is_internal_client(u))
+		return;
+	if (u->myuser == mn->owner)
+		return;
+	if (myuser_access_verify(u, mn->owner))
+		return;
+	if (!metadata_find(mn->owner, "private:doenforce"))
+		return;
+
+	notice(nicksvs.nick, u->nick, "You failed to identify in time for the nickname %s", mn->nick);
+	guest_nickname(u);
+	if (ircd->flags & IRCD_HOLDNICK)
+		holdnick_sts(nicksvs.me->me, u->flags & UF_WASENFORCED ? SECONDS_PER_HOUR : 30, u->nick, mn->owner);
+	else
+		u->flags |= UF_DOENFORCE;
+	u->flags |= UF_WASENFORCED;
 }
 
 static void
 check_enforce(struct hook_nick_enforce *hdata)
 {
-	struct enforce_timeout *timeout, *timeout2;
-	mowgli_node_t *n;
+	struct enforce_timeout *timeout;
 	struct metadata *md;
 
 	// nick is a service, ignore it
@@ -158,6 +156,9 @@ check_enforce(struct hook_nick_enforce *hdata)
 	// check if it's already in enforce_list
 	timeout = NULL;
 #ifdef SHOW_CORRECT_TIMEOUT_BUT_BE_SLOW
+	struct enforce_timeout *timeout2;
+	mowgli_node_t *n;
+
 	/* don't do this now, it's O(n^2) in the number of users using
 	 * a nick without access at a time */
 	MOWGLI_ITER_FOREACH(n, enforce_list.head)
@@ -186,27 +187,8 @@ check_enforce(struct hook_nick_enforce *hdata)
 			timeout->timelimit = CURRTIME + enforcetime;
 		}
 
-		// insert in sorted order
-		MOWGLI_ITER_FOREACH_PREV(n, enforce_list.tail)
-		{
-			timeout2 = n->data;
-			if (timeout2->timelimit <= timeout->timelimit)
-				break;
-		}
-		if (n == NULL)
-			mowgli_node_add_head(timeout, &timeout->node, &enforce_list);
-		else if (n->next == NULL)
-			mowgli_node_add(timeout, &timeout->node, &enforce_list);
-		else
-			mowgli_node_add_before(timeout, &timeout->node, &enforce_list, n->next);
-
-		if (enforce_next == 0 || enforce_next > timeout->timelimit)
-		{
-			if (enforce_next != 0)
-				mowgli_timer_destroy(base_eventloop, enforce_timeout_check_timer);
-			enforce_next = timeout->timelimit;
-			enforce_timeout_check_timer = mowgli_timer_add_once(base_eventloop, "enforce_timeout_check", enforce_timeout_check, NULL, enforce_next - CURRTIME);
-		}
+		mowgli_node_add(timeout, &timeout->node, &enforce_list);
+		timeout->deadline = deadline_add("enforce_timeout_expire", enforce_timeout_expire, timeout, timeout->timelimit);
 	}
 
 	notice(nicksvs.nick, hdata->u->nick, "You have %u seconds to identify to your nickname before it is changed.", (unsigned int)(timeout->timelimit - CURRTIME));
@@ -336,10 +318,7 @@ ns_cmd_release(struct sourceinfo *si, int parc, char *parv[])
 			{
 				timeout = n->data;
 				if (!irccasecmp(mn->nick, timeout->nick) && (!strcmp(si->su->host, timeout->host) || !strcmp(si->su->vhost, timeout->host)))
-				{
-					mowgli_node_delete(&timeout->node, &enforce_list);
-					mowgli_heap_free(enforce_timeout_heap, timeout);
-				}
+					enforce_timeout_free(timeout);
 			}
 		}
 		if (u == NULL || is_internal_client(u))
@@ -508,10 +487,7 @@ ns_cmd_regain(struct sourceinfo *si, int parc, char *parv[])
 			{
 				timeout = n->data;
 				if (!irccasecmp(mn->nick, timeout->nick) && (!strcmp(si->su->host, timeout->host) || !strcmp(si->su->vhost, timeout->host)))
-				{
-					mowgli_node_delete(&timeout->node, &enforce_list);
-					mowgli_heap_free(enforce_timeout_heap, timeout);
-				}
+					enforce_timeout_free(timeout);
 			}
 		}
 		if (u != NULL && is_service(u))
@@ -683,12 +659,14 @@ mod_init(struct module *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
+	mowgli_node_t *n, *tn;
+
 	enforce_remove_enforcers(NULL);
 
 	mowgli_timer_destroy(base_eventloop, enforce_remove_enforcers_timer);
 
-	if (enforce_next)
-		mowgli_timer_destroy(base_eventloop, enforce_timeout_check_timer);
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, enforce_list.head)
+		enforce_timeout_free(n->data);
 
 	service_named_unbind_command("nickserv", &ns_release);
 	service_named_unbind_command("nickserv", &ns_regain);
@@ -11,6 +11,32 @@
 
 #define CLONESDB_VERSION	3
 #define CLONES_GRACE_TIMEPERIOD	180
+#define CLONES_ADDRSZ		16U
+
+// Kills handed out during the grace period, per address and per subnet
+struct clones_grace
+{
+	time_t firstkill;
+	unsigned int gracekills;
+};
+
+/*
+ * A binary radix (PATRICIA) tree of parsed addresses. Each node covers the
+ * first `bits' bits of `addr'. Nodes carry the exemption for exactly that
+ * CIDR and/or the number of clients within that prefix when it is one of
+ * the configured aggregation lengths. Nodes with neither only exist as
+ * branch points.
+ */
+struct clones_radixnode
+{
+	struct clones_radixnode *parent;
+	struct clones_radixnode *child[2];
+	struct clones_exemption *exempt;
+	unsigned int count;
+	unsigned int bits;
+	unsigned char addr[CLONES_ADDRSZ];
+	struct clones_grace grace;
+};
 
 struct clones_exemption
 {
@@ -19,21 +45,33 @@ struct clones_exemption
 	unsigned int warn;
 	char *reason;
 	long expires;
+	struct clones_radixnode *node;
 };
 
 struct clones_hostentry
 {
 	char ip[HOSTIPLEN + 1];
 	mowgli_list_t clients;
-	time_t firstkill;
-	unsigned int gracekills;
+	struct clones_grace grace;
+	unsigned int addrbits;
+	unsigned char addr[CLONES_ADDRSZ];
+	struct clones_radixnode *subnet;
 };
 
 static mowgli_patricia_t *os_clones_cmds = NULL;
 static mowgli_patricia_t *hostlist = NULL;
 static mowgli_heap_t *hostentry_heap = NULL;
+static mowgli_heap_t *radixnode_heap = NULL;
 static struct service *serviceinfo = NULL;
 
+static struct clones_radixnode *radix_ipv4 = NULL;
+static struct clones_radixnode *radix_ipv6 = NULL;
+
+static unsigned int cidr_ipv4_len = 24;
+static unsigned int cidr_ipv6_len = 64;
+static unsigned int cidr_allowed;
+static unsigned int cidr_warn;
+
 static mowgli_list_t clone_exempts;
 static bool kline_enabled;
 static unsigned int grace_count;
@@ -50,11 +88,225 @@ cexempt_expired(struct clones_exemption *c)
 	return false;
 }
 
+static inline unsigned int
+radix_bit(const unsigned char *const restrict addr, const unsigned int bit)
+{
+	return (addr[bit / 8] >> (7 - (bit % 8))) & 1U;
+}
+
+// returns the number of leading bits (at most maxbits) that a and b share
+static unsigned int
+radix_common_bits(const unsigned char *const restrict a, const unsigned char *const restrict b,
+                  const unsigned int maxbits)
+{
+	unsigned int bit = 0;
+
+	while (bit + 8 <= maxbits && a[bit / 8] == b[bit / 8])
+		bit += 8;
+
+	while (bit < maxbits && radix_bit(a, bit) == radix_bit(b, bit))
+		bit++;
+
+	return bit;
+}
+
+static inline struct clones_radixnode **
+radix_root(const unsigned int addrbits)
+{
+	return (addrbits == 32) ? &radix_ipv4 : &radix_ipv6;
+}
+
+static struct clones_radixnode *
+radix_node_create(const unsigned char *const restrict addr, const unsigned int bits,
+                  struct clones_radixnode *const restrict parent)
+{
+	struct clones_radixnode *const node = mowgli_heap_alloc(radixnode_heap);
+
+	(void) memset(node, 0x00, sizeof *node);
+	(void) memcpy(node->addr, addr, (bits + 7) / 8);
+
+	if (bits % 8)
+		node->addr[bits / 8] &= (unsigned char) (0xFF00U >> (bits % 8));
+
+	node->bits = bits;
+	node->parent = parent;
+
+	return node;
+}
+
+// finds the node for exactly addr/bits, creating it (and a branch point) if necessary
+static struct clones_radixnode *
+radix_get(struct clones_radixnode **const root, const unsigned char *const restrict addr, const unsigned int bits)
+{
+	struct clones_radixnode **link = root;
+	struct clones_radixnode *parent = NULL;
+	struct clones_radixnode *node;
+
+	while ((node = *link) != NULL)
+	{
+		if (node->bits > bits || radix_common_bits(node->addr, addr, node->bits) != node->bits)
+			break;
+
+		if (node->bits == bits)
+			return node;
+
+		parent = node;
+		link = &node->child[radix_bit(addr, node->bits)];
+	}
+
+	struct clones_radixnode *const leaf = radix_node_create(addr, bits, parent);
+
+	if (node == NULL)
+	{
+		*link = leaf;
+		return leaf;
+	}
+
+	const unsigned int common = radix_common_bits(node->addr, addr, MIN(node->bits, bits));
+
+	if (common == bits)
+	{
+		// the new node is a prefix of the existing subtree
+		leaf->child[radix_bit(node->addr, bits)] = node;
+		node->parent = leaf;
+		*link = leaf;
+		return leaf;
+	}
+
+	struct clones_radixnode *const branch = radix_node_create(addr, common, parent);
+
+	branch->child[radix_bit(addr, common)] = leaf;
+	branch->child[radix_bit(node->addr, common)] = node;
+	leaf->parent = branch;
+	node->parent = branch;
+	*link = branch;
+
+	return leaf;
+}
+
+// frees node and any branch points above it that have become redundant
+static void
+radix_release(struct clones_radixnode *node)
+{
+	while (node != NULL && node->exempt == NULL && node->count == 0)
+	{
+		if (node->child[0] != NULL && node->child[1] != NULL)
+			return;
+
+		struct clones_radixnode *const parent = node->parent;
+		struct clones_radixnode *const only = node->child[0] ? node->child[0] : node->child[1];
+		struct clones_radixnode **link;
+
+		if (parent != NULL)
+			link = &parent->child[radix_bit(node->addr, parent->bits)];
+		else
+			link = (node == radix_ipv4) ? &radix_ipv4 : &radix_ipv6;
+
+		*link = only;
+
+		if (only != NULL)
+			only->parent = parent;
+
+		(void) mowgli_heap_free(radixnode_heap, node);
+
+		node = parent;
+	}
+}
+
+static void
+cexempt_attach(struct clones_exemption *const c)
+{
+	unsigned char addr[CLONES_ADDRSZ];
+	unsigned int cidrlen;
+	const unsigned int addrbits = parse_ip_cidr(c->ip, addr, &cidrlen);
+
+	c->node = NULL;
+
+	// match_ips() never matched a /0 mask, so don't let one cover everything here either
+	if (! addrbits || ! cidrlen)
+		return;
+
+	c->node = radix_get(radix_root(addrbits), addr, cidrlen);
+
+	if (c->node->exempt == NULL)
+		c->node->exempt = c;
+}
+
+static void
+cexempt_destroy(mowgli_node_t *const n)
+{
+	struct clones_exemption *const c = n->data;
+
+	mowgli_node_delete(n, &clone_exempts);
+	mowgli_node_free(n);
+
+	if (c->node != NULL && c->node->exempt == c)
+	{
+		mowgli_node_t *tn;
+
+		c->node->exempt = NULL;
+
+		// another exemption may have been written with the same mask
+		MOWGLI_ITER_FOREACH(tn, clone_exempts.head)
+		{
+			struct clones_exemption *const t = tn->data;
+
+			if (t->node == c->node)
+			{
+				c->node->exempt = t;
+				break;
+			}
+		}
+
+		if (c->node->exempt == NULL)
+			(void) radix_release(c->node);
+	}
+
+	sfree(c->ip);
+	sfree(c->reason);
+	sfree(c);
+}
+
+static void
+clones_subnet_detach(struct clones_hostentry *const he)
+{
+	if (he->subnet == NULL)
+		return;
+
+	he->subnet->count -= MOWGLI_LIST_LENGTH(&he->clients);
+
+	(void) radix_release(he->subnet);
+
+	he->subnet = NULL;
+}
+
+static void
+clones_subnet_attach(struct clones_hostentry *const he)
+{
+	if (! he->addrbits || (! cidr_allowed && ! cidr_warn))
+		return;
+
+	const unsigned int bits = (he->addrbits == 32) ? cidr_ipv4_len : cidr_ipv6_len;
+
+	he->subnet = radix_get(radix_root(he->addrbits), he->addr, bits);
+	he->subnet->count += MOWGLI_LIST_LENGTH(&he->clients);
+}
+
 static void
 clones_configready(void *unused)
 {
+	struct clones_hostentry *he;
+	mowgli_patricia_iteration_state_t state;
+
 	clones_allowed = config_options.default_clone_allowed;
 	clones_warn = config_options.default_clone_warn;
+
+	// The aggregation lengths or limits may have changed; recount every host
+	MOWGLI_PATRICIA_FOREACH(he, &state, hostlist)
+		clones_subnet_detach(he);
+
+	MOWGLI_PATRICIA_FOREACH(he, &state, hostlist)
+		clones_subnet_attach(he);
 }
 
 static void
@@ -81,11 +333,7 @@ write_exemptdb(struct database_handle *db)
 		struct clones_exemption *c = n->data;
 		if (cexempt_expired(c))
 		{
-			sfree(c->ip);
-			sfree(c->reason);
-			sfree(c);
-			mowgli_node_delete(n, &clone_exempts);
-			mowgli_node_free(n);
+			cexempt_destroy(n);
 		}
 		else
 		{
@@ -156,32 +404,33 @@ db_h_ex(struct database_handle *db, const char *type)
 	c->expires = expires;
 	c->reason = sstrdup(reason);
 	mowgli_node_add(c, mowgli_node_create(), &clone_exempts);
+	cexempt_attach(c);
 }
 
+// returns the most specific unexpired exemption covering the host, walking at most one node per prefix bit
 static struct clones_exemption *
-find_exempt(const char *ip)
+find_exempt(const struct clones_hostentry *const he)
 {
-	mowgli_node_t *n;
+	struct clones_exemption *best = NULL;
+	struct clones_radixnode *node;
 
-	// first check for an exact match
-	MOWGLI_ITER_FOREACH(n, clone_exempts.head)
-	{
-		struct clones_exemption *c = n->data;
+	if (! he->addrbits)
+		return NULL;
 
-		if (!strcmp(ip, c->ip))
-			return c;
-	}
+	node = *radix_root(he->addrbits);
 
-	// then look for cidr
-	MOWGLI_ITER_FOREACH(n, clone_exempts.head)
+	while (node != NULL && radix_common_bits(node->addr, he->addr, node->bits) == node->bits)
 	{
-		struct clones_exemption *c = n->data;
+		if (node->exempt != NULL && ! cexempt_expired(node->exempt))
+			best = node->exempt;
 
-		if (!match_ips(c->ip, ip))
-			return c;
+		if (node->bits == he->addrbits)
+			break;
+
+		node = node->child[radix_bit(he->addr, node->bits)];
 	}
 
-	return 0;
+	return best;
 }
 
 static void
@@ -274,7 +523,7 @@ os_cmd_clones_list(struct sourceinfo *si, int parc, char *parv[])
 
 		if (k > 3)
 		{
-			struct clones_exemption *c = find_exempt(he->ip);
+			struct clones_exemption *c = find_exempt(he);
 			if (c)
 				command_success_nodata(si, _("%u from %s (\2EXEMPT\2; allowed %u)"), k, he->ip, c->allowed);
 			else
@@ -407,6 +656,7 @@ os_cmd_clones_addexempt(struct sourceinfo *si, int parc, char *parv[])
 		c->ip = sstrdup(ip);
 		c->reason = sstrdup(rreason);
 		mowgli_node_add(c, mowgli_node_create(), &clone_exempts);
+		cexempt_attach(c);
 		command_success_nodata(si, _("Added \2%s\2 to clone exempt list."), ip);
 	}
 	else
@@ -446,19 +696,11 @@ os_cmd_clones_delexempt(struct sourceinfo *si, int parc, char *parv[])
 
 		if (cexempt_expired(c))
 		{
-			sfree(c->ip);
-			sfree(c->reason);
-			sfree(c);
-			mowgli_node_delete(n, &clone_exempts);
-			mowgli_node_free(n);
+			cexempt_destroy(n);
 		}
 		else if (!strcmp(c->ip, arg))
 		{
-			sfree(c->ip);
-			sfree(c->reason);
-			sfree(c);
-			mowgli_node_delete(n, &clone_exempts);
-			mowgli_node_free(n);
+			cexempt_destroy(n);
 			command_success_nodata(si, _("Removed \2%s\2 from clone exempt list."), arg);
 			logcommand(si, CMDLOG_ADMIN, "CLONES:DELEXEMPT: \2%s\2", arg);
 			return;
@@ -527,11 +769,7 @@ os_cmd_clones_setexempt(struct sourceinfo *si, int parc, char *parv[])
 
 			if (cexempt_expired(c))
 			{
-				sfree(c->ip);
-				sfree(c->reason);
-				sfree(c);
-				mowgli_node_delete(n, &clone_exempts);
-				mowgli_node_free(n);
+				cexempt_destroy(n);
 			}
 			else if (!strcmp(c->ip, ip))
 			{
@@ -678,11 +916,7 @@ os_cmd_clones_listexempt(struct sourceinfo *si, int parc, char *parv[])
 
 		if (cexempt_expired(c))
 		{
-			sfree(c->ip);
-			sfree(c->reason);
-			sfree(c);
-			mowgli_node_delete(n, &clone_exempts);
-			mowgli_node_free(n);
+			cexempt_destroy(n);
 		}
 		else if (c->expires)
 			command_success_nodata(si, _("%s - allowed limit %u, warn on %u - expires in %s - \2%s\2"), c->ip, c->allowed, c->warn, timediff(c->expires > CURRTIME ? c->expires - CURRTIME : 0), c->reason);
@@ -693,6 +927,81 @@ os_cmd_clones_listexempt(struct sourceinfo *si, int parc, char *parv[])
 	logcommand(si, CMDLOG_ADMIN, "CLONES:LISTEXEMPT");
 }
 
+static void
+clones_subnet_mask(const struct clones_hostentry *const he, char *const restrict buf, const size_t len)
+{
+	const unsigned char *const a = he->subnet->addr;
+	char addr[INET6_ADDRSTRLEN];
+
+	if (he->addrbits == 32)
+		(void) snprintf(buf, len, "%u.%u.%u.%u/%u", a[0], a[1], a[2], a[3], he->subnet->bits);
+	else if (inet_ntop(AF_INET6, a, addr, sizeof addr) != NULL)
+		// compressed, as the ircd will echo it back in its ban list
+		(void) snprintf(buf, len, "%s/%u", addr, he->subnet->bits);
+	else
+		(void) snprintf(buf, len, "%x:%x:%x:%x:%x:%x:%x:%x/%u",
+		                (a[0] << 8) | a[1], (a[2] << 8) | a[3], (a[4] << 8) | a[5], (a[6] << 8) | a[7],
+		                (a[8] << 8) | a[9], (a[10] << 8) | a[11], (a[12] << 8) | a[13], (a[14] << 8) | a[15],
+		                he->subnet->bits);
+}
+
+/*
+ * Applies the limits to a count of clones on `mask' (either the user's IP
+ * address or the subnet it belongs to), charging any grace kills to that
+ * address or subnet. Returns false if the user was killed.
+ */
+static bool
+clones_enforce(struct hook_user_nick *const data, struct clones_grace *const grace, const char *const mask,
+               const unsigned int i, const unsigned int allowed, const unsigned int warn)
+{
+	struct user *const u = data->u;
+
+	if (i > allowed && allowed != 0)
+	{
+		// User has exceeded the maximum number of allowed clones.
+		if (is_autokline_exempt(u))
+			slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (user is autokline exempt)", i, mask, u->nick, u->user, u->host);
+		else if (!kline_enabled || grace->gracekills < grace_count || (grace_count > 0 && grace->firstkill < time(NULL) - CLONES_GRACE_TIMEPERIOD))
+		{
+			if (grace->firstkill < time(NULL) - CLONES_GRACE_TIMEPERIOD)
+			{
+				grace->firstkill = time(NULL);
+				grace->gracekills = 1;
+			}
+			else
+			{
+				grace->gracekills++;
+			}
+
+			if (!kline_enabled)
+				slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (TKLINE disabled, killing user)", i, mask, u->nick, u->user, u->host);
+			else
+				slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (grace period, killing user, %u grace kills remaining)", i, mask, u->nick,
+					u->user, u->host, grace_count - grace->gracekills);
+
+			kill_user(serviceinfo->me, u, "Too many connections from this host.");
+			data->u = NULL; // Required due to kill_user being called during user_add hook. --mr_flea
+			return false;
+		}
+		else
+		{
+			if (! (u->flags & UF_KLINESENT)) {
+				slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (TKLINE due to excess clones)", i, mask, u->nick, u->user, u->host);
+				kline_sts("*", "*", mask, kline_duration, "Excessive clones");
+				u->flags |= UF_KLINESENT;
+			}
+		}
+
+	}
+	else if (i >= warn && warn != 0)
+	{
+		slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (\2%u\2 allowed)", i, mask, u->nick, u->user, u->host, allowed);
+		msg(serviceinfo->nick, u->nick, _("\2WARNING\2: You may not have more than \2%u\2 clients connected to the network at once. Any further connections risks being removed."), allowed);
+	}
+
+	return true;
+}
+
 static void
 clones_newuser(struct hook_user_nick *data)
 {
@@ -713,14 +1022,21 @@ clones_newuser(struct hook_user_nick *data)
 	he = mowgli_patricia_retrieve(hostlist, u->ip);
 	if (he == NULL)
 	{
+		unsigned int cidrlen;
+
 		he = mowgli_heap_alloc(hostentry_heap);
 		mowgli_strlcpy(he->ip, u->ip, sizeof he->ip);
+		he->addrbits = parse_ip_cidr(u->ip, he->addr, &cidrlen);
 		mowgli_patricia_add(hostlist, he->ip, he);
+		clones_subnet_attach(he);
 	}
 	mowgli_node_add(u, mowgli_node_create(), &he->clients);
 	i = MOWGLI_LIST_LENGTH(&he->clients);
 
-	struct clones_exemption *c = find_exempt(u->ip);
+	if (he->subnet != NULL)
+		he->subnet->count++;
+
+	struct clones_exemption *c = find_exempt(he);
 	if (c == 0)
 	{
 		allowed = clones_allowed;
@@ -741,6 +1057,10 @@ clones_newuser(struct hook_user_nick *data)
 		{
 			struct user *tu = n->data;
 
+			// Nothing more to gain once both limits have hit the cap below
+			if (allowed >= (real_allowed * 2) && warn >= (real_warn * 2))
+				break;
+
 			if (tu->myuser == NULL)
 				continue;
 			if (allowed != 0)
@@ -756,47 +1076,28 @@ clones_newuser(struct hook_user_nick *data)
 			warn = real_warn * 2;
 	}
 
-	if (i > allowed && allowed != 0)
-	{
-		// User has exceeded the maximum number of allowed clones.
-		if (is_autokline_exempt(u))
-			slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (user is autokline exempt)", i, u->ip, u->nick, u->user, u->host);
-		else if (!kline_enabled || he->gracekills < grace_count || (grace_count > 0 && he->firstkill < time(NULL) - CLONES_GRACE_TIMEPERIOD))
-		{
-			if (he->firstkill < time(NULL) - CLONES_GRACE_TIMEPERIOD)
-			{
-				he->firstkill = time(NULL);
-				he->gracekills = 1;
-			}
-			else
-			{
-				he->gracekills++;
-			}
+	if (! clones_enforce(data, &he->grace, u->ip, i, allowed, warn) || he->subnet == NULL)
+		return;
 
-			if (!kline_enabled)
-				slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (TKLINE disabled, killing user)", i, u->ip, u->nick, u->user, u->host);
-			else
-				slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (grace period, killing user, %u grace kills remaining)", i, u->ip, u->nick,
-					u->user, u->host, grace_count - he->gracekills);
+	/* An exemption covering the user also raises the limits for the
+	 * subnet as a whole, so that exempted hosts are not caught by it.
+	 */
+	allowed = cidr_allowed;
+	warn = cidr_warn;
 
-			kill_user(serviceinfo->me, u, "Too many connections from this host.");
-			data->u = NULL; // Required due to kill_user being called during user_add hook. --mr_flea
-		}
-		else
-		{
-			if (! (u->flags & UF_KLINESENT)) {
-				slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (TKLINE due to excess clones)", i, u->ip, u->nick, u->user, u->host);
-				kline_sts("*", "*", u->ip, kline_duration, "Excessive clones");
-				u->flags |= UF_KLINESENT;
-			}
-		}
-
-	}
-	else if (i >= warn && warn != 0)
+	if (c != NULL)
 	{
-		slog(LG_INFO, "CLONES: \2%u\2 clones on \2%s\2 (%s!%s@%s) (\2%u\2 allowed)", i, u->ip, u->nick, u->user, u->host, allowed);
-		msg(serviceinfo->nick, u->nick, _("\2WARNING\2: You may not have more than \2%u\2 clients connected to the network at once. Any further connections risks being removed."), allowed);
+		if (allowed != 0)
+			allowed = (c->allowed > allowed) ? c->allowed : allowed;
+		if (warn != 0)
+			warn = (c->warn > warn) ? c->warn : warn;
 	}
+
+	char mask[HOSTIPLEN + 1];
+
+	clones_subnet_mask(he, mask, sizeof mask);
+
+	(void) clones_enforce(data, &he->subnet->grace, mask, he->subnet->count, allowed, warn);
 }
 
 static void
@@ -820,9 +1121,14 @@ clones_userquit(struct user *u)
 	{
 		mowgli_node_delete(n, &he->clients);
 		mowgli_node_free(n);
+
+		if (he->subnet != NULL)
+			he->subnet->count--;
+
 		if (MOWGLI_LIST_LENGTH(&he->clients) == 0)
 		{
-			// TODO: free later if he->firstkill > time(NULL) - CLONES_GRACE_TIMEPERIOD.
+			// TODO: free later if he->grace.firstkill > time(NULL) - CLONES_GRACE_TIMEPERIOD.
+			clones_subnet_detach(he);
 			mowgli_patricia_delete(hostlist, he->ip);
 			mowgli_heap_free(hostentry_heap, he);
 		}
@@ -951,6 +1257,18 @@ mod_init(struct module *const restrict m)
 		return;
 	}
 
+	if (! (radixnode_heap = mowgli_heap_create(sizeof(struct clones_radixnode), HEAP_USER, BH_NOW)))
+	{
+		(void) slog(LG_ERROR, "%s: mowgli_heap_create() failed", m->name);
+
+		(void) mowgli_patricia_destroy(os_clones_cmds, NULL, NULL);
+		(void) mowgli_patricia_destroy(hostlist, NULL, NULL);
+		(void) mowgli_heap_destroy(hostentry_heap);
+
+		m->mflags |= MODFLAG_FAIL;
+		return;
+	}
+
 	(void) command_add(&os_clones_kline, os_clones_cmds);
 	(void) command_add(&os_clones_list, os_clones_cmds);
 	(void) command_add(&os_clones_addexempt, os_clones_cmds);
@@ -961,6 +1279,11 @@ mod_init(struct module *const restrict m)
 
 	(void) service_named_bind_command("operserv", &os_clones);
 
+	(void) add_uint_conf_item("CLONE_CIDR_IPV4", &serviceinfo->conf_table, 0, &cidr_ipv4_len, 1, 32, 24);
+	(void) add_uint_conf_item("CLONE_CIDR_IPV6", &serviceinfo->conf_table, 0, &cidr_ipv6_len, 1, 128, 64);
+	(void) add_uint_conf_item("CLONE_CIDR_ALLOWED", &serviceinfo->conf_table, 0, &cidr_allowed, 0, INT_MAX, 0);
+	(void) add_uint_conf_item("CLONE_CIDR_WARN", &serviceinfo->conf_table, 0, &cidr_warn, 0, INT_MAX, 0);
+
 	(void) hook_add_config_ready(&clones_configready);
 	(void) hook_add_user_add(&clones_newuser);
 	(void) hook_add_user_delete(&clones_userquit);
@@ -59,12 +59,31 @@ struct Blacklist {
 	mowgli_node_t node;
 };
 
-// A lookup in progress for a particular DNSBL for a particular client
-struct BlacklistClient {
+/* The (cached or in-flight) result of looking up one IP address in one
+ * DNSBL. Clients waiting on the same lookup share a single DNS query.
+ */
+struct BlacklistCacheEntry {
+	char name[IRCD_RES_HOSTLEN + 1];
 	struct Blacklist *blacklist;
-	struct user *u;
+	bool pending;
+	bool listed;
+	bool stale;
+	time_t expires;
 	mowgli_dns_query_t dns_query;
+	mowgli_list_t waiters;
+};
+
+/* A client waiting for a particular DNSBL lookup to complete. The user is
+ * identified by more than the pointer, so that a reply can be checked
+ * against whoever is on the network by the time it arrives.
+ */
+struct BlacklistClient {
+	struct BlacklistCacheEntry *entry;
+	struct user *u;
+	char id[NICKLEN + 1];
+	time_t ts;
 	mowgli_node_t node;
+	mowgli_node_t wnode;
 };
 
 struct dnsbl_exemption
@@ -103,6 +122,16 @@ static mowgli_list_t dnsbl_elist;
 
 static mowgli_dns_t *dns_base = NULL;
 
+static mowgli_patricia_t *dnsbl_cache = NULL;
+static mowgli_eventloop_timer_t *dnsbl_cache_purge_timer = NULL;
+
+static unsigned int dnsbl_cache_ttl;
+static unsigned int dnsbl_negative_ttl;
+
+static unsigned int dnsbl_cache_hits;
+static unsigned int dnsbl_cache_misses;
+static unsigned int dnsbl_cache_coalesced;
+
 static inline mowgli_list_t *
 dnsbl_queries(struct user *u)
 {
@@ -249,22 +278,79 @@ ps_cmd_dnsblexempt(struct sourceinfo *si, int parc, char *parv[])
 	}
 }
 
+// remember who this is, again whenever they change nick (and with it, TS)
+static void
+blacklist_client_track(struct BlacklistClient *blcptr, struct user *u)
+{
+	blcptr->u = u;
+	blcptr->ts = u->ts;
+	mowgli_strlcpy(blcptr->id, (ircd->uses_uid && u->uid != NULL) ? u->uid : u->nick, sizeof blcptr->id);
+}
+
+/* Waiters are dropped when their user quits, but a reply must never act on
+ * a user that has gone, or on a new user who has since been given the same
+ * memory; returns NULL for either.
+ */
+static struct user *
+blacklist_client_user(const struct BlacklistClient *blcptr)
+{
+	struct user *const u = user_find(blcptr->id);
+
+	if (u == NULL || u != blcptr->u || u->ts != blcptr->ts)
+		return NULL;
+
+	return u;
+}
+
+static void
+blacklist_client_free(struct BlacklistClient *blcptr)
+{
+	struct user *const u = blacklist_client_user(blcptr);
+
+	if (u != NULL)
+		mowgli_node_delete(&blcptr->node, dnsbl_queries(u));
+	else
+		slog(LG_DEBUG, "DNSBL: dropping lookup of %s for %s, who is no longer on the network",
+		     blcptr->entry->name, blcptr->id);
+
+	mowgli_node_delete(&blcptr->wnode, &blcptr->entry->waiters);
+	sfree(blcptr);
+}
+
 static void
 abort_blacklist_queries(struct user *u)
 {
 	mowgli_node_t *n, *tn;
 	mowgli_list_t *l = dnsbl_queries(u);
 
+	/* The DNS query itself is left to finish so that its result can be
+	 * cached and handed to any other client waiting on it.
+	 */
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, l->head)
 	{
 		struct BlacklistClient *blcptr = n->data;
 
-		mowgli_dns_delete_query(dns_base, &blcptr->dns_query);
+		mowgli_node_delete(&blcptr->wnode, &blcptr->entry->waiters);
 		mowgli_node_delete(n, l);
 		sfree(blcptr);
 	}
 }
 
+static void
+dnsbl_nickchange(struct hook_user_nick *data)
+{
+	struct user *const u = data->u;
+	mowgli_list_t *l;
+	mowgli_node_t *n;
+
+	if (u == NULL || (l = privatedata_get(u, "dnsbl:queries")) == NULL)
+		return;
+
+	// lookups still in flight must find them under their new nick
+	MOWGLI_ITER_FOREACH(n, l->head)
+		blacklist_client_track(n->data, u);
+}
+
 static void
 dnsbl_hit(struct user *u, struct Blacklist *blptr)
 {
@@ -279,14 +365,16 @@ dnsbl_hit(struct user *u, struct Blacklist *blptr)
 		case DNSBL_ACT_KLINE:
 			if (! (u->flags & UF_KLINESENT)) {
 				slog(LG_INFO, "DNSBL: k-lining \2%s\2!%s@%s [%s] who is listed in DNS Blacklist %s.", u->nick, u->user, u->host, u->gecos, blptr->host);
-				notice(svs->nick, u->nick, "Your IP address %s is listed in DNS Blacklist %s", u->ip, blptr->host);
+				if (svs != NULL)
+					notice(svs->nick, u->nick, "Your IP address %s is listed in DNS Blacklist %s", u->ip, blptr->host);
 				kline_add("*", u->ip, "Banned (DNS Blacklist)", SECONDS_PER_DAY, "Proxyscan");
 				u->flags |= UF_KLINESENT;
 			}
 			break;
 
 		case DNSBL_ACT_NOTIFY:
-			notice(svs->nick, u->nick, "Your IP address %s is listed in DNS Blacklist %s", u->ip, blptr->host);
+			if (svs != NULL)
+				notice(svs->nick, u->nick, "Your IP address %s is listed in DNS Blacklist %s", u->ip, blptr->host);
 			ATHEME_FALLTHROUGH;
 
 		case DNSBL_ACT_SNOOP:
@@ -299,78 +387,158 @@ dnsbl_hit(struct user *u, struct Blacklist *blptr)
 }
 
 static void
-blacklist_dns_callback(mowgli_dns_reply_t *reply, int result, void *vptr)
+blacklist_cache_entry_free(struct BlacklistCacheEntry *entry)
 {
-	struct BlacklistClient *blcptr = (struct BlacklistClient *) vptr;
-	int listed = 0;
-	mowgli_list_t *l;
+	mowgli_node_t *n, *tn;
 
-	if (blcptr == NULL)
-		return;
+	if (entry->pending)
+		mowgli_dns_delete_query(dns_base, &entry->dns_query);
 
-	if (blcptr->u == NULL)
-	{
-		sfree(blcptr);
-		return;
-	}
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, entry->waiters.head)
+		blacklist_client_free(n->data);
+
+	(void) mowgli_patricia_delete(dnsbl_cache, entry->name);
+
+	atheme_object_unref(entry->blacklist);
+	sfree(entry);
+}
+
+static void
+blacklist_dns_callback(mowgli_dns_reply_t *reply, int result, void *vptr)
+{
+	struct BlacklistCacheEntry *entry = vptr;
+	struct Blacklist *blptr = entry->blacklist;
+	mowgli_node_t *n;
 
-	l = dnsbl_queries(blcptr->u);
-	mowgli_node_delete(&blcptr->node, l);
+	entry->pending = false;
+	entry->listed = false;
 
 	if (reply != NULL)
 	{
 		// only accept 127.x.y.z as a listing
 		if (reply->addr.addr.ss_family == AF_INET &&
 				!memcmp(&((struct sockaddr_in *)&reply->addr.addr)->sin_addr, "\177", 1))
-			listed++;
-		else if (blcptr->blacklist->lastwarning + SECONDS_PER_HOUR < CURRTIME)
+			entry->listed = true;
+		else if (blptr->lastwarning + SECONDS_PER_HOUR < CURRTIME)
 		{
 			slog(LG_DEBUG,
 					"Garbage reply from blacklist %s",
-					blcptr->blacklist->host);
-			blcptr->blacklist->lastwarning = CURRTIME;
+					blptr->host);
+			blptr->lastwarning = CURRTIME;
 		}
 	}
 
-	// they have a blacklist entry for this client
-	if (listed)
-		dnsbl_hit(blcptr->u, blcptr->blacklist);
+	/* The resolver does not hand us the record's TTL, so listings are kept
+	 * for the configured cache time and anything else (NXDOMAIN, garbage
+	 * or a failed lookup) for the shorter negative cache time.
+	 */
+	entry->expires = CURRTIME + (entry->listed ? dnsbl_cache_ttl : dnsbl_negative_ttl);
 
-	atheme_object_unref(blcptr->blacklist);
-	sfree(blcptr);
+	(void) atheme_object_ref(blptr);
+
+	/* dnsbl_hit() aborts all other lookups for that client, which may also
+	 * be waiting on this entry, so always take the head of the list afresh.
+	 */
+	while ((n = entry->waiters.head) != NULL)
+	{
+		struct BlacklistClient *blcptr = n->data;
+		struct user *u = blacklist_client_user(blcptr);
+
+		blacklist_client_free(blcptr);
+
+		// they have a blacklist entry for this client
+		if (u != NULL && entry->listed)
+			dnsbl_hit(u, blptr);
+	}
+
+	if (entry->stale || entry->expires <= CURRTIME)
+		blacklist_cache_entry_free(entry);
+
+	atheme_object_unref(blptr);
 }
 
 /* XXX: no IPv6 implementation, not to concerned right now though. */
 /* 2015-12-06: at least we shouldn't crash on bad inputs anymore... -bcode */
-static void
+// returns true if the client was found to be listed in the cache
+static bool
 initiate_blacklist_dnsquery(struct Blacklist *blptr, struct user *u)
 {
 	char buf[IRCD_RES_HOSTLEN + 1];
 	unsigned int ip[4];
-	mowgli_list_t *l;
+	struct BlacklistCacheEntry *entry;
 
 	if (u->ip == NULL)
-		return;
+		return false;
 
 	// A sscanf worked fine for chary for many years, it'll be fine here
 	if (sscanf(u->ip, "%u.%u.%u.%u", &ip[3], &ip[2], &ip[1], &ip[0]) != 4)
-		return;
+		return false;
+
+	// becomes 2.0.0.127.torbl.ahbl.org or whatever
+	snprintf(buf, sizeof buf, "%u.%u.%u.%u.%s", ip[0], ip[1], ip[2], ip[3], blptr->host);
+
+	entry = mowgli_patricia_retrieve(dnsbl_cache, buf);
+
+	if (entry != NULL && entry->blacklist != blptr && ! entry->pending)
+	{
+		// the blacklist was reconfigured since this was cached
+		blacklist_cache_entry_free(entry);
+		entry = NULL;
+	}
+
+	if (entry != NULL && ! entry->pending && entry->expires > CURRTIME)
+	{
+		dnsbl_cache_hits++;
+
+		if (entry->listed)
+			dnsbl_hit(u, blptr);
+
+		return entry->listed;
+	}
+
+	if (entry != NULL && entry->pending)
+		dnsbl_cache_coalesced++;
+	else
+	{
+		dnsbl_cache_misses++;
+
+		if (entry == NULL)
+		{
+			entry = smalloc(sizeof *entry);
+			mowgli_strlcpy(entry->name, buf, sizeof entry->name);
+			entry->blacklist = atheme_object_ref(blptr);
+			mowgli_patricia_add(dnsbl_cache, entry->name, entry);
+		}
+
+		entry->pending = true;
+		entry->dns_query.ptr = entry;
+		entry->dns_query.callback = blacklist_dns_callback;
+
+		mowgli_dns_gethost_byname(dns_base, buf, &entry->dns_query, MOWGLI_DNS_T_A);
+	}
 
 	struct BlacklistClient *blcptr = smalloc(sizeof *blcptr);
 
-	blcptr->blacklist = atheme_object_ref(blptr);
-	blcptr->u = u;
+	blcptr->entry = entry;
+	blacklist_client_track(blcptr, u);
 
-	blcptr->dns_query.ptr = blcptr;
-	blcptr->dns_query.callback = blacklist_dns_callback;
+	mowgli_node_add(blcptr, &blcptr->wnode, &entry->waiters);
+	mowgli_node_add(blcptr, &blcptr->node, dnsbl_queries(u));
 
-	// becomes 2.0.0.127.torbl.ahbl.org or whatever
-	snprintf(buf, sizeof buf, "%u.%u.%u.%u.%s", ip[0], ip[1], ip[2], ip[3], blptr->host);
+	return false;
+}
 
-	mowgli_dns_gethost_byname(dns_base, buf, &blcptr->dns_query, MOWGLI_DNS_T_A);
+static void
+dnsbl_cache_purge(void *unused)
+{
+	struct BlacklistCacheEntry *entry;
+	mowgli_patricia_iteration_state_t state;
 
-	l = dnsbl_queries(u);
-	mowgli_node_add(blcptr, &blcptr->node, l);
+	MOWGLI_PATRICIA_FOREACH(entry, &state, dnsbl_cache)
+	{
+		if (! entry->pending && entry->expires <= CURRTIME)
+			blacklist_cache_entry_free(entry);
+	}
 }
 
 static void
@@ -385,7 +553,8 @@ lookup_blacklists(struct user *u)
 		if (u == NULL)
 			return;
 
-		initiate_blacklist_dnsquery(blptr, u);
+		if (initiate_blacklist_dnsquery(blptr, u))
+			return;
 	}
 }
 
@@ -490,7 +659,19 @@ dnsbl_config_handler(mowgli_config_file_entry_t *ce)
 static void
 dnsbl_config_purge(void *unused)
 {
+	struct BlacklistCacheEntry *entry;
+	mowgli_patricia_iteration_state_t state;
+
 	destroy_blacklists();
+
+	// the list of blacklists may change, so start over with an empty cache
+	MOWGLI_PATRICIA_FOREACH(entry, &state, dnsbl_cache)
+	{
+		if (entry->pending)
+			entry->stale = true;
+		else
+			blacklist_cache_entry_free(entry);
+	}
 }
 
 static int
@@ -557,6 +738,10 @@ osinfo_hook(struct sourceinfo *si)
 
 		command_success_nodata(si, _("Using DNSBL: %s"), blptr->host);
 	}
+
+	command_success_nodata(si, _("DNSBL cache: %u entries, %u hits, %u misses, %u coalesced lookups"),
+	                       mowgli_patricia_size(dnsbl_cache), dnsbl_cache_hits, dnsbl_cache_misses,
+	                       dnsbl_cache_coalesced);
 }
 
 static void
@@ -642,6 +827,14 @@ mod_init(struct module *const restrict m)
 		return;
 	}
 
+	if (! (dnsbl_cache = mowgli_patricia_create(&strcasecanon)))
+	{
+		(void) slog(LG_ERROR, "%s: mowgli_patricia_create() failed", m->name);
+		(void) mowgli_dns_destroy(dns_base);
+		m->mflags |= MODFLAG_FAIL;
+		return;
+	}
+
 	struct service *proxyscan = service_find("proxyscan");
 
 	hook_add_db_write(write_dnsbl_exempt_db);
@@ -654,10 +847,15 @@ mod_init(struct module *const restrict m)
 	hook_add_config_purge(dnsbl_config_purge);
 	hook_add_user_add(check_dnsbls);
 	hook_add_user_delete(abort_blacklist_queries);
+	hook_add_user_nickchange(dnsbl_nickchange);
 	hook_add_operserv_info(osinfo_hook);
 
 	add_conf_item("DNSBL_ACTION", &proxyscan->conf_table, dnsbl_action_config_handler);
 	add_conf_item("BLACKLISTS", &proxyscan->conf_table, dnsbl_config_handler);
+	add_duration_conf_item("DNSBL_CACHE_TTL", &proxyscan->conf_table, 0, &dnsbl_cache_ttl, "m", SECONDS_PER_HOUR);
+	add_duration_conf_item("DNSBL_NEGATIVE_TTL", &proxyscan->conf_table, 0, &dnsbl_negative_ttl, "m", 10 * SECONDS_PER_MINUTE);
+
+	dnsbl_cache_purge_timer = mowgli_timer_add(base_eventloop, "dnsbl_cache_purge", &dnsbl_cache_purge, NULL, SECONDS_PER_MINUTE);
 
 	command_add(&os_set_dnsblaction, *os_set_cmdtree);
 
@@ -667,6 +865,15 @@ mod_init(struct module *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
+	struct BlacklistCacheEntry *entry;
+	mowgli_patricia_iteration_state_t state;
+
+	mowgli_timer_destroy(base_eventloop, dnsbl_cache_purge_timer);
+
+	MOWGLI_PATRICIA_FOREACH(entry, &state, dnsbl_cache)
+		blacklist_cache_entry_free(entry);
+
+	mowgli_patricia_destroy(dnsbl_cache, NULL, NULL);
 	mowgli_dns_destroy(dns_base);
 
 	struct service *proxyscan;
@@ -674,6 +881,7 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	hook_del_db_write(write_dnsbl_exempt_db);
 	hook_del_user_add(check_dnsbls);
 	hook_del_user_delete(abort_blacklist_queries);
+	hook_del_user_nickchange(dnsbl_nickchange);
 	hook_del_config_purge(dnsbl_config_purge);
 	hook_del_operserv_info(osinfo_hook);
 
@@ -683,6 +891,8 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 
 	del_conf_item("DNSBL_ACTION", &proxyscan->conf_table);
 	del_conf_item("BLACKLISTS", &proxyscan->conf_table);
+	del_conf_item("DNSBL_CACHE_TTL", &proxyscan->conf_table);
+	del_conf_item("DNSBL_NEGATIVE_TTL", &proxyscan->conf_table);
 
 	command_delete(&os_set_dnsblaction, *os_set_cmdtree);
 
@@ -44,6 +44,7 @@ my %perl_api_types = (
 	'char *' => [ sub { "sv_setpv($_[0], $_[1]);" }, sub { die "Don't know how to unmarshal a read-write string"; } ],
 	'const char *' => [ sub { "sv_setpv($_[0], $_[1]);" }, sub { die "Don't know how to unmarshal a read-write string"; } ],
 	'int' => [ sub { "sv_setiv($_[0], $_[1]);" }, sub { "$_[1] = SvIV($_[0]);" } ],
+	'unsigned int' => [ sub { "sv_setuv($_[0], $_[1]);" }, sub { "$_[1] = SvUV($_[0]);" } ],
 	'time_t' => [ sub { "sv_setiv($_[0], $_[1]);" }, sub { "$_[1]= SvIV($_[0]);" } ],
 );
 
@@ -87,6 +88,11 @@ my %hook_structs = (
 		'si'            => [ 'struct sourceinfo', 'source' ],
 	},
 
+	'struct hook_channel_split' => {
+		'chan'          => [ 'struct channel', 'channel' ],
+		'parting'       => 'unsigned int',
+	},
+
 	'struct hook_channel_succession_req' => {
 		'mc'            => [ 'struct mychan', 'channel' ],
 		'mu'            => [ 'struct myuser', '+account' ],
@@ -10,91 +10,162 @@
 #include <atheme.h>
 #include "jsonrpclib.h"
 
-void
-jsonrpc_process(char *buffer, void *userdata)
+/* Replies to the calls in a batch are collected here, instead of each
+ * being sent as an HTTP response of its own, and go out together as one
+ * array once the whole batch has run.
+ */
+static mowgli_string_t *jsonrpc_batch = NULL;
+
+bool
+jsonrpc_batch_add(const char *str)
 {
-	if (!buffer)
+	if (jsonrpc_batch == NULL)
+		return false;
+
+	if (jsonrpc_batch->pos > 1)
+		mowgli_string_append_char(jsonrpc_batch, ',');
+
+	mowgli_string_append(jsonrpc_batch, str, strlen(str));
+
+	return true;
+}
+
+static void
+jsonrpc_call(void *userdata, mowgli_json_t *request)
+{
+	mowgli_patricia_t *obj;
+	mowgli_json_t *method, *params, *id, *param;
+	mowgli_list_t *params_list, *params_str;
+	mowgli_node_t *n;
+	jsonrpc_method_fn call_method;
+	char *id_str = NULL;
+
+	// JSON RPC works with JSON objects only, anything else can't be correct.
+	if (MOWGLI_JSON_TAG(request) != MOWGLI_JSON_TAG_OBJECT)
 	{
+		jsonrpc_failure_string(userdata, JSONRPC_INVALID_REQUEST, "Invalid request", NULL);
 		return;
 	}
 
-	mowgli_json_t *parsed = mowgli_json_parse_string(buffer);
+	obj = MOWGLI_JSON_OBJECT(request);
+
+	method = mowgli_patricia_retrieve(obj, "method");
+	params = mowgli_patricia_retrieve(obj, "params");
+	id = mowgli_patricia_retrieve(obj, "id");
+
+	if (id != NULL && MOWGLI_JSON_TAG(id) == MOWGLI_JSON_TAG_STRING)
+		id_str = MOWGLI_JSON_STRING_STR(id);
 
-	if (parsed == NULL) {
+	if (id_str == NULL || method == NULL || params == NULL ||
+			MOWGLI_JSON_TAG(method) != MOWGLI_JSON_TAG_STRING ||
+			MOWGLI_JSON_TAG(params) != MOWGLI_JSON_TAG_ARRAY)
+	{
+		jsonrpc_failure_string(userdata, JSONRPC_INVALID_REQUEST, "Invalid request", id_str);
 		return;
 	}
 
-	mowgli_json_tag_t tag = MOWGLI_JSON_TAG(parsed);
+	params_list = MOWGLI_JSON_ARRAY(params);
 
-	//JSON RPC works with JSON objects only, anything else can't be correct.
+	MOWGLI_LIST_FOREACH(n, params_list->head)
+	{
+		param = n->data;
+
+		if (MOWGLI_JSON_TAG(param) != MOWGLI_JSON_TAG_STRING)
+		{
+			jsonrpc_failure_string(userdata, fault_badparams, "Invalid parameters", id_str);
+			return;
+		}
+	}
 
-	if (tag != MOWGLI_JSON_TAG_OBJECT)
+	call_method = get_json_method(MOWGLI_JSON_STRING_STR(method));
+
+	if (call_method == NULL)
 	{
+		jsonrpc_failure_string(userdata, fault_badparams, "Invalid command", id_str);
 		return;
 	}
 
-	mowgli_patricia_t *obj = MOWGLI_JSON_OBJECT(parsed);
+	params_str = mowgli_list_create();
 
-	if (parsed == NULL)
+	MOWGLI_LIST_FOREACH(n, params_list->head)
 	{
-		return;
+		param = n->data;
+
+		mowgli_node_add(MOWGLI_JSON_STRING_STR(param), mowgli_node_create(), params_str);
 	}
 
-	mowgli_json_t *method = mowgli_patricia_retrieve(obj, "method");
-	mowgli_json_t *params = mowgli_patricia_retrieve(obj, "params");
-	mowgli_json_t *id = mowgli_patricia_retrieve(obj, "id");
+	call_method(userdata, params_str, id_str);
+
+	mowgli_list_free(params_str);
+}
+
+/* Every HTTP request gets exactly one response, even if it is only an
+ * error, so that the responses to pipelined requests on a keep-alive
+ * connection stay in step with them.
+ */
+void
+jsonrpc_process(char *buffer, void *userdata)
+{
+	mowgli_json_t *parsed;
+	mowgli_list_t *requests;
+	mowgli_node_t *n;
 
-	char *method_str, *id_str;
-	mowgli_list_t *params_list;
+	if (!buffer)
+	{
+		return;
+	}
 
-	if (id == NULL || params == NULL || method == NULL)
+	if ((parsed = mowgli_json_parse_string(buffer)) == NULL)
 	{
+		jsonrpc_failure_string(userdata, JSONRPC_PARSE_ERROR, "Parse error", NULL);
 		return;
 	}
 
-	if (MOWGLI_JSON_TAG(method) != MOWGLI_JSON_TAG_STRING ||
-			MOWGLI_JSON_TAG(id) != MOWGLI_JSON_TAG_STRING ||
-			MOWGLI_JSON_TAG(params) != MOWGLI_JSON_TAG_ARRAY)
+	if (MOWGLI_JSON_TAG(parsed) != MOWGLI_JSON_TAG_ARRAY)
 	{
+		jsonrpc_call(userdata, parsed);
+		mowgli_json_decref(parsed);
 		return;
 	}
 
-	method_str = MOWGLI_JSON_STRING_STR(method);
-	id_str = MOWGLI_JSON_STRING_STR(id);
-	params_list = MOWGLI_JSON_ARRAY(params);
+	requests = MOWGLI_JSON_ARRAY(parsed);
 
-	mowgli_json_t *param;
-	mowgli_node_t *n;
+	if (MOWGLI_LIST_LENGTH(requests) == 0)
+	{
+		jsonrpc_failure_string(userdata, JSONRPC_INVALID_REQUEST, "Invalid request", NULL);
+		mowgli_json_decref(parsed);
+		return;
+	}
 
-	jsonrpc_method_fn call_method = get_json_method(method_str);
+	mowgli_string_t *batch = jsonrpc_batch = mowgli_string_create();
 
-	MOWGLI_LIST_FOREACH(n, params_list->head)
+	mowgli_string_append_char(batch, '[');
+
+	MOWGLI_LIST_FOREACH(n, requests->head)
 	{
-		param = n->data;
+		jsonrpc_call(userdata, n->data);
+	}
 
-		if (MOWGLI_JSON_TAG(param) != MOWGLI_JSON_TAG_STRING) {
-			continue;
-		}
+	mowgli_string_append_char(batch, ']');
+	jsonrpc_batch = NULL;
 
-	}
+	jsonrpc_send_data(userdata, batch->str);
 
-	mowgli_list_t *params_str = mowgli_list_create();
+	mowgli_string_destroy(batch);
+	mowgli_json_decref(parsed);
+}
 
-	MOWGLI_LIST_FOREACH(n, params_list->head)
-	{
-		param = n->data;
+void
+jsonrpc_send_object(void *conn, mowgli_json_t *obj)
+{
+	mowgli_string_t *str = mowgli_string_create();
 
-		char *param_str = MOWGLI_JSON_STRING_STR(param);
-		mowgli_node_add(param_str, mowgli_node_create(), params_str);
-	}
+	mowgli_json_serialize_to_string(obj, str, 0);
 
-	if (call_method != NULL) {
-		call_method(userdata, params_str, id_str);
-	} else {
-		jsonrpc_failure_string(userdata, fault_badparams, "Invalid command", id_str);
-		return;
-	}
+	jsonrpc_send_data(conn, str->str);
 
+	mowgli_string_destroy(str);
+	mowgli_json_decref(obj);
 }
 
 void
@@ -105,17 +176,13 @@ jsonrpc_success_string(void *conn, const char *result, const char *id)
 	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(obj);
 
 	mowgli_json_t *resultobj = mowgli_json_create_string(result);
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
+	mowgli_json_t *idobj = (id != NULL) ? mowgli_json_create_string(id) : mowgli_json_null;
 
 	mowgli_patricia_add(patricia, "result", resultobj);
 	mowgli_patricia_add(patricia, "id", idobj);
 	mowgli_patricia_add(patricia, "error", mowgli_json_null);
 
-	mowgli_string_t *str = mowgli_string_create();
-
-	mowgli_json_serialize_to_string(obj, str, 0);
-
-	jsonrpc_send_data(conn, str->str);
+	jsonrpc_send_object(conn, obj);
 }
 
 void
@@ -131,17 +198,13 @@ jsonrpc_failure_string(void *conn, int code, const char *error, const char *id)
 
 	patricia = MOWGLI_JSON_OBJECT(obj);
 
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
+	mowgli_json_t *idobj = (id != NULL) ? mowgli_json_create_string(id) : mowgli_json_null;
 
 	mowgli_patricia_add(patricia, "result", mowgli_json_null);
 	mowgli_patricia_add(patricia, "id", idobj);
 	mowgli_patricia_add(patricia, "error", errorobj);
 
-	mowgli_string_t *str = mowgli_string_create();
-
-	mowgli_json_serialize_to_string(obj, str, 0);
-
-	jsonrpc_send_data(conn, str->str);
+	jsonrpc_send_object(conn, obj);
 }
 
 char * ATHEME_FATTR_MALLOC
@@ -12,13 +12,11 @@
 
 #include <atheme.h>
 
-typedef bool (*jsonrpc_method_fn)(void *conn, mowgli_list_t *params, char *id);
+// JSON-RPC 2.0 error codes, for requests which never get as far as a method
+#define JSONRPC_PARSE_ERROR             (-32700)
+#define JSONRPC_INVALID_REQUEST         (-32600)
 
-struct jsonrpc_sourceinfo
-{
-    struct sourceinfo *base;
-    char *id;
-};
+typedef bool (*jsonrpc_method_fn)(void *conn, mowgli_list_t *params, char *id);
 
 char *jsonrpc_normalizeBuffer(const char *buf) ATHEME_FATTR_MALLOC;
 
@@ -28,6 +26,8 @@ void jsonrpc_process(char *buffer, void *userdata);
 void jsonrpc_register_method(const char *method_name, bool (*method)(void *conn, mowgli_list_t *params, char *id));
 void jsonrpc_unregister_method(const char *method_name);
 void jsonrpc_send_data(void *conn, char *str);
+void jsonrpc_send_object(void *conn, mowgli_json_t *obj);
+bool jsonrpc_batch_add(const char *str);
 void jsonrpc_success_string(void *conn, const char *str, const char *id);
 void jsonrpc_failure_string(void *conn, int code, const char *str, const char *id);
 
@@ -10,7 +10,7 @@
 #include <atheme.h>
 #include "jsonrpclib.h"
 
-static mowgli_list_t *httpd_path_handlers = NULL;
+static const struct httpd_core_functions *httpd_core_functions = NULL;
 static mowgli_patricia_t *json_methods = NULL;
 
 void
@@ -44,9 +44,7 @@ jsonrpc_command_fail(struct sourceinfo *si, enum cmd_faultcode code, const char
 		return;
 	newmessage = jsonrpc_normalizeBuffer(message);
 
-	struct jsonrpc_sourceinfo *jsi = (struct jsonrpc_sourceinfo *)si;
-
-	jsonrpc_failure_string(cptr, code, newmessage, jsi->id);
+	jsonrpc_failure_string(cptr, code, newmessage, si->callerdata);
 
 	sfree(newmessage);
 	hd->sent_reply = true;
@@ -63,9 +61,7 @@ jsonrpc_command_success_string(struct sourceinfo *si, const char *result, const
 	if (hd->sent_reply)
 		return;
 
-	struct jsonrpc_sourceinfo *jsi = (struct jsonrpc_sourceinfo *)si;
-
-	jsonrpc_success_string(cptr, result, jsi->id);
+	jsonrpc_success_string(cptr, result, si->callerdata);
 	hd->sent_reply = true;
 }
 
@@ -167,17 +163,13 @@ jsonrpcmethod_login(void *conn, mowgli_list_t *params, char *id)
 
 		si = sourceinfo_create();
 
-		struct jsonrpc_sourceinfo *jsi = (struct jsonrpc_sourceinfo *)si;
-
 		si->service = NULL;
 		si->sourcedesc = sourceip;
 		si->connection = conn;
 		si->v = &jsonrpc_vtable;
+		si->callerdata = id;
 		si->force_language = language_find("en");
 
-		jsi->base = si;
-		jsi->id = id;
-
 		bad_password(si, mu);
 
 		atheme_object_unref(si);
@@ -348,17 +340,16 @@ jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id)
 
 	si = sourceinfo_create();
 
-	struct jsonrpc_sourceinfo *jsi = (struct jsonrpc_sourceinfo *)si;
-
 	si->smu = mu;
 	si->service = svs;
 	si->sourcedesc = sourceip[0] != '\0' ? sourceip : NULL;
 	si->connection = conn;
 	si->v = &jsonrpc_vtable;
+	si->callerdata = id;
 	si->force_language = language_find("en");
 
-	jsi->base = si;
-	jsi->id = id;
+	// the calls in a batch share the connection's reply state
+	hd->sent_reply = false;
 
 	command_exec(svs, si, cmd, newparc-5, newparv);
 
@@ -371,6 +362,9 @@ jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id)
 			jsonrpc_failure_string(conn, fault_unimplemented, "Command did not return a result", id);
 	}
 
+	sfree(hd->replybuf);
+	hd->replybuf = NULL;
+
 	atheme_object_unref(si);
 
 	return 0;
@@ -500,11 +494,7 @@ jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 		mowgli_patricia_add(patricia, "id", idobj);
 		mowgli_patricia_add(patricia, "error", mowgli_json_null);
 
-		mowgli_string_t *str = mowgli_string_create();
-
-		mowgli_json_serialize_to_string(obj, str, 0);
-
-		jsonrpc_send_data(conn, str->str);
+		jsonrpc_send_object(conn, obj);
 
 		return 0;
 	}
@@ -524,11 +514,7 @@ jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 	mowgli_patricia_add(patricia, "id", idobj);
 	mowgli_patricia_add(patricia, "error", mowgli_json_null);
 
-	mowgli_string_t *str = mowgli_string_create();
-
-	mowgli_json_serialize_to_string(obj, str, 0);
-
-	jsonrpc_send_data(conn, str->str);
+	jsonrpc_send_object(conn, obj);
 
 	return 0;
 }
@@ -613,6 +599,105 @@ jsonrpcmethod_metadata(void *conn, mowgli_list_t *params, char *id)
 	return 0;
 }
 
+static mowgli_json_t *
+jsonrpc_create_size(const size_t value)
+{
+	return mowgli_json_create_integer((value > INT_MAX) ? INT_MAX : (int) value);
+}
+
+static void
+jsonrpc_memstats_add(const struct memtag *const restrict tag, void *const restrict privdata)
+{
+	mowgli_patricia_t *const patricia = privdata;
+	mowgli_json_t *const tagobj = mowgli_json_create_object();
+	mowgli_patricia_t *const tagpatricia = MOWGLI_JSON_OBJECT(tagobj);
+	char name[BUFSIZE];
+
+	(void) snprintf(name, sizeof name, "%s/%s", tag->owner, tag->name);
+
+	// JSON integers here are ints, so sizes go out in KiB
+	mowgli_patricia_add(tagpatricia, "objects", jsonrpc_create_size(tag->objects));
+	mowgli_patricia_add(tagpatricia, "kib", jsonrpc_create_size((tag->bytes + 1023U) / 1024U));
+	mowgli_patricia_add(tagpatricia, "peak_kib", jsonrpc_create_size((tag->peak + 1023U) / 1024U));
+
+	mowgli_patricia_add(patricia, name, tagobj);
+}
+
+/* atheme.memstats
+ *
+ * JSON inputs:
+ *       authcookie, account name
+ *
+ * JSON outputs:
+ *       An object with a property per memory accounting tag, named
+ *       owner/tag (e.g. core/users), each an object with the properties:
+ *       objects: integer: number of objects currently allocated
+ *       kib: integer: KiB currently allocated
+ *       peak_kib: integer: most KiB ever allocated at once
+ */
+static bool
+jsonrpcmethod_memstats(void *conn, mowgli_list_t *params, char *id)
+{
+	struct myuser *mu;
+	mowgli_node_t *n;
+
+	char *param, *accountname, *cookie;
+
+	size_t len = MOWGLI_LIST_LENGTH(params);
+	cookie = mowgli_node_nth_data(params, 0);
+	accountname = mowgli_node_nth_data(params, 1);
+
+	MOWGLI_LIST_FOREACH(n, params->head)
+	{
+		param = n->data;
+
+		if (*param == '\0' || strchr(param, '\r') || strchr(param, '\n'))
+		{
+			jsonrpc_failure_string(conn, fault_badparams, "Invalid authcookie for this account.", id);
+			return 0;
+		}
+	}
+
+	if (len < 2)
+	{
+		jsonrpc_failure_string(conn, fault_needmoreparams, "Insufficient parameters.", id);
+		return 0;
+	}
+
+	if ((mu = myuser_find(accountname)) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_source, "Unknown user.", id);
+		return 0;
+	}
+
+	if (authcookie_validate(cookie, mu) == false)
+	{
+		jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
+		return 0;
+	}
+
+	if (!has_priv_myuser(mu, PRIV_SERVER_AUSPEX))
+	{
+		jsonrpc_failure_string(conn, fault_noprivs, "You do not have sufficient privileges.", id);
+		return 0;
+	}
+
+	mowgli_json_t *resultobj = mowgli_json_create_object();
+
+	memtag_foreach(&jsonrpc_memstats_add, MOWGLI_JSON_OBJECT(resultobj));
+
+	mowgli_json_t *obj = mowgli_json_create_object();
+	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(obj);
+
+	mowgli_patricia_add(patricia, "result", resultobj);
+	mowgli_patricia_add(patricia, "id", mowgli_json_create_string(id));
+	mowgli_patricia_add(patricia, "error", mowgli_json_null);
+
+	jsonrpc_send_object(conn, obj);
+
+	return 0;
+}
+
 void
 jsonrpc_send_data(void *conn, char *str)
 {
@@ -620,6 +705,9 @@ jsonrpc_send_data(void *conn, char *str)
 
 	char buf[300];
 
+	if (jsonrpc_batch_add(str))
+		return;
+
 	size_t len = strlen(str);
 
 	snprintf(buf, sizeof buf,
@@ -654,10 +742,10 @@ static struct path_handler handle_jsonrpc = { NULL, handle_request };
 static void
 mod_init(struct module *const restrict m)
 {
-	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handlers, "misc/httpd", "httpd_path_handlers")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_core_functions, "misc/httpd", "httpd_core_functions")
 
 	handle_jsonrpc.path = "/jsonrpc";
-	mowgli_node_add(&handle_jsonrpc, mowgli_node_create(), httpd_path_handlers);
+	httpd_core_functions->route_add(&handle_jsonrpc);
 
 	json_methods = mowgli_patricia_create(strcasecanon);
 
@@ -668,14 +756,13 @@ mod_init(struct module *const restrict m)
 	jsonrpc_register_method("atheme.privset", jsonrpcmethod_privset);
 	jsonrpc_register_method("atheme.ison", jsonrpcmethod_ison);
 	jsonrpc_register_method("atheme.metadata", jsonrpcmethod_metadata);
+	jsonrpc_register_method("atheme.memstats", jsonrpcmethod_memstats);
 
 }
 
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	mowgli_node_t *n;
-
 	jsonrpc_unregister_method("atheme.login");
 	jsonrpc_unregister_method("atheme.logout");
 	jsonrpc_unregister_method("atheme.command");
@@ -683,12 +770,9 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	jsonrpc_unregister_method("atheme.privset");
 	jsonrpc_unregister_method("atheme.ison");
 	jsonrpc_unregister_method("atheme.metadata");
+	jsonrpc_unregister_method("atheme.memstats");
 
-	if ((n = mowgli_node_find(&handle_jsonrpc, httpd_path_handlers)) != NULL)
-	{
-		mowgli_node_delete(n, httpd_path_handlers);
-		mowgli_node_free(n);
-	}
+	httpd_core_functions->route_del(&handle_jsonrpc);
 }
 
 SIMPLE_DECLARE_MODULE_V1("transport/jsonrpc", MODULE_UNLOAD_CAPABILITY_OK)
@@ -16,7 +16,7 @@ static struct {
 
 static struct connection *current_cptr = NULL; // XXX: Hack: src/xmlrpc.c requires us to do this
 
-static mowgli_list_t *httpd_path_handlers = NULL;
+static const struct httpd_core_functions *httpd_core_functions = NULL;
 
 // Configuration
 static mowgli_list_t conf_xmlrpc_table;
@@ -69,13 +69,8 @@ xmlrpc_config_ready(void *vptr)
 	 */
 	handle_xmlrpc.path = xmlrpc_config.path;
 
-	if (handle_xmlrpc.handler != NULL)
-	{
-		if (mowgli_node_find(&handle_xmlrpc, httpd_path_handlers))
-			return;
-
-		mowgli_node_add(&handle_xmlrpc, mowgli_node_create(), httpd_path_handlers);
-	}
+	if (handle_xmlrpc.path != NULL)
+		httpd_core_functions->route_add(&handle_xmlrpc);
 	else
 		slog(LG_ERROR, "xmlrpc_config_ready(): xmlrpc {} block missing or invalid");
 }
@@ -562,7 +557,7 @@ xmlrpcmethod_metadata(void *conn, int parc, char *parv[])
 static void
 mod_init(struct module *const restrict m)
 {
-	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handlers, "misc/httpd", "httpd_path_handlers")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_core_functions, "misc/httpd", "httpd_core_functions")
 
 	hook_add_config_ready(xmlrpc_config_ready);
 
@@ -584,8 +579,6 @@ mod_init(struct module *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	mowgli_node_t *n;
-
 	xmlrpc_unregister_method("atheme.login");
 	xmlrpc_unregister_method("atheme.logout");
 	xmlrpc_unregister_method("atheme.command");
@@ -593,11 +586,7 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	xmlrpc_unregister_method("atheme.ison");
 	xmlrpc_unregister_method("atheme.metadata");
 
-	if ((n = mowgli_node_find(&handle_xmlrpc, httpd_path_handlers)) != NULL)
-	{
-		mowgli_node_delete(n, httpd_path_handlers);
-		mowgli_node_free(n);
-	}
+	httpd_core_functions->route_del(&handle_xmlrpc);
 
 	del_conf_item("PATH", &conf_xmlrpc_table);
 	del_top_conf("XMLRPC");
@@ -40,105 +40,346 @@ xmlrpc_getlast_error(void)
 	return xmlrpc_error_code;
 }
 
-/**
- * Parse Data down to just the <xml> without any \r\n or \t
- * @param buffer Incoming data buffer
- * @return cleaned up buffer
+/*
+ * Requests are parsed in one pass over the buffer handed to us by httpd,
+ * without copying it: the method name and each parameter are decoded in
+ * place (entities are expanded and control characters dropped, which can
+ * only ever make them shorter) and NUL-terminated where they end, and the
+ * parameter vector is a fixed array. Nothing is allocated, and a request
+ * can only be as large as httpd allows a request body to be.
  */
-static char *
-xmlrpc_parse(char *buffer)
+
+#define XMLRPC_MAX_PARAMS       64
+
+struct xmlrpc_request
 {
-	char *tmp = NULL;
+	char *          method;
+	char *          av[XMLRPC_MAX_PARAMS];
+	int             ac;
+	bool            overflow;       // more than XMLRPC_MAX_PARAMS values
+	bool            truncated;      // the document ended inside a tag or its text
+};
 
-	/*
-	   Okay since the buffer could contain
-	   HTTP header information, lets break
-	   off at the point that the <?xml?> starts
-	 */
-	tmp = strstr(buffer, "<?xml");
+/* Decoded text goes through here. Like xmlrpc_normalizeBuffer(), this drops
+ * colour codes and all other control characters, so that nothing in a
+ * request can end or reformat a line it is later sent to IRC in.
+ */
+struct xmlrpc_text
+{
+	char *          out;
+	unsigned int    colour;         // how far into a colour code we are
+};
 
-	// check if its xml doc
-	if (tmp)
+static void
+xmlrpc_text_put(struct xmlrpc_text *t, char c)
+{
+	const bool digit = isdigit((unsigned char) c);
+
+	switch (t->colour)
 	{
-		// get all the odd characters out of the data
-		return xmlrpc_normalizeBuffer(tmp);
+		case 1:
+			// just after ^C, a foreground colour may follow
+			t->colour = digit ? 2 : 0;
+			break;
+		case 2:
+			t->colour = digit ? 3 : (c == ',') ? 4 : 0;
+			break;
+		case 3:
+			t->colour = (c == ',') ? 4 : 0;
+			break;
+		case 4:
+			// just after the comma, a background colour may follow
+			t->colour = digit ? 5 : 0;
+			if (digit)
+				return;
+			break;
+		case 5:
+			t->colour = 0;
+			if (digit)
+				return;
+			break;
 	}
-	return NULL;
+
+	if (t->colour > 1)
+		return;
+
+	if (c == 3)
+		t->colour = 1;
+	else if ((unsigned char) c > 31)
+		*t->out++ = c;
+}
+
+static inline bool
+xmlrpc_text_is(const char *p, const char *s)
+{
+	while (*s != '\0' && *p == *s)
+		p++, s++;
+
+	return *s == '\0';
 }
 
+// expands the entity at p (which is at a '&'), returning where to carry on
 static char *
-xmlrpc_method(char *buffer)
+xmlrpc_text_entity(struct xmlrpc_text *t, char *p)
 {
-	char *data, *p, *name;
-	int namelen;
+	unsigned long cp;
+	char *end;
+	char c = '\0';
+	size_t len = 0;
+
+	// requests are full of these, so they are picked out without calling anything
+	switch (p[1])
+	{
+		case 'l':
+			if (xmlrpc_text_is(p + 2, "t;"))
+				c = '<', len = 4;
+			break;
+		case 'g':
+			if (xmlrpc_text_is(p + 2, "t;"))
+				c = '>', len = 4;
+			break;
+		case 'a':
+			if (xmlrpc_text_is(p + 2, "mp;"))
+				c = '&', len = 5;
+			else if (xmlrpc_text_is(p + 2, "pos;"))
+				c = '\'', len = 6;
+			break;
+		case 'q':
+			if (xmlrpc_text_is(p + 2, "uot;"))
+				c = '"', len = 6;
+			break;
+	}
 
-	data = strstr(buffer, "<methodName>");
-	if (data)
+	if (len)
 	{
-		data += 12;
-		p = strchr(data, '<');
-		if (p == NULL)
-			return NULL;
-		namelen = p - data;
-		name = smalloc(namelen + 1);
-		memcpy(name, data, namelen);
-		return name;
+		// none of these can be part of a colour code
+		t->colour = 0;
+		*t->out++ = c;
+		return p + len;
 	}
-	return NULL;
+
+	if (p[1] != '#')
+	{
+		// not an entity we know; keep the ampersand
+		xmlrpc_text_put(t, *p);
+		return p + 1;
+	}
+
+	if ((p[2] == 'x' || p[2] == 'X') && isxdigit((unsigned char) p[3]))
+		cp = strtoul(p + 3, &end, 16);
+	else if (isdigit((unsigned char) p[2]))
+		cp = strtoul(p + 2, &end, 10);
+	else
+		end = NULL;
+
+	if (end == NULL || *end != ';')
+	{
+		xmlrpc_text_put(t, *p);
+		return p + 1;
+	}
+
+	/* Below 256, a reference is a byte, which is how we encode anything
+	 * that is not ASCII in our replies. Above that, it is a code point,
+	 * and its UTF-8 form is never longer than the reference was.
+	 */
+	if (cp < 0x100)
+		xmlrpc_text_put(t, (char) cp);
+	else if (cp < 0x800)
+	{
+		*t->out++ = (char) (0xC0 | (cp >> 6));
+		*t->out++ = (char) (0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000)
+	{
+		*t->out++ = (char) (0xE0 | (cp >> 12));
+		*t->out++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+		*t->out++ = (char) (0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x110000)
+	{
+		*t->out++ = (char) (0xF0 | (cp >> 18));
+		*t->out++ = (char) (0x80 | ((cp >> 12) & 0x3F));
+		*t->out++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+		*t->out++ = (char) (0x80 | (cp & 0x3F));
+	}
+
+	return end + 1;
 }
 
-/* Splits up a series of values into an array of strings.
- * The given buffer is modified and the pointers in the array point to
- * parts of the buffer. The array itself is dynamically allocated.
- * Returns the number of values placed in the array.
- * Largely rewritten by jilles 20080803
+/* Decodes the character data starting at p in place, up to the next tag,
+ * and NUL-terminates it. Returns the position of that tag's '<', which the
+ * terminator may have overwritten, or NULL if the document ends first.
  */
-static int
-xmlrpc_split_buf(char *buffer, char ***argv)
-{
-	int ac = 0;
-	int argvsize = 8;
-	char *data, *str;
-	char *nexttag = NULL;
-	char *p;
-	int tagtype = 0;
-
-	data = buffer;
-	*argv = smalloc(sizeof(char *) * argvsize);
-	while ((data = strstr(data, "<value>")))
-	{
-		data += 7;
-		nexttag = strchr(data, '<');
-		if (nexttag == NULL)
-			break;
-		nexttag++;
-		p = strchr(nexttag, '>');
-		if (p == NULL)
+static char *
+xmlrpc_text_decode(char *p)
+{
+	struct xmlrpc_text t = { .out = p, .colour = 0 };
+	bool tag;
+
+	for (;;)
+	{
+		// most text is runs of ordinary characters, which need no looking at
+		if (t.colour == 0)
+			while ((unsigned char) *p > 31 && *p != '<' && *p != '&')
+				*t.out++ = *p++;
+
+		if (*p == '<' || *p == '\0')
 			break;
-		*p++ = '\0';
 
-		// strings
-		if (!stricmp("string", nexttag))
-			tagtype = 1;
+		if (*p == '&')
+			p = xmlrpc_text_entity(&t, p);
 		else
-			tagtype = 0;
-		str = p;
-		p = strchr(str, '<');
-		if (p == NULL)
+			xmlrpc_text_put(&t, *p++);
+	}
+
+	tag = (*p == '<');
+	*t.out = '\0';
+
+	return tag ? p : NULL;
+}
+
+/* Reads the tag whose name starts at p, just past its '<'. Returns the
+ * position just past its '>', or NULL if the document ends first. The name
+ * ("value", "/value", ...) is NUL-terminated in place; processing
+ * instructions and comments are skipped and come back with a name that
+ * matches nothing.
+ */
+static char *
+xmlrpc_tag(char *p, char **name, bool *empty)
+{
+	char *end;
+	size_t len;
+
+	*name = p;
+	*empty = false;
+
+	if (*p == '?')
+		return (end = strstr(p, "?>")) ? end + 2 : NULL;
+
+	if (!strncmp(p, "!--", 3))
+		return (end = strstr(p + 3, "-->")) ? end + 3 : NULL;
+
+	if ((end = strchr(p, '>')) == NULL)
+		return NULL;
+
+	*empty = (end > p && end[-1] == '/' && *p != '/');
+
+	len = (*p == '/') ? 1 : 0;
+	len += strcspn(p + len, " \t\r\n/>");
+	p[len] = '\0';
+
+	return end + 1;
+}
+
+// for <value/> and <string/>: the tag's name is not needed any more, so it can be the value
+static void
+xmlrpc_param_empty(struct xmlrpc_request *req, char *name)
+{
+	*name = '\0';
+
+	if (req->ac == XMLRPC_MAX_PARAMS)
+		req->overflow = true;
+	else
+		req->av[req->ac++] = name;
+}
+
+static char *
+xmlrpc_param(struct xmlrpc_request *req, char *text)
+{
+	if (req->ac == XMLRPC_MAX_PARAMS)
+	{
+		req->overflow = true;
+		return strchr(text, '<');
+	}
+
+	req->av[req->ac++] = text;
+
+	if ((text = xmlrpc_text_decode(text)) == NULL)
+		req->truncated = true;
+
+	return text;
+}
+
+/* Handles what follows a <value>: either a type tag and its text, or the
+ * text itself, which is a string. Arrays and structs contribute no value of
+ * their own; the values inside them are picked up one after the other, as
+ * if they had been given as separate parameters.
+ */
+static char *
+xmlrpc_value(struct xmlrpc_request *req, char *p)
+{
+	char *q = p + strspn(p, " \t\r\n");
+	char *name;
+	bool empty;
+
+	if (*q != '<')
+		return xmlrpc_param(req, p);
+
+	// <value></value>, an empty string
+	if (q[1] == '/')
+		return xmlrpc_param(req, q);
+
+	if ((p = xmlrpc_tag(q + 1, &name, &empty)) == NULL)
+	{
+		req->truncated = true;
+		return NULL;
+	}
+
+	if (!strcmp(name, "array") || !strcmp(name, "struct"))
+		return strchr(p, '<');
+
+	if (empty)
+	{
+		xmlrpc_param_empty(req, name);
+		return strchr(p, '<');
+	}
+
+	return xmlrpc_param(req, p);
+}
+
+static bool
+xmlrpc_tokenize(char *p, struct xmlrpc_request *req)
+{
+	char *name;
+	bool empty;
+
+	req->method = NULL;
+	req->ac = 0;
+	req->overflow = false;
+	req->truncated = false;
+
+	p = strchr(p, '<');
+
+	while (p != NULL)
+	{
+		// p is at the '<' of a tag (which may have been overwritten)
+		if ((p = xmlrpc_tag(p + 1, &name, &empty)) == NULL)
+		{
+			req->truncated = true;
 			break;
-		*p++ = '\0';
-		if (ac >= argvsize)
+		}
+
+		if (empty)
 		{
-			argvsize *= 2;
-			*argv = sreallocarray(*argv, argvsize, sizeof(char *));
+			if (!strcmp(name, "value"))
+				xmlrpc_param_empty(req, name);
+
+			p = strchr(p, '<');
 		}
-		if (tagtype == 1)
-			(*argv)[ac++] = xmlrpc_decode_string(str);
+		else if (!strcmp(name, "methodName") && req->method == NULL)
+		{
+			req->method = p;
+
+			if ((p = xmlrpc_text_decode(p)) == NULL)
+				req->truncated = true;
+		}
+		else if (!strcmp(name, "value"))
+			p = xmlrpc_value(req, p);
 		else
-			(*argv)[ac++] = str;
-		data = p;
-	}			// while
-	return ac;
+			p = strchr(p, '<');
+	}
+
+	return req->method != NULL && *req->method != '\0';
 }
 
 void
@@ -147,10 +388,7 @@ xmlrpc_process(char *buffer, void *userdata)
 	int retVal = 0;
 	XMLRPCCmd *current = NULL;
 	XMLRPCCmd *xml;
-	char *tmp;
-	int ac;
-	char **av = NULL;
-	char *name = NULL;
+	struct xmlrpc_request req;
 
 	xmlrpc_error_code = 0;
 
@@ -160,60 +398,59 @@ xmlrpc_process(char *buffer, void *userdata)
 		return;
 	}
 
-	tmp = xmlrpc_parse(buffer);
-	if (tmp)
+	if (!xmlrpc_tokenize(buffer, &req))
+	{
+		xmlrpc_error_code = -3;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Missing methodRequest or methodName.");
+		return;
+	}
+
+	if (req.truncated)
+	{
+		xmlrpc_error_code = -2;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Invalid document end");
+		return;
+	}
+
+	if (req.overflow)
 	{
-		name = xmlrpc_method(tmp);
-		if (name)
+		xmlrpc_error_code = -9;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Too many parameters");
+		return;
+	}
+
+	xml = mowgli_patricia_retrieve(XMLRPCCMD, req.method);
+	if (xml)
+	{
+		if (xml->func)
 		{
-			xml = mowgli_patricia_retrieve(XMLRPCCMD, name);
-			if (xml)
+			retVal = xml->func(userdata, req.ac, req.av);
+			if (retVal == XMLRPC_CONT)
 			{
-				ac = xmlrpc_split_buf(tmp, &av);
-				if (xml->func)
+				current = xml->next;
+				while (current && current->func && retVal == XMLRPC_CONT)
 				{
-					retVal = xml->func(userdata, ac, av);
-					if (retVal == XMLRPC_CONT)
-					{
-						current = xml->next;
-						while (current && current->func && retVal == XMLRPC_CONT)
-						{
-							retVal = current->func(userdata, ac, av);
-							current = current->next;
-						}
-					}
-					else
-					{	// we assume that XMLRPC_STOP means the handler has given no output
-						xmlrpc_error_code = -7;
-						xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: First eligible function returned XMLRPC_STOP");
-					}
-				}
-				else
-				{
-					xmlrpc_error_code = -6;
-					xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Method has no registered function");
+					retVal = current->func(userdata, req.ac, req.av);
+					current = current->next;
 				}
 			}
 			else
-			{
-				xmlrpc_error_code = -4;
-				xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Unknown routine called");
+			{	// we assume that XMLRPC_STOP means the handler has given no output
+				xmlrpc_error_code = -7;
+				xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: First eligible function returned XMLRPC_STOP");
 			}
 		}
 		else
 		{
-			xmlrpc_error_code = -3;
-			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Missing methodRequest or methodName.");
+			xmlrpc_error_code = -6;
+			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Method has no registered function");
 		}
 	}
 	else
 	{
-		xmlrpc_error_code = -2;
-		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Invalid document end at line 1");
+		xmlrpc_error_code = -4;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Unknown routine called");
 	}
-	sfree(av);
-	sfree(tmp);
-	sfree(name);
 }
 
 void
@@ -265,123 +502,154 @@ xmlrpc_unregister_method(const char *method)
 	return XMLRPC_ERR_OK;
 }
 
-static char *
-xmlrpc_write_header(int length)
+static size_t
+xmlrpc_write_header(char *buf, size_t size, size_t length)
 {
-	char buf[512];
 	time_t ts;
 	char timebuf[64];
 	struct tm *tm;
-
-	*buf = '\0';
+	int len;
 
 	ts = time(NULL);
 	tm = localtime(&ts);
 	strftime(timebuf, sizeof timebuf, "%Y-%m-%d %H:%M:%S", tm);
 
-	snprintf(buf, sizeof buf,
+	len = snprintf(buf, size,
 	         "HTTP/1.1 200 OK\r\n"
 	         "Date: %s\r\n"
 	         "Server: %s/%s\r\n"
 	         "Content-Type: text/xml\r\n"
-	         "Content-Length: %d\r\n"
+	         "Content-Length: %zu\r\n"
 	         "Connection: close\r\n"
 	         "\r\n",
 	         timebuf,
 	         PACKAGE_TARNAME, PACKAGE_VERSION,
 	         length);
 
-	return sstrdup(buf);
+	return (len > 0 && (size_t) len < size) ? (size_t) len : 0;
+}
+
+/*
+ * Responses are written by the same code twice: first without a buffer,
+ * which only adds up their length, then into a buffer of exactly that size
+ * (plus the HTTP header, if we are adding one), allocated once.
+ */
+struct xmlrpc_writer
+{
+	char *          buf;
+	size_t          len;
+};
+
+static void
+xmlrpc_put(struct xmlrpc_writer *w, const char *s, size_t len)
+{
+	if (w->buf != NULL)
+		memcpy(w->buf + w->len, s, len);
+
+	w->len += len;
+}
+
+static void
+xmlrpc_puts(struct xmlrpc_writer *w, const char *s)
+{
+	xmlrpc_put(w, s, strlen(s));
 }
 
+// writes s with the characters that are not safe in XML character data encoded
 static void
-xmlrpc_append_char_encode(mowgli_string_t *s, const char *s1)
+xmlrpc_put_encoded(struct xmlrpc_writer *w, const char *s)
 {
-	long unsigned int i;
+	const char *run;
 	unsigned char c;
-	char buf2[15];
+	char buf[8];
 
-	if ((!(s1) || (*(s1) == '\0')))
-	{
+	if (s == NULL)
 		return;
-	}
 
-	for (i = 0; s1[i] != '\0'; i++)
+	while (*s != '\0')
 	{
-		c = s1[i];
+		for (run = s; (c = (unsigned char) *s) != '\0'; s++)
+			if (c > 127 || c == '&' || c == '<' || c == '>' || c == '"')
+				break;
+
+		xmlrpc_put(w, run, (size_t) (s - run));
+
+		if (c == '\0')
+			break;
+
 		if (c > 127)
-		{
-			snprintf(buf2, sizeof buf2, "&#%d;", c);
-			s->append(s, buf2, strlen(buf2));
-		}
+			xmlrpc_put(w, buf, (size_t) snprintf(buf, sizeof buf, "&#%d;", c));
 		else if (c == '&')
-		{
-			s->append(s, "&amp;", 5);
-		}
+			xmlrpc_put(w, "&amp;", 5);
 		else if (c == '<')
-		{
-			s->append(s, "&lt;", 4);
-		}
+			xmlrpc_put(w, "&lt;", 4);
 		else if (c == '>')
-		{
-			s->append(s, "&gt;", 4);
-		}
-		else if (c == '"')
-		{
-			s->append(s, "&quot;", 6);
-		}
+			xmlrpc_put(w, "&gt;", 4);
 		else
-		{
-			s->append_char(s, c);
-		}
+			xmlrpc_put(w, "&quot;", 6);
+
+		s++;
 	}
 }
 
-void
-xmlrpc_generic_error(int code, const char *string)
+static void
+xmlrpc_put_prolog(struct xmlrpc_writer *w)
 {
-	char buf[1024];
-	const char *ss;
-	mowgli_string_t *s = mowgli_string_create();
-	char *s2;
-	int len;
-
 	if (xmlrpc.encode)
 	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\" encoding=\"%s\" ?>\r\n<methodResponse>\r\n", xmlrpc.encode);
+		xmlrpc_puts(w, "<?xml version=\"1.0\" encoding=\"");
+		xmlrpc_puts(w, xmlrpc.encode);
+		xmlrpc_puts(w, "\" ?>\r\n<methodResponse>\r\n");
 	}
 	else
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n");
-	}
-	s->append(s, buf, strlen(buf));
-
-	ss = " <fault>\r\n  <value>\r\n   <struct>\r\n    <member>\r\n     <name>faultCode</name>\r\n     <value><int>";
-	s->append(s, ss, strlen(ss));
-	snprintf(buf, sizeof buf, "%d", code);
-	s->append(s, buf, strlen(buf));
-	ss = "</int></value>\r\n    </member>\r\n    <member>\r\n     <name>faultString</name>\r\n     <value><string>";
-	s->append(s, ss, strlen(ss));
-	xmlrpc_append_char_encode(s, string);
-	ss = "</string></value>\r\n    </member>\r\n   </struct>\r\n  </value>\r\n </fault>\r\n</methodResponse>";
-	s->append(s, ss, strlen(ss));
+		xmlrpc_puts(w, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n");
+}
 
-	len = s->pos;
+// allocates the buffer for the second pass, once the first has sized the body
+static void
+xmlrpc_writer_start(struct xmlrpc_writer *w)
+{
+	char header[512];
+	size_t hlen = 0;
 
 	if (xmlrpc.httpheader)
-	{
-		char *header = xmlrpc_write_header(len);
-		s2 = smalloc(strlen(header) + len + 1);
-		strcpy(s2, header);
-		memcpy(s2 + strlen(header), s->str, len);
-		xmlrpc.setbuffer(s2, len + strlen(header));
-		sfree(header);
-		sfree(s2);
-	}
-	else
-		xmlrpc.setbuffer(s->str, len);
+		hlen = xmlrpc_write_header(header, sizeof header, w->len);
+
+	w->buf = smalloc(hlen + w->len + 1);
+	memcpy(w->buf, header, hlen);
+	w->len = hlen;
+}
+
+static void
+xmlrpc_writer_finish(struct xmlrpc_writer *w)
+{
+	w->buf[w->len] = '\0';
+	xmlrpc.setbuffer(w->buf, w->len);
+	sfree(w->buf);
+}
+
+static void
+xmlrpc_put_fault(struct xmlrpc_writer *w, int code, const char *string)
+{
+	char buf[16];
+
+	xmlrpc_put_prolog(w);
+	xmlrpc_puts(w, " <fault>\r\n  <value>\r\n   <struct>\r\n    <member>\r\n     <name>faultCode</name>\r\n     <value><int>");
+	xmlrpc_put(w, buf, (size_t) snprintf(buf, sizeof buf, "%d", code));
+	xmlrpc_puts(w, "</int></value>\r\n    </member>\r\n    <member>\r\n     <name>faultString</name>\r\n     <value><string>");
+	xmlrpc_put_encoded(w, string);
+	xmlrpc_puts(w, "</string></value>\r\n    </member>\r\n   </struct>\r\n  </value>\r\n </fault>\r\n</methodResponse>");
+}
+
+void
+xmlrpc_generic_error(int code, const char *string)
+{
+	struct xmlrpc_writer w = { NULL, 0 };
 
-	s->destroy(s);
+	xmlrpc_put_fault(&w, code, string);
+	xmlrpc_writer_start(&w);
+	xmlrpc_put_fault(&w, code, string);
+	xmlrpc_writer_finish(&w);
 }
 
 int
@@ -405,122 +673,72 @@ xmlrpc_about(void *userdata, int ac, char **av)
 	return XMLRPC_CONT;
 }
 
-void
-xmlrpc_send(int argc, ...)
+static void
+xmlrpc_put_params(struct xmlrpc_writer *w, int argc, va_list va)
 {
-	va_list va;
-	int idx = 0;
-	int len;
-	char buf[1024];
-	const char *ss;
-	mowgli_string_t *s = mowgli_string_create();
-	char *s2;
-	char *header;
+	int idx;
 
-	if (xmlrpc.encode)
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\" encoding=\"%s\" ?>\r\n<methodResponse>\r\n<params>\r\n", xmlrpc.encode);
-	}
-	else
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n<params>\r\n");
-	}
-	s->append(s, buf, strlen(buf));
+	xmlrpc_put_prolog(w);
+	xmlrpc_puts(w, "<params>\r\n");
 
-	va_start(va, argc);
 	for (idx = 0; idx < argc; idx++)
 	{
-		ss = " <param>\r\n  <value>\r\n   ";
-		s->append(s, ss, strlen(ss));
-		ss = va_arg(va, const char *);
-		s->append(s, ss, strlen(ss));
-		ss = "\r\n  </value>\r\n </param>\r\n";
-		s->append(s, ss, strlen(ss));
+		xmlrpc_puts(w, " <param>\r\n  <value>\r\n   ");
+		xmlrpc_puts(w, va_arg(va, const char *));
+		xmlrpc_puts(w, "\r\n  </value>\r\n </param>\r\n");
 	}
-	va_end(va);
 
-	ss = "</params>\r\n</methodResponse>";
-	s->append(s, ss, strlen(ss));
+	xmlrpc_puts(w, "</params>\r\n</methodResponse>");
+}
 
-	len = s->pos;
+void
+xmlrpc_send(int argc, ...)
+{
+	struct xmlrpc_writer w = { NULL, 0 };
+	va_list va, va2;
+
+	va_start(va, argc);
+	va_copy(va2, va);
+
+	xmlrpc_put_params(&w, argc, va);
+	xmlrpc_writer_start(&w);
+	xmlrpc_put_params(&w, argc, va2);
+	xmlrpc_writer_finish(&w);
+
+	va_end(va2);
+	va_end(va);
 
-	if (xmlrpc.httpheader)
-	{
-		header = xmlrpc_write_header(len);
-		s2 = smalloc(strlen(header) + len + 1);
-		strcpy(s2, header);
-		memcpy(s2 + strlen(header), s->str, len);
-		xmlrpc.setbuffer(s2, len + strlen(header));
-		sfree(header);
-		sfree(s2);
-		xmlrpc.httpheader = 1;
-	}
-	else
-	{
-		xmlrpc.setbuffer(s->str, len);
-	}
 	if (xmlrpc.encode)
 	{
 		sfree(xmlrpc.encode);
 		xmlrpc.encode = NULL;
 	}
+}
 
-	s->destroy(s);
+static void
+xmlrpc_put_string_param(struct xmlrpc_writer *w, const char *value)
+{
+	xmlrpc_put_prolog(w);
+	xmlrpc_puts(w, "<params>\r\n <param>\r\n  <value>\r\n   <string>");
+	xmlrpc_put_encoded(w, value);
+	xmlrpc_puts(w, "</string>\r\n  </value>\r\n </param>\r\n</params>\r\n</methodResponse>");
 }
 
 void
 xmlrpc_send_string(const char *value)
 {
-	int len;
-	char buf[1024];
-	const char *ss;
-	mowgli_string_t *s = mowgli_string_create();
-	char *s2;
-	char *header;
+	struct xmlrpc_writer w = { NULL, 0 };
 
-	if (xmlrpc.encode)
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\" encoding=\"%s\" ?>\r\n<methodResponse>\r\n<params>\r\n", xmlrpc.encode);
-	}
-	else
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n<params>\r\n");
-	}
-	s->append(s, buf, strlen(buf));
+	xmlrpc_put_string_param(&w, value);
+	xmlrpc_writer_start(&w);
+	xmlrpc_put_string_param(&w, value);
+	xmlrpc_writer_finish(&w);
 
-	ss = " <param>\r\n  <value>\r\n   <string>";
-	s->append(s, ss, strlen(ss));
-	xmlrpc_append_char_encode(s, value);
-	ss = "</string>\r\n  </value>\r\n </param>\r\n";
-	s->append(s, ss, strlen(ss));
-
-	ss = "</params>\r\n</methodResponse>";
-	s->append(s, ss, strlen(ss));
-
-	len = s->pos;
-
-	if (xmlrpc.httpheader)
-	{
-		header = xmlrpc_write_header(len);
-		s2 = smalloc(strlen(header) + len + 1);
-		strcpy(s2, header);
-		memcpy(s2 + strlen(header), s->str, len);
-		xmlrpc.setbuffer(s2, len + strlen(header));
-		sfree(header);
-		sfree(s2);
-		xmlrpc.httpheader = 1;
-	}
-	else
-	{
-		xmlrpc.setbuffer(s->str, len);
-	}
 	if (xmlrpc.encode)
 	{
 		sfree(xmlrpc.encode);
 		xmlrpc.encode = NULL;
 	}
-
-	s->destroy(s);
 }
 
 char *
@@ -588,36 +806,42 @@ xmlrpc_double(char *buf, double value)
 	return buf;
 }
 
-char *
-xmlrpc_array(int argc, ...)
+static void
+xmlrpc_put_array(struct xmlrpc_writer *w, int argc, va_list va)
 {
-	va_list va;
-	char *a;
-	int idx = 0;
-	char *s = NULL;
-	char buf[XMLRPC_BUFSIZE];
+	int idx;
+
+	xmlrpc_puts(w, "<array>\r\n    <data>\r\n  ");
 
-	va_start(va, argc);
 	for (idx = 0; idx < argc; idx++)
 	{
-		a = va_arg(va, char *);
-		if (!s)
-		{
-			snprintf(buf, XMLRPC_BUFSIZE, "   <value>%s</value>", a);
-			s = sstrdup(buf);
-		}
-		else
-		{
-			snprintf(buf, XMLRPC_BUFSIZE, "%s\r\n     <value>%s</value>", s, a);
-			sfree(s);
-			s = sstrdup(buf);
-		}
+		xmlrpc_puts(w, idx ? "\r\n     <value>" : "   <value>");
+		xmlrpc_puts(w, va_arg(va, const char *));
+		xmlrpc_puts(w, "</value>");
 	}
+
+	xmlrpc_puts(w, "\r\n    </data>\r\n   </array>");
+}
+
+char *
+xmlrpc_array(int argc, ...)
+{
+	struct xmlrpc_writer w = { NULL, 0 };
+	va_list va, va2;
+
+	va_start(va, argc);
+	va_copy(va2, va);
+
+	xmlrpc_put_array(&w, argc, va);
+	w.buf = smalloc(w.len + 1);
+	w.len = 0;
+	xmlrpc_put_array(&w, argc, va2);
+	w.buf[w.len] = '\0';
+
+	va_end(va2);
 	va_end(va);
 
-	snprintf(buf, XMLRPC_BUFSIZE, "<array>\r\n    <data>\r\n  %s\r\n    </data>\r\n   </array>", s);
-	sfree(s);
-	return sstrdup(buf);
+	return w.buf;
 }
 
 char *
@@ -751,50 +975,25 @@ xmlrpc_set_options(int type, const char *value)
 void
 xmlrpc_char_encode(char *outbuffer, const char *s1)
 {
-	long unsigned int i;
-	unsigned char c;
-	char buf2[15];
-	mowgli_string_t *s = mowgli_string_create();
-	*buf2 = '\0';
-	*outbuffer = '\0';
+	struct xmlrpc_writer w = { outbuffer, 0 };
+	struct xmlrpc_writer next;
+	char c[2] = { '\0', '\0' };
 
-	if ((!(s1) || (*(s1) == '\0')))
+	for (; s1 != NULL && *s1 != '\0'; s1++)
 	{
-		return;
-	}
+		// stop at the last character whose encoding fits whole
+		c[0] = *s1;
+		next.buf = NULL;
+		next.len = w.len;
+		xmlrpc_put_encoded(&next, c);
 
-	for (i = 0; s1[i] != '\0'; i++)
-	{
-		c = s1[i];
-		if (c > 127)
-		{
-			snprintf(buf2, sizeof buf2, "&#%d;", c);
-			s->append(s, buf2, strlen(buf2));
-		}
-		else if (c == '&')
-		{
-			s->append(s, "&amp;", 5);
-		}
-		else if (c == '<')
-		{
-			s->append(s, "&lt;", 4);
-		}
-		else if (c == '>')
-		{
-			s->append(s, "&gt;", 4);
-		}
-		else if (c == '"')
-		{
-			s->append(s, "&quot;", 6);
-		}
-		else
-		{
-			s->append_char(s, c);
-		}
+		if (next.len >= XMLRPC_BUFSIZE)
+			break;
+
+		xmlrpc_put_encoded(&w, c);
 	}
-	s->append_char(s, 0);
 
-	strncpy(outbuffer, s->str, XMLRPC_BUFSIZE);
+	outbuffer[w.len] = '\0';
 }
 
 /* In-place decode of some entities
@@ -0,0 +1,357 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * Base64 kernel check and benchmark.
+ *
+ * Runs the test vectors through every base64 kernel this CPU supports, then
+ * checks each of them against the scalar code on random input, in all of
+ * the alphabets in <atheme/base64.h>, with whitespace and invalid characters
+ * mixed in and with output buffers that are too small: every call must
+ * return the same thing and leave the same bytes in the output buffer.
+ *
+ * Then measures how fast each kernel encodes and decodes.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>        // mowgli_getopt_option_t, mowgli_getopt_long()
+
+#define BENCH_BYTES_DEF         (64UL * 1024UL * 1024UL)
+#define CHECK_LENGTH_MAX        520U
+#define CHECK_ROUNDS            40U
+#define CHECK_BUFSIZE           (BASE64_SIZE_STR(CHECK_LENGTH_MAX) * 2U)
+
+static const char *const check_alphabets[] = {
+
+	BASE64_ALPHABET_RFC4648,
+	BASE64_ALPHABET_RFC4648_NOPAD,
+	BASE64_ALPHABET_CRYPT3,
+	BASE64_ALPHABET_CRYPT3_BLOWFISH,
+};
+
+static uint64_t check_state = UINT64_C(0x9E3779B97F4A7C15);
+
+// xorshift64*; the check is the same on every run
+static uint32_t
+check_random(void)
+{
+	check_state ^= check_state >> 12;
+	check_state ^= check_state << 25;
+	check_state ^= check_state >> 27;
+
+	return (uint32_t) ((check_state * UINT64_C(0x2545F4914F6CDD1D)) >> 32);
+}
+
+static uint64_t
+bench_clock(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * UINT64_C(1000000000)) + (uint64_t) ts.tv_nsec;
+}
+
+// the scalar code is the last kernel
+static size_t
+kernel_scalar(void)
+{
+	return base64_kernel_count() - 1U;
+}
+
+static void
+kernel_use(const size_t kernel)
+{
+	if (! base64_kernel_select(kernel))
+	{
+		(void) fprintf(stderr, "cannot select base64 kernel %zu\n", kernel);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static bool
+check_vectors(void)
+{
+	// the vector from the b64test program, and those from RFC 4648 section 10
+	static const char b64test_enc[] = "Q2hyaXNUZXN0AENocmlzVGVzdABwbXpqZ3VseGF5ZWJjcGJ3cXFkaA==";
+	static const char b64test_dec[] = "ChrisTest\0ChrisTest\0pmzjgulxayebcpbwqqdh";
+	static const char *const rfc4648[][2] = {
+		{ "",       ""         },
+		{ "f",      "Zg=="     },
+		{ "fo",     "Zm8="     },
+		{ "foo",    "Zm9v"     },
+		{ "foob",   "Zm9vYg==" },
+		{ "fooba",  "Zm9vYmE=" },
+		{ "foobar", "Zm9vYmFy" },
+	};
+
+	// the last NUL of b64test_dec is the string terminator, not part of the data
+	const size_t b64test_len = sizeof b64test_dec - 1U;
+
+	unsigned char dec[BUFSIZE];
+	char enc[BUFSIZE];
+
+	if (base64_decode(b64test_enc, dec, sizeof dec) != b64test_len || memcmp(dec, b64test_dec, b64test_len) != 0)
+		return false;
+
+	if (base64_encode(b64test_dec, b64test_len, enc, sizeof enc) != strlen(b64test_enc) ||
+	    strcmp(enc, b64test_enc) != 0)
+		return false;
+
+	for (size_t i = 0; i < ARRAY_SIZE(rfc4648); i++)
+	{
+		const size_t len = strlen(rfc4648[i][0]);
+
+		if (base64_decode(rfc4648[i][1], dec, sizeof dec) != len || memcmp(dec, rfc4648[i][0], len) != 0)
+			return false;
+
+		if (base64_encode(rfc4648[i][0], len, enc, sizeof enc) != strlen(rfc4648[i][1]) ||
+		    strcmp(enc, rfc4648[i][1]) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+// encodes and decodes in with the kernel being checked and with the scalar code; they must agree
+static bool
+check_one(const size_t kernel, const char *const restrict alphabet,
+          const unsigned char *const restrict in, const size_t len, const size_t out_len)
+{
+	static char enc[2][CHECK_BUFSIZE];
+	static unsigned char dec[2][CHECK_BUFSIZE];
+	static char text[CHECK_BUFSIZE * 2];
+	size_t rc[2];
+
+	// encode
+	for (size_t i = 0; i < 2; i++)
+	{
+		(void) kernel_use((i == 0) ? kernel : kernel_scalar());
+
+		(void) memset(enc[i], 0x5A, sizeof enc[i]);
+		rc[i] = base64_encode_table(in, len, enc[i], out_len, alphabet);
+	}
+	if (rc[0] != rc[1] || memcmp(enc[0], enc[1], sizeof enc[0]) != 0)
+		return false;
+	if (rc[0] == BASE64_FAIL)
+		return true;
+
+	// decode, with some whitespace or an invalid character (or the end of the string) mixed in
+	const size_t enc_len = rc[0];
+	size_t text_len = 0;
+
+	for (size_t i = 0; i < enc_len; i++)
+	{
+		const uint32_t r = check_random() % 64U;
+
+		if (r == 0)
+			text[text_len++] = " \t\r\n\v\f"[check_random() % 6U];
+		else if (r == 1 && (check_random() % 8U) == 0)
+			text[text_len++] = "!*-~\x7F"[check_random() % 5U];
+		else if (r == 2 && (check_random() % 16U) == 0)
+			text[text_len++] = (char) 0x80;
+
+		text[text_len++] = enc[0][i];
+	}
+	text[text_len] = 0x00;
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		(void) kernel_use((i == 0) ? kernel : kernel_scalar());
+
+		(void) memset(dec[i], 0xA5, sizeof dec[i]);
+		rc[i] = base64_decode_table(text, dec[i], out_len, alphabet);
+	}
+	if (rc[0] != rc[1] || memcmp(dec[0], dec[1], sizeof dec[0]) != 0)
+		return false;
+
+	// and only count the output
+	for (size_t i = 0; i < 2; i++)
+	{
+		(void) kernel_use((i == 0) ? kernel : kernel_scalar());
+
+		rc[i] = base64_decode_table(text, NULL, 0, alphabet);
+	}
+
+	return (rc[0] == rc[1]);
+}
+
+static bool
+check_kernel(const size_t kernel)
+{
+	unsigned char in[CHECK_LENGTH_MAX];
+	bool ok;
+
+	(void) kernel_use(kernel);
+	ok = check_vectors();
+
+	for (size_t a = 0; ok && a < ARRAY_SIZE(check_alphabets); a++)
+	{
+		for (size_t len = 0; ok && len <= CHECK_LENGTH_MAX; len++)
+		{
+			for (unsigned int round = 0; ok && round < CHECK_ROUNDS; round++)
+			{
+				// mostly enough room; sometimes not
+				size_t out_len = BASE64_SIZE_STR(len) + (check_random() % 8U);
+
+				if ((check_random() % 4U) == 0)
+					out_len = 1U + (check_random() % out_len);
+
+				for (size_t i = 0; i < len; i++)
+					in[i] = (unsigned char) check_random();
+
+				ok = check_one(kernel, check_alphabets[a], in, len, out_len);
+
+				if (! ok)
+					(void) fprintf(stderr, "%s: mismatch with the scalar code (alphabet %zu, length %zu, "
+					                       "buffer %zu)\n", base64_kernel_name(kernel), a, len, out_len);
+			}
+		}
+	}
+
+	(void) kernel_use(BASE64_KERNEL_AUTO);
+	return ok;
+}
+
+static void
+bench_kernel(const size_t kernel, const size_t len, const unsigned long rounds,
+             double *const restrict enc_time, double *const restrict dec_time)
+{
+	unsigned char *const in = smalloc(len);
+	unsigned char *const dec = smalloc(len);
+	char *const enc = smalloc(BASE64_SIZE_STR(len));
+	uint64_t start;
+	size_t rc = 0;
+
+	for (size_t i = 0; i < len; i++)
+		in[i] = (unsigned char) check_random();
+
+	(void) kernel_use(kernel);
+
+	start = bench_clock();
+	for (unsigned long i = 0; i < rounds; i++)
+		rc |= base64_encode(in, len, enc, BASE64_SIZE_STR(len));
+	*enc_time = (double) (bench_clock() - start) / 1e9;
+
+	start = bench_clock();
+	for (unsigned long i = 0; i < rounds; i++)
+		rc |= base64_decode(enc, dec, len);
+	*dec_time = (double) (bench_clock() - start) / 1e9;
+
+	if (rc == BASE64_FAIL || memcmp(in, dec, len) != 0)
+		(void) fprintf(stderr, "%s: round trip of %zu bytes failed\n", base64_kernel_name(kernel), len);
+
+	(void) kernel_use(BASE64_KERNEL_AUTO);
+
+	(void) sfree(in);
+	(void) sfree(dec);
+	(void) sfree(enc);
+}
+
+static void
+print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr, "usage: %s [-h] [-l length] [-n rounds]\n"
+	                       "\n"
+	                       "  -l length  bytes per call (default: 32, 300, 3072 and 65536 in turn)\n"
+	                       "  -n rounds  calls for each kernel and length (default: %lu MiB worth)\n",
+	                       progname, BENCH_BYTES_DEF / (1024UL * 1024UL));
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{   "help",       no_argument, NULL, 'h', 0 },
+		{ "length", required_argument, NULL, 'l', 0 },
+		{ "rounds", required_argument, NULL, 'n', 0 },
+		{     NULL,                 0, NULL,  0 , 0 },
+	};
+
+	// a short SASL chunk, a full one (400 characters), a large key blob, a large buffer
+	size_t lengths[] = { 32U, 300U, 3072U, 65536U };
+	size_t nlengths = ARRAY_SIZE(lengths);
+	unsigned long rounds = 0;
+	int r;
+
+	while ((r = mowgli_getopt_long(argc, argv, "hl:n:", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'l':
+				lengths[0] = strtoul(mowgli_optarg, NULL, 10);
+				nlengths = 1;
+				break;
+			case 'n':
+				rounds = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			default:
+				(void) print_usage(argv[0]);
+				return (r == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (! lengths[0])
+	{
+		(void) print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	(void) printf("kernel used by default: %s\n", base64_kernel_name(base64_kernel_current()));
+
+	for (size_t k = 0; k < base64_kernel_count(); k++)
+	{
+		if (! base64_kernel_supported(k))
+		{
+			(void) printf("%-8s not supported by this CPU\n", base64_kernel_name(k));
+			continue;
+		}
+
+		if (! check_kernel(k))
+			return EXIT_FAILURE;
+
+		(void) printf("%-8s test vectors and comparison with scalar code passed\n", base64_kernel_name(k));
+	}
+
+	for (size_t l = 0; l < nlengths; l++)
+	{
+		const size_t len = lengths[l];
+		const unsigned long n = rounds ? rounds : ((BENCH_BYTES_DEF / len) + 1U);
+		double scalar_enc = 0, scalar_dec = 0;
+
+		(void) printf("\n%lu calls of %zu bytes:\n", n, len);
+
+		// the scalar code is last in the list; time it first, to compare the others with
+		for (size_t k = base64_kernel_count(); k-- > 0; /* */)
+		{
+			double enc_time, dec_time;
+
+			if (! base64_kernel_supported(k))
+				continue;
+
+			(void) bench_kernel(k, len, n, &enc_time, &dec_time);
+
+			if (k == kernel_scalar())
+			{
+				scalar_enc = enc_time;
+				scalar_dec = dec_time;
+			}
+
+			(void) printf("  %-8s encode %8.1f MB/s (%.2fx)  decode %8.1f MB/s (%.2fx)\n", base64_kernel_name(k),
+			              ((double) len * (double) n) / enc_time / 1e6, scalar_enc / enc_time,
+			              ((double) len * (double) n) / dec_time / 1e6, scalar_dec / dec_time);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * OpenSEX database compression benchmark.
+ *
+ * Loads an existing database, then writes it back out as plain text and at
+ * a range of compression levels, reporting the size of each and how long
+ * it took to save and to read back. Loading the same objects twice would
+ * collide, so the read-back is a scan of every row through the backend;
+ * for compressed databases this includes decompressing and verifying the
+ * checksum of every block.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+
+#define DB_BENCHMARK_FILE       "db-benchmark.db"
+
+static const unsigned int db_levels[] = {
+	0U,
+#ifdef HAVE_LIBZSTD
+	1U, 3U, 9U, 19U,
+#endif
+};
+
+static double
+elapsed(const struct timeval *const restrict start)
+{
+	struct timeval end;
+
+	(void) gettimeofday(&end, NULL);
+
+	return (double) (end.tv_sec - start->tv_sec) + ((double) (end.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+static bool
+scan_rows(unsigned int *const restrict rows)
+{
+	struct database_handle *const db = db_open(DB_BENCHMARK_FILE, DB_READ);
+
+	if (! db)
+		return false;
+
+	for (*rows = 0; db_read_next_row(db); (*rows)++)
+		;
+
+	db_close(db);
+	return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *const filename = (argc > 1) ? argv[1] : "services.db";
+	char path[BUFSIZE];
+	struct timeval start;
+	struct stat sb;
+	double save_time;
+	unsigned int rows;
+
+	if (argc > 2)
+	{
+		(void) fprintf(stderr, "usage: %s [database]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	atheme_bootstrap();
+	atheme_init(argv[0], LOGDIR "/db-benchmark.log");
+	atheme_setup();
+
+	runflags = RF_LIVE;
+	datadir = DATADIR;
+	strict_mode = false;
+	offline_mode = true;
+
+	if (! module_load("backend/opensex"))
+		return EXIT_FAILURE;
+
+	(void) printf("loading %s/%s ... ", datadir, filename);
+	(void) fflush(stdout);
+	(void) gettimeofday(&start, NULL);
+
+	runflags &= ~RF_LIVE;
+	db_load(filename);
+	runflags |= RF_LIVE;
+
+	(void) printf("%.3f s (%u accounts, %u channels)\n\n", elapsed(&start), cnt.myuser, cnt.mychan);
+	(void) printf("%-7s %14s %10s %10s %10s\n", "level", "bytes", "save (s)", "read (s)", "rows");
+
+	(void) snprintf(path, sizeof path, "%s/%s", datadir, DB_BENCHMARK_FILE);
+
+	for (size_t i = 0; i < ARRAY_SIZE(db_levels); i++)
+	{
+		config_options.db_compression = db_levels[i];
+
+		(void) gettimeofday(&start, NULL);
+		db_save(DB_BENCHMARK_FILE, DB_SAVE_BLOCKING);
+		save_time = elapsed(&start);
+
+		if (stat(path, &sb) != 0)
+		{
+			(void) fprintf(stderr, "stat('%s'): %s\n", path, strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		(void) gettimeofday(&start, NULL);
+
+		if (! scan_rows(&rows))
+		{
+			(void) fprintf(stderr, "cannot read back '%s'\n", path);
+			return EXIT_FAILURE;
+		}
+
+		(void) printf("%-7s %14llu %10.3f %10.3f %10u\n", db_levels[i] ? number_to_string((int) db_levels[i]) : "plain",
+		              (unsigned long long) sb.st_size, save_time, elapsed(&start), rows);
+	}
+
+	(void) unlink(path);
+
+	return EXIT_SUCCESS;
+}
@@ -12,6 +12,9 @@
 #include <atheme.h>
 #include <atheme/libathemecore.h>
 
+// level used to rewrite a database that was found compressed
+#define DBVERIFY_COMPRESSION_LEVEL      3U
+
 static unsigned int
 verify_entity_uids(void)
 {
@@ -81,6 +84,25 @@ verify_channel_registrations(void)
 	}
 }
 
+static bool
+database_is_compressed(const char *filename)
+{
+	char path[BUFSIZE];
+	char magic[sizeof DB_COMPRESSED_MAGIC - 1];
+	bool compressed;
+	FILE *f;
+
+	(void) snprintf(path, sizeof path, "%s/%s", datadir, filename);
+
+	if (! (f = fopen(path, "r")))
+		return false;
+
+	compressed = (fread(magic, 1, sizeof magic, f) == sizeof magic && ! memcmp(magic, DB_COMPRESSED_MAGIC, sizeof magic));
+
+	(void) fclose(f);
+	return compressed;
+}
+
 static void
 handle_mdep(struct database_handle *db, const char *type)
 {
@@ -108,6 +130,16 @@ main(int argc, char *argv[])
 	char *filename = argv[1] ? argv[1] : "services.db";
 	slog(LG_INFO, "dbverify is operating on %s", filename);
 
+	/* The backend verifies the checksum of every compressed block while
+	 * loading and bails out on the first bad one; keep the database
+	 * compressed when writing the corrected state back.
+	 */
+	if (database_is_compressed(filename))
+	{
+		slog(LG_INFO, "%s is compressed; block checksums will be verified in phase 1", filename);
+		config_options.db_compression = DBVERIFY_COMPRESSION_LEVEL;
+	}
+
 	if (! module_load("backend/opensex"))
 		return EXIT_FAILURE;
 
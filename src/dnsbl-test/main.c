@@ -0,0 +1,264 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * DNSBL lookup test.
+ *
+ * Builds the proxyscan/dnsbl module in, with the resolver replaced by a
+ * stand-in that only records the queries it is given. The test then answers
+ * those queries itself, in whatever order and way it likes, and checks what
+ * the module did to the users waiting on them: a listing, NXDOMAIN, a query
+ * that timed out, lookups shared between users, a user who changed nick
+ * while waiting, and a user who is gone by the time the reply arrives.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+
+#define DNSBL_TEST_BLACKLIST    "dnsbl.example.org"
+#define DNSBL_TEST_QUERIES      16U
+
+enum dnsbl_test_answer
+{
+	DNSBL_TEST_LISTED,
+	DNSBL_TEST_NXDOMAIN,
+	DNSBL_TEST_TIMEOUT,
+};
+
+static mowgli_dns_query_t *dnsbl_test_queries[DNSBL_TEST_QUERIES];
+static char dnsbl_test_names[DNSBL_TEST_QUERIES][BUFSIZE];
+static unsigned int dnsbl_test_sent = 0;
+static unsigned int dnsbl_test_failures = 0;
+
+static struct ircd dnsbl_test_ircd = {
+	.ircdname       = "dnsbl-test",
+	.tldprefix      = "$$",
+};
+
+static void
+dnsbl_test_gethost_byname(mowgli_dns_t *const ATHEME_VATTR_UNUSED dns, const char *const name,
+                          mowgli_dns_query_t *const query, const int ATHEME_VATTR_UNUSED type)
+{
+	for (size_t i = 0; i < DNSBL_TEST_QUERIES; i++)
+	{
+		if (dnsbl_test_queries[i] != NULL)
+			continue;
+
+		dnsbl_test_queries[i] = query;
+		(void) mowgli_strlcpy(dnsbl_test_names[i], name, sizeof dnsbl_test_names[i]);
+		dnsbl_test_sent++;
+		return;
+	}
+
+	(void) fprintf(stderr, "too many queries in flight\n");
+	abort();
+}
+
+static void
+dnsbl_test_delete_query(mowgli_dns_t *const ATHEME_VATTR_UNUSED dns, const mowgli_dns_query_t *const query)
+{
+	for (size_t i = 0; i < DNSBL_TEST_QUERIES; i++)
+		if (dnsbl_test_queries[i] == query)
+			dnsbl_test_queries[i] = NULL;
+}
+
+#define mowgli_dns_gethost_byname       dnsbl_test_gethost_byname
+#define mowgli_dns_delete_query         dnsbl_test_delete_query
+
+// the module's lookup and cache code is all static; build it in here
+#include "dnsbl.c"
+
+#undef mowgli_dns_gethost_byname
+#undef mowgli_dns_delete_query
+
+// Answers the query for `name', as the resolver would have; false if none is in flight
+static bool
+answer(const char *const restrict name, const enum dnsbl_test_answer how)
+{
+	mowgli_dns_reply_t reply;
+	struct sockaddr_in *const sin = (struct sockaddr_in *) &reply.addr.addr;
+
+	for (size_t i = 0; i < DNSBL_TEST_QUERIES; i++)
+	{
+		mowgli_dns_query_t *const query = dnsbl_test_queries[i];
+
+		if (query == NULL || strcasecmp(dnsbl_test_names[i], name) != 0)
+			continue;
+
+		dnsbl_test_queries[i] = NULL;
+
+		switch (how)
+		{
+			case DNSBL_TEST_LISTED:
+				(void) memset(&reply, 0x00, sizeof reply);
+				sin->sin_family = AF_INET;
+				sin->sin_addr.s_addr = htonl(0x7F000002U);
+				query->callback(&reply, MOWGLI_DNS_RES_SUCCESS, query->ptr);
+				break;
+
+			case DNSBL_TEST_NXDOMAIN:
+				query->callback(NULL, MOWGLI_DNS_RES_NXDOMAIN, query->ptr);
+				break;
+
+			case DNSBL_TEST_TIMEOUT:
+				query->callback(NULL, MOWGLI_DNS_RES_TIMEOUT, query->ptr);
+				break;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+static struct user *
+connect_user(const char *const restrict nick, const char *const restrict ip, const time_t ts)
+{
+	static struct server *server = NULL;
+	struct user *u;
+
+	if (server == NULL)
+		server = server_add("irc.example.org", 1, NULL, NULL, "test server");
+
+	u = user_add(nick, "user", "host.example.org", NULL, ip, NULL, "test user", server, ts);
+
+	if (u != NULL)
+		check_dnsbls(&(struct hook_user_nick){ .u = u });
+
+	return u;
+}
+
+static bool
+is_klined(const struct user *const restrict u, const char *const restrict ip)
+{
+	return (u->flags & UF_KLINESENT) && kline_find("*", ip) != NULL;
+}
+
+static bool
+is_waiting(struct user *const restrict u)
+{
+	return MOWGLI_LIST_LENGTH(dnsbl_queries(u)) != 0;
+}
+
+static void
+check(const bool ok, const char *const restrict what)
+{
+	(void) printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+
+	if (! ok)
+		dnsbl_test_failures++;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char blacklist[] = DNSBL_TEST_BLACKLIST;
+	struct user *u, *u2;
+	unsigned int sent;
+	time_t ts = 1000000;
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	atheme_bootstrap();
+	atheme_init(argv[0], LOGDIR "/dnsbl-test.log");
+	atheme_setup();
+
+	ircd = &dnsbl_test_ircd;
+	me.name = sstrdup("services.example.org");
+	claro_state.currtime = time(NULL);
+
+	if (! (dnsbl_cache = mowgli_patricia_create(&strcasecanon)))
+		return EXIT_FAILURE;
+
+	action = DNSBL_ACT_KLINE;
+	dnsbl_cache_ttl = SECONDS_PER_HOUR;
+	dnsbl_negative_ttl = 10 * SECONDS_PER_MINUTE;
+	(void) new_blacklist(blacklist);
+	(void) hook_add_user_nickchange(dnsbl_nickchange);
+
+	// A listed address is k-lined once the reply is in, and cached
+	u = connect_user("listed", "192.0.2.1", ++ts);
+
+	check(dnsbl_test_sent == 1 && is_waiting(u), "hit: lookup sent");
+	check(! is_klined(u, "192.0.2.1"), "hit: nothing done before the reply");
+	check(answer("1.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_LISTED), "hit: query answered");
+	check(is_klined(u, "192.0.2.1"), "hit: user k-lined");
+	check(! is_waiting(u), "hit: user no longer waiting");
+
+	u = connect_user("listed2", "192.0.2.1", ++ts);
+
+	check(dnsbl_test_sent == 1, "hit: second user served from the cache");
+	check(is_klined(u, "192.0.2.1"), "hit: second user k-lined");
+
+	// NXDOMAIN leaves the user alone, and is cached too
+	u = connect_user("clean", "192.0.2.2", ++ts);
+
+	check(dnsbl_test_sent == 2 && is_waiting(u), "miss: lookup sent");
+	check(answer("2.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_NXDOMAIN), "miss: query answered");
+	check(! is_klined(u, "192.0.2.2") && ! is_waiting(u), "miss: user left alone");
+
+	u = connect_user("clean2", "192.0.2.2", ++ts);
+
+	check(dnsbl_test_sent == 2 && ! is_waiting(u), "miss: second user served from the cache");
+	check(! is_klined(u, "192.0.2.2"), "miss: second user left alone");
+
+	// A timeout is only remembered for the negative cache time
+	u = connect_user("slow", "192.0.2.3", ++ts);
+
+	check(dnsbl_test_sent == 3 && is_waiting(u), "timeout: lookup sent");
+	check(answer("3.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_TIMEOUT), "timeout: query timed out");
+	check(! is_klined(u, "192.0.2.3") && ! is_waiting(u), "timeout: user left alone");
+
+	u = connect_user("slow2", "192.0.2.3", ++ts);
+
+	check(dnsbl_test_sent == 3, "timeout: not asked again straight away");
+
+	claro_state.currtime += dnsbl_negative_ttl + 1;
+	u = connect_user("slow3", "192.0.2.3", ++ts);
+
+	check(dnsbl_test_sent == 4 && is_waiting(u), "timeout: asked again once the entry expired");
+	check(answer("3.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_LISTED), "timeout: query answered");
+	check(is_klined(u, "192.0.2.3"), "timeout: user k-lined");
+
+	// Users waiting on the same address share one query
+	u = connect_user("first", "192.0.2.4", ++ts);
+	u2 = connect_user("second", "192.0.2.4", ++ts);
+
+	check(dnsbl_test_sent == 5 && is_waiting(u) && is_waiting(u2), "shared: one lookup for both");
+	check(answer("4.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_LISTED), "shared: query answered");
+	check(is_klined(u, "192.0.2.4") && is_klined(u2, "192.0.2.4"), "shared: both users k-lined");
+
+	// A nick change (and with it a new TS) while waiting does not lose the reply
+	u = connect_user("before", "192.0.2.5", ++ts);
+	(void) user_changenick(u, "after", ++ts);
+
+	check(answer("5.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_LISTED), "nick change: query answered");
+	check(is_klined(u, "192.0.2.5"), "nick change: user k-lined");
+
+	/* A reply for someone who has gone must not touch whoever has their
+	 * nick, and quite likely their memory, by then. The module normally
+	 * drops them from the query when they quit; it is not told here.
+	 */
+	u = connect_user("gone", "192.0.2.6", ++ts);
+	sent = dnsbl_test_sent;
+	user_delete(u, "test");
+	u2 = connect_user("gone", "192.0.2.7", ++ts);
+
+	check(dnsbl_test_sent == sent + 1, "stale: new user sent their own lookup");
+	check(answer("6.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_LISTED), "stale: query answered");
+	check(! is_klined(u2, "192.0.2.6") && kline_find("*", "192.0.2.6") == NULL, "stale: reply dropped");
+	check(is_waiting(u2), "stale: new user still waiting on their own lookup");
+	check(answer("7.2.0.192." DNSBL_TEST_BLACKLIST, DNSBL_TEST_NXDOMAIN), "stale: their query answered");
+	check(! is_klined(u2, "192.0.2.7") && ! is_waiting(u2), "stale: new user left alone");
+
+	(void) printf("\n%u failure(s)\n", dnsbl_test_failures);
+
+	return dnsbl_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * Outgoing mail queue test.
+ *
+ * Spools messages and runs the queue against a stand-in MTA, checking what
+ * the MTA received and what was left in the spool. The program is its own
+ * stand-in: started with -bs it speaks just enough SMTP on its standard
+ * input and output to accept mail, and started with -t it reads a single
+ * message. Every message it accepts is written to the directory named by
+ * EMAIL_TEST_SINK, recipient first. EMAIL_TEST_MODE selects its behaviour:
+ * "reject" refuses every recipient, and "nosmtp" makes -bs exit without a
+ * greeting, as an MTA that only offers -t would.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+
+#define EMAIL_TEST_DIR          "email-test.XXXXXX"
+
+struct email_test_message
+{
+	const char *    rcpt;
+	const char *    body;
+	const char *    expected;
+};
+
+static const struct email_test_message email_test_messages[] = {
+	{
+		"one@example.org",
+		"Subject: plain\n\nHello.\n",
+		"Subject: plain\n\nHello.\n",
+	}, {
+		"two@example.org",
+		"Subject: dots\n\n.leading\n..two\n.\nend\n",
+		"Subject: dots\n\n.leading\n..two\n.\nend\n",
+	}, {
+		"three@example.org",
+		"Subject: unterminated\n\nno newline",
+		"Subject: unterminated\n\nno newline\n",
+	},
+};
+
+static char email_test_sink[BUFSIZE];
+static unsigned int email_test_failures = 0;
+
+static FILE *
+mta_sink_open(void)
+{
+	static unsigned int seq = 0;
+	char path[BUFSIZE];
+
+	(void) snprintf(path, sizeof path, "%s/%lu.%u", getenv("EMAIL_TEST_SINK"), (unsigned long) getpid(), seq++);
+
+	return fopen(path, "w");
+}
+
+static void
+mta_reply(const char *const restrict reply)
+{
+	(void) printf("%s\r\n", reply);
+	(void) fflush(stdout);
+}
+
+static int
+mta_smtp(const bool reject)
+{
+	char line[BUFSIZE];
+	char rcpt[BUFSIZE] = "";
+	FILE *out = NULL;
+
+	(void) mta_reply("220 stand-in ESMTP");
+
+	while (fgets(line, sizeof line, stdin) != NULL)
+	{
+		(void) strip(line);
+
+		if (out != NULL)
+		{
+			if (strcmp(line, ".") == 0)
+			{
+				(void) fclose(out);
+				(void) mta_reply("250 queued");
+				out = NULL;
+			}
+			else
+				(void) fprintf(out, "%s\n", (line[0] == '.') ? line + 1 : line);
+		}
+		else if (strncasecmp(line, "HELO ", 5) == 0 || strncasecmp(line, "MAIL FROM:", 10) == 0 ||
+		         strcasecmp(line, "RSET") == 0)
+			(void) mta_reply("250 ok");
+		else if (strncasecmp(line, "RCPT TO:<", 9) == 0 && ! reject)
+		{
+			(void) mowgli_strlcpy(rcpt, line + 9, sizeof rcpt);
+			rcpt[strcspn(rcpt, ">")] = '\0';
+			(void) mta_reply("250 ok");
+		}
+		else if (strncasecmp(line, "RCPT TO:", 8) == 0)
+			(void) mta_reply("550 no such user");
+		else if (strcasecmp(line, "DATA") == 0 && rcpt[0] && (out = mta_sink_open()) != NULL)
+		{
+			(void) fprintf(out, "%s\n", rcpt);
+			(void) mta_reply("354 go ahead");
+			rcpt[0] = '\0';
+		}
+		else if (strcasecmp(line, "QUIT") == 0)
+		{
+			(void) mta_reply("221 bye");
+			return EXIT_SUCCESS;
+		}
+		else
+			(void) mta_reply("503 bad sequence of commands");
+	}
+
+	return EXIT_FAILURE;
+}
+
+static int
+mta_pipe(const bool reject)
+{
+	char buf[BUFSIZE];
+	size_t len;
+	FILE *out;
+
+	if (reject || (out = mta_sink_open()) == NULL)
+		return EXIT_FAILURE;
+
+	(void) fprintf(out, "-t\n");
+
+	while ((len = fread(buf, 1, sizeof buf, stdin)) > 0)
+		(void) fwrite(buf, len, 1, out);
+
+	return (fclose(out) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static unsigned int
+count_files(const char *const restrict path, const char *const restrict suffix)
+{
+	unsigned int count = 0;
+	struct dirent *ent;
+	DIR *dir;
+
+	if ((dir = opendir(path)) == NULL)
+		return 0;
+
+	while ((ent = readdir(dir)) != NULL)
+	{
+		const size_t len = strlen(ent->d_name);
+
+		if (ent->d_name[0] == '.')
+			continue;
+		if (suffix && (len < strlen(suffix) || strcmp(ent->d_name + len - strlen(suffix), suffix) != 0))
+			continue;
+
+		count++;
+	}
+
+	(void) closedir(dir);
+	return count;
+}
+
+static void
+remove_files(const char *const restrict path)
+{
+	struct dirent *ent;
+	DIR *dir;
+
+	if ((dir = opendir(path)) == NULL)
+		return;
+
+	while ((ent = readdir(dir)) != NULL)
+	{
+		char file[BUFSIZE];
+
+		if (ent->d_name[0] == '.')
+			continue;
+
+		(void) snprintf(file, sizeof file, "%s/%s", path, ent->d_name);
+		(void) unlink(file);
+	}
+
+	(void) closedir(dir);
+}
+
+// Looks for a delivered message in the sink, removing it if found
+static bool
+sink_take(const char *const restrict rcpt, const char *const restrict expected)
+{
+	char want[BUFSIZE * 2];
+	struct dirent *ent;
+	bool found = false;
+	DIR *dir;
+
+	(void) snprintf(want, sizeof want, "%s\n%s", rcpt, expected);
+
+	if ((dir = opendir(email_test_sink)) == NULL)
+		return false;
+
+	while (! found && (ent = readdir(dir)) != NULL)
+	{
+		char path[BUFSIZE];
+		char got[BUFSIZE * 2];
+		size_t len;
+		FILE *in;
+
+		if (ent->d_name[0] == '.')
+			continue;
+
+		(void) snprintf(path, sizeof path, "%s/%s", email_test_sink, ent->d_name);
+
+		if ((in = fopen(path, "r")) == NULL)
+			continue;
+
+		len = fread(got, 1, sizeof got - 1, in);
+		got[len] = '\0';
+		(void) fclose(in);
+
+		if (strcmp(got, want) == 0 && unlink(path) == 0)
+			found = true;
+	}
+
+	(void) closedir(dir);
+	return found;
+}
+
+static void
+check(const bool ok, const char *const restrict what)
+{
+	(void) printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+
+	if (! ok)
+		email_test_failures++;
+}
+
+static void
+queue_all(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(email_test_messages); i++)
+	{
+		const struct email_test_message *const m = &email_test_messages[i];
+
+		(void) email_queue_add(m->rcpt, m->body, strlen(m->body));
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char queuepath[BUFSIZE];
+	char mta[PATH_MAX];
+	char *testdir;
+	long next;
+
+	if (argc > 1)
+	{
+		const char *const mode = getenv("EMAIL_TEST_MODE");
+		const bool reject = (mode && strcmp(mode, "reject") == 0);
+
+		if (strcmp(argv[1], "-bs") == 0)
+			return (mode && strcmp(mode, "nosmtp") == 0) ? EXIT_FAILURE : mta_smtp(reject);
+
+		if (strcmp(argv[1], "-t") == 0)
+			return mta_pipe(reject);
+
+		(void) fprintf(stderr, "usage: %s\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	atheme_bootstrap();
+	atheme_init(argv[0], LOGDIR "/email-test.log");
+	atheme_setup();
+
+	(void) signal(SIGPIPE, SIG_IGN);
+
+	if (realpath(argv[0], mta) == NULL || (testdir = mkdtemp(sstrdup(EMAIL_TEST_DIR))) == NULL)
+	{
+		(void) perror(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	(void) snprintf(email_test_sink, sizeof email_test_sink, "%s/sink", testdir);
+	(void) snprintf(queuepath, sizeof queuepath, "%s/mailqueue", testdir);
+	(void) mkdir(email_test_sink, 0700);
+	(void) setenv("EMAIL_TEST_SINK", email_test_sink, 1);
+
+	datadir = testdir;
+	me.name = sstrdup("services.example.org");
+	me.register_email = sstrdup("services@example.org");
+	me.mta = sstrdup(mta);
+
+	// One SMTP session takes the whole queue
+	(void) setenv("EMAIL_TEST_MODE", "smtp", 1);
+	(void) queue_all();
+	next = email_queue_deliver();
+
+	check(next == -1, "smtp: nothing left to retry");
+	check(count_files(queuepath, NULL) == 0, "smtp: spool is empty");
+	for (size_t i = 0; i < ARRAY_SIZE(email_test_messages); i++)
+		check(sink_take(email_test_messages[i].rcpt, email_test_messages[i].expected), "smtp: message delivered intact");
+	check(count_files(email_test_sink, NULL) == 0, "smtp: nothing else delivered");
+
+	// Rejected messages stay queued and back off
+	(void) setenv("EMAIL_TEST_MODE", "reject", 1);
+	(void) queue_all();
+	next = email_queue_deliver();
+
+	check(next > 0, "reject: retry scheduled for later");
+	check(count_files(queuepath, ".1") == ARRAY_SIZE(email_test_messages), "reject: messages kept, one attempt each");
+
+	next = email_queue_deliver();
+
+	check(next > 0, "reject: not retried before it is due");
+	check(count_files(queuepath, ".1") == ARRAY_SIZE(email_test_messages), "reject: attempts unchanged");
+	(void) remove_files(queuepath);
+
+	// An MTA that does not speak SMTP gets one 'mta -t' per message
+	(void) setenv("EMAIL_TEST_MODE", "nosmtp", 1);
+	(void) queue_all();
+	next = email_queue_deliver();
+
+	check(next == -1, "nosmtp: nothing left to retry");
+	check(count_files(queuepath, NULL) == 0, "nosmtp: spool is empty");
+	for (size_t i = 0; i < ARRAY_SIZE(email_test_messages); i++)
+		check(sink_take("-t", email_test_messages[i].body), "nosmtp: message piped intact");
+
+	(void) remove_files(email_test_sink);
+	(void) remove_files(queuepath);
+	(void) rmdir(email_test_sink);
+	(void) rmdir(queuepath);
+	(void) rmdir(testdir);
+
+	(void) printf("\n%u failure(s)\n", email_test_failures);
+
+	return email_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -5,6 +5,10 @@
  * Copyright (C) 2005-2010 William Pitcock <nenolod@dereferenced.org>
  *
  * Initialization stub for libathemecore.
+ *
+ * Given a database (such as one written by tools/createtestdb), the
+ * registered object counts are those loaded from it, and the memory it
+ * took to load is measured as well as estimated.
  */
 
 #include <atheme.h>
@@ -18,8 +22,16 @@ main(int argc, char *argv[])
 
 	unsigned int usercount = 0, channelcount = 0, membercount = 0,
 		klinecount = 0, qlinecount = 0, xlinecount = 0, regchannelcount = 0,
-		servercount = 0, regusercount = 0;
+		servercount = 0, regusercount = 0, regnickcount = 0, chanacscount = 0;
 	unsigned int i;
+	long rss_before = 0, rss_after = 0;
+	struct rusage ru;
+
+	if (argc > 2)
+	{
+		fprintf(stderr, "usage: %s [database]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
 
 	/* make up some statistics */
 	srand(time(NULL));
@@ -32,7 +44,38 @@ main(int argc, char *argv[])
 	channelcount = usercount / servercount;
 	membercount = (usercount + channelcount) * ((rand() % 3) + 1);
 	regchannelcount = channelcount * 0.65;
-	regusercount = usercount * 0.65;
+	regusercount = regnickcount = usercount * 0.65;
+	chanacscount = regchannelcount * 3;
+
+	if (argc > 1)
+	{
+		atheme_bootstrap();
+		atheme_init(argv[0], LOGDIR "/footprint.log");
+		atheme_setup();
+
+		runflags = RF_LIVE;
+		datadir = DATADIR;
+		strict_mode = false;
+		offline_mode = true;
+
+		if (! module_load("backend/opensex"))
+			return EXIT_FAILURE;
+
+		if (getrusage(RUSAGE_SELF, &ru) == 0)
+			rss_before = ru.ru_maxrss;
+
+		runflags &= ~RF_LIVE;
+		db_load(argv[1]);
+		runflags |= RF_LIVE;
+
+		if (getrusage(RUSAGE_SELF, &ru) == 0)
+			rss_after = ru.ru_maxrss;
+
+		regusercount = cnt.myuser;
+		regnickcount = cnt.mynick;
+		regchannelcount = cnt.mychan;
+		chanacscount = cnt.chanacs;
+	}
 
 	/* 5% of users are probably misbehaving in some way... */
 	klinecount = xlinecount = qlinecount = (usercount * 0.05);
@@ -44,8 +87,10 @@ main(int argc, char *argv[])
 	printf("%u servers\n", servercount);
 	printf("%u users\n", usercount);
 	printf("%u registered users\n", regusercount);
+	printf("%u registered nicks\n", regnickcount);
 	printf("%u channels\n", channelcount);
 	printf("%u registered channels\n", regchannelcount);
+	printf("%u channel access entries\n", chanacscount);
 	printf("%u memberships\n", membercount);
 	printf("%u klines / xlines / qlines\n", klinecount);
 
@@ -58,7 +103,11 @@ main(int argc, char *argv[])
 	printf("sizeof myentity_t: %zu B --> %zu KB\n", sizeof(struct myentity), (regusercount * sizeof(struct myentity)) / 1024);
 	printf("sizeof myuser_t: %zu B --> %zu KB\n", sizeof(struct myuser), (regusercount * sizeof(struct myuser)) / 1024);
 	printf("sizeof mychan_t: %zu B --> %zu KB\n", sizeof(struct mychan), (regchannelcount * sizeof(struct mychan)) / 1024);
-	printf("sizeof mynick_t: %zu B --> %zu KB\n", sizeof(struct mynick), (regusercount * sizeof(struct mynick)) / 1024);
+	printf("sizeof mynick_t: %zu B --> %zu KB\n", sizeof(struct mynick), (regnickcount * sizeof(struct mynick)) / 1024);
+	printf("sizeof chanacs_t: %zu B --> %zu KB\n", sizeof(struct chanacs), (chanacscount * sizeof(struct chanacs)) / 1024);
+
+	if (argc > 1)
+		printf("measured: loading %s took %ld KB (%ld KB peak RSS)\n", argv[1], rss_after - rss_before, rss_after);
 
 	printf("\n* * *\n\n");
 
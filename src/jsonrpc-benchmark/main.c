@@ -0,0 +1,395 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * JSON-RPC throughput benchmark.
+ *
+ * Connects to the httpd of a running services instance (normally over
+ * the loopback interface) and makes the same JSON-RPC call over and over
+ * on one keep-alive connection, one call per HTTP request or several per
+ * request in a batch, with up to a given number of requests pipelined.
+ *
+ * Reports calls and HTTP requests per second, and how many of the calls
+ * came back with an error.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>        // mowgli_getopt_option_t, mowgli_getopt_long()
+
+#define BENCH_HOST_DEF          "127.0.0.1"
+#define BENCH_PORT_DEF          "8080"
+#define BENCH_PATH              "/jsonrpc"
+#define BENCH_CALLS_DEF         100000UL
+#define BENCH_METHOD_DEF        "atheme.ison"
+#define BENCH_PARAM_DEF         "ChanServ"
+
+struct bench_buf
+{
+	char *          data;
+	size_t          len;
+	size_t          size;
+};
+
+static void
+bench_buf_append(struct bench_buf *const restrict b, const char *const restrict data, const size_t len)
+{
+	if (b->len + len + 1 > b->size)
+	{
+		while (b->len + len + 1 > b->size)
+			b->size = b->size ? (b->size * 2) : 4096;
+
+		b->data = srealloc(b->data, b->size);
+	}
+
+	(void) memcpy(b->data + b->len, data, len);
+	b->len += len;
+	b->data[b->len] = 0x00;
+}
+
+static void
+bench_buf_str(struct bench_buf *const restrict b, const char *const restrict str)
+{
+	(void) bench_buf_append(b, str, strlen(str));
+}
+
+// appends str as a JSON string; only what needs escaping in a method name or parameter is handled
+static void
+bench_buf_json(struct bench_buf *const restrict b, const char *str)
+{
+	(void) bench_buf_append(b, "\"", 1);
+
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			(void) bench_buf_append(b, "\\", 1);
+
+		(void) bench_buf_append(b, str, 1);
+	}
+
+	(void) bench_buf_append(b, "\"", 1);
+}
+
+static uint64_t
+bench_clock(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * UINT64_C(1000000000)) + (uint64_t) ts.tv_nsec;
+}
+
+static int
+bench_connect(const char *const restrict host, const char *const restrict port)
+{
+	struct addrinfo hints, *res, *ai;
+	int fd = -1;
+	int r;
+
+	(void) memset(&hints, 0x00, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if ((r = getaddrinfo(host, port, &hints, &res)) != 0)
+	{
+		(void) fprintf(stderr, "%s:%s: %s\n", host, port, gai_strerror(r));
+		return -1;
+	}
+
+	for (ai = res; ai != NULL; ai = ai->ai_next)
+	{
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+			continue;
+
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+
+		(void) close(fd);
+		fd = -1;
+	}
+
+	(void) freeaddrinfo(res);
+
+	if (fd == -1)
+		(void) fprintf(stderr, "%s:%s: %s\n", host, port, strerror(errno));
+
+	return fd;
+}
+
+static bool
+bench_write(const int fd, const char *buf, size_t len)
+{
+	while (len)
+	{
+		const ssize_t r = write(fd, buf, len);
+
+		if (r == -1 && errno == EINTR)
+			continue;
+
+		if (r <= 0)
+		{
+			(void) perror("write");
+			return false;
+		}
+
+		buf += r;
+		len -= (size_t) r;
+	}
+
+	return true;
+}
+
+static size_t
+bench_count(const char *const restrict buf, const size_t len, const char *const restrict needle)
+{
+	const size_t nlen = strlen(needle);
+	size_t count = 0;
+
+	for (size_t i = 0; i + nlen <= len; i++)
+	{
+		if (! memcmp(buf + i, needle, nlen))
+		{
+			count++;
+			i += nlen - 1;
+		}
+	}
+
+	return count;
+}
+
+/* If a whole response is at the start of the buffer, counts the successful
+ * calls in it and returns its length; returns 0 if more data is needed, or
+ * SIZE_MAX if the response is not one we understand.
+ */
+static size_t
+bench_response(const struct bench_buf *const restrict in, size_t *const restrict ok)
+{
+	const char *const end = (in->len >= 4) ? strstr(in->data, "\r\n\r\n") : NULL;
+	const char *p;
+	size_t hdrlen, bodylen = 0;
+	bool have_length = false;
+
+	if (end == NULL)
+		return 0;
+
+	hdrlen = (size_t) (end - in->data) + 4;
+
+	if (strncmp(in->data, "HTTP/1.1 200 ", 13) != 0)
+	{
+		(void) fprintf(stderr, "unexpected response: %.*s\n", (int) strcspn(in->data, "\r\n"), in->data);
+		return SIZE_MAX;
+	}
+
+	for (p = strstr(in->data, "\r\n"); p != NULL && p < end; p = strstr(p + 2, "\r\n"))
+	{
+		if (! strncasecmp(p + 2, "Content-Length:", 15))
+		{
+			bodylen = strtoul(p + 17, NULL, 10);
+			have_length = true;
+			break;
+		}
+	}
+
+	if (! have_length)
+	{
+		(void) fprintf(stderr, "response without a Content-Length\n");
+		return SIZE_MAX;
+	}
+
+	if (in->len < hdrlen + bodylen)
+		return 0;
+
+	*ok = bench_count(in->data + hdrlen, bodylen, "\"error\":null");
+
+	return hdrlen + bodylen;
+}
+
+static void
+print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr, "usage: %s [-h] [-H host] [-p port] [-n calls] [-b batch] [-d depth] [method [param ...]]\n"
+	                       "\n"
+	                       "  -H host   host the services httpd listens on (default: %s)\n"
+	                       "  -p port   its port (default: %s)\n"
+	                       "  -n calls  number of calls to make (default: %lu)\n"
+	                       "  -b batch  calls per HTTP request, sent as a batch if more than 1 (default: 1)\n"
+	                       "  -d depth  HTTP requests to have in flight at once (default: 1)\n"
+	                       "\n"
+	                       "The default call is %s(\"%s\"), which needs no authentication.\n",
+	                       progname, BENCH_HOST_DEF, BENCH_PORT_DEF, BENCH_CALLS_DEF, BENCH_METHOD_DEF,
+	                       BENCH_PARAM_DEF);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{  "help",       no_argument, NULL, 'h', 0 },
+		{  "host", required_argument, NULL, 'H', 0 },
+		{  "port", required_argument, NULL, 'p', 0 },
+		{ "calls", required_argument, NULL, 'n', 0 },
+		{ "batch", required_argument, NULL, 'b', 0 },
+		{ "depth", required_argument, NULL, 'd', 0 },
+		{    NULL,                 0, NULL,  0 , 0 },
+	};
+
+	const char *host = BENCH_HOST_DEF;
+	const char *port = BENCH_PORT_DEF;
+	const char *method = BENCH_METHOD_DEF;
+	unsigned long calls = BENCH_CALLS_DEF;
+	unsigned long batch = 1;
+	unsigned long depth = 1;
+	struct bench_buf body = { NULL, 0, 0 };
+	struct bench_buf request = { NULL, 0, 0 };
+	struct bench_buf in = { NULL, 0, 0 };
+	char buf[BUFSIZE];
+	uint64_t requests, sent = 0, received = 0, ok = 0, start;
+	double elapsed;
+	int fd;
+	int r;
+
+	while ((r = mowgli_getopt_long(argc, argv, "hH:p:n:b:d:", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'H':
+				host = mowgli_optarg;
+				break;
+			case 'p':
+				port = mowgli_optarg;
+				break;
+			case 'n':
+				calls = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			case 'b':
+				batch = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			case 'd':
+				depth = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			default:
+				(void) print_usage(argv[0]);
+				return (r == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (! calls || ! batch || ! depth)
+	{
+		(void) print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (mowgli_optind < argc)
+		method = argv[mowgli_optind++];
+
+	// one HTTP request, sent over and over
+	if (batch > 1)
+		(void) bench_buf_str(&body, "[");
+
+	for (unsigned long i = 0; i < batch; i++)
+	{
+		(void) snprintf(buf, sizeof buf, "%s{\"jsonrpc\":\"2.0\",\"id\":\"%lu\",\"method\":", i ? "," : "", i);
+		(void) bench_buf_str(&body, buf);
+		(void) bench_buf_json(&body, method);
+		(void) bench_buf_str(&body, ",\"params\":[");
+
+		if (mowgli_optind < argc)
+		{
+			for (int j = mowgli_optind; j < argc; j++)
+			{
+				if (j > mowgli_optind)
+					(void) bench_buf_str(&body, ",");
+
+				(void) bench_buf_json(&body, argv[j]);
+			}
+		}
+		else if (! strcmp(method, BENCH_METHOD_DEF))
+			(void) bench_buf_json(&body, BENCH_PARAM_DEF);
+
+		(void) bench_buf_str(&body, "]}");
+	}
+
+	if (batch > 1)
+		(void) bench_buf_str(&body, "]");
+
+	(void) snprintf(buf, sizeof buf, "POST %s HTTP/1.1\r\n"
+	                                 "Host: %s\r\n"
+	                                 "Content-Type: application/json\r\n"
+	                                 "Content-Length: %zu\r\n"
+	                                 "\r\n", BENCH_PATH, host, body.len);
+	(void) bench_buf_str(&request, buf);
+	(void) bench_buf_append(&request, body.data, body.len);
+
+	if ((fd = bench_connect(host, port)) == -1)
+		return EXIT_FAILURE;
+
+	requests = (calls + batch - 1) / batch;
+	start = bench_clock();
+
+	while (received < requests)
+	{
+		while (sent < requests && sent - received < depth)
+		{
+			if (! bench_write(fd, request.data, request.len))
+				return EXIT_FAILURE;
+
+			sent++;
+		}
+
+		const ssize_t n = read(fd, buf, sizeof buf);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+		{
+			(void) fprintf(stderr, "connection lost after %" PRIu64 " responses\n", received);
+			return EXIT_FAILURE;
+		}
+
+		(void) bench_buf_append(&in, buf, (size_t) n);
+
+		for (;;)
+		{
+			size_t good = 0;
+			const size_t used = bench_response(&in, &good);
+
+			if (used == SIZE_MAX)
+				return EXIT_FAILURE;
+
+			if (! used)
+				break;
+
+			(void) memmove(in.data, in.data + used, in.len - used + 1);
+			in.len -= used;
+
+			ok += good;
+			received++;
+		}
+	}
+
+	elapsed = (double) (bench_clock() - start) / 1e9;
+
+	(void) close(fd);
+
+	(void) printf("%" PRIu64 " calls in %" PRIu64 " requests (batch %lu, depth %lu) in %.3f s\n",
+	              requests * batch, requests, batch, depth, elapsed);
+	(void) printf("%.0f calls/s, %.0f requests/s\n", (double) (requests * batch) / elapsed,
+	              (double) requests / elapsed);
+
+	if (ok != requests * batch)
+		(void) printf("%" PRIu64 " calls returned an error\n", (requests * batch) - ok);
+
+	(void) sfree(body.data);
+	(void) sfree(request.data);
+	(void) sfree(in.data);
+
+	return EXIT_SUCCESS;
+}
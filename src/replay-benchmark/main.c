@@ -0,0 +1,437 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * Uplink traffic replay benchmark.
+ *
+ * Starts up as services would from a configuration file (loading its
+ * modules and database, but never saving it), connects to a fake uplink
+ * made of one end of a socketpair, and feeds a capture of server-to-server
+ * traffic through the protocol module's parser as fast as it can.
+ *
+ * The capture is either raw protocol lines, or a log written with the
+ * rawdata log level; in the latter only the lines we received ("-> ") are
+ * replayed. Whatever services send back is read and discarded.
+ *
+ * Reports lines per second, the time spent in each protocol command and
+ * each hook event (hook time is included in that of the command that
+ * raised it), and peak RSS. For hooks, both the inclusive time and the
+ * self time (excluding hooks raised from within them) are shown; the share
+ * column is based on self time, so the hook shares add up to the overall
+ * hook share rather than past it.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>        // mowgli_getopt_option_t, mowgli_getopt_long()
+
+#define REPLAY_FLUSH_LINES      256U
+#define REPLAY_REPORT_ROWS      25U
+#define REPLAY_HOOK_DEPTH       32U
+
+struct replay_stat
+{
+	char *          name;
+	uint64_t        calls;
+	uint64_t        nsec;           // inclusive
+	uint64_t        self_nsec;      // excluding nested hooks
+};
+
+static mowgli_patricia_t *replay_commands = NULL;
+static mowgli_patricia_t *replay_hooks = NULL;
+
+static uint64_t replay_hook_nsec = 0;
+static uint64_t replay_hook_begin[REPLAY_HOOK_DEPTH];
+static uint64_t replay_hook_child_nsec[REPLAY_HOOK_DEPTH + 1];
+static uint64_t replay_bytes_out = 0;
+static int replay_sink = -1;
+
+static uint64_t
+replay_clock(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * UINT64_C(1000000000)) + (uint64_t) ts.tv_nsec;
+}
+
+static void
+replay_stat_add(mowgli_patricia_t *const restrict stats, const char *const restrict name, const uint64_t nsec,
+                const uint64_t self_nsec)
+{
+	struct replay_stat *st;
+
+	if ((st = mowgli_patricia_retrieve(stats, name)) == NULL)
+	{
+		st = smalloc(sizeof *st);
+		st->name = sstrdup(name);
+
+		(void) mowgli_patricia_add(stats, st->name, st);
+	}
+
+	st->calls++;
+	st->nsec += nsec;
+	st->self_nsec += self_nsec;
+}
+
+/* Nested events finish before the event that raised them, so the time of
+ * every event at depth d + 1 is collected in child[d + 1] until the event
+ * at depth d finishes and subtracts it from its own.
+ */
+static void
+replay_hook_timing(const char *const restrict event, const bool done, unsigned int depth)
+{
+	uint64_t nsec, children;
+
+	if (depth >= REPLAY_HOOK_DEPTH)
+		depth = REPLAY_HOOK_DEPTH - 1;
+
+	if (! done)
+	{
+		replay_hook_begin[depth] = replay_clock();
+		return;
+	}
+
+	nsec = replay_clock() - replay_hook_begin[depth];
+	children = replay_hook_child_nsec[depth + 1];
+	replay_hook_child_nsec[depth + 1] = 0;
+
+	(void) replay_stat_add(replay_hooks, event, nsec, (children < nsec) ? nsec - children : 0);
+
+	if (depth == 0)
+		replay_hook_nsec += nsec;
+	else
+		replay_hook_child_nsec[depth] += nsec;
+}
+
+static int
+replay_stat_cmp(const void *const restrict a, const void *const restrict b)
+{
+	const struct replay_stat *const sa = *(const struct replay_stat *const *) a;
+	const struct replay_stat *const sb = *(const struct replay_stat *const *) b;
+
+	if (sa->self_nsec != sb->self_nsec)
+		return (sa->self_nsec < sb->self_nsec) ? 1 : -1;
+
+	return strcmp(sa->name, sb->name);
+}
+
+static void
+replay_stat_report(mowgli_patricia_t *const restrict stats, const char *const restrict title,
+                   const uint64_t total_nsec)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct replay_stat **sorted;
+	struct replay_stat *st;
+	size_t count = 0;
+
+	if (! mowgli_patricia_size(stats))
+		return;
+
+	sorted = smalloc(mowgli_patricia_size(stats) * sizeof *sorted);
+
+	MOWGLI_PATRICIA_FOREACH(st, &state, stats)
+		sorted[count++] = st;
+
+	(void) qsort(sorted, count, sizeof *sorted, &replay_stat_cmp);
+
+	(void) printf("\n%-24s %12s %12s %12s %10s %7s\n", title, "calls", "total (ms)", "self (ms)", "avg (us)",
+	              "share");
+
+	for (size_t i = 0; i < count && i < REPLAY_REPORT_ROWS; i++)
+		(void) printf("%-24s %12" PRIu64 " %12.3f %12.3f %10.3f %6.1f%%\n", sorted[i]->name, sorted[i]->calls,
+		              sorted[i]->nsec / 1000000.0, sorted[i]->self_nsec / 1000000.0,
+		              (sorted[i]->nsec / 1000.0) / sorted[i]->calls,
+		              total_nsec ? (100.0 * sorted[i]->self_nsec) / total_nsec : 0.0);
+
+	if (count > REPLAY_REPORT_ROWS)
+		(void) printf("(%zu more)\n", count - REPLAY_REPORT_ROWS);
+
+	(void) sfree(sorted);
+}
+
+// write out whatever services have queued for the uplink, and throw it away
+static void
+replay_drain(struct connection *const restrict cptr)
+{
+	char buf[BUFSIZE * 16];
+	ssize_t len;
+
+	do
+	{
+		if (cptr->sendq_len)
+			(void) sendq_flush(cptr);
+
+		while ((len = read(replay_sink, buf, sizeof buf)) > 0)
+			replay_bytes_out += (uint64_t) len;
+
+	} while (cptr->sendq_len && ! (cptr->flags & CF_DEAD));
+}
+
+static void
+replay_close(struct connection *const restrict cptr)
+{
+	curr_uplink->conn = NULL;
+	me.connected = false;
+}
+
+/* Returns the line to replay, or NULL if this line of a log is not one we
+ * received from the uplink.
+ */
+static char *
+replay_extract(char *line)
+{
+	char *p;
+
+	if ((p = strpbrk(line, "\r\n")) != NULL)
+		*p = '\0';
+
+	if (*line != '[')
+		return line;
+
+	if ((p = strstr(line, "] ")) == NULL)
+		return NULL;
+
+	p += 2;
+
+	if (strncmp(p, "-> ", 3) != 0)
+		return NULL;
+
+	return p + 3;
+}
+
+static void
+replay_command_name(const char *line, char *const restrict buf, const size_t buflen)
+{
+	size_t len;
+
+	if (*line == ':' && (line = strchr(line, ' ')) != NULL)
+		line++;
+
+	if (line == NULL || *line == '\0')
+	{
+		(void) mowgli_strlcpy(buf, "(none)", buflen);
+		return;
+	}
+
+	for (len = 0; line[len] != '\0' && line[len] != ' ' && len < buflen - 1; len++)
+		buf[len] = line[len];
+
+	buf[len] = '\0';
+}
+
+static void
+print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr, "usage: %s [-h] [-c config] [-p protocol] capture\n"
+	                       "\n"
+	                       "  -c config    configuration file (default: %s)\n"
+	                       "  -p protocol  protocol module to load if the configuration does not,\n"
+	                       "               e.g. ts6-generic, p10-generic, inspircd, unreal4\n",
+	                       progname, SYSCONFDIR "/atheme.conf");
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{     "help",       no_argument, NULL, 'h', 0 },
+		{   "config", required_argument, NULL, 'c', 0 },
+		{ "protocol", required_argument, NULL, 'p', 0 },
+		{       NULL,                 0, NULL,  0 , 0 },
+	};
+
+	const char *protocol = NULL;
+	char line[BUFSIZE + 1];
+	char command[BUFSIZE];
+	char modname[BUFSIZE];
+	struct connection *cptr;
+	struct rusage ru;
+	uint64_t start, parse_nsec = 0, lines = 0, bytes_in = 0;
+	double elapsed;
+	FILE *capture;
+	int sv[2];
+	int r;
+
+	config_file = sstrdup(SYSCONFDIR "/atheme.conf");
+
+	while ((r = mowgli_getopt_long(argc, argv, "hc:p:", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'c':
+				(void) sfree(config_file);
+				config_file = sstrdup(mowgli_optarg);
+				break;
+			case 'p':
+				protocol = mowgli_optarg;
+				break;
+			default:
+				(void) print_usage(argv[0]);
+				return (r == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (mowgli_optind != argc - 1)
+	{
+		(void) print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if ((capture = fopen(argv[mowgli_optind], "r")) == NULL)
+	{
+		(void) fprintf(stderr, "fopen('%s'): %s\n", argv[mowgli_optind], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	atheme_bootstrap();
+	atheme_init(argv[0], LOGDIR "/replay-benchmark.log");
+	atheme_setup();
+
+	runflags = RF_LIVE | RF_STARTING;
+	datadir = DATADIR;
+	readonly = true;
+	cold_start = true;
+
+	conf_init();
+
+	if (! conf_parse(config_file))
+	{
+		(void) fprintf(stderr, "cannot load configuration file '%s'\n", config_file);
+		return EXIT_FAILURE;
+	}
+
+	cold_start = false;
+
+	if (protocol != NULL)
+	{
+		if (ircd != NULL)
+		{
+			(void) fprintf(stderr, "'%s' already loads a protocol module\n", config_file);
+			return EXIT_FAILURE;
+		}
+
+		(void) snprintf(modname, sizeof modname, "protocol/%s", protocol);
+
+		if (! module_load(modname))
+			return EXIT_FAILURE;
+	}
+
+	if (ircd == NULL || parse == NULL)
+	{
+		(void) fprintf(stderr, "no protocol module loaded; use -p\n");
+		return EXIT_FAILURE;
+	}
+
+	if (db_load != NULL)
+		db_load(NULL);
+
+	runflags &= ~RF_STARTING;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+	{
+		(void) perror("socketpair(2)");
+		return EXIT_FAILURE;
+	}
+
+	replay_sink = sv[1];
+	(void) fcntl(replay_sink, F_SETFL, fcntl(replay_sink, F_GETFL, 0) | O_NONBLOCK);
+
+	if (MOWGLI_LIST_LENGTH(&uplinks) != 0)
+		curr_uplink = uplinks.head->data;
+	else
+		curr_uplink = uplink_add("replay.invalid", "127.0.0.1", "replay", "replay", NULL, 6667);
+
+	if ((cptr = connection_add("replay uplink", sv[0], 0, NULL, NULL)) == NULL)
+		return EXIT_FAILURE;
+
+	cptr->close_handler = &replay_close;
+	curr_uplink->conn = cptr;
+	irc_handle_connect(cptr);
+	replay_drain(cptr);
+
+	replay_commands = mowgli_patricia_create(&strcasecanon);
+	replay_hooks = mowgli_patricia_create(&strcasecanon);
+	hook_timing_fn = &replay_hook_timing;
+
+	(void) printf("replaying %s through %s ...\n", argv[mowgli_optind], ircd->ircdname);
+	(void) fflush(stdout);
+
+	start = replay_clock();
+
+	while (fgets(line, sizeof line, capture) != NULL)
+	{
+		const bool truncated = strchr(line, '\n') == NULL && ! feof(capture);
+		char *const msg = replay_extract(line);
+		uint64_t before, spent;
+
+		// fgets() splits a too-long line; drop the rest of it, as recvq would
+		if (truncated)
+		{
+			int c;
+
+			while ((c = fgetc(capture)) != EOF && c != '\n')
+				;
+		}
+
+		if (msg == NULL || *msg == '\0')
+			continue;
+
+		(void) replay_command_name(msg, command, sizeof command);
+
+		bytes_in += strlen(msg) + 2;
+
+		before = replay_clock();
+		parse(msg);
+		spent = replay_clock() - before;
+
+		(void) replay_stat_add(replay_commands, command, spent, spent);
+		parse_nsec += spent;
+
+		if (! (++lines % REPLAY_FLUSH_LINES))
+		{
+			CURRTIME = time(NULL);
+			(void) replay_drain(cptr);
+		}
+
+		if (curr_uplink->conn == NULL || (curr_uplink->conn->flags & CF_DEAD) || ! me.connected)
+		{
+			(void) fprintf(stderr, "uplink closed after %" PRIu64 " lines, stopping\n", lines);
+			break;
+		}
+	}
+
+	elapsed = (replay_clock() - start) / 1000000000.0;
+
+	if (curr_uplink->conn != NULL && ! (curr_uplink->conn->flags & CF_DEAD))
+		(void) replay_drain(curr_uplink->conn);
+
+	hook_timing_fn = NULL;
+	(void) fclose(capture);
+
+	(void) printf("\n%" PRIu64 " lines (%" PRIu64 " bytes in, %" PRIu64 " bytes out) in %.3f s: %.0f lines/s\n",
+	              lines, bytes_in, replay_bytes_out, elapsed, elapsed > 0 ? lines / elapsed : 0.0);
+	(void) printf("parsing and handling: %.3f s, of which hooks %.3f s (%.1f%%)\n",
+	              parse_nsec / 1000000000.0, replay_hook_nsec / 1000000000.0,
+	              parse_nsec ? (100.0 * replay_hook_nsec) / parse_nsec : 0.0);
+	(void) printf("network: %u servers, %u users, %u channels, %u memberships\n",
+	              cnt.server, cnt.user, cnt.chan, cnt.chanuser);
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		(void) printf("peak RSS: %ld KiB\n", (long) ru.ru_maxrss);
+
+	(void) replay_stat_report(replay_commands, "command", parse_nsec);
+	(void) replay_stat_report(replay_hooks, "hook", parse_nsec);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * Netsplit teardown benchmark.
+ *
+ * Builds a synthetic leaf server with a large number of users spread over
+ * a set of channels, then measures how long it takes to remove them all,
+ * once by quitting every user individually and once by splitting the leaf.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+
+#define SPLIT_USERS_DEF         50000U
+#define SPLIT_JOINS_DEF         5U
+
+#define SPLIT_LEAF_NAME         "leaf.split.test"
+#define SPLIT_LEAF_SID          "1SP"
+
+static struct ircd split_ircd = {
+	.ircdname               = "split-benchmark",
+	.tldprefix              = "$$",
+	.uses_uid               = true,
+	.ban_like_modes         = "beI",
+	.except_mchar           = 'e',
+	.invex_mchar            = 'I',
+};
+
+static const char uid_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static void
+make_uid(char *const restrict buf, unsigned int n)
+{
+	(void) memcpy(buf, SPLIT_LEAF_SID, 3);
+
+	for (int i = 8; i >= 3; i--)
+	{
+		buf[i] = uid_chars[n % 36];
+		n /= 36;
+	}
+
+	buf[9] = 0x00;
+}
+
+static struct server *
+build_leaf(const unsigned int users, const unsigned int chans, const unsigned int joins)
+{
+	struct server *const leaf = server_add(SPLIT_LEAF_NAME, 1, me.me, SPLIT_LEAF_SID, "split benchmark leaf");
+	struct channel **const chanv = smalloc(chans * sizeof *chanv);
+	char name[BUFSIZE];
+	char uid[IDLEN + 1];
+
+	for (unsigned int i = 0; i < chans; i++)
+	{
+		(void) snprintf(name, sizeof name, "#split%u", i);
+		chanv[i] = channel_add(name, CURRTIME, leaf);
+	}
+
+	for (unsigned int i = 0; i < users; i++)
+	{
+		(void) snprintf(name, sizeof name, "split%u", i);
+		make_uid(uid, i);
+		(void) user_add(name, "split", "split.test", NULL, NULL, uid, "split benchmark user", leaf, CURRTIME);
+
+		for (unsigned int j = 0; j < joins; j++)
+			(void) chanuser_add(chanv[(i + j * 7919U) % chans], uid);
+	}
+
+	(void) sfree(chanv);
+	return leaf;
+}
+
+static double
+elapsed(const struct timeval *const restrict start)
+{
+	struct timeval end;
+
+	(void) gettimeofday(&end, NULL);
+
+	return (double) (end.tv_sec - start->tv_sec) + ((double) (end.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int users = SPLIT_USERS_DEF;
+	unsigned int joins = SPLIT_JOINS_DEF;
+	struct server *leaf;
+	struct timeval start;
+	mowgli_node_t *n, *tn;
+
+	if (argc > 1 && (! string_to_uint(argv[1], &users) || ! users))
+	{
+		(void) fprintf(stderr, "usage: %s [users [joins-per-user]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc > 2 && (! string_to_uint(argv[2], &joins) || ! joins))
+	{
+		(void) fprintf(stderr, "usage: %s [users [joins-per-user]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const unsigned int chans = (users / 10U) ? (users / 10U) : 1U;
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	atheme_bootstrap();
+	atheme_init(argv[0], LOGDIR "/split-benchmark.log");
+	atheme_setup();
+
+	runflags = RF_LIVE;
+	ircd = &split_ircd;
+	me.me = server_add("services.split.test", 0, NULL, "0SP", "split benchmark services");
+
+	(void) printf("%u users, %u channels, %u joins per user\n\n", users, chans, joins);
+
+	leaf = build_leaf(users, chans, joins);
+	(void) printf("per-user QUIT:  %u users, %u memberships ... ", cnt.user, cnt.chanuser);
+	(void) fflush(stdout);
+	(void) gettimeofday(&start, NULL);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, leaf->userlist.head)
+		(void) user_delete(n->data, "Quit");
+
+	(void) printf("%.3f s\n", elapsed(&start));
+	(void) server_delete(SPLIT_LEAF_NAME);
+
+	leaf = build_leaf(users, chans, joins);
+	(void) printf("bulk netsplit:  %u users, %u memberships ... ", cnt.user, cnt.chanuser);
+	(void) fflush(stdout);
+	(void) gettimeofday(&start, NULL);
+
+	(void) server_delete(SPLIT_LEAF_NAME);
+
+	(void) printf("%.3f s\n", elapsed(&start));
+
+	if (cnt.chanuser != 0 || cnt.chan != 0)
+	{
+		(void) fprintf(stderr, "leftover state: %u channels, %u memberships\n", cnt.chan, cnt.chanuser);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
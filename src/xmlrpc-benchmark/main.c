@@ -0,0 +1,418 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * XML-RPC request processing benchmark.
+ *
+ * Runs the same method call through the XML-RPC library over and over, in
+ * process, and measures how many requests per second it gets through: once
+ * with the current one-pass parser and response writer, and once with the
+ * code they replaced (normalise a copy of the document, look for the method
+ * name and each value with strstr(), build the response out of string
+ * appends), which is kept below for comparison.
+ *
+ * Both paths must produce the same response for the same request; the
+ * benchmark fails if they did not.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>        // mowgli_getopt_option_t, mowgli_getopt_long()
+
+// the library is built into the module; build it in here too, for its statics
+#include "xmlrpclib.c"
+
+#define BENCH_REQUESTS_DEF      200000UL
+#define BENCH_PARAMS_DEF        6UL
+#define BENCH_LENGTH_DEF        32UL
+#define BENCH_METHOD            "bench.echo"
+
+static bool bench_legacy = false;
+static char *bench_response = NULL;
+
+/*
+ * The previous request path, as it was.
+ */
+
+static char *
+legacy_parse(char *buffer)
+{
+	char *tmp = strstr(buffer, "<?xml");
+
+	if (tmp)
+		return xmlrpc_normalizeBuffer(tmp);
+
+	return NULL;
+}
+
+static char *
+legacy_method(char *buffer)
+{
+	char *data, *p, *name;
+	int namelen;
+
+	data = strstr(buffer, "<methodName>");
+	if (data)
+	{
+		data += 12;
+		p = strchr(data, '<');
+		if (p == NULL)
+			return NULL;
+		namelen = p - data;
+		name = smalloc(namelen + 1);
+		memcpy(name, data, namelen);
+		return name;
+	}
+	return NULL;
+}
+
+static int
+legacy_split_buf(char *buffer, char ***argv)
+{
+	int ac = 0;
+	int argvsize = 8;
+	char *data, *str;
+	char *nexttag = NULL;
+	char *p;
+	int tagtype = 0;
+
+	data = buffer;
+	*argv = smalloc(sizeof(char *) * argvsize);
+	while ((data = strstr(data, "<value>")))
+	{
+		data += 7;
+		nexttag = strchr(data, '<');
+		if (nexttag == NULL)
+			break;
+		nexttag++;
+		p = strchr(nexttag, '>');
+		if (p == NULL)
+			break;
+		*p++ = '\0';
+
+		if (!stricmp("string", nexttag))
+			tagtype = 1;
+		else
+			tagtype = 0;
+		str = p;
+		p = strchr(str, '<');
+		if (p == NULL)
+			break;
+		*p++ = '\0';
+		if (ac >= argvsize)
+		{
+			argvsize *= 2;
+			*argv = sreallocarray(*argv, argvsize, sizeof(char *));
+		}
+		if (tagtype == 1)
+			(*argv)[ac++] = xmlrpc_decode_string(str);
+		else
+			(*argv)[ac++] = str;
+		data = p;
+	}
+	return ac;
+}
+
+static void
+legacy_process(char *buffer, void *userdata)
+{
+	XMLRPCCmd *xml;
+	char *tmp;
+	int ac;
+	char **av = NULL;
+	char *name = NULL;
+
+	tmp = legacy_parse(buffer);
+	if (tmp)
+	{
+		name = legacy_method(tmp);
+		if (name)
+		{
+			xml = mowgli_patricia_retrieve(XMLRPCCMD, name);
+			if (xml)
+			{
+				ac = legacy_split_buf(tmp, &av);
+				xml->func(userdata, ac, av);
+			}
+		}
+	}
+	sfree(av);
+	sfree(tmp);
+	sfree(name);
+}
+
+static void
+legacy_append_char_encode(mowgli_string_t *s, const char *s1)
+{
+	long unsigned int i;
+	unsigned char c;
+	char buf2[15];
+
+	if ((!(s1) || (*(s1) == '\0')))
+	{
+		return;
+	}
+
+	for (i = 0; s1[i] != '\0'; i++)
+	{
+		c = s1[i];
+		if (c > 127)
+		{
+			snprintf(buf2, sizeof buf2, "&#%d;", c);
+			s->append(s, buf2, strlen(buf2));
+		}
+		else if (c == '&')
+			s->append(s, "&amp;", 5);
+		else if (c == '<')
+			s->append(s, "&lt;", 4);
+		else if (c == '>')
+			s->append(s, "&gt;", 4);
+		else if (c == '"')
+			s->append(s, "&quot;", 6);
+		else
+			s->append_char(s, c);
+	}
+}
+
+static void
+legacy_send_string(const char *value)
+{
+	char buf[1024];
+	const char *ss;
+	mowgli_string_t *s = mowgli_string_create();
+
+	snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n<params>\r\n");
+	s->append(s, buf, strlen(buf));
+
+	ss = " <param>\r\n  <value>\r\n   <string>";
+	s->append(s, ss, strlen(ss));
+	legacy_append_char_encode(s, value);
+	ss = "</string>\r\n  </value>\r\n </param>\r\n";
+	s->append(s, ss, strlen(ss));
+
+	ss = "</params>\r\n</methodResponse>";
+	s->append(s, ss, strlen(ss));
+
+	xmlrpc.setbuffer(s->str, s->pos);
+
+	s->destroy(s);
+}
+
+/*
+ * The benchmark.
+ */
+
+// replies with the parameters joined by spaces, so that all of them are looked at
+static int
+bench_echo(void *userdata, int ac, char **av)
+{
+	char buf[XMLRPC_BUFSIZE];
+
+	(void) mowgli_strlcpy(buf, ac ? av[0] : "", sizeof buf);
+
+	for (int i = 1; i < ac; i++)
+	{
+		(void) mowgli_strlcat(buf, " ", sizeof buf);
+		(void) mowgli_strlcat(buf, av[i], sizeof buf);
+	}
+
+	if (bench_legacy)
+		(void) legacy_send_string(buf);
+	else
+		(void) xmlrpc_send_string(buf);
+
+	return XMLRPC_CONT;
+}
+
+static char *
+bench_setbuffer(char *buf, int length)
+{
+	if (bench_response == NULL)
+	{
+		bench_response = smalloc((size_t) length + 1);
+		(void) memcpy(bench_response, buf, (size_t) length);
+	}
+
+	return buf;
+}
+
+static uint64_t
+bench_clock(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * UINT64_C(1000000000)) + (uint64_t) ts.tv_nsec;
+}
+
+/* A call with the given number of string parameters, each with a few
+ * entities in it. They are all named ones: the previous path left the
+ * semicolon of a numeric one in the string.
+ */
+static char *
+bench_request(const unsigned long params, const unsigned long length, size_t *const restrict len)
+{
+	static const char text[] = "a&amp;b &lt;c&gt; d&quot;ef &amp;&amp; ghijklmnopqrstuvwxyz0123456789 ";
+	static const char param_head[] = " <param>\r\n  <value><string>";
+	static const char param_tail[] = "</string></value>\r\n </param>\r\n";
+	static const char head[] = "<?xml version=\"1.0\"?>\r\n<methodCall>\r\n<methodName>" BENCH_METHOD
+	                           "</methodName>\r\n<params>\r\n";
+	static const char tail[] = "</params>\r\n</methodCall>\r\n";
+	mowgli_string_t *const s = mowgli_string_create();
+	char *request;
+
+	s->append(s, head, sizeof head - 1);
+
+	for (unsigned long i = 0; i < params; i++)
+	{
+		bool entity = false;
+
+		s->append(s, param_head, sizeof param_head - 1);
+
+		// never stop in the middle of an entity; the two paths disagree about broken ones
+		for (unsigned long j = 0; j < length || entity; j++)
+		{
+			const char c = text[j % (sizeof text - 1)];
+
+			if (c == '&')
+				entity = true;
+			else if (c == ';')
+				entity = false;
+
+			s->append_char(s, c);
+		}
+
+		s->append(s, param_tail, sizeof param_tail - 1);
+	}
+
+	s->append(s, tail, sizeof tail - 1);
+
+	*len = s->pos;
+	request = smalloc(s->pos + 1);
+	(void) memcpy(request, s->str, s->pos);
+
+	s->destroy(s);
+	return request;
+}
+
+static double
+bench_run(const bool legacy, const char *const restrict request, const size_t len, const unsigned long requests,
+          char **const restrict response)
+{
+	char *const work = smalloc(len + 1);
+	uint64_t start = 0;
+
+	bench_legacy = legacy;
+	bench_response = NULL;
+
+	for (unsigned long i = 0; i < requests; i++)
+	{
+		if (i == 1)
+			start = bench_clock();
+
+		// httpd hands over a fresh buffer for every request, which the parser may write to
+		(void) memcpy(work, request, len + 1);
+
+		if (legacy)
+			(void) legacy_process(work, NULL);
+		else
+			(void) xmlrpc_process(work, NULL);
+	}
+
+	*response = bench_response;
+	(void) sfree(work);
+
+	return (double) (bench_clock() - start) / 1e9;
+}
+
+static void
+print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr, "usage: %s [-h] [-n requests] [-p params] [-l length]\n"
+	                       "\n"
+	                       "  -n requests  number of requests to process on each path (default: %lu)\n"
+	                       "  -p params    string parameters per request (default: %lu)\n"
+	                       "  -l length    characters per parameter (default: %lu)\n",
+	                       progname, BENCH_REQUESTS_DEF, BENCH_PARAMS_DEF, BENCH_LENGTH_DEF);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{     "help",       no_argument, NULL, 'h', 0 },
+		{ "requests", required_argument, NULL, 'n', 0 },
+		{   "params", required_argument, NULL, 'p', 0 },
+		{   "length", required_argument, NULL, 'l', 0 },
+		{       NULL,                 0, NULL,  0 , 0 },
+	};
+
+	unsigned long requests = BENCH_REQUESTS_DEF;
+	unsigned long params = BENCH_PARAMS_DEF;
+	unsigned long length = BENCH_LENGTH_DEF;
+	char *request, *old_response, *new_response;
+	double old_time, new_time;
+	size_t len;
+	int r;
+
+	while ((r = mowgli_getopt_long(argc, argv, "hn:p:l:", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'n':
+				requests = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			case 'p':
+				params = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			case 'l':
+				length = strtoul(mowgli_optarg, NULL, 10);
+				break;
+			default:
+				(void) print_usage(argv[0]);
+				return (r == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	// the first request of each run is a warm-up and is not timed
+	if (requests < 2 || ! params || params > XMLRPC_MAX_PARAMS)
+	{
+		(void) print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	(void) xmlrpc_set_buffer(&bench_setbuffer);
+	(void) xmlrpc_set_options(XMLRPC_HTTP_HEADER, XMLRPC_OFF);
+	(void) xmlrpc_register_method(BENCH_METHOD, &bench_echo);
+
+	request = bench_request(params, length, &len);
+
+	(void) printf("%lu requests of %zu bytes (%lu parameters of %lu characters)\n",
+	              requests, len, params, length);
+
+	old_time = bench_run(true, request, len, requests, &old_response);
+	new_time = bench_run(false, request, len, requests, &new_response);
+
+	if (old_response == NULL || new_response == NULL || strcmp(old_response, new_response) != 0)
+	{
+		(void) fprintf(stderr, "the two paths did not produce the same response\n");
+		return EXIT_FAILURE;
+	}
+
+	(void) printf("previous path: %.3f s, %.0f requests/s\n", old_time, (double) (requests - 1) / old_time);
+	(void) printf("current path:  %.3f s, %.0f requests/s (%.2fx)\n", new_time,
+	              (double) (requests - 1) / new_time, old_time / new_time);
+
+	(void) sfree(old_response);
+	(void) sfree(new_response);
+	(void) sfree(request);
+
+	return EXIT_SUCCESS;
+}
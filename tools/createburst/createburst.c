@@ -27,134 +27,620 @@
  * SUCH DAMAGE.
  */
 /*
- * make createtestdb
- * ./createtestdb 500000 >atheme.db
+ * make createburst
+ * ./createburst -s 42 -T 1500000000 500000 >burst.txt
+ * ./createburst -p p10 -s 42 -T 1500000000 500000 >burst.txt
+ * ./createburst -p ts5 -s 42 -T 1500000000 500000 >burst.txt
  *
- * then start atheme-services with this atheme.db
+ * Writes what an uplink would send when linking to services on a network
+ * of the given size: the servers, every client (logged in to their account
+ * if they have one), then every channel with its members, bans and topic.
+ * Given the same options as createtestdb it describes the network whose
+ * services.db that wrote, and can be fed to the replay benchmark or sent
+ * to services over a socket.
+ *
+ * TS5 has no client or server IDs, so that burst refers to everything by
+ * name, logs clients in with ENCAP LOGIN and sets bans with MODE.
  */
 
-#include	<stdio.h>
-#include	<time.h>
-#include	<stdlib.h>
-#include	<string.h>
+#include	<stdarg.h>
+#include	<unistd.h>
+
+#include	"../synthnet.h"
 
-#define		BUFSIZE 1024
-#define		SID "007"
+#define		LINELEN		510U
+#define		PASSWORD	"linkit"
+#define		TS5_MODES	4U
 
-static char new_uid[9];
-static unsigned int uindex = 9;
+static const char p10_b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789[]";
+static const char ts6_b36[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
 
-void init_uid(void)
+enum burst_proto
 {
-	unsigned int i;
-	char buf[BUFSIZE];
+	PROTO_TS6,
+	PROTO_TS5,
+	PROTO_P10,
+};
 
-	memset(new_uid, 0, sizeof(new_uid));
-	memcpy(new_uid, SID, strlen(SID));
+struct member
+{
+	unsigned long	client;
+	char		mode;		// 'o', 'v' or 0
+};
 
-	for (i = 0; i < strlen(SID); i++)
-		if (new_uid[i] == '\0')
-			new_uid[i] = 'A';
+struct burst
+{
+	const struct synthnet *sn;
+	enum burst_proto proto;
+	unsigned int	servers;
+	struct member *	members;
+	size_t		nmembers;
+};
 
-	for (i = strlen(SID); i < uindex; i++)
-		new_uid[i] = 'A';
+// a line being built up from tokens, and sent when the next would not fit
+struct line
+{
+	char		buf[LINELEN + 1];
+	size_t		len;
+	size_t		head;		// length of the part repeated on every line
+	size_t		tokens;
+	char		mode;		// if set, a MODE line: one of these per token
+};
+
+static void
+line_start(struct line *l, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	l->len = (size_t) vsnprintf(l->buf, sizeof l->buf, fmt, ap);
+	va_end(ap);
+
+	l->head = l->len;
+	l->tokens = 0;
+	l->mode = 0;
 }
 
-static void add_one_to_uid(unsigned int i)
+static void
+line_flush(struct line *l)
 {
-	if (i != strlen(SID))	/* Not reached server SID portion yet? */
+	char modes[TS5_MODES + 1];
+
+	if (! l->tokens)
+		return;
+
+	if (l->mode)
 	{
-		if (new_uid[i] == 'Z')
-			new_uid[i] = '0';
-		else if (new_uid[i] == '9')
-		{
-			new_uid[i] = 'A';
-			add_one_to_uid(i - 1);
-		}
-		else
-			new_uid[i] = new_uid[i] + 1;
+		(void) memset(modes, l->mode, l->tokens);
+		modes[l->tokens] = '\0';
+		(void) printf("%.*s%s %.*s\r\n", (int) l->head, l->buf, modes, (int) (l->len - l->head),
+		              l->buf + l->head);
+	}
+	else
+		(void) printf("%.*s\r\n", (int) l->len, l->buf);
+
+	l->len = l->head;
+	l->tokens = 0;
+}
+
+// flushes the line if a token of this length would not fit; true if it is now empty
+static bool
+line_fresh(struct line *l, size_t len)
+{
+	const size_t modes = l->mode ? l->tokens + 2U : 0;
+
+	if (l->tokens && (l->len + 1 + len + modes > LINELEN || (l->mode && l->tokens == TS5_MODES)))
+		(void) line_flush(l);
+
+	return ! l->tokens;
+}
+
+static void
+line_add(struct line *l, const char *token, char sep)
+{
+	const size_t len = strlen(token);
+
+	(void) line_fresh(l, len);
+
+	if (l->tokens)
+		l->buf[l->len++] = sep;
+
+	(void) memcpy(l->buf + l->len, token, len);
+	l->len += len;
+	l->tokens++;
+}
+
+static void
+encode(char *buf, const char *alphabet, unsigned int base, unsigned long value, unsigned int width)
+{
+	buf[width] = '\0';
+
+	while (width--)
+	{
+		buf[width] = alphabet[value % base];
+		value /= base;
 	}
+}
+
+static const char *
+server_id(const struct burst *b, unsigned int k, char *buf)
+{
+	const unsigned int v = k + 7U;
+
+	if (b->proto == PROTO_P10)
+	{
+		(void) encode(buf, p10_b64, 64U, k + 1U, 2U);
+		return buf;
+	}
+
+	// TS6 SIDs are a digit and two of [0-9A-Z]; the uplink is 007
+	buf[0] = (char) ('0' + (v / 1296U) % 10U);
+	buf[1] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[(v / 36U) % 36U];
+	buf[2] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[v % 36U];
+	buf[3] = '\0';
+	return buf;
+}
+
+static const char *
+server_name(unsigned int k, char *buf)
+{
+	if (k == 0)
+		(void) snprintf(buf, SN_NAMELEN, "irc.uplink.example");
+	else
+		(void) snprintf(buf, SN_NAMELEN, "leaf%u.uplink.example", k);
+
+	return buf;
+}
+
+static const char *
+client_uid(const struct burst *b, unsigned long c, char *buf)
+{
+	const unsigned long local = c / b->servers;
+
+	(void) server_id(b, (unsigned int) (c % b->servers), buf);
+
+	if (b->proto == PROTO_P10)
+		(void) encode(buf + 2, p10_b64, 64U, local, 3U);
 	else
 	{
-		if (new_uid[i] == 'Z')
-			for (i = strlen(SID); i < 9; i++)
-				new_uid[i] = 'A';
+		// the first character of a TS6 client ID must be a letter
+		buf[3] = (char) ('A' + (local / 60466176UL) % 26U);
+		(void) encode(buf + 4, ts6_b36, 36U, local % 60466176UL, 5U);
+	}
+
+	return buf;
+}
+
+// how a channel burst refers to a client: by nick in TS5, by UID otherwise
+static const char *
+client_ref(const struct burst *b, unsigned long c, char *buf)
+{
+	if (b->proto == PROTO_TS5)
+		return sn_client_nick(b->sn, c, buf);
+
+	return client_uid(b, c, buf);
+}
+
+// how a server is prefixed: by name in TS5, by ID otherwise
+static const char *
+server_ref(const struct burst *b, unsigned int k, char *buf)
+{
+	if (b->proto == PROTO_TS5)
+		return server_name(k, buf);
+
+	return server_id(b, k, buf);
+}
+
+static void
+burst_servers(const struct burst *b)
+{
+	char id[8], name[SN_NAMELEN], uplink[8];
+
+	(void) server_id(b, 0, uplink);
+
+	if (b->proto == PROTO_P10)
+	{
+		(void) printf("PASS :%s\r\n", PASSWORD);
+		(void) printf("SERVER %s 1 %lu %lu J10 %s]]] +h6 :Synthetic uplink\r\n", server_name(0, name),
+		              (unsigned long) b->sn->now, (unsigned long) b->sn->now, uplink);
+
+		for (unsigned int k = 1; k < b->servers; k++)
+			(void) printf("%s S %s 2 %lu %lu J10 %s]]] +h6 :Synthetic leaf\r\n", uplink, server_name(k, name),
+			              (unsigned long) b->sn->now, (unsigned long) b->sn->now, server_id(b, k, id));
+		return;
+	}
+
+	if (b->proto == PROTO_TS5)
+	{
+		(void) printf("PASS %s :TS\r\n", PASSWORD);
+		(void) printf("CAPAB :QS EX IE KLN UNKLN ENCAP TB SERVICES\r\n");
+		(void) printf("SERVER %s 1 :Synthetic uplink\r\n", server_name(0, uplink));
+		(void) printf("SVINFO 5 3 0 :%lu\r\n", (unsigned long) b->sn->now);
+
+		for (unsigned int k = 1; k < b->servers; k++)
+			(void) printf(":%s SERVER %s 2 :Synthetic leaf\r\n", uplink, server_name(k, name));
+		return;
+	}
+
+	(void) printf("PASS %s TS 6 :%s\r\n", PASSWORD, uplink);
+	(void) printf("CAPAB :QS EX IE KLN UNKLN ENCAP TB SERVICES EUID EOPMOD MLOCK\r\n");
+	(void) printf("SERVER %s 1 :Synthetic uplink\r\n", server_name(0, name));
+	(void) printf("SVINFO 6 3 0 :%lu\r\n", (unsigned long) b->sn->now);
+
+	for (unsigned int k = 1; k < b->servers; k++)
+		(void) printf(":%s SID %s 2 %s :Synthetic leaf\r\n", uplink, server_name(k, name), server_id(b, k, id));
+}
+
+static void
+burst_clients(const struct burst *b)
+{
+	const struct synthnet *const sn = b->sn;
+	char sid[SN_NAMELEN], uid[16], nick[SN_NAMELEN], ident[11], host[SN_NAMELEN], account[SN_NAMELEN], ip[8];
+
+	for (unsigned long c = 0; c < sn_clients(sn); c++)
+	{
+		if (! sn_client_exists(sn, c))
+			continue;
+
+		const uint64_t h = sn_hash(sn, SN_CLIENT, c, 3);
+		const unsigned int k = (unsigned int) (c % b->servers);
+		const unsigned long ts = (unsigned long) sn->now - (unsigned long) (h % (30U * 86400U));
+		const uint32_t addr = sn_client_ip(sn, c);
+		const bool oper = (h >> 40) % 1000U == 0;
+		size_t n = 0;
+
+		(void) sn_client_nick(sn, c, nick);
+		(void) sn_client_host(sn, c, host);
+
+		// ~ and up to 9 characters of the nick, before any separator
+		ident[n++] = '~';
+		for (; n < sizeof ident - 1 && nick[n - 1] && ! strchr("_|`-^[", nick[n - 1]); n++)
+			ident[n] = nick[n - 1];
+		ident[n] = '\0';
+		(void) sn_lower(ident);
+
+		if (c < sn->accounts)
+			(void) sn_account_name(sn, c, account);
+
+		if (b->proto == PROTO_TS5)
+		{
+			(void) printf("NICK %s %u %lu +i%s %s %s %s :%s %s\r\n", nick, k ? 2U : 1U, ts, oper ? "o" : "",
+			              ident, host, server_name(k, sid), sn_word_at(h, 8), sn_word_at(h, 16));
+
+			if (c < sn->accounts)
+				(void) printf(":%s ENCAP * LOGIN %s\r\n", nick, account);
+
+			continue;
+		}
+
+		(void) server_id(b, k, sid);
+		(void) client_uid(b, c, uid);
+
+		if (b->proto == PROTO_P10)
+		{
+			(void) encode(ip, p10_b64, 64U, addr, 6U);
+			(void) printf("%s N %s %u %lu %s %s +i%s%s%s %s %s :%s %s\r\n", sid, nick, k ? 2U : 1U, ts, ident,
+			              host, oper ? "o" : "", (c < sn->accounts) ? "r " : "", (c < sn->accounts) ? account : "",
+			              ip, uid, sn_word_at(h, 8), sn_word_at(h, 16));
+		}
 		else
-			new_uid[i] = new_uid[i] + 1;
+			(void) printf(":%s EUID %s %u %lu +i%s %s %s %u.%u.%u.%u %s * %s :%s %s\r\n", sid, nick, k ? 2U : 1U,
+			              ts, oper ? "o" : "", ident, host, addr >> 24, (addr >> 16) & 0xFFU, (addr >> 8) & 0xFFU,
+			              addr & 0xFFU, uid, (c < sn->accounts) ? account : "*", sn_word_at(h, 8),
+			              sn_word_at(h, 16));
 	}
 }
 
-const char *uid_get(void)
+static void
+member_add(struct burst *b, unsigned long client, char mode)
 {
-	add_one_to_uid(uindex - 1);	/* index from 0 */
-	return (new_uid);
+	b->members[b->nmembers].client = client;
+	b->members[b->nmembers].mode = mode;
+	b->nmembers++;
 }
 
-int
-do_burst_ts5(int count, time_t now)
+/* Those on the access list who are online, with the status it gives them,
+ * then a heavy-tailed number of other clients. The first of those is the
+ * creator of an unregistered channel, and opped.
+ */
+static void
+channel_members(struct burst *b, unsigned long j, bool registered)
 {
-	int i;
-	char nick[20];
+	const struct synthnet *const sn = b->sn;
+	const unsigned int want = sn_pareto(sn_hash(sn, SN_MEMBER, j, registered ? 0 : 1), sn->members, SN_MAX_MEMBERS);
+	size_t access = 0;
+	struct sn_access ca;
+	struct sn_walk w;
+
+	b->nmembers = 0;
+
+	if (registered)
+	{
+		const unsigned int len = sn_channel_access_len(sn, j);
+
+		for (unsigned int k = 0; k < len; k++)
+		{
+			(void) sn_channel_access(sn, j, k, &ca);
+
+			if (ca.role == SN_ROLE_AKICK || ! sn_account_online(sn, ca.account))
+				continue;
 
-	printf("PASS linkit TS\r\n");
-	printf("CAPAB :QS EX IE KLN UNKLN ENCAP TB SERVICES EUID EOPMOD MLOCK\r\n");
-	printf("SERVER irc.uplink.com 1 :Test file\r\n");
-	printf("SVINFO 5 3 0 :%lu\r\n", (unsigned long) now);
+			(void) member_add(b, ca.account, (ca.role == SN_ROLE_VOP || ca.role == SN_ROLE_HOP) ? 'v' : 'o');
+		}
+
+		access = b->nmembers;
+	}
+
+	(void) sn_walk_init(&w, sn_hash(sn, SN_MEMBER, j, registered ? 2 : 3), sn_clients(sn));
 
-	for (i = 0; i < count; i++)
+	for (unsigned long e = 0, added = 0; added < want && e < 4UL * want && e < sn_clients(sn); e++)
 	{
-		snprintf(nick, sizeof nick, "a%010d", i);
-		printf("NICK %s 1 %lu +i ~Guest moo.cows.go.moo irc.uplink.com :Grazing cow #%ld\r\n",
-				nick, (unsigned long) now, i);
+		const unsigned long c = (unsigned long) sn_walk_at(&w, e);
+		bool dup = false;
+
+		if (! sn_client_exists(sn, c))
+			continue;
+
+		for (size_t m = 0; m < access && ! dup; m++)
+			dup = (b->members[m].client == c);
+
+		if (dup)
+			continue;
+
+		(void) member_add(b, c, (! registered && ! added) ? 'o' : 0);
+		added++;
 	}
+}
+
+static void
+channel_bans(const struct burst *b, unsigned long j, bool registered, struct line *l)
+{
+	const struct synthnet *const sn = b->sn;
+	const unsigned int count = sn_geometric(sn_hash(sn, SN_BAN, j, registered ? 0 : 1), sn->bans, SN_MAX_BANS);
+	char mask[SN_NAMELEN + 8], host[SN_NAMELEN];
+	struct sn_access ca;
 
-	printf(":irc.uplink.com PONG irc.uplink.com :irc.uplink.com\r\n");
+	// akicks are enforced with bans
+	if (registered)
+	{
+		const unsigned int len = sn_channel_access_len(sn, j);
 
-	return 0;
+		for (unsigned int k = 1; k < len; k++)
+		{
+			(void) sn_channel_access(sn, j, k, &ca);
+
+			if (ca.role == SN_ROLE_AKICK)
+				(void) line_add(l, ca.mask, ' ');
+		}
+	}
+
+	for (unsigned int k = 0; k < count; k++)
+	{
+		const uint64_t h = sn_hash(sn, SN_BAN, j, k + 2U);
+
+		if ((h >> 40) % 4U == 0)
+			(void) snprintf(mask, sizeof mask, "*!~%s*@*", sn_word_at(h, 8));
+		else
+			(void) snprintf(mask, sizeof mask, "*!*@%s",
+			                sn_client_host(sn, (unsigned long) (h % sn_clients(sn)), host));
+
+		(void) line_add(l, mask, ' ');
+	}
 }
 
-int
-do_burst_ts6(int count, time_t now)
+static void
+burst_channel(struct burst *b, unsigned long j, bool registered)
 {
-	int i;
-	char nick[20];
+	const struct synthnet *const sn = b->sn;
+	const unsigned long ts = (unsigned long) sn_channel_ts(sn, j, registered);
+	const char *const modes = sn_channel_secret(sn, j, registered) ? "+nst" : "+nt";
+	char uplink[SN_NAMELEN], uid[SN_NAMELEN], name[SN_NAMELEN], token[SN_NAMELEN + 2], setter[SN_NAMELEN];
+	char topic[BUFSIZ];
+	unsigned long topicts;
+	struct sn_access ca;
+	struct line l;
+
+	(void) channel_members(b, j, registered);
 
-	printf("PASS linkit TS 6 :%s\r\n", SID);
-	printf("CAPAB :QS EX IE KLN UNKLN ENCAP TB SERVICES EUID EOPMOD MLOCK\r\n");
-	printf("SERVER irc.uplink.com 1 :Test file\r\n");
-	printf("SVINFO 6 3 0 :%lu\r\n", (unsigned long) now);
+	// nobody is in it, so as far as the network is concerned it does not exist
+	if (! b->nmembers)
+		return;
 
-	for (i = 0; i < count; i++)
+	(void) server_ref(b, 0, uplink);
+	(void) sn_channel_name(sn, j, registered, name);
+
+	if (b->proto == PROTO_P10)
 	{
-		snprintf(nick, sizeof nick, "a%010d", i);
-		printf(":%s UID %s 1 %lu +i ~Guest moo.cows.go.moo 0 %s :Grazing cow #%ld\r\n",
-				SID, nick, (unsigned long) now, uid_get(), i);
+		static const char groups[] = { 0, 'v', 'o' };
+
+		/* Each member takes the status of the last one before it on the
+		 * same line that had any, so send them grouped by status.
+		 */
+		(void) line_start(&l, "%s B %s %lu %s ", uplink, name, ts, modes);
+
+		for (size_t g = 0; g < sizeof groups; g++)
+		{
+			bool first = true;
+
+			for (size_t m = 0; m < b->nmembers; m++)
+			{
+				if (b->members[m].mode != groups[g])
+					continue;
+
+				const bool fresh = line_fresh(&l, 7U);
+				const char *const status = (groups[g] == 'o') ? ":o" : ":v";
+
+				(void) snprintf(token, sizeof token, "%s%s", client_uid(b, b->members[m].client, uid),
+				                (groups[g] && (first || fresh)) ? status : "");
+				(void) line_add(&l, token, ',');
+				first = false;
+			}
+		}
+
+		(void) line_flush(&l);
+		(void) line_start(&l, "%s B %s %lu :%%", uplink, name, ts);
+		(void) channel_bans(b, j, registered, &l);
+		(void) line_flush(&l);
 	}
+	else
+	{
+		(void) line_start(&l, ":%s SJOIN %lu %s %s :", uplink, ts, name, modes);
 
-	printf(":%s PONG %s :%s\r\n", SID, SID, SID);
+		for (size_t m = 0; m < b->nmembers; m++)
+		{
+			const char mode = b->members[m].mode;
 
-	return 0;
+			(void) snprintf(token, sizeof token, "%s%s", (mode == 'o') ? "@" : (mode == 'v') ? "+" : "",
+			                client_ref(b, b->members[m].client, uid));
+			(void) line_add(&l, token, ' ');
+		}
+
+		(void) line_flush(&l);
+
+		if (b->proto == PROTO_TS5)
+		{
+			(void) line_start(&l, ":%s MODE %s +", uplink, name);
+			l.mode = 'b';
+		}
+		else
+			(void) line_start(&l, ":%s BMASK %lu %s b :", uplink, ts, name);
+
+		(void) channel_bans(b, j, registered, &l);
+		(void) line_flush(&l);
+	}
+
+	if (! sn_channel_topic(sn, j, registered, topic, sizeof topic))
+		return;
+
+	// the topic services have stored for a registered channel, or one its creator set
+	if (registered)
+	{
+		(void) sn_channel_access(sn, j, 0, &ca);
+		(void) sn_account_name(sn, ca.account, setter);
+		topicts = (unsigned long) sn_channel_used(sn, j);
+	}
+	else
+	{
+		(void) sn_client_nick(sn, b->members[0].client, setter);
+		topicts = ts + (unsigned long) ((unsigned long) sn->now - ts) / 2U;
+	}
+
+	if (b->proto == PROTO_P10)
+		(void) printf("%s T %s %s %lu %lu :%s\r\n", uplink, name, setter, ts, topicts, topic);
+	else
+		(void) printf(":%s TB %s %lu %s :%s\r\n", uplink, name, topicts, setter, topic);
+}
+
+static void
+burst_end(const struct burst *b)
+{
+	char id[SN_NAMELEN];
+
+	// leaves first, so the uplink is the last to finish bursting
+	for (unsigned int k = b->servers; k-- > 0; )
+	{
+		(void) server_ref(b, k, id);
+
+		if (b->proto == PROTO_P10)
+			(void) printf("%s EB\r\n", id);
+		else
+			(void) printf(":%s PONG %s :%s\r\n", id, id, id);
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr, "Usage: %s [options] accounts\n\n", prog);
+	(void) fprintf(stderr, "  -p protocol   ts6 (with EUID, the default), ts5 or p10\n");
+	(void) sn_usage_options(stderr);
 }
 
 int
 main(int argc, char *argv[])
 {
-	int count;
-	time_t now;
+	struct synthnet sn;
+	struct burst b;
+	int c;
+
+	(void) sn_defaults(&sn);
+	(void) memset(&b, 0x00, sizeof b);
+
+	while ((c = getopt(argc, argv, SN_COMMON_OPTS "p:")) != -1)
+	{
+		if (c == 'p' && strcmp(optarg, "ts6") == 0)
+		{
+			b.proto = PROTO_TS6;
+			continue;
+		}
+
+		if (c == 'p' && strcmp(optarg, "ts5") == 0)
+		{
+			b.proto = PROTO_TS5;
+			continue;
+		}
+
+		if (c == 'p' && strcmp(optarg, "p10") == 0)
+		{
+			b.proto = PROTO_P10;
+			continue;
+		}
 
-	init_uid();
+		if (c == '?' || c == 'p' || ! sn_option(&sn, c, optarg))
+		{
+			if (c != '?')
+				(void) fprintf(stderr, "%s: bad argument for -%c: %s\n", argv[0], c, optarg);
 
-	if (argc < 2)
+			(void) usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1 || ! sn_finish(&sn, argv[optind]))
 	{
-		fprintf(stderr, "Usage: %s count\n", argv[0]);
+		(void) usage(argv[0]);
 		return 1;
 	}
 
-	count = atoi(argv[1]);
-	now = time(NULL);
+	b.sn = &sn;
+	b.servers = sn.servers;
 
-	if (argc > 2)
-		return do_burst_ts5(count, now);
+	// P10 has room for 262144 clients per server
+	if (b.proto == PROTO_P10 && sn_clients(&sn) / b.servers >= SN_P10_CLIENTS)
+		b.servers = (unsigned int) (sn_clients(&sn) / SN_P10_CLIENTS) + 1U;
 
-	return do_burst_ts6(count, now);
+	if (b.servers > 4000U)
+	{
+		(void) fprintf(stderr, "%s: too many clients\n", argv[0]);
+		return 1;
+	}
+
+	b.members = calloc(SN_MAX_ACCESS + SN_MAX_MEMBERS, sizeof *b.members);
+
+	if (b.members == NULL)
+	{
+		(void) fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 1;
+	}
+
+	(void) burst_servers(&b);
+	(void) burst_clients(&b);
+
+	for (unsigned long j = 0; j < sn.channels; j++)
+		(void) burst_channel(&b, j, true);
+
+	for (unsigned long j = 0; j < sn.unregistered; j++)
+		(void) burst_channel(&b, j, false);
+
+	(void) burst_end(&b);
+
+	(void) free(b.members);
+
+	if (fflush(stdout) != 0 || ferror(stdout))
+	{
+		(void) fprintf(stderr, "%s: write error: %s\n", argv[0], strerror(errno));
+		return 1;
+	}
+
+	return 0;
 }
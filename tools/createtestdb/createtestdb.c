@@ -0,0 +1,308 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ * SPDX-URL: https://spdx.org/licenses/BSD-2-Clause.html
+ *
+ * Copyright (C) 2008 Jilles Tjoelker
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * make createtestdb
+ * ./createtestdb -s 42 -T 1500000000 500000 >services.db
+ * ../createburst/createburst -s 42 -T 1500000000 500000 >burst.txt
+ *
+ * then start atheme-services with this services.db, or feed both to the
+ * replay benchmark. The database is in the current (DBV 12) format, with
+ * accounts, grouped nicks, metadata, memos, channels and access lists.
+ */
+
+#include	<errno.h>
+#include	<unistd.h>
+
+#include	"../synthnet.h"
+
+#define		DB_VERSION	12U
+
+// CMODE_NOEXT | CMODE_TOPIC, and CMODE_SEC as well
+#define		MLOCK_DEFAULT	0x110U
+#define		MLOCK_SECRET	0x190U
+
+// in the same order as mu_flags[] in libathemecore/flags.c
+static const struct
+{
+	char		flag;
+	double		frequency;
+} mu_flags[] = {
+	{ 'h', 0.005 },
+	{ 's', 0.4 },
+	{ 'm', 0.02 },
+	{ 'C', 1.0 },
+	{ 'E', 0.05 },
+	{ 'P', 0.02 },
+	{ 'p', 0.03 },
+	{ 'Q', 0.05 },
+};
+
+static const char *const mdu_names[] = {
+	"private:usercloak",
+	"private:lastquit:message",
+	"private:loginfail:failnum",
+	"private:loginfail:lastfailaddr",
+	"private:loginfail:lastfailtime",
+	"private:mark:setter",
+	"private:mark:reason",
+	"private:mark:timestamp",
+	"url",
+	"private:greet",
+};
+
+// the entity UIDs myentity_alloc_uid() would have handed out, in order
+static const char *
+entity_id(unsigned long i)
+{
+	static char id[10];
+	unsigned long v = i + 1;
+
+	(void) memset(id, 'A', 9);
+	id[9] = '\0';
+
+	for (int pos = 8; pos > 3; pos--, v /= 36U)
+	{
+		const unsigned int d = (unsigned int) (v % 36U);
+
+		id[pos] = (char) ((d < 26U) ? ('A' + d) : ('0' + d - 26U));
+	}
+
+	id[3] = (char) ('A' + v);
+	return id;
+}
+
+static void
+write_account(const struct synthnet *sn, unsigned long i)
+{
+	char name[SN_NAMELEN], nick[SN_NAMELEN], host[SN_NAMELEN], lower[SN_NAMELEN], sender[SN_NAMELEN];
+	char flags[SN_ARRAY_SIZE(mu_flags) + 2];
+	const uint64_t h = sn_hash(sn, SN_ACCOUNT, i, 3);
+	const time_t reg = sn_account_registered(sn, i);
+	const time_t login = sn_account_lastlogin(sn, i);
+	const uint32_t ip = sn_client_ip(sn, i);
+	unsigned int count, first;
+	size_t len = 0;
+
+	(void) sn_account_name(sn, i, name);
+	(void) snprintf(lower, sizeof lower, "%s", name);
+	(void) sn_lower(lower);
+
+	flags[len++] = '+';
+	for (size_t f = 0; f < SN_ARRAY_SIZE(mu_flags); f++)
+		if (sn_unit(sn_hash(sn, SN_ACCOUNT, i, 16U + f)) < mu_flags[f].frequency)
+			flags[len++] = mu_flags[f].flag;
+	flags[len] = '\0';
+
+	// a bcrypt-shaped hash, so the strings are the size real ones are
+	(void) printf("MU %s %s $2b$10$%016llx%016llx%016llx%05llx %s@%s %lu %lu %s default\n", entity_id(i), name,
+	              (unsigned long long) sn_mix(h), (unsigned long long) sn_mix(h + 1),
+	              (unsigned long long) sn_mix(h + 2), (unsigned long long) (sn_mix(h + 3) & 0xFFFFFU), lower,
+	              sn_domains[h % SN_ARRAY_SIZE(sn_domains)], (unsigned long) reg,
+	              (unsigned long) login, flags);
+
+	(void) sn_client_host(sn, i, host);
+	(void) printf("MDU %s private:host:vhost ~%s@%s\n", name, lower, host);
+	(void) printf("MDU %s private:host:actual ~%s@%u.%u.%u.%u\n", name, lower, ip >> 24, (ip >> 16) & 0xFFU,
+	              (ip >> 8) & 0xFFU, ip & 0xFFU);
+
+	count = sn_geometric(sn_hash(sn, SN_META, i, 0), sn->metadata, SN_ARRAY_SIZE(mdu_names));
+	first = (unsigned int) (sn_hash(sn, SN_META, i, 1) % SN_ARRAY_SIZE(mdu_names));
+
+	for (unsigned int k = 0; k < count; k++)
+	{
+		const char *const md = mdu_names[(first + k) % SN_ARRAY_SIZE(mdu_names)];
+
+		if (strstr(md, "time") != NULL)
+			(void) printf("MDU %s %s %lu\n", name, md, (unsigned long) login);
+		else if (strcmp(md, "private:usercloak") == 0)
+			(void) printf("MDU %s %s user/%s\n", name, md, lower);
+		else if (strcmp(md, "private:loginfail:failnum") == 0)
+			(void) printf("MDU %s %s %u\n", name, md, 1U + (unsigned int) (h >> 60));
+		else if (strcmp(md, "private:loginfail:lastfailaddr") == 0)
+			(void) printf("MDU %s %s %u.%u.%u.%u\n", name, md, ip >> 24, (ip >> 16) & 0xFFU, (ip >> 8) & 0xFFU,
+			              (ip + 1U) & 0xFFU);
+		else if (strcmp(md, "private:mark:setter") == 0)
+			(void) printf("MDU %s %s %s\n", name, md, sn_account_name(sn, (unsigned long) (h % sn->accounts), nick));
+		else if (strcmp(md, "url") == 0)
+			(void) printf("MDU %s %s https://www.%s/~%s\n", name, md,
+			              sn_domains[(h >> 4) % SN_ARRAY_SIZE(sn_domains)], lower);
+		else
+			(void) printf("MDU %s %s %s %s %s\n", name, md, sn_word_at(h, 8), sn_word_at(h, 16), sn_word_at(h, 24));
+	}
+
+	count = sn_geometric(sn_hash(sn, SN_MEMO, i, 0), sn->memos, SN_MAX_MEMOS);
+
+	for (unsigned int k = 0; k < count; k++)
+	{
+		const uint64_t mh = sn_hash(sn, SN_MEMO, i, k + 1U);
+		const time_t sent = login + (time_t) ((double) (sn->now - login) * sn_unit(mh));
+
+		(void) sn_account_name(sn, (unsigned long) (mh % sn->accounts), sender);
+		// most memos have been read
+		(void) printf("ME %s %s %lu %u %s %s %s %s %s\n", name, sender, (unsigned long) sent,
+		              ((mh >> 32) % 10U < 7U) ? 1U : 0U, sn_word_at(mh, 8), sn_word_at(mh, 16), sn_word_at(mh, 24),
+		              sn_word_at(mh, 40), sn_word_at(mh, 48));
+	}
+
+	count = sn_account_nicks(sn, i);
+
+	for (unsigned int k = 0; k <= count; k++)
+	{
+		const time_t nreg = reg + (time_t) ((double) (sn->now - reg) * sn_unit(sn_hash(sn, SN_NICK, i, 100U + k)));
+
+		(void) printf("MN %s %s %lu %lu\n", name, sn_account_nick(sn, i, k, nick), (unsigned long) (k ? nreg : reg),
+		              (unsigned long) login);
+	}
+}
+
+static void
+write_channel(const struct synthnet *sn, unsigned long j)
+{
+	char name[SN_NAMELEN], target[SN_NAMELEN], founder[SN_NAMELEN], topic[BUFSIZ];
+	const uint64_t h = sn_hash(sn, SN_CHANNEL, j, 4);
+	const time_t reg = sn_channel_ts(sn, j, true);
+	const time_t used = sn_channel_used(sn, j);
+	const unsigned int len = sn_channel_access_len(sn, j);
+	char flags[8];
+	size_t fl = 0;
+	struct sn_access ca;
+
+	// hold, verbose, keeptopic, topiclock, guard and private, in mc_flags[] order
+	flags[fl++] = '+';
+	if ((h & 0xFFU) < 3U)
+		flags[fl++] = 'h';
+	if (((h >> 8) & 0xFFU) < 26U)
+		flags[fl++] = 'v';
+	if (((h >> 16) & 0xFFU) < 77U)
+		flags[fl++] = 'k';
+	if (((h >> 24) & 0xFFU) < 26U)
+		flags[fl++] = 't';
+	if (((h >> 32) & 0xFFU) < 154U)
+		flags[fl++] = 'g';
+	if (((h >> 40) & 0xFFU) < 13U)
+		flags[fl++] = 'p';
+	flags[fl] = '\0';
+
+	(void) sn_channel_name(sn, j, true, name);
+	(void) sn_channel_access(sn, j, 0, &ca);
+	(void) sn_account_name(sn, ca.account, founder);
+
+	(void) printf("MC %s %lu %lu %s %u 0 0\n", name, (unsigned long) reg, (unsigned long) used, flags,
+	              sn_channel_secret(sn, j, true) ? MLOCK_SECRET : MLOCK_DEFAULT);
+
+	for (unsigned int k = 0; k < len; k++)
+	{
+		const time_t tmod = reg + (time_t) ((double) (used - reg) * sn_unit(sn_hash(sn, SN_ACCESS, j, 5000U + k)));
+
+		(void) sn_channel_access(sn, j, k, &ca);
+
+		if (ca.role == SN_ROLE_AKICK)
+			(void) snprintf(target, sizeof target, "%s", ca.mask);
+		else
+			(void) sn_account_name(sn, ca.account, target);
+
+		// entries other than the founder's were added by the founder
+		(void) printf("CA %s %s %s %lu %s\n", name, target, sn_role_flags(ca.role),
+		              (unsigned long) (k ? tmod : reg), k ? founder : "*");
+	}
+
+	(void) printf("MDC %s private:channelts %lu\n", name, (unsigned long) reg);
+
+	if (sn_channel_topic(sn, j, true, topic, sizeof topic))
+	{
+		(void) printf("MDC %s private:topic:setter %s\n", name, founder);
+		(void) printf("MDC %s private:topic:text %s\n", name, topic);
+		(void) printf("MDC %s private:topic:ts %lu\n", name, (unsigned long) used);
+	}
+
+	if (((h >> 52) % 20U) == 0)
+		(void) printf("MDC %s url https://%s.%s/\n", name, name + strspn(name, "#"),
+		              sn_domains[(h >> 56) % SN_ARRAY_SIZE(sn_domains)]);
+
+	if (((h >> 58) % 16U) == 0)
+		(void) printf("MDC %s private:entrymsg Welcome to %s, please %s the %s\n", name, name,
+		              sn_word_at(h, 20), sn_word_at(h, 28));
+}
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr, "Usage: %s [options] accounts\n\n", prog);
+	(void) sn_usage_options(stderr);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct synthnet sn;
+	int c;
+
+	(void) sn_defaults(&sn);
+
+	while ((c = getopt(argc, argv, SN_COMMON_OPTS)) != -1)
+	{
+		if (c == '?' || ! sn_option(&sn, c, optarg))
+		{
+			if (c != '?')
+				(void) fprintf(stderr, "%s: bad argument for -%c: %s\n", argv[0], c, optarg);
+
+			(void) usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1 || ! sn_finish(&sn, argv[optind]))
+	{
+		(void) usage(argv[0]);
+		return 1;
+	}
+
+	(void) printf("GRVER 1\n");
+	(void) printf("DBV %u\n", DB_VERSION);
+	(void) printf("LUID %s\n", entity_id(sn.accounts - 1));
+	(void) printf("CF +AFHORVabefhioqrstv\n");
+
+	for (unsigned long i = 0; i < sn.accounts; i++)
+		(void) write_account(&sn, i);
+
+	for (unsigned long j = 0; j < sn.channels; j++)
+		(void) write_channel(&sn, j);
+
+	(void) printf("KID 0\n");
+	(void) printf("XID 0\n");
+	(void) printf("QID 0\n");
+
+	if (fflush(stdout) != 0 || ferror(stdout))
+	{
+		(void) fprintf(stderr, "%s: write error: %s\n", argv[0], strerror(errno));
+		return 1;
+	}
+
+	return 0;
+}
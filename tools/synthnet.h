@@ -0,0 +1,608 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * Synthetic network model shared by createtestdb and createburst.
+ *
+ * Every property of every account, channel and client is a pure function
+ * of the seed, the options and its index, so the two tools agree on names,
+ * access lists and who is online without sharing any state, and neither
+ * needs memory proportional to the size of the network. Given the same
+ * seed, options and -T timestamp the output is byte-for-byte identical.
+ */
+
+#ifndef ATHEME_TOOLS_SYNTHNET_H
+#define ATHEME_TOOLS_SYNTHNET_H
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SN_NAMELEN              64U
+#define SN_MAX_NICKS            20U     // grouped nicks per account, beyond the first
+#define SN_MAX_MEMOS            30U
+#define SN_MAX_ACCESS           1000U   // access list entries per channel
+#define SN_MAX_MEMBERS          5000U   // members per channel, beyond those on the access list
+#define SN_MAX_BANS             100U
+#define SN_P10_CLIENTS          262144U // 3 base64 characters of client numeric
+
+#define SN_ARRAY_SIZE(a)        (sizeof (a) / sizeof (a)[0])
+
+#define SN_COMMON_OPTS          "A:B:c:g:J:m:M:n:o:s:S:T:u:y:"
+
+enum sn_stream
+{
+	SN_ACCOUNT,
+	SN_NICK,
+	SN_META,
+	SN_MEMO,
+	SN_CHANNEL,
+	SN_ACCESS,
+	SN_ONLINE,
+	SN_CLIENT,
+	SN_MEMBER,
+	SN_BAN,
+	SN_TOPIC,
+};
+
+enum sn_role
+{
+	SN_ROLE_FOUNDER,
+	SN_ROLE_VOP,
+	SN_ROLE_HOP,
+	SN_ROLE_AOP,
+	SN_ROLE_SOP,
+	SN_ROLE_AKICK,          // hostmask entry, not an account
+};
+
+struct synthnet
+{
+	uint64_t        seed;
+	time_t          now;
+	unsigned int    years;          // registrations are spread over this many years
+	unsigned long   accounts;
+	unsigned long   channels;       // registered
+	unsigned long   unregistered;   // channels which only exist in the burst
+	unsigned long   guests;         // clients not logged in to any account
+	unsigned int    servers;
+	double          nicks;          // mean grouped nicks per account, beyond the first
+	double          memos;          // mean memos per account
+	double          metadata;       // mean extra metadata entries per account
+	double          access;         // mean access list entries per channel
+	double          online;         // fraction of accounts which are online
+	double          members;        // mean members per channel, beyond those with access
+	double          bans;           // mean bans per channel
+};
+
+struct sn_access
+{
+	enum sn_role    role;
+	unsigned long   account;        // not for SN_ROLE_AKICK
+	char            mask[SN_NAMELEN];
+};
+
+static const char *const sn_syllables[] = {
+	"ba", "ko", "mi", "ra", "te", "zu", "lo", "ne", "shi", "va", "do", "ri", "ka", "mo", "su", "ti",
+	"ge", "fa", "ju", "pe", "no", "xi", "ha", "lu", "we", "yo", "ci", "de", "bri", "sto", "qua", "ly",
+};
+
+static const char *const sn_domains[] = {
+	"example.com", "example.net", "example.org", "mail.example", "inbox.example", "users.example",
+};
+
+static const char *const sn_words[] = {
+	"the", "channel", "meeting", "tomorrow", "release", "please", "review", "patch", "server", "thanks",
+	"later", "about", "network", "question", "weekend", "build", "support", "again", "today", "docs",
+};
+
+static inline const char *
+sn_word_at(const uint64_t h, const unsigned int shift)
+{
+	return sn_words[(h >> shift) % SN_ARRAY_SIZE(sn_words)];
+}
+
+static inline uint64_t
+sn_mix(uint64_t x)
+{
+	x += UINT64_C(0x9E3779B97F4A7C15);
+	x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return x ^ (x >> 31);
+}
+
+static inline uint64_t
+sn_hash(const struct synthnet *const sn, const enum sn_stream stream, const uint64_t index, const uint64_t sub)
+{
+	return sn_mix(sn->seed ^ sn_mix((((uint64_t) stream) << 56) ^ index) ^ sn_mix(~sub));
+}
+
+// uniform in (0, 1)
+static inline double
+sn_unit(const uint64_t h)
+{
+	return ((double) (h >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// geometric on {0, 1, ...} with the given mean
+static inline unsigned int
+sn_geometric(const uint64_t h, const double mean, const unsigned int max)
+{
+	if (mean <= 0.0)
+		return 0;
+
+	const double v = floor(log(sn_unit(h)) / log1p(-1.0 / (1.0 + mean)));
+
+	return (v >= max) ? max : (unsigned int) v;
+}
+
+/* Heavy-tailed (Pareto, alpha 1.5) on {0, 1, ...} with roughly the given
+ * mean: most channels are tiny, a few are huge.
+ */
+static inline unsigned int
+sn_pareto(const uint64_t h, const double mean, const unsigned int max)
+{
+	if (mean <= 0.0)
+		return 0;
+
+	const double v = floor(((mean + 0.5) / 3.0) / pow(sn_unit(h), 1.0 / 1.5));
+
+	return (v >= max) ? max : (unsigned int) v;
+}
+
+static inline uint64_t
+sn_gcd(uint64_t a, uint64_t b)
+{
+	while (b)
+	{
+		const uint64_t t = a % b;
+
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* A walk over [0, n) which visits n distinct values in a scattered order;
+ * used to pick distinct accounts and clients without remembering them.
+ */
+struct sn_walk
+{
+	uint64_t        n;
+	uint64_t        base;
+	uint64_t        step;
+};
+
+static inline void
+sn_walk_init(struct sn_walk *const w, const uint64_t h, const uint64_t n)
+{
+	w->n = n;
+	w->base = n ? (h % n) : 0;
+	w->step = (n > 1) ? (1U + (sn_mix(h) % (n - 1))) : 1;
+
+	while (sn_gcd(w->step, n) > 1)
+		w->step = (w->step % (n - 1)) + 1U;
+}
+
+static inline uint64_t
+sn_walk_at(const struct sn_walk *const w, const uint64_t i)
+{
+	return (w->base + (i % w->n) * w->step) % w->n;
+}
+
+static inline void
+sn_word(uint64_t h, char *const buf, const size_t size)
+{
+	const unsigned int count = 1U + (unsigned int) (h & 3U);
+
+	buf[0] = '\0';
+	h >>= 2;
+
+	for (unsigned int i = 0; i < count; i++, h >>= 5)
+		(void) strncat(buf, sn_syllables[h & 31U], size - strlen(buf) - 1);
+}
+
+static inline void
+sn_lower(char *s)
+{
+	for (; *s; s++)
+		if (*s >= 'A' && *s <= 'Z')
+			*s = (char) (*s - 'A' + 'a');
+}
+
+/* Letters then the decimal index, so names are unique however the letters
+ * come out; a quarter of them are capitalised.
+ */
+static inline const char *
+sn_account_name(const struct synthnet *const sn, const unsigned long i, char *const buf)
+{
+	const uint64_t h = sn_hash(sn, SN_ACCOUNT, i, 0);
+	char word[SN_NAMELEN];
+
+	(void) sn_word(h, word, 16U);
+
+	if (((h >> 40) & 3U) == 0)
+		word[0] = (char) (word[0] - 'a' + 'A');
+
+	(void) snprintf(buf, SN_NAMELEN, "%s%lu", word, i);
+	return buf;
+}
+
+static inline unsigned int
+sn_account_nicks(const struct synthnet *const sn, const unsigned long i)
+{
+	return sn_geometric(sn_hash(sn, SN_NICK, i, 0), sn->nicks, SN_MAX_NICKS);
+}
+
+// grouped nicks: the account name, a separator that names never contain, and a number
+static inline const char *
+sn_account_nick(const struct synthnet *const sn, const unsigned long i, const unsigned int k, char *const buf)
+{
+	static const char *const seps[] = { "_", "|", "`", "-", "^", "[m]" };
+	const size_t len = strlen(sn_account_name(sn, i, buf));
+
+	if (k)
+		(void) snprintf(buf + len, SN_NAMELEN - len, "%s%u",
+		                seps[sn_hash(sn, SN_NICK, i, k) % SN_ARRAY_SIZE(seps)], k);
+
+	return buf;
+}
+
+static inline bool
+sn_account_online(const struct synthnet *const sn, const unsigned long i)
+{
+	return sn_unit(sn_hash(sn, SN_ONLINE, i, 0)) < sn->online;
+}
+
+static inline time_t
+sn_account_registered(const struct synthnet *const sn, const unsigned long i)
+{
+	const double span = (double) sn->years * 365.0 * 86400.0;
+
+	return sn->now - (time_t) (span * sn_unit(sn_hash(sn, SN_ACCOUNT, i, 1)));
+}
+
+// recent logins are far more common than old ones
+static inline time_t
+sn_account_lastlogin(const struct synthnet *const sn, const unsigned long i)
+{
+	const time_t reg = sn_account_registered(sn, i);
+	const double u = sn_unit(sn_hash(sn, SN_ACCOUNT, i, 2));
+
+	return sn->now - (time_t) ((double) (sn->now - reg) * u * u * u);
+}
+
+/* Channel names are #word<index> or ##word<index> when registered, and
+ * #word_<index> otherwise; none of them can collide.
+ */
+static inline const char *
+sn_channel_name(const struct synthnet *const sn, const unsigned long j, const bool registered, char *const buf)
+{
+	const uint64_t h = sn_hash(sn, SN_CHANNEL, j, registered ? 0 : 1);
+	char word[SN_NAMELEN];
+
+	(void) sn_word(h, word, 24U);
+
+	if (! registered)
+		(void) snprintf(buf, SN_NAMELEN, "#%s_%lu", word, j);
+	else if (((h >> 40) % 10U) == 0)
+		(void) snprintf(buf, SN_NAMELEN, "##%s%lu", word, j);
+	else
+		(void) snprintf(buf, SN_NAMELEN, "#%s%lu", word, j);
+
+	return buf;
+}
+
+static inline time_t
+sn_channel_ts(const struct synthnet *const sn, const unsigned long j, const bool registered)
+{
+	const double span = (double) sn->years * 365.0 * 86400.0;
+
+	return sn->now - (time_t) (span * sn_unit(sn_hash(sn, SN_CHANNEL, j, registered ? 2 : 3)));
+}
+
+// when a registered channel was last used; recent use is far more common
+static inline time_t
+sn_channel_used(const struct synthnet *const sn, const unsigned long j)
+{
+	const time_t reg = sn_channel_ts(sn, j, true);
+	const double u = sn_unit(sn_hash(sn, SN_CHANNEL, j, 5));
+
+	return sn->now - (time_t) ((double) (sn->now - reg) * u * u);
+}
+
+// a tenth of channels are +s (and registered ones have that in their mlock)
+static inline bool
+sn_channel_secret(const struct synthnet *const sn, const unsigned long j, const bool registered)
+{
+	return (sn_hash(sn, SN_CHANNEL, j, registered ? 6 : 7) % 10U) == 0;
+}
+
+static inline bool
+sn_channel_topic(const struct synthnet *const sn, const unsigned long j, const bool registered, char *const buf,
+                 const size_t size)
+{
+	const uint64_t h = sn_hash(sn, SN_TOPIC, j, registered ? 0 : 1);
+	const unsigned int words = 3U + (unsigned int) ((h >> 8) % 12U);
+	uint64_t w = sn_mix(h);
+
+	if (sn_unit(h) >= 0.7)
+		return false;
+
+	buf[0] = '\0';
+
+	for (unsigned int i = 0; i < words; i++, w = sn_mix(w))
+	{
+		if (i)
+			(void) strncat(buf, " ", size - strlen(buf) - 1);
+
+		(void) strncat(buf, sn_word_at(w, 0), size - strlen(buf) - 1);
+	}
+
+	return true;
+}
+
+// 1 + heavy-tailed, as every registered channel has a founder
+static inline unsigned int
+sn_channel_access_len(const struct synthnet *const sn, const unsigned long j)
+{
+	unsigned int max = SN_MAX_ACCESS;
+
+	if (sn->accounts < max)
+		max = (unsigned int) sn->accounts;
+
+	return 1U + sn_pareto(sn_hash(sn, SN_ACCESS, j, 0), sn->access - 1.0, max - 1U);
+}
+
+static inline void
+sn_channel_access(const struct synthnet *const sn, const unsigned long j, const unsigned int k,
+                  struct sn_access *const ca)
+{
+	const uint64_t h = sn_hash(sn, SN_ACCESS, j, k + 1U);
+	const double u = sn_unit(h);
+	struct sn_walk w;
+
+	(void) sn_walk_init(&w, sn_hash(sn, SN_ACCESS, j, UINT64_MAX), sn->accounts);
+
+	ca->account = (unsigned long) sn_walk_at(&w, k);
+	ca->mask[0] = '\0';
+
+	if (k == 0)
+		ca->role = SN_ROLE_FOUNDER;
+	else if (u < 0.45)
+		ca->role = SN_ROLE_VOP;
+	else if (u < 0.55)
+		ca->role = SN_ROLE_HOP;
+	else if (u < 0.85)
+		ca->role = SN_ROLE_AOP;
+	else if (u < 0.95)
+		ca->role = SN_ROLE_SOP;
+	else
+	{
+		ca->role = SN_ROLE_AKICK;
+		(void) snprintf(ca->mask, sizeof ca->mask, "*!*@bad%u.%s", (unsigned int) (h >> 40) % 100000U,
+		                sn_domains[(h >> 8) % SN_ARRAY_SIZE(sn_domains)]);
+	}
+}
+
+static inline const char *
+sn_role_flags(const enum sn_role role)
+{
+	switch (role)
+	{
+		case SN_ROLE_FOUNDER:
+			return "+AFRefiorstv";
+		case SN_ROLE_VOP:
+			return "+AVv";
+		case SN_ROLE_HOP:
+			return "+AHhtv";
+		case SN_ROLE_AOP:
+			return "+AOhotv";
+		case SN_ROLE_SOP:
+			return "+AOhiorstv";
+		case SN_ROLE_AKICK:
+			break;
+	}
+
+	return "+b";
+}
+
+/* Clients are numbered 0 .. accounts + guests - 1; client i < accounts is
+ * that account's owner and only exists if they are online.
+ */
+static inline unsigned long
+sn_clients(const struct synthnet *const sn)
+{
+	return sn->accounts + sn->guests;
+}
+
+static inline bool
+sn_client_exists(const struct synthnet *const sn, const unsigned long c)
+{
+	return c >= sn->accounts || sn_account_online(sn, c);
+}
+
+static inline const char *
+sn_client_nick(const struct synthnet *const sn, const unsigned long c, char *const buf)
+{
+	char word[SN_NAMELEN];
+
+	if (c < sn->accounts)
+	{
+		const unsigned int nicks = sn_account_nicks(sn, c);
+		const unsigned int k = nicks ? (unsigned int) (sn_hash(sn, SN_CLIENT, c, 0) % (nicks + 1U)) : 0;
+
+		return sn_account_nick(sn, c, k, buf);
+	}
+
+	(void) sn_word(sn_hash(sn, SN_CLIENT, c, 0), word, 16U);
+	(void) snprintf(buf, SN_NAMELEN, "%s_guest%lu", word, c - sn->accounts);
+	return buf;
+}
+
+static inline uint32_t
+sn_client_ip(const struct synthnet *const sn, const unsigned long c)
+{
+	// 10.0.0.0/8, so nothing here is a real address
+	return UINT32_C(0x0A000000) | (uint32_t) (sn_hash(sn, SN_CLIENT, c, 1) & UINT32_C(0x00FFFFFF));
+}
+
+static inline const char *
+sn_client_host(const struct synthnet *const sn, const unsigned long c, char *const buf)
+{
+	const uint32_t ip = sn_client_ip(sn, c);
+	const uint64_t h = sn_hash(sn, SN_CLIENT, c, 2);
+
+	(void) snprintf(buf, SN_NAMELEN, "ip-%u-%u-%u.isp%u.%s", (ip >> 16) & 0xFFU, (ip >> 8) & 0xFFU, ip & 0xFFU,
+	                (unsigned int) (h % 50U), sn_domains[(h >> 8) % SN_ARRAY_SIZE(sn_domains)]);
+	return buf;
+}
+
+static inline void
+sn_defaults(struct synthnet *const sn)
+{
+	(void) memset(sn, 0x00, sizeof *sn);
+
+	sn->seed = 1;
+	sn->now = time(NULL);
+	sn->years = 8;
+	sn->accounts = 0;
+	sn->channels = ULONG_MAX;
+	sn->unregistered = ULONG_MAX;
+	sn->guests = ULONG_MAX;
+	sn->servers = 4;
+	sn->nicks = 0.3;
+	sn->memos = 0.2;
+	sn->metadata = 1.0;
+	sn->access = 4.0;
+	sn->online = 0.2;
+	sn->members = 6.0;
+	sn->bans = 1.0;
+}
+
+static inline bool
+sn_parse_ulong(const char *const arg, unsigned long *const out)
+{
+	char *end;
+
+	errno = 0;
+	*out = strtoul(arg, &end, 10);
+
+	return *arg && ! *end && ! errno && *out < ULONG_MAX;
+}
+
+static inline bool
+sn_parse_double(const char *const arg, double *const out)
+{
+	char *end;
+
+	*out = strtod(arg, &end);
+
+	return *arg && ! *end && *out >= 0.0;
+}
+
+// handles an option in SN_COMMON_OPTS; false if its argument is bad
+static inline bool
+sn_option(struct synthnet *const sn, const int c, const char *const arg)
+{
+	unsigned long v;
+
+	switch (c)
+	{
+		case 'A':
+			return sn_parse_double(arg, &sn->access);
+		case 'B':
+			return sn_parse_double(arg, &sn->bans);
+		case 'c':
+			return sn_parse_ulong(arg, &sn->channels);
+		case 'g':
+			return sn_parse_ulong(arg, &sn->guests);
+		case 'J':
+			return sn_parse_double(arg, &sn->members);
+		case 'm':
+			return sn_parse_double(arg, &sn->memos);
+		case 'M':
+			return sn_parse_double(arg, &sn->metadata);
+		case 'n':
+			return sn_parse_double(arg, &sn->nicks);
+		case 'o':
+			return sn_parse_double(arg, &sn->online) && sn->online <= 1.0;
+		case 's':
+			if (! sn_parse_ulong(arg, &v))
+				return false;
+			sn->seed = v;
+			return true;
+		case 'S':
+			if (! sn_parse_ulong(arg, &v) || ! v || v > 1000U)
+				return false;
+			sn->servers = (unsigned int) v;
+			return true;
+		case 'T':
+			if (! sn_parse_ulong(arg, &v))
+				return false;
+			sn->now = (time_t) v;
+			return true;
+		case 'u':
+			return sn_parse_ulong(arg, &sn->unregistered);
+		case 'y':
+			if (! sn_parse_ulong(arg, &v) || ! v || v > 50U)
+				return false;
+			sn->years = (unsigned int) v;
+			return true;
+	}
+
+	return false;
+}
+
+// fills in the counts which default to a proportion of the accounts
+static inline bool
+sn_finish(struct synthnet *const sn, const char *const accounts)
+{
+	if (! sn_parse_ulong(accounts, &sn->accounts) || ! sn->accounts || sn->accounts > 100000000UL)
+		return false;
+
+	if (sn->channels == ULONG_MAX)
+		sn->channels = sn->accounts / 5U;
+	if (sn->unregistered == ULONG_MAX)
+		sn->unregistered = sn->channels / 2U;
+	if (sn->guests == ULONG_MAX)
+		sn->guests = sn->accounts / 4U;
+
+	return true;
+}
+
+static inline void
+sn_usage_options(FILE *const out)
+{
+	(void) fprintf(out,
+	    "  -s seed       seed for every choice made (default 1)\n"
+	    "  -T time       current time, for reproducible timestamps (default now)\n"
+	    "  -y years      spread registrations over this many years (default 8)\n"
+	    "  -n mean       grouped nicks per account, beyond the first (default 0.3)\n"
+	    "  -m mean       memos per account (default 0.2)\n"
+	    "  -M mean       extra metadata entries per account (default 1)\n"
+	    "  -c count      registered channels (default accounts / 5)\n"
+	    "  -A mean       access list entries per channel, heavy-tailed (default 4)\n"
+	    "  -u count      unregistered channels (default registered / 2)\n"
+	    "  -o fraction   accounts online and logged in (default 0.2)\n"
+	    "  -g count      online clients without an account (default accounts / 4)\n"
+	    "  -J mean       members per channel beyond those with access, heavy-tailed (default 6)\n"
+	    "  -B mean       bans per channel (default 1)\n"
+	    "  -S count      servers the clients are spread over (default 4)\n"
+	    "\n"
+	    "createtestdb and createburst given the same options describe the same network.\n");
+}
+
+#endif /* !ATHEME_TOOLS_SYNTHNET_H */